@@ -4,8 +4,10 @@
 module;
 
 #include <wrappers/buffer.h>
+#include <wrappers/device.h>
 #include <wrappers/memory_block.h>
 #include <misc/buffer_create_info.h>
+#include <misc/memory_block_create_info.h>
 #if 0
 #include <wrappers/device.h>
 #include <wrappers/instance.h>
@@ -42,16 +44,12 @@ module pragma.prosper.vulkan;
 
 import :buffer.buffer;
 
-std::mutex &get_mem_alloc_mutex();
 prosper::VlkBuffer::VlkBuffer(IPrContext &context, const util::BufferCreateInfo &bufCreateInfo, DeviceSize startOffset, DeviceSize size, Anvil::BufferUniquePtr buf) : IBuffer {context, bufCreateInfo, startOffset, size}, m_buffer {std::move(buf)}
 {
 	if(m_buffer != nullptr) {
-		auto &memAllocMutex = get_mem_alloc_mutex();
-		memAllocMutex.lock();
-		m_buffer->get_buffer(); // This will invoke memory allocation and is not thread-safe!
-		memAllocMutex.unlock();
-		prosper::debug::register_debug_object(m_buffer->get_buffer(), *this, prosper::debug::ObjectType::Buffer);
+		// This will invoke the memory allocation (see VlkImage constructor)
 		m_vkBuffer = m_buffer->get_buffer();
+		prosper::debug::register_debug_object(m_vkBuffer, *this, prosper::debug::ObjectType::Buffer);
 
 		if(GetContext().IsValidationEnabled())
 			VlkDebugObject::Init(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
@@ -60,11 +58,15 @@ prosper::VlkBuffer::VlkBuffer(IPrContext &context, const util::BufferCreateInfo
 }
 prosper::VlkBuffer::~VlkBuffer()
 {
+	ReleasePersistentMapping();
 	MemoryTracker::GetInstance().RemoveResource(*this);
-	if(GetContext().IsValidationEnabled())
-		VlkDebugObject::Clear(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
-	if(m_buffer != nullptr)
+	if(m_buffer != nullptr) {
+		if(GetContext().IsValidationEnabled())
+			VlkDebugObject::Clear(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
 		prosper::debug::deregister_debug_object(m_buffer->get_buffer());
+	}
+	// Has to be destroyed before the memory owner
+	m_buffer = nullptr;
 }
 void prosper::VlkBuffer::Initialize()
 {
@@ -107,25 +109,291 @@ const Anvil::Buffer &prosper::VlkBuffer::operator*() const { return const_cast<V
 Anvil::Buffer *prosper::VlkBuffer::operator->() { return m_buffer.get(); }
 const Anvil::Buffer *prosper::VlkBuffer::operator->() const { return const_cast<VlkBuffer *>(this)->operator->(); }
 
+const prosper::VlkBuffer &prosper::VlkBuffer::GetRootBuffer() const
+{
+	auto *buf = this;
+	while(buf->m_parent)
+		buf = &buf->m_parent->GetAPITypeRef<VlkBuffer>();
+	return *buf;
+}
+
+const prosper::VlkBuffer::PersistentMapping *prosper::VlkBuffer::GetPersistentMapping() const
+{
+	auto &root = GetRootBuffer();
+	std::scoped_lock lock {root.m_persistentMappingMutex};
+	auto &mapping = root.m_persistentMapping;
+	if(mapping.initialized)
+		return mapping.data ? &mapping : nullptr;
+	mapping.initialized = true;
+	auto *memBlock = root.m_buffer ? root.m_buffer->get_memory_block(0u) : nullptr;
+	auto *memCreateInfo = memBlock ? memBlock->get_create_info_ptr() : nullptr;
+	if(memCreateInfo == nullptr)
+		return nullptr;
+	auto &memProps = static_cast<VlkContext &>(GetContext()).GetDevice().get_physical_device_memory_properties();
+	if(memCreateInfo->get_memory_type_index() >= memProps.types.size())
+		return nullptr;
+	auto &memType = memProps.types[memCreateInfo->get_memory_type_index()];
+	if((memType.features & Anvil::MemoryFeatureFlagBits::MAPPABLE_BIT) == Anvil::MemoryFeatureFlagBits::NONE)
+		return nullptr;
+	void *data = nullptr;
+	if(!memBlock->map(0, memBlock->get_size(), &data) || data == nullptr)
+		return nullptr;
+	mapping.data = static_cast<uint8_t *>(data);
+	mapping.memory = memBlock->get_memory();
+	mapping.memoryOffset = memBlock->get_start_offset();
+	mapping.memorySize = memBlock->get_size();
+	mapping.coherent = (memType.features & Anvil::MemoryFeatureFlagBits::HOST_COHERENT_BIT) != Anvil::MemoryFeatureFlagBits::NONE;
+	// Uncached host-visible memory is write-combined, so it benefits from streaming stores
+	mapping.writeCombined = (memType.features & Anvil::MemoryFeatureFlagBits::HOST_CACHED_BIT) == Anvil::MemoryFeatureFlagBits::NONE;
+	return &mapping;
+}
+
+void prosper::VlkBuffer::ReleasePersistentMapping()
+{
+	if(m_parent)
+		return;
+	auto &context = static_cast<VlkContext &>(GetContext());
+	context.UnregisterDirtyBuffer(*this);
+	// Pending writes have to be flushed before the memory is unmapped
+	std::vector<VkMappedMemoryRange> ranges;
+	CollectDirtyRanges(ranges, context.GetDevice().get_physical_device_properties().core_vk1_0_properties_ptr->limits.non_coherent_atom_size);
+	if(!ranges.empty())
+		vkFlushMappedMemoryRanges(context.GetDevice().get_device_vk(), static_cast<uint32_t>(ranges.size()), ranges.data());
+	std::scoped_lock lock {m_persistentMappingMutex};
+	if(m_persistentMapping.data)
+		m_buffer->get_memory_block(0u)->unmap();
+	m_persistentMapping = {};
+	m_mappedRange = {};
+}
+
+uint8_t *prosper::VlkBuffer::GetPersistentHostPointer() const
+{
+	auto *mapping = GetPersistentMapping();
+	return mapping ? (mapping->data + GetStartOffset()) : nullptr;
+}
+bool prosper::VlkBuffer::IsHostCoherent() const
+{
+	auto *mapping = GetPersistentMapping();
+	return !mapping || mapping->coherent;
+}
+
+using DirtyRange = std::pair<prosper::DeviceSize, prosper::DeviceSize>;
+static void add_dirty_range(std::vector<DirtyRange> &ranges, prosper::DeviceSize start, prosper::DeviceSize end)
+{
+	// Consecutive writes are usually sequential, so try to extend the last range first
+	if(!ranges.empty() && ranges.back().second >= start && ranges.back().first <= end) {
+		ranges.back().first = pragma::math::min(ranges.back().first, start);
+		ranges.back().second = pragma::math::max(ranges.back().second, end);
+	}
+	else
+		ranges.push_back({start, end});
+}
+// Ranges have to be aligned to the non-coherent atom size relative to the start of the VkDeviceMemory. Overlapping and adjacent ranges are merged.
+static void append_mapped_memory_ranges(std::vector<DirtyRange> &ranges, VkDeviceMemory memory, VkDeviceSize memoryOffset, VkDeviceSize memorySize, prosper::DeviceSize nonCoherentAtomSize, std::vector<VkMappedMemoryRange> &outRanges)
+{
+	auto atomSize = pragma::math::max(nonCoherentAtomSize, static_cast<prosper::DeviceSize>(1));
+	auto memoryEnd = memoryOffset + memorySize;
+	for(auto &range : ranges) {
+		range.first = ((memoryOffset + range.first) / atomSize) * atomSize;
+		range.second = pragma::math::min(((memoryOffset + range.second + atomSize - 1) / atomSize) * atomSize, memoryEnd);
+	}
+	std::sort(ranges.begin(), ranges.end());
+	auto first = outRanges.size();
+	for(auto &range : ranges) {
+		if(outRanges.size() > first) {
+			auto &prev = outRanges.back();
+			if(range.first <= prev.offset + prev.size) {
+				prev.size = pragma::math::max(prev.offset + prev.size, range.second) - prev.offset;
+				continue;
+			}
+		}
+		VkMappedMemoryRange memRange {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+		memRange.memory = memory;
+		memRange.offset = range.first;
+		memRange.size = range.second - range.first;
+		outRanges.push_back(memRange);
+	}
+}
+
+void prosper::VlkBuffer::AddDirtyRange(DeviceSize offset, DeviceSize size) const
+{
+	auto &root = GetRootBuffer();
+	auto start = GetStartOffset() + offset;
+	auto wasEmpty = false;
+	{
+		std::scoped_lock lock {root.m_persistentMappingMutex};
+		auto &ranges = root.m_persistentMapping.dirtyRanges;
+		wasEmpty = ranges.empty();
+		add_dirty_range(ranges, start, start + size);
+	}
+	if(wasEmpty)
+		static_cast<VlkContext &>(GetContext()).RegisterDirtyBuffer(const_cast<VlkBuffer &>(root));
+}
+
+void prosper::VlkBuffer::BeginMappedRange(DeviceSize offset, DeviceSize size) const
+{
+	auto &root = GetRootBuffer();
+	auto start = GetStartOffset() + offset;
+	std::optional<DirtyRange> prevRange {};
+	{
+		std::scoped_lock lock {root.m_persistentMappingMutex};
+		auto &mappedRanges = root.m_persistentMapping.mappedRanges;
+		if(m_mappedRange) {
+			// Mapped again without having been unmapped
+			auto it = std::find(mappedRanges.begin(), mappedRanges.end(), *m_mappedRange);
+			if(it != mappedRanges.end())
+				mappedRanges.erase(it);
+			prevRange = m_mappedRange;
+		}
+		m_mappedRange = DirtyRange {start, start + size};
+		mappedRanges.push_back(*m_mappedRange);
+	}
+	if(prevRange)
+		AddDirtyRange(prevRange->first - GetStartOffset(), prevRange->second - prevRange->first);
+	// The buffer stays registered while the range is mapped, so that it's flushed before every submission
+	static_cast<VlkContext &>(GetContext()).RegisterDirtyBuffer(const_cast<VlkBuffer &>(root));
+}
+
+void prosper::VlkBuffer::EndMappedRange() const
+{
+	auto &root = GetRootBuffer();
+	std::optional<DirtyRange> range {};
+	{
+		std::scoped_lock lock {root.m_persistentMappingMutex};
+		if(!m_mappedRange)
+			return;
+		auto &mappedRanges = root.m_persistentMapping.mappedRanges;
+		auto it = std::find(mappedRanges.begin(), mappedRanges.end(), *m_mappedRange);
+		if(it != mappedRanges.end())
+			mappedRanges.erase(it);
+		range = m_mappedRange;
+		m_mappedRange = {};
+	}
+	// Anything that has been written since the last flush still has to be flushed
+	AddDirtyRange(range->first - GetStartOffset(), range->second - range->first);
+}
+
+bool prosper::VlkBuffer::CollectDirtyRanges(std::vector<VkMappedMemoryRange> &outRanges, DeviceSize nonCoherentAtomSize) const
+{
+	std::scoped_lock lock {m_persistentMappingMutex};
+	auto &mapping = m_persistentMapping;
+	if(mapping.memory == VK_NULL_HANDLE) {
+		mapping.dirtyRanges.clear();
+		return false;
+	}
+	// Ranges that are still mapped may have been written to since the last flush, but they remain mapped, so they're not cleared
+	auto ranges = std::move(mapping.dirtyRanges);
+	mapping.dirtyRanges.clear();
+	ranges.insert(ranges.end(), mapping.mappedRanges.begin(), mapping.mappedRanges.end());
+	if(!ranges.empty())
+		append_mapped_memory_ranges(ranges, mapping.memory, mapping.memoryOffset, mapping.memorySize, nonCoherentAtomSize, outRanges);
+	return !mapping.mappedRanges.empty();
+}
+
+prosper::VlkBuffer::FlushBenchmarkResult prosper::VlkBuffer::RunFlushBenchmark(uint32_t writeCount, DeviceSize writeSize, DeviceSize nonCoherentAtomSize)
+{
+	FlushBenchmarkResult result {};
+	result.writes = writeCount;
+	// Mostly sequential writes, with a gap after every 16 writes
+	constexpr uint32_t writesPerRun = 16;
+	auto memorySize = (static_cast<DeviceSize>(writeCount) + writeCount / writesPerRun + 1) * writeSize;
+	std::vector<VkMappedMemoryRange> ranges;
+
+	auto t = std::chrono::steady_clock::now();
+	std::vector<DirtyRange> dirtyRanges;
+	DeviceSize offset = 0;
+	for(auto i = decltype(writeCount) {0u}; i < writeCount; ++i) {
+		if(i > 0 && (i % writesPerRun) == 0)
+			offset += writeSize;
+		add_dirty_range(dirtyRanges, offset, offset + writeSize);
+		offset += writeSize;
+	}
+	append_mapped_memory_ranges(dirtyRanges, VK_NULL_HANDLE, 0, memorySize, nonCoherentAtomSize, ranges);
+	result.batchedRanges = static_cast<uint32_t>(ranges.size());
+	result.batchedDuration = std::chrono::steady_clock::now() - t;
+
+	// Without batching, every write is flushed individually
+	ranges.clear();
+	t = std::chrono::steady_clock::now();
+	offset = 0;
+	for(auto i = decltype(writeCount) {0u}; i < writeCount; ++i) {
+		if(i > 0 && (i % writesPerRun) == 0)
+			offset += writeSize;
+		std::vector<DirtyRange> writeRange {{offset, offset + writeSize}};
+		append_mapped_memory_ranges(writeRange, VK_NULL_HANDLE, 0, memorySize, nonCoherentAtomSize, ranges);
+		offset += writeSize;
+	}
+	result.unbatchedRanges = static_cast<uint32_t>(ranges.size());
+	result.unbatchedDuration = std::chrono::steady_clock::now() - t;
+	return result;
+}
+
+void prosper::VlkBuffer::InvalidateRange(DeviceSize offset, DeviceSize size) const
+{
+	auto *mapping = GetPersistentMapping();
+	if(!mapping || mapping->coherent)
+		return;
+	auto &dev = static_cast<VlkContext &>(GetContext()).GetDevice();
+	auto atomSize = pragma::math::max(static_cast<DeviceSize>(dev.get_physical_device_properties().core_vk1_0_properties_ptr->limits.non_coherent_atom_size), static_cast<DeviceSize>(1));
+	auto start = mapping->memoryOffset + GetStartOffset() + offset;
+	VkMappedMemoryRange memRange {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+	memRange.memory = mapping->memory;
+	memRange.offset = (start / atomSize) * atomSize;
+	memRange.size = pragma::math::min(((start + size + atomSize - 1) / atomSize) * atomSize, mapping->memoryOffset + mapping->memorySize) - memRange.offset;
+	vkInvalidateMappedMemoryRanges(dev.get_device_vk(), 1, &memRange);
+}
+
 bool prosper::VlkBuffer::DoWrite(Offset offset, Size size, const void *data) const
 {
 	if(size == 0)
 		return true;
-	return m_buffer->get_memory_block(0u)->write(offset, size, data);
+	auto *mapping = GetPersistentMapping();
+	if(!mapping)
+		return m_buffer->get_memory_block(0u)->write(offset, size, data);
+	auto *dst = mapping->data + GetStartOffset() + offset;
+	if(mapping->writeCombined)
+		util::copy_write_combined(dst, data, size);
+	else
+		memcpy(dst, data, size);
+	if(!mapping->coherent)
+		AddDirtyRange(offset, size);
+	return true;
 }
 bool prosper::VlkBuffer::DoRead(Offset offset, Size size, void *data) const
 {
 	if(size == 0)
 		return true;
-	return m_buffer->get_memory_block(0u)->read(offset, size, data);
+	auto *mapping = GetPersistentMapping();
+	if(!mapping)
+		return m_buffer->get_memory_block(0u)->read(offset, size, data);
+	InvalidateRange(offset, size);
+	memcpy(data, mapping->data + GetStartOffset() + offset, size);
+	return true;
 }
 bool prosper::VlkBuffer::DoMap(Offset offset, Size size, MapFlags mapFlags, void **optOutMappedPtr) const
 {
 	if(size == 0)
 		return false;
-	return m_buffer->get_memory_block(0u)->map(offset, size, optOutMappedPtr);
+	auto *mapping = GetPersistentMapping();
+	if(!mapping)
+		return m_buffer->get_memory_block(0u)->map(offset, size, optOutMappedPtr);
+	InvalidateRange(offset, size);
+	if(optOutMappedPtr)
+		*optOutMappedPtr = mapping->data + GetStartOffset() + offset;
+	// The caller may write to the mapped range until it is unmapped, so it's flushed before every submission until then,
+	// and recorded as dirty once it has been unmapped
+	if(!mapping->coherent)
+		BeginMappedRange(offset, size);
+	return true;
+}
+bool prosper::VlkBuffer::DoUnmap() const
+{
+	if(GetPersistentMapping()) {
+		EndMappedRange();
+		return true;
+	}
+	return m_buffer->get_memory_block(0u)->unmap();
 }
-bool prosper::VlkBuffer::DoUnmap() const { return m_buffer->get_memory_block(0u)->unmap(); }
 
 void prosper::VlkBuffer::RecreateInternalSubBuffer(IBuffer &newParentBuffer)
 {
@@ -135,19 +403,44 @@ void prosper::VlkBuffer::RecreateInternalSubBuffer(IBuffer &newParentBuffer)
 	SetBuffer(Anvil::Buffer::create(Anvil::BufferCreateInfo::create_no_alloc_child(&newParentBuffer.GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), startOffset, size)));
 }
 
-void prosper::VlkBuffer::SetBuffer(Anvil::BufferUniquePtr buf)
+void prosper::VlkBuffer::SetBuffer(Anvil::BufferUniquePtr buf) { ReplaceBuffer(std::move(buf)); }
+Anvil::BufferUniquePtr prosper::VlkBuffer::ReplaceBuffer(Anvil::BufferUniquePtr buf)
 {
 	auto bPermanentlyMapped = m_permanentlyMapped;
 	SetPermanentlyMapped(false, prosper::IBuffer::MapFlags::None);
+	ReleasePersistentMapping();
 
-	if(m_buffer != nullptr)
+	auto validationEnabled = GetContext().IsValidationEnabled();
+	if(m_buffer != nullptr) {
+		if(validationEnabled)
+			VlkDebugObject::Clear(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
 		prosper::debug::deregister_debug_object(m_buffer->get_buffer());
+	}
+	auto oldBuffer = std::move(m_buffer);
 	m_buffer = std::move(buf);
 	if(m_buffer != nullptr) {
-		prosper::debug::register_debug_object(m_buffer->get_buffer(), *this, prosper::debug::ObjectType::Buffer);
 		m_vkBuffer = m_buffer->get_buffer();
+		prosper::debug::register_debug_object(m_vkBuffer, *this, prosper::debug::ObjectType::Buffer);
+		if(validationEnabled)
+			VlkDebugObject::Init(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
 	}
+	else
+		m_vkBuffer = VK_NULL_HANDLE;
+	MemoryTracker::GetInstance().UpdateResource(*this);
 
-	if(m_permanentlyMapped.has_value())
-		SetPermanentlyMapped(true, *m_permanentlyMapped);
+	if(bPermanentlyMapped.has_value())
+		SetPermanentlyMapped(true, *bPermanentlyMapped);
+	return oldBuffer;
+}
+Anvil::BufferUniquePtr prosper::VlkBuffer::ReleaseBuffer()
+{
+	ReleasePersistentMapping();
+	MemoryTracker::GetInstance().RemoveResource(*this);
+	if(m_buffer != nullptr) {
+		if(GetContext().IsValidationEnabled())
+			VlkDebugObject::Clear(GetContext(), debug::ObjectType::Buffer, GetInternalHandle());
+		prosper::debug::deregister_debug_object(m_buffer->get_buffer());
+	}
+	m_vkBuffer = VK_NULL_HANDLE;
+	return std::move(m_buffer);
 }
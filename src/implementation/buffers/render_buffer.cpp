@@ -30,6 +30,14 @@ bool VlkRenderBuffer::Record(VkCommandBuffer cmdBuf) const
 		vkCmdBindIndexBuffer(cmdBuf, m_vkIndexBuffer, m_vkIndexBufferOffset, static_cast<VkIndexType>(m_indexBufferInfo->indexType));
 	return true;
 }
+void VlkRenderBuffer::OnBuffersRelocated(const std::unordered_set<const IBuffer *> &buffers)
+{
+	auto referenced = std::find_if(m_buffers.begin(), m_buffers.end(), [&buffers](const auto &buf) { return buffers.contains(&*buf); }) != m_buffers.end();
+	if(!referenced && m_indexBufferInfo.has_value())
+		referenced = buffers.contains(&*m_indexBufferInfo->buffer);
+	if(referenced)
+		Reload();
+}
 void VlkRenderBuffer::Reload()
 {
 	m_vkBuffers.clear();
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module pragma.prosper.vulkan;
+
+import :buffer.transient_buffer_allocator;
+
+using namespace prosper;
+
+// The alignment is not necessarily a power of two (see VlkContext::CalcBufferAlignment)
+static DeviceSize align_size(DeviceSize size, DeviceSize alignment) { return ((size + alignment - 1) / alignment) * alignment; }
+
+std::unique_ptr<TransientBufferAllocator> TransientBufferAllocator::Create(IPrContext &context, DeviceSize sizePerFrame, uint32_t frameCount, BufferUsageFlags usageFlags)
+{
+	if(sizePerFrame == 0 || frameCount == 0)
+		return nullptr;
+	auto &vkContext = static_cast<VlkContext &>(context);
+	auto alignment = pragma::math::max(vkContext.CalcBufferAlignment(usageFlags), static_cast<DeviceSize>(1));
+	sizePerFrame = align_size(sizePerFrame, alignment);
+
+	// Prefer device-local memory that is visible to the host (resizable BAR), so the GPU doesn't have to read the data over PCIe
+	constexpr auto hostVisibleFlags = MemoryFeatureFlags::HostAccessable | MemoryFeatureFlags::HostCoherent;
+	constexpr auto barFlags = hostVisibleFlags | MemoryFeatureFlags::DeviceLocal;
+	// Without resizable BAR the heap is only a small window (usually 256 MiB), so large buffers are kept out of it
+	auto &memTypeTable = vkContext.GetMemoryTypeTable();
+	auto &barType = memTypeTable.FindCompatibleMemoryType(barFlags);
+	auto deviceLocal = (barType.IsValid() && barType.featureFlags == barFlags && (memTypeTable.IsResizableBarAvailable() || sizePerFrame * frameCount <= memTypeTable.GetBarHeapSize() / 8));
+
+	prosper::util::BufferCreateInfo createInfo {};
+	createInfo.size = sizePerFrame * frameCount;
+	createInfo.usageFlags = usageFlags;
+	createInfo.memoryFeatures = deviceLocal ? barFlags : hostVisibleFlags;
+	createInfo.debugName = "transient_buffer";
+	auto buf = context.CreateBuffer(createInfo);
+	if(!buf)
+		return nullptr;
+	void *ptr = nullptr;
+	if(buf->Map(0, createInfo.size, IBuffer::MapFlags::None, &ptr) == false || ptr == nullptr)
+		return nullptr;
+
+	auto allocator = std::unique_ptr<TransientBufferAllocator> {new TransientBufferAllocator {}};
+	allocator->m_buffer = std::move(buf);
+	allocator->m_mappedPtr = static_cast<uint8_t *>(ptr);
+	allocator->m_alignment = alignment;
+	allocator->m_sizePerFrame = sizePerFrame;
+	allocator->m_frameCount = frameCount;
+	allocator->m_deviceLocal = deviceLocal;
+	return allocator;
+}
+
+TransientBufferAllocator::~TransientBufferAllocator()
+{
+	if(m_buffer && m_mappedPtr)
+		m_buffer->Unmap();
+}
+
+TransientBufferAllocator::Allocation TransientBufferAllocator::Allocate(DeviceSize size)
+{
+	if(size == 0)
+		return {};
+	auto alignedSize = align_size(size, m_alignment);
+	auto head = m_head.fetch_add(alignedSize, std::memory_order_relaxed);
+	auto offset = head & HEAD_MASK;
+	if(offset + size > m_sizePerFrame) {
+		m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+		return {};
+	}
+	m_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	auto absOffset = (head >> FRAME_INDEX_SHIFT) * m_sizePerFrame + offset;
+	return {m_buffer.get(), absOffset, m_mappedPtr + absOffset};
+}
+
+TransientBufferAllocator::Allocation TransientBufferAllocator::Write(const void *data, DeviceSize size)
+{
+	auto alloc = Allocate(size);
+	if(alloc.IsValid())
+		memcpy(alloc.data, data, size);
+	return alloc;
+}
+
+void TransientBufferAllocator::BeginFrame(uint32_t frameIndex)
+{
+	auto head = m_head.exchange(static_cast<DeviceSize>(frameIndex % m_frameCount) << FRAME_INDEX_SHIFT, std::memory_order_relaxed);
+	auto usage = pragma::math::min(head & HEAD_MASK, m_sizePerFrame);
+	if(usage > m_peakUsage.load(std::memory_order_relaxed))
+		m_peakUsage.store(usage, std::memory_order_relaxed);
+}
+
+TransientBufferAllocator::Stats TransientBufferAllocator::GetStats() const
+{
+	Stats stats {};
+	stats.sizePerFrame = m_sizePerFrame;
+	stats.frameCount = m_frameCount;
+	stats.peakUsage = m_peakUsage.load(std::memory_order_relaxed);
+	stats.allocationCount = m_allocationCount.load(std::memory_order_relaxed);
+	stats.overflowCount = m_overflowCount.load(std::memory_order_relaxed);
+	stats.deviceLocal = m_deviceLocal;
+	return stats;
+}
@@ -42,15 +42,21 @@ bool prosper::VlkCommandBuffer::RecordBindDescriptorSets(PipelineBindPoint bindP
 		r->AddArgument("dynamicOffsets", dynamicOffsets);
 	}
 #endif
-	std::vector<Anvil::DescriptorSet *> anvDescSets {};
-	anvDescSets.reserve(descSets.size());
+	prosper::PipelineID pipelineId;
+	if(shader.GetPipelineId(pipelineId, pipelineIdx) == false)
+		return false;
+	// Pipelines created from pipeline libraries don't have an Anvil pipeline layout
+	auto vkLayout = static_cast<VlkContext &>(GetContext()).GetVkPipelineLayout(shader.IsGraphicsShader(), pipelineId);
+	if(vkLayout == VK_NULL_HANDLE)
+		return false;
+	std::vector<VkDescriptorSet> vkDescSets {};
+	vkDescSets.reserve(descSets.size());
 	for(auto *ds : descSets) {
 		UpdateLastUsageTimes(*ds);
-		anvDescSets.push_back(&static_cast<prosper::VlkDescriptorSet &>(*ds).GetAnvilDescriptorSet());
+		vkDescSets.push_back(static_cast<prosper::VlkDescriptorSet &>(*ds).GetVkDescriptorSet());
 	}
-	prosper::PipelineID pipelineId;
-	return shader.GetPipelineId(pipelineId, pipelineIdx)
-	  && (*this)->record_bind_descriptor_sets(static_cast<Anvil::PipelineBindPoint>(bindPoint), static_cast<VlkContext &>(GetContext()).GetPipelineLayout(shader.IsGraphicsShader(), pipelineId), firstSet, anvDescSets.size(), anvDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	vkCmdBindDescriptorSets(m_vkCommandBuffer, static_cast<VkPipelineBindPoint>(bindPoint), vkLayout, firstSet, vkDescSets.size(), vkDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	return true;
 }
 
 bool prosper::VlkCommandBuffer::RecordBindDescriptorSets(PipelineBindPoint bindPoint, const IShaderPipelineLayout &pipelineLayout, uint32_t firstSet, uint32_t numDescSets, const prosper::IDescriptorSet *const *descSets, uint32_t numDynamicOffsets, const uint32_t *dynamicOffsets)
@@ -130,7 +136,13 @@ bool prosper::VlkCommandBuffer::RecordPushConstants(prosper::Shader &shader, Pip
 	}
 #endif
 	prosper::PipelineID pipelineId;
-	return shader.GetPipelineId(pipelineId, pipelineIdx) && (*this)->record_push_constants(static_cast<VlkContext &>(GetContext()).GetPipelineLayout(shader.IsGraphicsShader(), pipelineId), static_cast<Anvil::ShaderStageFlagBits>(stageFlags), offset, size, data);
+	if(shader.GetPipelineId(pipelineId, pipelineIdx) == false)
+		return false;
+	auto vkLayout = static_cast<VlkContext &>(GetContext()).GetVkPipelineLayout(shader.IsGraphicsShader(), pipelineId);
+	if(vkLayout == VK_NULL_HANDLE)
+		return false;
+	vkCmdPushConstants(m_vkCommandBuffer, vkLayout, static_cast<VkShaderStageFlags>(stageFlags), offset, size, data);
+	return true;
 }
 bool prosper::VlkCommandBuffer::DoRecordBindShaderPipeline(prosper::Shader &shader, PipelineID shaderPipelineId, PipelineID pipelineId)
 {
@@ -143,7 +155,23 @@ bool prosper::VlkCommandBuffer::DoRecordBindShaderPipeline(prosper::Shader &shad
 		r->AddArgument("pipelineId", pipelineId);
 	}
 #endif
-	return (*this)->record_bind_pipeline(static_cast<Anvil::PipelineBindPoint>(shader.GetPipelineBindPoint()), static_cast<VlkContext &>(GetContext()).GetAnvilPipelineId(pipelineId));
+	auto &context = static_cast<VlkContext &>(GetContext());
+	if(auto *gpl = context.GetGraphicsPipelineLibraryManager(); gpl && shader.IsGraphicsShader()) {
+		auto dynamicStates = ExtendedDynamicStateFlags::None;
+		GraphicsPipelineLibraryManager::ExtendedDynamicStateValues dynamicStateValues {};
+		if(auto vkPipeline = gpl->GetPipeline(pipelineId, m_dynamicRenderingActive, dynamicStates, dynamicStateValues); vkPipeline != VK_NULL_HANDLE) {
+			vkCmdBindPipeline(m_vkCommandBuffer, static_cast<VkPipelineBindPoint>(shader.GetPipelineBindPoint()), vkPipeline);
+			ApplyExtendedDynamicState(dynamicStates, dynamicStateValues);
+			return true;
+		}
+	}
+	// Render pass pipelines are incompatible with dynamic rendering
+	if(m_dynamicRenderingActive && shader.IsGraphicsShader())
+		return false;
+	// Monolithic pipelines have no dynamic extended state
+	if(shader.IsGraphicsShader())
+		m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
+	return (*this)->record_bind_pipeline(static_cast<Anvil::PipelineBindPoint>(shader.GetPipelineBindPoint()), context.GetAnvilPipelineId(pipelineId));
 }
 bool prosper::VlkCommandBuffer::RecordSetLineWidth(float lineWidth)
 {
@@ -202,18 +230,19 @@ bool prosper::VlkCommandBuffer::RecordBindVertexBuffers(const std::vector<IBuffe
 	}
 #endif
 	// Note: Same implementation as below
-	std::vector<Anvil::Buffer *> anvBuffers {};
-	anvBuffers.reserve(buffers.size());
+	std::vector<VkBuffer> vkBuffers {};
+	vkBuffers.reserve(buffers.size());
 	for(auto *buf : buffers)
-		anvBuffers.push_back(&buf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer());
-	std::vector<DeviceSize> anvOffsets;
+		vkBuffers.push_back(buf->GetAPITypeRef<VlkBuffer>().GetVkBuffer());
+	std::vector<DeviceSize> vkOffsets;
 	if(offsets.empty())
-		anvOffsets.resize(buffers.size(), 0);
+		vkOffsets.resize(buffers.size(), 0);
 	else
-		anvOffsets = offsets;
+		vkOffsets = offsets;
 	for(auto i = decltype(buffers.size()) {0u}; i < buffers.size(); ++i)
-		anvOffsets.at(i) += buffers.at(i)->GetStartOffset();
-	return (*this)->record_bind_vertex_buffers(startBinding, anvBuffers.size(), anvBuffers.data(), anvOffsets.data());
+		vkOffsets.at(i) += buffers.at(i)->GetStartOffset();
+	vkCmdBindVertexBuffers(m_vkCommandBuffer, startBinding, static_cast<uint32_t>(vkBuffers.size()), vkBuffers.data(), reinterpret_cast<const VkDeviceSize *>(vkOffsets.data()));
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordBindVertexBuffers(const std::vector<std::shared_ptr<IBuffer>> &buffers, uint32_t startBinding, const std::vector<DeviceSize> &offsets)
 {
@@ -227,18 +256,19 @@ bool prosper::VlkCommandBuffer::RecordBindVertexBuffers(const std::vector<std::s
 	}
 #endif
 	// Note: Same implementation as above
-	std::vector<Anvil::Buffer *> anvBuffers {};
-	anvBuffers.reserve(buffers.size());
+	std::vector<VkBuffer> vkBuffers {};
+	vkBuffers.reserve(buffers.size());
 	for(auto &buf : buffers)
-		anvBuffers.push_back(&buf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer());
-	std::vector<DeviceSize> anvOffsets;
+		vkBuffers.push_back(buf->GetAPITypeRef<VlkBuffer>().GetVkBuffer());
+	std::vector<DeviceSize> vkOffsets;
 	if(offsets.empty())
-		anvOffsets.resize(buffers.size(), 0);
+		vkOffsets.resize(buffers.size(), 0);
 	else
-		anvOffsets = offsets;
+		vkOffsets = offsets;
 	for(auto i = decltype(buffers.size()) {0u}; i < buffers.size(); ++i)
-		anvOffsets.at(i) += buffers.at(i)->GetStartOffset();
-	return (*this)->record_bind_vertex_buffers(startBinding, anvBuffers.size(), anvBuffers.data(), anvOffsets.data());
+		vkOffsets.at(i) += buffers.at(i)->GetStartOffset();
+	vkCmdBindVertexBuffers(m_vkCommandBuffer, startBinding, static_cast<uint32_t>(vkBuffers.size()), vkBuffers.data(), reinterpret_cast<const VkDeviceSize *>(vkOffsets.data()));
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordBindRenderBuffer(const IRenderBuffer &renderBuffer)
 {
@@ -423,6 +453,154 @@ bool prosper::VlkCommandBuffer::RecordSetStencilWriteMask(StencilFaceFlags faceM
 	vkCmdSetStencilWriteMask(m_vkCommandBuffer, static_cast<VkStencilFaceFlags>(faceMask), stencilWriteMask);
 	return true;
 }
+static bool stencil_ops_equal(const VkStencilOpState &a, const VkStencilOpState &b) { return a.failOp == b.failOp && a.passOp == b.passOp && a.depthFailOp == b.depthFailOp && a.compareOp == b.compareOp; }
+void prosper::VlkCommandBuffer::ApplyExtendedDynamicState(ExtendedDynamicStateFlags dynamicStates, const GraphicsPipelineLibraryManager::ExtendedDynamicStateValues &values)
+{
+	// Dynamic state is retained across pipeline binds, unless a pipeline with the state baked in was bound in between
+	auto prevDynamicStates = m_extendedDynamicStates;
+	auto &cur = m_extendedDynamicStateValues;
+	auto needsUpdate = [dynamicStates, prevDynamicStates](ExtendedDynamicStateFlags state, bool changed) { return pragma::math::is_flag_set(dynamicStates, state) && (changed || !pragma::math::is_flag_set(prevDynamicStates, state)); };
+	auto &fns = static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions();
+	if(needsUpdate(ExtendedDynamicStateFlags::CullModeBit, values.cullMode != cur.cullMode))
+		fns.vkCmdSetCullModeEXT(m_vkCommandBuffer, values.cullMode);
+	if(needsUpdate(ExtendedDynamicStateFlags::FrontFaceBit, values.frontFace != cur.frontFace))
+		fns.vkCmdSetFrontFaceEXT(m_vkCommandBuffer, values.frontFace);
+	if(needsUpdate(ExtendedDynamicStateFlags::PrimitiveTopologyBit, values.primitiveTopology != cur.primitiveTopology))
+		fns.vkCmdSetPrimitiveTopologyEXT(m_vkCommandBuffer, values.primitiveTopology);
+	if(needsUpdate(ExtendedDynamicStateFlags::DepthTestEnableBit, values.depthTestEnable != cur.depthTestEnable))
+		fns.vkCmdSetDepthTestEnableEXT(m_vkCommandBuffer, values.depthTestEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::DepthWriteEnableBit, values.depthWriteEnable != cur.depthWriteEnable))
+		fns.vkCmdSetDepthWriteEnableEXT(m_vkCommandBuffer, values.depthWriteEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::DepthCompareOpBit, values.depthCompareOp != cur.depthCompareOp))
+		fns.vkCmdSetDepthCompareOpEXT(m_vkCommandBuffer, values.depthCompareOp);
+	if(needsUpdate(ExtendedDynamicStateFlags::StencilTestEnableBit, values.stencilTestEnable != cur.stencilTestEnable))
+		fns.vkCmdSetStencilTestEnableEXT(m_vkCommandBuffer, values.stencilTestEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::StencilOpBit, !stencil_ops_equal(values.front, cur.front) || !stencil_ops_equal(values.back, cur.back))) {
+		auto &front = values.front;
+		auto &back = values.back;
+		if(stencil_ops_equal(front, back))
+			fns.vkCmdSetStencilOpEXT(m_vkCommandBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, front.failOp, front.passOp, front.depthFailOp, front.compareOp);
+		else {
+			fns.vkCmdSetStencilOpEXT(m_vkCommandBuffer, VK_STENCIL_FACE_FRONT_BIT, front.failOp, front.passOp, front.depthFailOp, front.compareOp);
+			fns.vkCmdSetStencilOpEXT(m_vkCommandBuffer, VK_STENCIL_FACE_BACK_BIT, back.failOp, back.passOp, back.depthFailOp, back.compareOp);
+		}
+	}
+	if(needsUpdate(ExtendedDynamicStateFlags::DepthBiasEnableBit, values.depthBiasEnable != cur.depthBiasEnable))
+		fns.vkCmdSetDepthBiasEnableEXT(m_vkCommandBuffer, values.depthBiasEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::PrimitiveRestartEnableBit, values.primitiveRestartEnable != cur.primitiveRestartEnable))
+		fns.vkCmdSetPrimitiveRestartEnableEXT(m_vkCommandBuffer, values.primitiveRestartEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::RasterizerDiscardEnableBit, values.rasterizerDiscardEnable != cur.rasterizerDiscardEnable))
+		fns.vkCmdSetRasterizerDiscardEnableEXT(m_vkCommandBuffer, values.rasterizerDiscardEnable);
+	if(needsUpdate(ExtendedDynamicStateFlags::PolygonModeBit, values.polygonMode != cur.polygonMode))
+		fns.vkCmdSetPolygonModeEXT(m_vkCommandBuffer, values.polygonMode);
+	m_extendedDynamicStates = dynamicStates;
+	cur = values;
+}
+bool prosper::VlkCommandBuffer::RecordSetCullMode(CullModeFlags cullMode)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::CullModeBit))
+		return false;
+	m_extendedDynamicStateValues.cullMode = static_cast<VkCullModeFlags>(cullMode);
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetCullModeEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.cullMode);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetFrontFace(FrontFace frontFace)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::FrontFaceBit))
+		return false;
+	m_extendedDynamicStateValues.frontFace = static_cast<VkFrontFace>(frontFace);
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetFrontFaceEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.frontFace);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetPrimitiveTopology(PrimitiveTopology topology)
+{
+	// The topology has to be of the same class (point, line, triangle or patch) as the one the pipeline was created with
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::PrimitiveTopologyBit))
+		return false;
+	m_extendedDynamicStateValues.primitiveTopology = static_cast<VkPrimitiveTopology>(topology);
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetPrimitiveTopologyEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.primitiveTopology);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetDepthTestEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::DepthTestEnableBit))
+		return false;
+	m_extendedDynamicStateValues.depthTestEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetDepthTestEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.depthTestEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetDepthWriteEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::DepthWriteEnableBit))
+		return false;
+	m_extendedDynamicStateValues.depthWriteEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetDepthWriteEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.depthWriteEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetDepthCompareOp(CompareOp compareOp)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::DepthCompareOpBit))
+		return false;
+	m_extendedDynamicStateValues.depthCompareOp = static_cast<VkCompareOp>(compareOp);
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetDepthCompareOpEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.depthCompareOp);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetStencilTestEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::StencilTestEnableBit))
+		return false;
+	m_extendedDynamicStateValues.stencilTestEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetStencilTestEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.stencilTestEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetStencilOp(StencilFaceFlags faceMask, StencilOp failOp, StencilOp passOp, StencilOp depthFailOp, CompareOp compareOp)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::StencilOpBit))
+		return false;
+	auto vkFaceMask = static_cast<VkStencilFaceFlags>(faceMask);
+	for(auto [faceBit, state] : {std::pair<VkStencilFaceFlags, VkStencilOpState *> {VK_STENCIL_FACE_FRONT_BIT, &m_extendedDynamicStateValues.front}, {VK_STENCIL_FACE_BACK_BIT, &m_extendedDynamicStateValues.back}}) {
+		if((vkFaceMask & faceBit) == 0)
+			continue;
+		state->failOp = static_cast<VkStencilOp>(failOp);
+		state->passOp = static_cast<VkStencilOp>(passOp);
+		state->depthFailOp = static_cast<VkStencilOp>(depthFailOp);
+		state->compareOp = static_cast<VkCompareOp>(compareOp);
+	}
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetStencilOpEXT(m_vkCommandBuffer, vkFaceMask, static_cast<VkStencilOp>(failOp), static_cast<VkStencilOp>(passOp), static_cast<VkStencilOp>(depthFailOp), static_cast<VkCompareOp>(compareOp));
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetDepthBiasEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::DepthBiasEnableBit))
+		return false;
+	m_extendedDynamicStateValues.depthBiasEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetDepthBiasEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.depthBiasEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetPrimitiveRestartEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::PrimitiveRestartEnableBit))
+		return false;
+	m_extendedDynamicStateValues.primitiveRestartEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetPrimitiveRestartEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.primitiveRestartEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetRasterizerDiscardEnable(bool enabled)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::RasterizerDiscardEnableBit))
+		return false;
+	m_extendedDynamicStateValues.rasterizerDiscardEnable = enabled;
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetRasterizerDiscardEnableEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.rasterizerDiscardEnable);
+	return true;
+}
+bool prosper::VlkCommandBuffer::RecordSetPolygonMode(PolygonMode polygonMode)
+{
+	if(!IsExtendedDynamicStateBound(ExtendedDynamicStateFlags::PolygonModeBit))
+		return false;
+	m_extendedDynamicStateValues.polygonMode = static_cast<VkPolygonMode>(polygonMode);
+	static_cast<VlkContext &>(GetContext()).GetExtendedDynamicStateFunctions().vkCmdSetPolygonModeEXT(m_vkCommandBuffer, m_extendedDynamicStateValues.polygonMode);
+	return true;
+}
 bool prosper::VlkCommandBuffer::RecordBeginOcclusionQuery(const prosper::OcclusionQuery &query) const
 {
 #ifdef PR_DEBUG_API_DUMP
@@ -742,6 +920,7 @@ prosper::VlkPrimaryCommandBuffer::VlkPrimaryCommandBuffer(IPrContext &context, A
 }
 bool prosper::VlkPrimaryCommandBuffer::StartRecording(bool oneTimeSubmit, bool simultaneousUseAllowed) const
 {
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return IPrimaryCommandBuffer::StartRecording(oneTimeSubmit, simultaneousUseAllowed) && static_cast<Anvil::PrimaryCommandBuffer &>(*m_cmdBuffer).start_recording(oneTimeSubmit, simultaneousUseAllowed);
 }
 bool prosper::VlkPrimaryCommandBuffer::IsPrimary() const { return true; }
@@ -860,11 +1039,109 @@ bool prosper::VlkPrimaryCommandBuffer::DoRecordBeginRenderPass(prosper::IImage &
 	}
 	auto extents = img.GetExtents();
 	auto renderArea = vk::Rect2D(vk::Offset2D(), reinterpret_cast<vk::Extent2D &>(extents));
+	// Transient attachments are never read after the render pass, so there's no point in storing them
+	auto &vkRp = static_cast<prosper::VlkRenderPass &>(rp);
+	auto &beginRp = vkRp.GetDontCareStoreVariant(vkRp.GetDiscardableAttachmentMask(fb));
 	return static_cast<prosper::VlkPrimaryCommandBuffer &>(*this)->record_begin_render_pass(clearValues.size(), reinterpret_cast<const VkClearValue *>(clearValues.data()), &static_cast<prosper::VlkFramebuffer &>(fb).GetAnvilFramebuffer(), static_cast<VkRect2D &>(renderArea),
-	  &static_cast<prosper::VlkRenderPass &>(rp).GetAnvilRenderPass(),
+	  &beginRp.GetAnvilRenderPass(),
 	  pragma::math::is_flag_set(renderPassFlags, RenderPassFlags::SecondaryCommandBuffers) ? Anvil::SubpassContents::SECONDARY_COMMAND_BUFFERS : Anvil::SubpassContents::INLINE); // && RecordSetViewport(extents.width,extents.height) && RecordSetScissor(extents.width,extents.height);
 }
 
+static void to_vk_rendering_attachment_info(const prosper::util::RenderingAttachmentInfo &attInfo, VkResolveModeFlagBits resolveMode, VkRenderingAttachmentInfo &outInfo)
+{
+	static_assert(sizeof(prosper::ClearValue) == sizeof(VkClearValue));
+	outInfo = {VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+	outInfo.imageView = static_cast<VkImageView>(const_cast<void *>(attInfo.imageView->GetInternalHandle()));
+	outInfo.imageLayout = static_cast<VkImageLayout>(attInfo.imageLayout);
+	outInfo.loadOp = static_cast<VkAttachmentLoadOp>(attInfo.loadOp);
+	outInfo.storeOp = static_cast<VkAttachmentStoreOp>(attInfo.storeOp);
+	outInfo.clearValue = reinterpret_cast<const VkClearValue &>(attInfo.clearValue);
+	if(attInfo.resolveImageView) {
+		outInfo.resolveMode = resolveMode;
+		outInfo.resolveImageView = static_cast<VkImageView>(const_cast<void *>(attInfo.resolveImageView->GetInternalHandle()));
+		outInfo.resolveImageLayout = static_cast<VkImageLayout>(attInfo.resolveImageLayout);
+	}
+}
+// A combined depth/stencil view has to be bound to both aspects, otherwise the attachments don't match the formats the dynamic rendering
+// variants of the pipelines were created with (see get_rendering_formats in context.cpp)
+static void get_depth_stencil_attachments(const prosper::util::RenderingInfo &renderingInfo, const prosper::util::RenderingAttachmentInfo *&outDepthAttachment, const prosper::util::RenderingAttachmentInfo *&outStencilAttachment)
+{
+	outDepthAttachment = (renderingInfo.depthAttachment && renderingInfo.depthAttachment->imageView) ? &*renderingInfo.depthAttachment : nullptr;
+	outStencilAttachment = (renderingInfo.stencilAttachment && renderingInfo.stencilAttachment->imageView) ? &*renderingInfo.stencilAttachment : nullptr;
+	auto isCombined = [](const prosper::util::RenderingAttachmentInfo &attInfo) {
+		auto format = attInfo.imageView->GetImage().GetFormat();
+		return format != prosper::Format::S8_UInt && prosper::util::has_stencil_aspect(format);
+	};
+	if(outDepthAttachment && !outStencilAttachment && isCombined(*outDepthAttachment))
+		outStencilAttachment = outDepthAttachment;
+	else if(outStencilAttachment && !outDepthAttachment && isCombined(*outStencilAttachment))
+		outDepthAttachment = outStencilAttachment;
+}
+bool prosper::VlkPrimaryCommandBuffer::RecordBeginRendering(const util::RenderingInfo &renderingInfo)
+{
+	auto &fns = static_cast<VlkContext &>(GetContext()).GetDynamicRenderingFunctions();
+	if(!fns.IsValid() || m_dynamicRenderingActive)
+		return false;
+	std::vector<VkRenderingAttachmentInfo> colorAttachments;
+	colorAttachments.resize(renderingInfo.colorAttachments.size());
+	IImageView *firstView = nullptr;
+	for(auto i = decltype(colorAttachments.size()) {0u}; i < colorAttachments.size(); ++i) {
+		auto &attInfo = renderingInfo.colorAttachments[i];
+		if(!attInfo.imageView) {
+			// Unused attachment location
+			colorAttachments[i] = {VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+			continue;
+		}
+		to_vk_rendering_attachment_info(attInfo, VK_RESOLVE_MODE_AVERAGE_BIT, colorAttachments[i]);
+		if(!firstView)
+			firstView = attInfo.imageView;
+	}
+	const util::RenderingAttachmentInfo *depthAttInfo;
+	const util::RenderingAttachmentInfo *stencilAttInfo;
+	get_depth_stencil_attachments(renderingInfo, depthAttInfo, stencilAttInfo);
+	VkRenderingAttachmentInfo depthAttachment;
+	VkRenderingAttachmentInfo stencilAttachment;
+	VkRenderingInfo info {VK_STRUCTURE_TYPE_RENDERING_INFO};
+	if(depthAttInfo) {
+		to_vk_rendering_attachment_info(*depthAttInfo, VK_RESOLVE_MODE_SAMPLE_ZERO_BIT, depthAttachment);
+		info.pDepthAttachment = &depthAttachment;
+		if(!firstView)
+			firstView = depthAttInfo->imageView;
+	}
+	if(stencilAttInfo) {
+		to_vk_rendering_attachment_info(*stencilAttInfo, VK_RESOLVE_MODE_SAMPLE_ZERO_BIT, stencilAttachment);
+		info.pStencilAttachment = &stencilAttachment;
+		if(!firstView)
+			firstView = stencilAttInfo->imageView;
+	}
+	auto width = renderingInfo.width;
+	auto height = renderingInfo.height;
+	if(width == 0 || height == 0) {
+		if(!firstView)
+			return false;
+		auto extents = firstView->GetImage().GetExtents(firstView->GetBaseMipmapLevel());
+		width = extents.width;
+		height = extents.height;
+	}
+	if(renderingInfo.secondaryCommandBuffers)
+		info.flags |= VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	info.renderArea = {{0, 0}, {width, height}};
+	info.layerCount = renderingInfo.layerCount;
+	info.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+	info.pColorAttachments = colorAttachments.data();
+	fns.vkCmdBeginRenderingKHR(m_vkCommandBuffer, &info);
+	m_dynamicRenderingActive = true;
+	return true;
+}
+bool prosper::VlkPrimaryCommandBuffer::RecordEndRendering()
+{
+	if(!m_dynamicRenderingActive)
+		return false;
+	static_cast<VlkContext &>(GetContext()).GetDynamicRenderingFunctions().vkCmdEndRenderingKHR(m_vkCommandBuffer);
+	m_dynamicRenderingActive = false;
+	return true;
+}
+
 ///////////////////
 
 std::shared_ptr<prosper::VlkSecondaryCommandBuffer> prosper::VlkSecondaryCommandBuffer::Create(IPrContext &context, std::unique_ptr<Anvil::SecondaryCommandBuffer, std::function<void(Anvil::SecondaryCommandBuffer *)>> cmdBuffer, prosper::QueueFamilyType queueFamilyType,
@@ -899,10 +1176,67 @@ bool prosper::VlkSecondaryCommandBuffer::StartRecording(bool oneTimeSubmit, bool
 		r->AddArgument("simultaneousUseAllowed", simultaneousUseAllowed);
 	}
 #endif
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return ISecondaryCommandBuffer::StartRecording(oneTimeSubmit, simultaneousUseAllowed)
 	  && static_cast<Anvil::SecondaryCommandBuffer &>(*m_cmdBuffer)
 	       .start_recording(oneTimeSubmit, simultaneousUseAllowed, true /* renderPassUsageOnly */, nullptr, nullptr, 0 /* subPass */, Anvil::OcclusionQuerySupportScope::NOT_REQUIRED, false, Anvil::QueryPipelineStatisticFlagBits::NONE);
 }
+bool prosper::VlkSecondaryCommandBuffer::StartRecording(const util::RenderingInfo &renderingInfo, bool oneTimeSubmit, bool simultaneousUseAllowed) const
+{
+#ifdef PR_DEBUG_API_DUMP
+	if(debug::is_api_dump_enabled()) {
+		auto &adr = GetApiDumpRecorder();
+		auto r = adr.AddRecord<bool>("StartRecording");
+		r->AddArgument("oneTimeSubmit", oneTimeSubmit);
+		r->AddArgument("simultaneousUseAllowed", simultaneousUseAllowed);
+	}
+#endif
+	if(!static_cast<VlkContext &>(GetContext()).GetDynamicRenderingFunctions().IsValid())
+		return false;
+	std::vector<VkFormat> colorFormats;
+	colorFormats.reserve(renderingInfo.colorAttachments.size());
+	auto samples = VK_SAMPLE_COUNT_1_BIT;
+	for(auto &attInfo : renderingInfo.colorAttachments) {
+		if(!attInfo.imageView) {
+			colorFormats.push_back(VK_FORMAT_UNDEFINED);
+			continue;
+		}
+		auto &img = attInfo.imageView->GetImage();
+		colorFormats.push_back(static_cast<VkFormat>(img.GetFormat()));
+		samples = static_cast<VkSampleCountFlagBits>(img.GetSampleCount());
+	}
+	const util::RenderingAttachmentInfo *depthAttInfo;
+	const util::RenderingAttachmentInfo *stencilAttInfo;
+	get_depth_stencil_attachments(renderingInfo, depthAttInfo, stencilAttInfo);
+	VkCommandBufferInheritanceRenderingInfo renderingInheritanceInfo {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO};
+	renderingInheritanceInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+	renderingInheritanceInfo.pColorAttachmentFormats = colorFormats.data();
+	if(depthAttInfo)
+		renderingInheritanceInfo.depthAttachmentFormat = static_cast<VkFormat>(depthAttInfo->imageView->GetImage().GetFormat());
+	if(stencilAttInfo)
+		renderingInheritanceInfo.stencilAttachmentFormat = static_cast<VkFormat>(stencilAttInfo->imageView->GetImage().GetFormat());
+	if(auto *attInfo = depthAttInfo ? depthAttInfo : stencilAttInfo)
+		samples = static_cast<VkSampleCountFlagBits>(attInfo->imageView->GetImage().GetSampleCount());
+	renderingInheritanceInfo.rasterizationSamples = samples;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+	inheritanceInfo.pNext = &renderingInheritanceInfo;
+	VkCommandBufferBeginInfo beginInfo {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	if(oneTimeSubmit)
+		beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if(simultaneousUseAllowed)
+		beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
+	if(!ISecondaryCommandBuffer::StartRecording(oneTimeSubmit, simultaneousUseAllowed) || vkBeginCommandBuffer(m_vkCommandBuffer, &beginInfo) != VK_SUCCESS)
+		return false;
+	m_recordingWithoutAnvil = true;
+	// Pipelines have to be bound with their dynamic rendering variants
+	m_dynamicRenderingActive = true;
+	return true;
+}
 bool prosper::VlkSecondaryCommandBuffer::StartRecording(prosper::IRenderPass &rp, prosper::IFramebuffer &fb, bool oneTimeSubmit, bool simultaneousUseAllowed) const
 {
 #ifdef PR_DEBUG_API_DUMP
@@ -915,6 +1249,7 @@ bool prosper::VlkSecondaryCommandBuffer::StartRecording(prosper::IRenderPass &rp
 		r->AddArgument("simultaneousUseAllowed", simultaneousUseAllowed);
 	}
 #endif
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return ISecondaryCommandBuffer::StartRecording(rp, fb, oneTimeSubmit, simultaneousUseAllowed)
 	  && static_cast<Anvil::SecondaryCommandBuffer &>(*m_cmdBuffer)
 	       .start_recording(oneTimeSubmit, simultaneousUseAllowed, true /* renderPassUsageOnly */, &static_cast<const VlkFramebuffer &>(fb).GetAnvilFramebuffer(), &static_cast<const VlkRenderPass &>(rp).GetAnvilRenderPass(), 0 /* subPass */, Anvil::OcclusionQuerySupportScope::NOT_REQUIRED,
@@ -938,6 +1273,7 @@ bool prosper::VlkSecondaryCommandBuffer::StartRecording(bool oneTimeSubmit, bool
 		r->AddArgument("statisticsFlags", statisticsFlags.get_vk());
 	}
 #endif
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return ISecondaryCommandBuffer::StartRecording(const_cast<IRenderPass &>(rp), const_cast<IFramebuffer &>(framebuffer), oneTimeSubmit, simultaneousUseAllowed)
 	  && static_cast<Anvil::SecondaryCommandBuffer &>(*m_cmdBuffer)
 	       .start_recording(oneTimeSubmit, simultaneousUseAllowed, renderPassUsageOnly, &static_cast<const VlkFramebuffer &>(framebuffer).GetAnvilFramebuffer(), &static_cast<const VlkRenderPass &>(rp).GetAnvilRenderPass(), subPassId, occlusionQuerySupportScope,
@@ -951,7 +1287,11 @@ bool prosper::VlkSecondaryCommandBuffer::StopRecording() const
 		auto r = adr.AddRecord<bool>("StopRecording");
 	}
 #endif
-	auto res = ISecondaryCommandBuffer::StopRecording() && m_cmdBuffer->stop_recording();
+	auto res = ISecondaryCommandBuffer::StopRecording() && (m_recordingWithoutAnvil ? (vkEndCommandBuffer(m_vkCommandBuffer) == VK_SUCCESS) : m_cmdBuffer->stop_recording());
+	if(m_recordingWithoutAnvil) {
+		m_recordingWithoutAnvil = false;
+		m_dynamicRenderingActive = false;
+	}
 #ifdef PR_DEBUG_API_DUMP
 	if(debug::is_api_dump_enabled()) {
 		auto &adr = GetApiDumpRecorder();
@@ -983,6 +1323,8 @@ bool prosper::VlkCommandBuffer::Reset(bool shouldReleaseResources) const
 		r->AddArgument("shouldReleaseResources", shouldReleaseResources);
 	}
 #endif
+	m_dynamicRenderingActive = false;
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return m_cmdBuffer->reset(shouldReleaseResources);
 }
 bool prosper::VlkCommandBuffer::RecordSetDepthBias(float depthBiasConstantFactor, float depthBiasClamp, float depthBiasSlopeFactor)
@@ -996,7 +1338,8 @@ bool prosper::VlkCommandBuffer::RecordSetDepthBias(float depthBiasConstantFactor
 		r->AddArgument("depthBiasSlopeFactor", depthBiasSlopeFactor);
 	}
 #endif
-	return m_cmdBuffer->record_set_depth_bias(depthBiasConstantFactor, depthBiasClamp, depthBiasSlopeFactor);
+	vkCmdSetDepthBias(m_vkCommandBuffer, depthBiasConstantFactor, depthBiasClamp, depthBiasSlopeFactor);
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordClearAttachment(IImage &img, const std::array<float, 4> &clearColor, uint32_t attId, uint32_t layerId, uint32_t layerCount)
 {
@@ -1015,9 +1358,10 @@ bool prosper::VlkCommandBuffer::RecordClearAttachment(IImage &img, const std::ar
 	//	throw std::logic_error("Attempted to copy image to buffer while render pass is active!");
 
 	vk::ClearValue clearVal {vk::ClearColorValue {clearColor}};
-	Anvil::ClearAttachment clearAtt {Anvil::ImageAspectFlagBits::COLOR_BIT, attId, clearVal};
+	vk::ClearAttachment clearAtt {vk::ImageAspectFlagBits::eColor, attId, clearVal};
 	vk::ClearRect clearRect {vk::Rect2D {vk::Offset2D {0, 0}, static_cast<prosper::VlkImage &>(img)->get_image_extent_2D(0u)}, layerId, layerCount};
-	return m_cmdBuffer->record_clear_attachments(1u, &clearAtt, 1u, reinterpret_cast<VkClearRect *>(&clearRect));
+	vkCmdClearAttachments(m_vkCommandBuffer, 1u, reinterpret_cast<VkClearAttachment *>(&clearAtt), 1u, reinterpret_cast<VkClearRect *>(&clearRect));
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordClearAttachment(IImage &img, std::optional<float> clearDepth, std::optional<uint32_t> clearStencil, uint32_t layerId)
 {
@@ -1038,21 +1382,22 @@ bool prosper::VlkCommandBuffer::RecordClearAttachment(IImage &img, std::optional
 
 	float depth = 0.f;
 	uint32_t stencil = 0;
-	Anvil::ImageAspectFlags aspectMask = Anvil::ImageAspectFlagBits::NONE;
+	vk::ImageAspectFlags aspectMask {};
 	if(clearDepth.has_value()) {
-		aspectMask |= Anvil::ImageAspectFlagBits::DEPTH_BIT;
+		aspectMask |= vk::ImageAspectFlagBits::eDepth;
 		depth = *clearDepth;
 	}
 	if(clearStencil.has_value()) {
-		aspectMask |= Anvil::ImageAspectFlagBits::STENCIL_BIT;
+		aspectMask |= vk::ImageAspectFlagBits::eStencil;
 		stencil = *clearStencil;
 	}
 	vk::ClearValue clearVal {vk::ClearDepthStencilValue {depth, stencil}};
-	Anvil::ClearAttachment clearAtt {aspectMask, 0u /* color attachment */, clearVal};
+	vk::ClearAttachment clearAtt {aspectMask, 0u /* color attachment */, clearVal};
 	vk::ClearRect clearRect {
 	  vk::Rect2D {vk::Offset2D {0, 0}, static_cast<prosper::VlkImage &>(img)->get_image_extent_2D(0u)}, layerId, 1 /* layerCount */
 	};
-	return m_cmdBuffer->record_clear_attachments(1u, &clearAtt, 1u, reinterpret_cast<VkClearRect *>(&clearRect));
+	vkCmdClearAttachments(m_vkCommandBuffer, 1u, reinterpret_cast<VkClearAttachment *>(&clearAtt), 1u, reinterpret_cast<VkClearRect *>(&clearRect));
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordSetViewport(uint32_t width, uint32_t height, uint32_t x, uint32_t y, float minDepth, float maxDepth)
 {
@@ -1069,7 +1414,8 @@ bool prosper::VlkCommandBuffer::RecordSetViewport(uint32_t width, uint32_t heigh
 	}
 #endif
 	auto vp = vk::Viewport(x, y, width, height, minDepth, maxDepth);
-	return m_cmdBuffer->record_set_viewport(0u, 1u, reinterpret_cast<VkViewport *>(&vp));
+	vkCmdSetViewport(m_vkCommandBuffer, 0u, 1u, reinterpret_cast<VkViewport *>(&vp));
+	return true;
 }
 bool prosper::VlkCommandBuffer::RecordSetScissor(uint32_t width, uint32_t height, uint32_t x, uint32_t y)
 {
@@ -1084,7 +1430,8 @@ bool prosper::VlkCommandBuffer::RecordSetScissor(uint32_t width, uint32_t height
 	}
 #endif
 	auto scissor = vk::Rect2D(vk::Offset2D(x, y), vk::Extent2D(width, height));
-	return m_cmdBuffer->record_set_scissor(0u, 1u, reinterpret_cast<VkRect2D *>(&scissor));
+	vkCmdSetScissor(m_vkCommandBuffer, 0u, 1u, reinterpret_cast<VkRect2D *>(&scissor));
+	return true;
 }
 bool prosper::VlkCommandBuffer::DoRecordCopyBuffer(const util::BufferCopy &copyInfo, IBuffer &bufferSrc, IBuffer &bufferDst)
 {
@@ -1281,5 +1628,7 @@ bool prosper::VlkPrimaryCommandBuffer::RecordNextSubPass() { return (*this)->rec
 bool prosper::VlkPrimaryCommandBuffer::ExecuteCommands(prosper::ISecondaryCommandBuffer &cmdBuf)
 {
 	auto *anvCmdBuf = &static_cast<VlkSecondaryCommandBuffer &>(cmdBuf).GetAnvilCommandBuffer();
+	// The dynamic states of the primary command buffer are undefined after the secondary command buffer has been executed
+	m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
 	return static_cast<Anvil::PrimaryCommandBuffer &>(**this).record_execute_commands(1, &anvCmdBuf);
 }
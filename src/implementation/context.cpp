@@ -30,6 +30,8 @@ module;
 #include <wrappers/descriptor_set_group.h>
 #include <wrappers/graphics_pipeline_manager.h>
 #include <wrappers/compute_pipeline_manager.h>
+#include <wrappers/memory_block.h>
+#include <misc/memory_block_create_info.h>
 #include <wrappers/query_pool.h>
 #include <wrappers/shader_module.h>
 #include <misc/image_view_create_info.h>
@@ -64,6 +66,47 @@ void VkRaytracingFunctions::Initialize(VkDevice dev)
 }
 bool VkRaytracingFunctions::IsValid() const { return vkCreateAccelerationStructureKHR && vkDestroyAccelerationStructureKHR; }
 
+void VkHostImageCopyFunctions::Initialize(VkDevice dev)
+{
+	vkCopyMemoryToImageEXT = (PFN_vkCopyMemoryToImageEXT)vkGetDeviceProcAddr(dev, "vkCopyMemoryToImageEXT");
+	vkTransitionImageLayoutEXT = (PFN_vkTransitionImageLayoutEXT)vkGetDeviceProcAddr(dev, "vkTransitionImageLayoutEXT");
+}
+bool VkHostImageCopyFunctions::IsValid() const { return vkCopyMemoryToImageEXT && vkTransitionImageLayoutEXT; }
+
+void VkDynamicRenderingFunctions::Initialize(VkDevice dev)
+{
+	vkCmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(dev, "vkCmdBeginRenderingKHR");
+	vkCmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(dev, "vkCmdEndRenderingKHR");
+}
+bool VkDynamicRenderingFunctions::IsValid() const { return vkCmdBeginRenderingKHR && vkCmdEndRenderingKHR; }
+
+void VkExtendedDynamicStateFunctions::Initialize(VkDevice dev)
+{
+	vkCmdSetCullModeEXT = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(dev, "vkCmdSetCullModeEXT");
+	vkCmdSetFrontFaceEXT = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(dev, "vkCmdSetFrontFaceEXT");
+	vkCmdSetPrimitiveTopologyEXT = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(dev, "vkCmdSetPrimitiveTopologyEXT");
+	vkCmdSetDepthTestEnableEXT = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetDepthTestEnableEXT");
+	vkCmdSetDepthWriteEnableEXT = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetDepthWriteEnableEXT");
+	vkCmdSetDepthCompareOpEXT = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(dev, "vkCmdSetDepthCompareOpEXT");
+	vkCmdSetStencilTestEnableEXT = (PFN_vkCmdSetStencilTestEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetStencilTestEnableEXT");
+	vkCmdSetStencilOpEXT = (PFN_vkCmdSetStencilOpEXT)vkGetDeviceProcAddr(dev, "vkCmdSetStencilOpEXT");
+	vkCmdSetDepthBiasEnableEXT = (PFN_vkCmdSetDepthBiasEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetDepthBiasEnableEXT");
+	vkCmdSetPrimitiveRestartEnableEXT = (PFN_vkCmdSetPrimitiveRestartEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetPrimitiveRestartEnableEXT");
+	vkCmdSetRasterizerDiscardEnableEXT = (PFN_vkCmdSetRasterizerDiscardEnableEXT)vkGetDeviceProcAddr(dev, "vkCmdSetRasterizerDiscardEnableEXT");
+	vkCmdSetPolygonModeEXT = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(dev, "vkCmdSetPolygonModeEXT");
+}
+ExtendedDynamicStateFlags VkExtendedDynamicStateFunctions::GetSupportedStates() const
+{
+	auto states = ExtendedDynamicStateFlags::None;
+	if(vkCmdSetCullModeEXT && vkCmdSetFrontFaceEXT && vkCmdSetPrimitiveTopologyEXT && vkCmdSetDepthTestEnableEXT && vkCmdSetDepthWriteEnableEXT && vkCmdSetDepthCompareOpEXT && vkCmdSetStencilTestEnableEXT && vkCmdSetStencilOpEXT)
+		states |= ExtendedDynamicStateFlags::ExtendedDynamicState1;
+	if(vkCmdSetDepthBiasEnableEXT && vkCmdSetPrimitiveRestartEnableEXT && vkCmdSetRasterizerDiscardEnableEXT)
+		states |= ExtendedDynamicStateFlags::ExtendedDynamicState2;
+	if(vkCmdSetPolygonModeEXT)
+		states |= ExtendedDynamicStateFlags::PolygonModeBit;
+	return states;
+}
+
 /////////////
 
 std::unique_ptr<VlkShaderPipelineLayout> VlkShaderPipelineLayout::Create(const Shader &shader, uint32_t pipelineIdx)
@@ -72,10 +115,9 @@ std::unique_ptr<VlkShaderPipelineLayout> VlkShaderPipelineLayout::Create(const S
 	if(shader.GetPipelineId(pipelineId, pipelineIdx) == false)
 		return nullptr;
 	auto &vkContext = static_cast<VlkContext &>(shader.GetContext());
-	auto *anvLayout = vkContext.GetPipelineLayout(shader.IsGraphicsShader(), pipelineId);
-	if(anvLayout == nullptr)
+	auto vkLayout = vkContext.GetVkPipelineLayout(shader.IsGraphicsShader(), pipelineId);
+	if(vkLayout == VK_NULL_HANDLE)
 		return nullptr;
-	auto vkLayout = anvLayout->get_pipeline_layout();
 	auto res = std::unique_ptr<VlkShaderPipelineLayout> {new VlkShaderPipelineLayout {}};
 	res->m_pipelineLayout = vkLayout;
 	res->m_pipelineBindPoint = static_cast<VkPipelineBindPoint>(shader.GetPipelineBindPoint());
@@ -106,6 +148,17 @@ void VlkContext::OnClose()
 	Anvil::set_assertion_failure_handler(nullptr);
 	m_dummyTexture = nullptr;
 	m_dummyCubemapTexture = nullptr;
+	m_transientBufferAllocator = nullptr;
+	m_descriptorSetAllocator = nullptr;
+	m_memoryDefragmenter = nullptr;
+	m_threadSafeKeepAliveResources.clear();
+	m_uploadBatch = {};
+	m_pendingUploads.clear();
+	// Destroys all remaining objects
+	m_deferredDestructionQueue = nullptr;
+	// Have to outlive the dispatch resources that were retired through the deferred destruction queue
+	m_gpuFormatConverter = nullptr;
+	m_mipmapGenerator = nullptr;
 
 	m_memAllocator = nullptr;
 	IPrContext::OnClose();
@@ -113,6 +166,13 @@ void VlkContext::OnClose()
 
 VlkContext::~VlkContext()
 {
+	m_graphicsPipelineLibrary = nullptr;
+	m_pipelineResources.clear();
+	m_shaderModuleCache.Clear(); // Shader modules have to be destroyed before the device
+	m_samplerCache.Clear();
+	m_framebufferCache.Clear();
+	m_renderPassCache.Clear();
+	m_pipelineLayoutCache.Clear();
 	m_renderPass = nullptr;
 	m_devicePtr = nullptr;
 	m_instancePtr = nullptr;
@@ -231,7 +291,33 @@ void VlkContext::DrawFrame(const std::function<void()> &drawFrame)
 	// in time we can be sure that the resources are no longer in use by the previous frame.
 	// TODO: If the window is minimized, it could cause resources to accumulate in the keep alive resources list. In this case
 	// we should clear the resources immediately.
-	ClearKeepAliveResources();
+	// The resources are handed to the destruction queue, so that their destructors are spread across frames. Arbitrary resources
+	// may be freed into externally synchronized pools (e.g. descriptor sets or command buffers), so only the resources that were
+	// explicitly registered as thread-safe are destroyed on the destruction thread.
+	auto lastSwapchainImgIdx = GetLastAcquiredPrimaryWindowSwapchainImageIndex();
+	if(lastSwapchainImgIdx < m_keepAliveResources.size()) {
+		std::vector<std::shared_ptr<void>> keepAliveResources;
+		std::vector<std::shared_ptr<void>> threadSafeKeepAliveResources;
+		{
+			std::scoped_lock lock {m_swapchainResourcesInUseMutex};
+			keepAliveResources = std::move(m_keepAliveResources[lastSwapchainImgIdx]);
+			m_keepAliveResources[lastSwapchainImgIdx].clear();
+			if(lastSwapchainImgIdx < m_threadSafeKeepAliveResources.size()) {
+				threadSafeKeepAliveResources = std::move(m_threadSafeKeepAliveResources[lastSwapchainImgIdx]);
+				m_threadSafeKeepAliveResources[lastSwapchainImgIdx].clear();
+			}
+		}
+		m_deferredDestructionQueue->Retire(std::move(keepAliveResources), DeferredDestructionQueue::DestructionThread::UpdateThread);
+		m_deferredDestructionQueue->Retire(std::move(threadSafeKeepAliveResources), DeferredDestructionQueue::DestructionThread::Any);
+	}
+	ReleaseCompletedUploads();
+	m_deferredDestructionQueue->Update();
+	// The copies of relocated buffers have to be submitted before the frame's command buffer
+	if(m_memoryDefragmenter)
+		m_memoryDefragmenter->RunPass();
+	if(m_graphicsPipelineLibrary)
+		m_graphicsPipelineLibrary->Update();
+	UpdateMemoryBudget();
 
 	auto swapchainImgIdx = GetLastAcquiredPrimaryWindowSwapchainImageIndex();
 	if(swapchainImgIdx == UINT32_MAX) {
@@ -246,6 +332,11 @@ void VlkContext::DrawFrame(const std::function<void()> &drawFrame)
 	m_swapchainResourcesInUseMutex.lock();
 	m_swapchainResourcesInUse[swapchainImgIdx] = true;
 	m_swapchainResourcesInUseMutex.unlock();
+	// The fence of this swapchain image has been waited on, so the transient data of the frame that last used it can be overwritten
+	if(m_transientBufferAllocator)
+		m_transientBufferAllocator->BeginFrame(swapchainImgIdx);
+	if(m_descriptorSetAllocator)
+		m_descriptorSetAllocator->BeginFrame(swapchainImgIdx);
 	pragma::math::set_flag(m_stateFlags, StateFlags::IsRecording);
 	while(m_scheduledBufferUpdates.empty() == false) {
 		auto &f = m_scheduledBufferUpdates.front();
@@ -261,6 +352,7 @@ void VlkContext::DrawFrame(const std::function<void()> &drawFrame)
 		return;
 	}
 
+	FlushMappedMemoryRanges();
 	for(uint32_t idx = 0; auto &window : m_windows) {
 		if(!window || window->IsValid() == false) {
 			++idx;
@@ -282,10 +374,25 @@ void VlkContext::DrawFrame(const std::function<void()> &drawFrame)
 	}
 }
 
+// Waits on the semaphores of operations that were submitted to other queues (see VlkContext::AddUniversalQueueWaitSemaphore)
+static VkResult submit_to_universal_queue(VlkContext &context, Anvil::CommandBufferBase &cmd, bool shouldBlock, Anvil::Fence *optFence)
+{
+	// Uploads that have been recorded so far may be used by the command buffer
+	context.SubmitUploadCommands();
+	auto waitSemaphores = context.TakeUniversalQueueWaitSemaphores();
+	std::vector<Anvil::Semaphore *> waitSemaphorePtrs;
+	waitSemaphorePtrs.reserve(waitSemaphores.size());
+	for(auto &semaphore : waitSemaphores)
+		waitSemaphorePtrs.push_back(semaphore.get());
+	std::vector<Anvil::PipelineStageFlags> waitStageMasks(waitSemaphorePtrs.size(), Anvil::PipelineStageFlagBits::ALL_COMMANDS_BIT);
+	return context.GetDevice().get_universal_queue(0)->submit(
+	  Anvil::SubmitInfo::create(&cmd, 0u, nullptr, static_cast<uint32_t>(waitSemaphorePtrs.size()), waitSemaphorePtrs.data(), waitStageMasks.data(), shouldBlock, optFence));
+}
+
 bool VlkContext::Submit(ICommandBuffer &cmdBuf, bool shouldBlock, IFence *optFence)
 {
-	auto &dev = GetDevice();
-	auto res = dev.get_universal_queue(0)->submit(Anvil::SubmitInfo::create(&cmdBuf.GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer(), 0u, nullptr, 0u, nullptr, nullptr, shouldBlock, optFence ? &dynamic_cast<VlkFence *>(optFence)->GetAnvilFence() : nullptr));
+	FlushMappedMemoryRanges();
+	auto res = submit_to_universal_queue(*this, cmdBuf.GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer(), shouldBlock, optFence ? &dynamic_cast<VlkFence *>(optFence)->GetAnvilFence() : nullptr);
 	if(res == VkResult::VK_SUCCESS)
 		SetDeviceBusy(true);
 	return res == VkResult::VK_SUCCESS;
@@ -348,7 +455,9 @@ Anvil::Swapchain &VlkContext::GetSwapchain() { return static_cast<VlkWindow &>(G
 void VlkContext::DoWaitIdle()
 {
 	auto &dev = GetDevice();
+	SubmitUploadCommands();
 	dev.wait_idle();
+	ReleaseCompletedUploads(true);
 
 	std::unique_lock lock {m_swapchainResourcesInUseMutex};
 	m_swapchainResourcesInUse.assign(m_swapchainResourcesInUse.size(), false);
@@ -361,8 +470,8 @@ void VlkContext::DoFlushCommandBuffer(ICommandBuffer &cmd)
 	auto &pcmd = static_cast<prosper::VlkPrimaryCommandBuffer &>(cmd.GetAPITypeRef<prosper::VlkCommandBuffer>());
 	if(cmd.IsRecording())
 		static_cast<Anvil::PrimaryCommandBuffer &>(pcmd.GetAnvilCommandBuffer()).stop_recording();
-	auto &dev = GetDevice();
-	auto res = static_cast<prosper::Result>(dev.get_universal_queue(0)->submit(Anvil::SubmitInfo::create(&pcmd.GetAnvilCommandBuffer(), 0u, nullptr, 0u, nullptr, nullptr, true)));
+	FlushMappedMemoryRanges();
+	auto res = static_cast<prosper::Result>(submit_to_universal_queue(*this, pcmd.GetAnvilCommandBuffer(), true, nullptr));
 	if(res != prosper::Result::Success)
 		throw std::runtime_error {"Failed to submit command buffer: " + util::to_string(res) + "!"};
 	SetDeviceBusy(true);
@@ -395,11 +504,37 @@ prosper::util::Limits VlkContext::GetPhysicalDeviceLimits() const
 	return limits;
 }
 
+void VlkContext::ReleasePipelineResources(PipelineResources &resources)
+{
+	m_pipelineLayoutCache.Release(resources.layout);
+	for(auto &shaderModule : resources.shaderModules)
+		m_shaderModuleCache.Release(shaderModule);
+	resources = {};
+}
+
+void VlkContext::SetPipelineResources(PipelineID pipelineId, PipelineResources &&resources)
+{
+	if(pipelineId >= m_pipelineResources.size())
+		m_pipelineResources.resize(pipelineId + 1);
+	ReleasePipelineResources(m_pipelineResources[pipelineId]);
+	m_pipelineResources[pipelineId] = std::move(resources);
+}
+
 bool VlkContext::ClearPipeline(bool graphicsShader, PipelineID pipelineId)
 {
 	auto &dev = static_cast<VlkContext &>(*this).GetDevice();
-	if(graphicsShader)
-		return dev.get_graphics_pipeline_manager()->delete_pipeline(m_prosperPipelineToAnvilPipeline[pipelineId]);
+	if(pipelineId < m_pipelineResources.size())
+		ReleasePipelineResources(m_pipelineResources[pipelineId]);
+	if(graphicsShader && m_graphicsPipelineLibrary)
+		m_graphicsPipelineLibrary->ClearPipeline(pipelineId);
+	if(graphicsShader) {
+		auto anvPipelineId = m_prosperPipelineToAnvilPipeline[pipelineId];
+		// Pipelines created from pipeline libraries were never registered with Anvil
+		if(anvPipelineId == std::numeric_limits<Anvil::PipelineID>::max())
+			return true;
+		m_prosperPipelineToAnvilPipeline[pipelineId] = std::numeric_limits<Anvil::PipelineID>::max();
+		return dev.get_graphics_pipeline_manager()->delete_pipeline(anvPipelineId);
+	}
 	return dev.get_compute_pipeline_manager()->delete_pipeline(m_prosperPipelineToAnvilPipeline[pipelineId]);
 }
 
@@ -408,8 +543,12 @@ void VlkContext::BakeShaderPipeline(PipelineID pipelineId, prosper::PipelineBind
 	auto anvPipelineId = GetAnvilPipelineId(pipelineId);
 	auto &dev = GetDevice();
 	// This will force-initiate the baking process
-	if(pipelineType == prosper::PipelineBindPoint::Graphics)
+	if(pipelineType == prosper::PipelineBindPoint::Graphics) {
+		// Pipelines created from pipeline libraries are not known to Anvil
+		if(anvPipelineId == std::numeric_limits<Anvil::PipelineID>::max())
+			return;
 		dev.get_graphics_pipeline_manager()->get_pipeline(anvPipelineId);
+	}
 	else
 		dev.get_compute_pipeline_manager()->get_pipeline(anvPipelineId);
 }
@@ -442,7 +581,7 @@ static prosper::FormatFeatureFlags to_prosper_format_features(Anvil::FormatFeatu
 	return static_cast<prosper::FormatFeatureFlags>(0);
 }
 
-prosper::FeatureSupport VlkContext::AreFormatFeaturesSupported(Format format, FormatFeatureFlags featureFlags, std::optional<ImageTiling> tiling) const
+Anvil::FormatProperties VlkContext::GetFormatProperties(Format format) const
 {
 	std::scoped_lock lock {m_formatPropertiesMutex};
 	auto it = m_formatProperties.find(format);
@@ -452,8 +591,14 @@ prosper::FeatureSupport VlkContext::AreFormatFeaturesSupported(Format format, Fo
 		auto props = dev.get_physical_device_format_properties(static_cast<Anvil::Format>(format));
 		it = m_formatProperties.insert(std::make_pair(format, props)).first;
 	}
+	return it->second;
+}
 
-	auto &props = it->second;
+bool VlkContext::IsStorageImageFormatSupported(Format format) const { return (GetFormatProperties(format).optimal_tiling_capabilities.get_vk() & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0; }
+
+prosper::FeatureSupport VlkContext::AreFormatFeaturesSupported(Format format, FormatFeatureFlags featureFlags, std::optional<ImageTiling> tiling) const
+{
+	auto props = GetFormatProperties(format);
 	auto supportedFeatureFlags = !tiling.has_value() ? props.buffer_capabilities : (*tiling == ImageTiling::Optimal ? props.optimal_tiling_capabilities : props.linear_tiling_capabilities);
 	constexpr std::array<Anvil::FormatFeatureFlagBits, 8> toAnvFlag {Anvil::FormatFeatureFlagBits::BLIT_DST_BIT, Anvil::FormatFeatureFlagBits::BLIT_SRC_BIT, Anvil::FormatFeatureFlagBits::COLOR_ATTACHMENT_BIT, Anvil::FormatFeatureFlagBits::DEPTH_STENCIL_ATTACHMENT_BIT,
 	  Anvil::FormatFeatureFlagBits::SAMPLED_IMAGE_BIT, Anvil::FormatFeatureFlagBits::STORAGE_TEXEL_BUFFER_BIT, Anvil::FormatFeatureFlagBits::UNIFORM_TEXEL_BUFFER_BIT, Anvil::FormatFeatureFlagBits::VERTEX_BUFFER_BIT};
@@ -571,8 +716,91 @@ void VlkContext::OnPrimaryWindowSwapchainReloaded()
 	auto numSwapchainImages = static_cast<VlkWindow &>(GetWindow()).GetSwapchainImageCount();
 	m_keepAliveResources.clear();
 	m_keepAliveResources.resize(numSwapchainImages);
+	{
+		std::scoped_lock lock {m_swapchainResourcesInUseMutex};
+		m_threadSafeKeepAliveResources.clear();
+		m_threadSafeKeepAliveResources.resize(numSwapchainImages);
+	}
 	m_swapchainResourcesInUse.resize(numSwapchainImages, false);
 	m_swapchainResourcesInUse.assign(m_swapchainResourcesInUse.size(), false);
+	if(m_transientBufferAllocator && m_transientBufferAllocator->GetFrameCount() != numSwapchainImages)
+		m_transientBufferAllocator = nullptr; // Will be re-created with the new number of frames on next use
+	if(m_descriptorSetAllocator)
+		m_descriptorSetAllocator->SetFrameCount(numSwapchainImages);
+}
+
+TransientBufferAllocator *VlkContext::GetTransientBufferAllocator()
+{
+	if(!m_transientBufferAllocator)
+		m_transientBufferAllocator = TransientBufferAllocator::Create(*this, m_transientBufferSizePerFrame, pragma::math::max(static_cast<uint32_t>(m_swapchainResourcesInUse.size()), 1u));
+	return m_transientBufferAllocator.get();
+}
+
+GpuFormatConverter *VlkContext::GetGpuFormatConverter()
+{
+	std::scoped_lock lock {m_gpuFormatConverterMutex};
+	if(!m_gpuFormatConverter) {
+		m_gpuFormatConverter = GpuFormatConverter::Create(*this);
+		if(!m_gpuFormatConverter) {
+			Log("Failed to initialize GPU format converter, falling back to CPU conversion!", pragma::util::LogSeverity::Warning);
+			m_gpuFormatConversionEnabled = false;
+		}
+	}
+	return m_gpuFormatConverter.get();
+}
+
+MipmapGenerator *VlkContext::GetMipmapGenerator()
+{
+	std::scoped_lock lock {m_mipmapGeneratorMutex};
+	if(!m_mipmapGenerator)
+		m_mipmapGenerator = MipmapGenerator::Create(*this);
+	return m_mipmapGenerator.get();
+}
+
+void VlkContext::RegisterDirtyBuffer(VlkBuffer &buffer)
+{
+	std::scoped_lock lock {m_dirtyBufferMutex};
+	m_dirtyBuffers.insert(&buffer);
+}
+
+void VlkContext::UnregisterDirtyBuffer(VlkBuffer &buffer)
+{
+	std::scoped_lock lock {m_dirtyBufferMutex};
+	m_dirtyBuffers.erase(&buffer);
+}
+
+void VlkContext::FlushMappedMemoryRanges()
+{
+	// The lock has to be held until the ranges have been flushed, otherwise a buffer could be unmapped or destroyed in the meantime
+	// (see VlkBuffer::ReleasePersistentMapping)
+	std::scoped_lock lock {m_dirtyBufferMutex};
+	if(m_dirtyBuffers.empty())
+		return;
+	std::vector<VkMappedMemoryRange> ranges;
+	auto nonCoherentAtomSize = GetDevice().get_physical_device_properties().core_vk1_0_properties_ptr->limits.non_coherent_atom_size;
+	for(auto it = m_dirtyBuffers.begin(); it != m_dirtyBuffers.end();) {
+		// Buffers with ranges that are still mapped have to be flushed again with the next submission
+		if((*it)->CollectDirtyRanges(ranges, nonCoherentAtomSize))
+			++it;
+		else
+			it = m_dirtyBuffers.erase(it);
+	}
+	if(ranges.empty())
+		return;
+	auto res = vkFlushMappedMemoryRanges(GetDevice().get_device_vk(), static_cast<uint32_t>(ranges.size()), ranges.data());
+	if(res != VK_SUCCESS)
+		Log("Failed to flush " + std::to_string(ranges.size()) + " mapped memory ranges: " + util::to_string(static_cast<Result>(res)), pragma::util::LogSeverity::Warning);
+}
+
+void VlkContext::SetTransientBufferSizePerFrame(DeviceSize size)
+{
+	if(size == m_transientBufferSizePerFrame)
+		return;
+	m_transientBufferSizePerFrame = size;
+	if(m_transientBufferAllocator) {
+		WaitIdle();
+		m_transientBufferAllocator = nullptr;
+	}
 }
 
 std::expected<std::shared_ptr<Window>, std::string> VlkContext::CreateWindow(const WindowSettings &windowCreationInfo)
@@ -738,6 +966,122 @@ void VlkContext::InitVulkan(const CreateInfo &createInfo)
 		devExtConfig.extension_status["VK_NV_device_diagnostics_config"] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
 	}
 
+	// Shader module identifiers (Used for pipeline library creation, which requires VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT from pipeline creation cache control)
+	if(m_physicalDevicePtr->is_device_extension_supported(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) && m_physicalDevicePtr->is_device_extension_supported(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) {
+		VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeatures {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT};
+		VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT cacheControlFeatures {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT};
+		shaderModuleIdentifierFeatures.pNext = &cacheControlFeatures;
+		VkPhysicalDeviceFeatures2 features2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		features2.pNext = &shaderModuleIdentifierFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevicePtr->get_physical_device(), &features2);
+		if(shaderModuleIdentifierFeatures.shaderModuleIdentifier && cacheControlFeatures.pipelineCreationCacheControl) {
+			devExtConfig.extension_status[VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			devExtConfig.extension_status[VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT);
+			features.shaderModuleIdentifier = VK_TRUE;
+			auto &cacheControl = addExtension.template operator()<VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT);
+			cacheControl.pipelineCreationCacheControl = VK_TRUE;
+		}
+	}
+
+	// Host image copy
+	if(m_physicalDevicePtr->is_device_extension_supported(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+		VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT};
+		VkPhysicalDeviceFeatures2 features2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		features2.pNext = &hostImageCopyFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevicePtr->get_physical_device(), &features2);
+		if(hostImageCopyFeatures.hostImageCopy) {
+			devExtConfig.extension_status[VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			// Dependencies of VK_EXT_host_image_copy (Core in Vulkan 1.3)
+			devExtConfig.extension_status[VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			devExtConfig.extension_status[VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceHostImageCopyFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT);
+			features.hostImageCopy = VK_TRUE;
+		}
+	}
+
+	// Dynamic rendering
+	if(m_physicalDevicePtr->is_device_extension_supported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR};
+		VkPhysicalDeviceFeatures2 features2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		features2.pNext = &dynamicRenderingFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevicePtr->get_physical_device(), &features2);
+		if(dynamicRenderingFeatures.dynamicRendering) {
+			devExtConfig.extension_status[VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			// Dependencies of VK_KHR_dynamic_rendering (Core in Vulkan 1.2)
+			devExtConfig.extension_status[VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			devExtConfig.extension_status[VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceDynamicRenderingFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR);
+			features.dynamicRendering = VK_TRUE;
+		}
+	}
+
+	// Extended dynamic state
+	auto extendedDynamicStates = ExtendedDynamicStateFlags::None;
+	{
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT};
+		VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extendedDynamicState2Features {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT};
+		VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT};
+		VkPhysicalDeviceFeatures2 features2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		// Feature structures of unsupported extensions must not be chained
+		auto **pNext = &features2.pNext;
+		auto chainFeatures = [this, &pNext](const char *ext, auto &features, void *&featuresNext) {
+			if(!m_physicalDevicePtr->is_device_extension_supported(ext))
+				return;
+			*pNext = &features;
+			pNext = &featuresNext;
+		};
+		chainFeatures(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, extendedDynamicStateFeatures, extendedDynamicStateFeatures.pNext);
+		chainFeatures(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME, extendedDynamicState2Features, extendedDynamicState2Features.pNext);
+		chainFeatures(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME, extendedDynamicState3Features, extendedDynamicState3Features.pNext);
+		vkGetPhysicalDeviceFeatures2(m_physicalDevicePtr->get_physical_device(), &features2);
+		if(extendedDynamicStateFeatures.extendedDynamicState) {
+			devExtConfig.extension_status[VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceExtendedDynamicStateFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT);
+			features.extendedDynamicState = VK_TRUE;
+			extendedDynamicStates |= ExtendedDynamicStateFlags::ExtendedDynamicState1;
+		}
+		if(extendedDynamicState2Features.extendedDynamicState2) {
+			devExtConfig.extension_status[VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceExtendedDynamicState2FeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT);
+			features.extendedDynamicState2 = VK_TRUE;
+			extendedDynamicStates |= ExtendedDynamicStateFlags::ExtendedDynamicState2;
+		}
+		if(extendedDynamicState3Features.extendedDynamicState3PolygonMode) {
+			devExtConfig.extension_status[VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceExtendedDynamicState3FeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT);
+			features.extendedDynamicState3PolygonMode = VK_TRUE;
+			extendedDynamicStates |= ExtendedDynamicStateFlags::PolygonModeBit;
+		}
+	}
+
+	// Memory budget
+	devExtConfig.extension_status[VK_EXT_MEMORY_BUDGET_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+
+	// Dedicated allocation hints
+	devExtConfig.extension_status[VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+	devExtConfig.extension_status[VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+	// Allows querying the memory requirements of an image without creating it
+	if(m_physicalDevicePtr->is_device_extension_supported(VK_KHR_MAINTENANCE_4_EXTENSION_NAME)) {
+		VkPhysicalDeviceMaintenance4FeaturesKHR maintenance4Features {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_4_FEATURES_KHR};
+		VkPhysicalDeviceFeatures2 features2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		features2.pNext = &maintenance4Features;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevicePtr->get_physical_device(), &features2);
+		if(maintenance4Features.maintenance4) {
+			devExtConfig.extension_status[VK_KHR_MAINTENANCE_4_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+			auto &features = addExtension.template operator()<VkPhysicalDeviceMaintenance4FeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_4_FEATURES_KHR);
+			features.maintenance4 = VK_TRUE;
+		}
+	}
+
+	// Graphics pipeline libraries
+	if(GraphicsPipelineLibraryManager::IsSupported(*m_physicalDevicePtr)) {
+		devExtConfig.extension_status[VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+		devExtConfig.extension_status[VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
+		auto &features = addExtension.template operator()<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+		features.graphicsPipelineLibrary = VK_TRUE;
+	}
+
 	// OpenXr
 	devExtConfig.extension_status["XR_KHR_vulkan_enable2"] = Anvil::ExtensionAvailability::ENABLE_IF_AVAILABLE;
 
@@ -782,13 +1126,20 @@ void VlkContext::InitVulkan(const CreateInfo &createInfo)
 	if(ShouldLog(pragma::util::LogSeverity::Debug))
 		m_logHandler("Creating GPU device...", pragma::util::LogSeverity::Debug);
 	m_devicePtr = Anvil::SGPUDevice::create(std::move(devCreateInfo));
+	m_shaderModuleCache.SetShaderModuleIdentifiersEnabled(*m_devicePtr, m_devicePtr->is_extension_enabled(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) && m_devicePtr->is_extension_enabled(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME));
+	m_samplerCache.SetSamplerLimit(m_devicePtr->get_physical_device_properties().core_vk1_0_properties_ptr->limits.max_sampler_allocation_count);
+	if(m_devicePtr->is_extension_enabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && m_devicePtr->is_extension_enabled(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME))
+		m_graphicsPipelineLibrary = std::make_unique<GraphicsPipelineLibraryManager>(*this, m_devicePtr->get_device_vk(), m_devicePtr->get_pipeline_cache() ? m_devicePtr->get_pipeline_cache()->get_pipeline_cache() : VK_NULL_HANDLE);
 	if(m_useAllocator)
 		m_useReservedDeviceLocalImageBuffer = false; // VMA already handles the allocation of large buffers; We'll just let it do its thing for image allocation
 
 	if(m_useAllocator) {
 		if(ShouldLog(pragma::util::LogSeverity::Debug))
 			m_logHandler("Creating VMA allocator...", pragma::util::LogSeverity::Debug);
+		// The allocator inherits the thread-safety of the device, which allows buffers and images to be created
+		// concurrently without any additional synchronization
 		m_memAllocator = Anvil::MemoryAllocator::create_vma(m_devicePtr.get());
+		m_memoryDefragmenter = std::make_unique<MemoryDefragmenter>(*this);
 	}
 
 	/*[](Anvil::BaseDevice &dev) -> Anvil::PipelineCacheUniquePtr {
@@ -805,6 +1156,36 @@ void VlkContext::InitVulkan(const CreateInfo &createInfo)
 	s_devToContext[m_devicePtr.get()] = this;
 
 	m_rtFunctions.Initialize(m_devicePtr->get_device_vk());
+	m_deferredDestructionQueue = std::make_unique<DeferredDestructionQueue>();
+	// Persistent descriptor sets may be created before the swapchain, so the number of frames is updated once it exists
+	m_descriptorSetAllocator = std::make_unique<DescriptorSetAllocator>(*this, 1);
+
+	VkPhysicalDeviceMemoryProperties memProps;
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevicePtr->get_physical_device(), &memProps);
+	m_memoryTypeTable.Initialize(memProps);
+	if(m_devicePtr->is_extension_enabled(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME) && m_devicePtr->is_extension_enabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) && m_devicePtr->is_extension_enabled(VK_KHR_MAINTENANCE_4_EXTENSION_NAME))
+		m_vkGetDeviceImageMemoryRequirements = (PFN_vkGetDeviceImageMemoryRequirementsKHR)vkGetDeviceProcAddr(m_devicePtr->get_device_vk(), "vkGetDeviceImageMemoryRequirementsKHR");
+	if(m_devicePtr->is_extension_enabled(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+		m_dynamicRenderingFunctions.Initialize(m_devicePtr->get_device_vk());
+	if(extendedDynamicStates != ExtendedDynamicStateFlags::None) {
+		m_extendedDynamicStateFunctions.Initialize(m_devicePtr->get_device_vk());
+		m_supportedExtendedDynamicStates = extendedDynamicStates & m_extendedDynamicStateFunctions.GetSupportedStates();
+		SetExtendedDynamicStatesEnabled(true);
+	}
+	if(m_devicePtr->is_extension_enabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+		m_hostImageCopyFunctions.Initialize(m_devicePtr->get_device_vk());
+		VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProps {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT};
+		VkPhysicalDeviceProperties2 props2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+		props2.pNext = &hostImageCopyProps;
+		vkGetPhysicalDeviceProperties2(m_physicalDevicePtr->get_physical_device(), &props2);
+		m_hostImageCopyDstLayouts.resize(hostImageCopyProps.copyDstLayoutCount);
+		m_hostImageCopySrcLayouts.resize(hostImageCopyProps.copySrcLayoutCount);
+		hostImageCopyProps.pCopyDstLayouts = m_hostImageCopyDstLayouts.data();
+		hostImageCopyProps.pCopySrcLayouts = m_hostImageCopySrcLayouts.data();
+		vkGetPhysicalDeviceProperties2(m_physicalDevicePtr->get_physical_device(), &props2);
+		m_hostImageCopyDstLayouts.resize(hostImageCopyProps.copyDstLayoutCount);
+		m_hostImageCopySrcLayouts.resize(hostImageCopyProps.copySrcLayoutCount);
+	}
 
 	auto vendor = GetPhysicalDeviceVendor();
 	if(vendor == Vendor::AMD) {
@@ -898,8 +1279,31 @@ std::optional<std::string> VlkContext::DumpMemoryBudget() const
 	str << "Allocation Count: " << budget.statistics.allocationCount << " (Number of #VmaAllocation objects allocated.)\n";
 	str << "Block Bytes: " << pragma::util::get_pretty_bytes(budget.statistics.blockBytes) << " (Number of bytes allocated in `VkDeviceMemory` blocks.)\n";
 	str << "Allocation Bytes: " << pragma::util::get_pretty_bytes(budget.statistics.allocationBytes) << " (Total number of bytes occupied by all #VmaAllocation objects.)\n";
+	str << "\nGovernor:\n" << m_memoryBudgetGovernor.ToString();
 	return str.str();
 }
+void VlkContext::UpdateMemoryBudget()
+{
+	if(m_memAllocator == nullptr)
+		return;
+	auto *backend = m_memAllocator->GetAllocatorBackend();
+	if(backend == nullptr)
+		return;
+	auto vmaHandle = static_cast<Anvil::MemoryAllocatorBackends::VMA *>(backend)->GetVmaHandle();
+	if(!vmaHandle)
+		return;
+	// Uses VK_EXT_memory_budget if available, otherwise VMA estimates the budget
+	std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> vmaBudgets;
+	vmaGetHeapBudgets(vmaHandle, vmaBudgets.data());
+	auto &memProps = GetDevice().get_physical_device_memory_properties();
+	std::vector<MemoryBudgetGovernor::HeapBudget> budgets;
+	budgets.reserve(memProps.n_heaps);
+	for(auto i = decltype(memProps.n_heaps) {0u}; i < memProps.n_heaps; ++i) {
+		auto deviceLocal = (memProps.heaps[i].flags & Anvil::MemoryHeapFlagBits::DEVICE_LOCAL_BIT) != Anvil::MemoryHeapFlagBits::NONE;
+		budgets.push_back({vmaBudgets[i].budget, vmaBudgets[i].usage, deviceLocal});
+	}
+	m_memoryBudgetGovernor.Update(budgets);
+}
 std::optional<std::string> VlkContext::DumpMemoryStats() const
 {
 	if(m_memAllocator == nullptr)
@@ -914,6 +1318,93 @@ std::optional<std::string> VlkContext::DumpMemoryStats() const
 	vmaBuildStatsString(vmaHandle, &statsString, true /* detailedMap */);
 	std::string str = statsString;
 	vmaFreeStatsString(vmaHandle, statsString);
+
+	std::stringstream ss;
+	auto moduleStats = m_shaderModuleCache.GetStats();
+	ss << "\nShader modules:\n";
+	ss << "Unique modules: " << moduleStats.moduleCount << " (" << pragma::util::get_pretty_bytes(moduleStats.spirvSize) << " of SPIR-V)\n";
+	ss << "Module references: " << moduleStats.moduleReferenceCount << "\n";
+	ss << "Cache hits / misses: " << moduleStats.hits << " / " << moduleStats.misses << "\n";
+	ss << "Saved by deduplication: " << (moduleStats.moduleReferenceCount - moduleStats.moduleCount) << " modules (" << pragma::util::get_pretty_bytes(moduleStats.spirvSizeSaved) << " of SPIR-V)\n";
+
+	auto samplerStats = m_samplerCache.GetStats();
+	ss << "\nSamplers:\n";
+	ss << "Unique samplers: " << samplerStats.samplerCount << " (device limit: " << GetDevice().get_physical_device_properties().core_vk1_0_properties_ptr->limits.max_sampler_allocation_count << ")\n";
+	ss << "Sampler references: " << samplerStats.samplerReferenceCount << "\n";
+	ss << "Cache hits / misses: " << samplerStats.hits << " / " << samplerStats.misses << "\n";
+
+	auto rpStats = m_renderPassCache.GetStats();
+	auto fbStats = m_framebufferCache.GetStats();
+	ss << "\nRender passes / framebuffers:\n";
+	ss << "Cached render passes: " << rpStats.objectCount << " (hits / misses: " << rpStats.hits << " / " << rpStats.misses << ")\n";
+	ss << "Cached framebuffers: " << fbStats.objectCount << " (hits / misses: " << fbStats.hits << " / " << fbStats.misses << ")\n";
+
+	if(m_descriptorSetAllocator) {
+		auto dsStats = m_descriptorSetAllocator->GetStats();
+		auto avgMicroseconds = [](std::chrono::nanoseconds t, uint64_t count) { return (count > 0) ? (static_cast<double>(t.count()) / 1'000.0 / static_cast<double>(count)) : 0.0; };
+		ss << "\nDescriptor sets:\n";
+		ss << "Layouts: " << dsStats.layoutCount << ", pools: " << dsStats.blockCount << " persistent / " << dsStats.transientBlockCount << " transient\n";
+		ss << "Live sets: " << dsStats.liveSets << " (capacity: " << dsStats.setCapacity << ")\n";
+		ss << "Allocations: " << dsStats.allocations << " persistent / " << dsStats.transientAllocations << " transient\n";
+		ss << "Pooled create / destroy: " << avgMicroseconds(dsStats.pooledCreateTime, dsStats.pooledCreateCount) << "us / " << avgMicroseconds(dsStats.pooledDestroyTime, dsStats.pooledDestroyCount) << "us (" << dsStats.pooledCreateCount << " / "
+		   << dsStats.pooledDestroyCount << " groups)\n";
+		ss << "Dedicated pool create / destroy: " << avgMicroseconds(dsStats.dedicatedCreateTime, dsStats.dedicatedCreateCount) << "us / " << avgMicroseconds(dsStats.dedicatedDestroyTime, dsStats.dedicatedDestroyCount) << "us (" << dsStats.dedicatedCreateCount
+		   << " / " << dsStats.dedicatedDestroyCount << " groups)\n";
+	}
+
+	uint64_t viewHits = m_imageViewCacheHits;
+	uint64_t viewMisses = m_imageViewCacheMisses;
+	ss << "\nImage views:\n";
+	ss << "Live views: " << VlkImageView::GetLiveViewCount() << "\n";
+	ss << "Cache hits / misses: " << viewHits << " / " << viewMisses;
+	if(viewHits + viewMisses > 0)
+		ss << " (" << (viewHits * 100 / (viewHits + viewMisses)) << "% hit rate)";
+	ss << "\n";
+
+	// Transient attachments in lazily allocated memory only commit physical memory if the driver has to spill them from tile memory
+	uint32_t numLazyImages = 0;
+	uint32_t numRegularImages = 0;
+	uint64_t lazySize = 0;
+	uint64_t regularSize = 0;
+	uint64_t committedSize = 0;
+	std::unordered_set<VkDeviceMemory> lazyMemories;
+	auto &memProps = GetDevice().get_physical_device_memory_properties();
+	auto vkDevice = GetDevice().get_device_vk();
+	// The images are accessed while the tracker keeps them locked, since they could be destroyed by another thread otherwise
+	MemoryTracker::GetInstance().IterateResources(
+	  [&](const MemoryTracker::Resource &res) {
+		  auto &img = *static_cast<VlkImage *>(res.resource);
+		  if(!pragma::math::is_flag_set(img.GetCreateInfo().usage, ImageUsageFlags::TransientAttachmentBit))
+			  return;
+		  for(auto &alloc : res.allocations) {
+			  auto lazy = alloc.memoryType < memProps.types.size() && (memProps.types[alloc.memoryType].features & Anvil::MemoryFeatureFlagBits::LAZILY_ALLOCATED_BIT) != Anvil::MemoryFeatureFlagBits::NONE;
+			  if(!lazy) {
+				  ++numRegularImages;
+				  regularSize += alloc.size;
+				  continue;
+			  }
+			  ++numLazyImages;
+			  lazySize += alloc.size;
+			  auto *memBlock = res.GetMemoryBlock(0);
+			  if(memBlock == nullptr || lazyMemories.insert(memBlock->get_memory()).second == false)
+				  continue;
+			  VkDeviceSize committed = 0;
+			  vkGetDeviceMemoryCommitment(vkDevice, memBlock->get_memory(), &committed);
+			  committedSize += committed;
+		  }
+	  },
+	  MemoryTracker::Resource::TypeFlags::ImageBit);
+	ss << "\nTransient attachments:\n";
+	ss << "Lazily allocated: " << numLazyImages << " images (" << pragma::util::get_pretty_bytes(lazySize) << ", " << pragma::util::get_pretty_bytes(committedSize) << " committed)\n";
+	ss << "Regular memory: " << numRegularImages << " images (" << pragma::util::get_pretty_bytes(regularSize) << ")\n";
+	ss << "Saved: " << pragma::util::get_pretty_bytes((lazySize > committedSize) ? (lazySize - committedSize) : 0) << "\n";
+	if(m_memoryDefragmenter) {
+		ss << "\nFragmentation:\n" << m_memoryDefragmenter->CalcFragmentationMetrics().ToString();
+		if(auto &lastPass = m_memoryDefragmenter->GetLastPassResult())
+			ss << "Last defragmentation pass: " << lastPass->buffersRelocated << " of " << lastPass->movesRequested << " requested moves (" << pragma::util::get_pretty_bytes(lastPass->bytesMoved) << ")\n";
+	}
+	ss << "\n" << m_memoryTypeTable.ToString();
+	str += ss.str();
 	return str;
 }
 
@@ -1013,6 +1504,20 @@ void VlkContext::DoKeepResourceAliveUntilPresentationComplete(const std::shared_
 	m_keepAliveResources.at(swapchainImgIdx).push_back(resource);
 }
 
+void VlkContext::KeepThreadSafeResourceAliveUntilPresentationComplete(const std::shared_ptr<void> &resource)
+{
+	if(!m_window)
+		return;
+	auto swapchainImgIdx = GetLastAcquiredPrimaryWindowSwapchainImageIndex();
+	auto *fence = static_cast<VlkWindow &>(GetWindow()).GetFence(swapchainImgIdx);
+	if(!fence || fence->is_set())
+		return;
+	std::unique_lock lock {m_swapchainResourcesInUseMutex};
+	if(swapchainImgIdx >= m_threadSafeKeepAliveResources.size() || !m_swapchainResourcesInUse[swapchainImgIdx])
+		return;
+	m_threadSafeKeepAliveResources[swapchainImgIdx].push_back(resource);
+}
+
 bool VlkContext::IsPresentationModeSupported(prosper::PresentModeKHR presentMode) const { return m_window ? static_cast<const VlkWindow &>(GetWindow()).IsPresentationModeSupported(presentMode) : true; }
 
 static Anvil::QueueFamilyFlags queue_family_flags_to_anvil_queue_family(prosper::QueueFamilyFlags flags)
@@ -1085,7 +1590,7 @@ std::shared_ptr<prosper::IBuffer> VlkContext::CreateBuffer(const prosper::util::
 
 	auto &dev = static_cast<VlkContext &>(*this).GetDevice();
 	if((createInfo.flags & prosper::util::BufferCreateInfo::Flags::Sparse) != prosper::util::BufferCreateInfo::Flags::None) {
-		Anvil::BufferCreateFlags createFlags {Anvil::BufferCreateFlagBits::NONE};
+		Anvil::BufferCreateFlags createFlags {Anvil::BufferCreateFlagBits::SPARSE_BINDING_BIT};
 		if((createInfo.flags & prosper::util::BufferCreateInfo::Flags::SparseAliasedResidency) != prosper::util::BufferCreateInfo::Flags::None)
 			createFlags |= Anvil::BufferCreateFlagBits::SPARSE_ALIASED_BIT | Anvil::BufferCreateFlagBits::SPARSE_RESIDENCY_BIT;
 
@@ -1095,7 +1600,7 @@ std::shared_ptr<prosper::IBuffer> VlkContext::CreateBuffer(const prosper::util::
 	}
 	Anvil::BufferCreateFlags createFlags {Anvil::BufferCreateFlagBits::NONE};
 	if((createInfo.flags & prosper::util::BufferCreateInfo::Flags::DontAllocateMemory) == prosper::util::BufferCreateInfo::Flags::None) {
-		auto memoryFeatures = createInfo.memoryFeatures;
+		auto memoryFeatures = m_memoryBudgetGovernor.ApplyAllocationPolicy(createInfo.memoryFeatures, createInfo.usageFlags);
 		find_compatible_memory_feature_flags(*this, memoryFeatures);
 		if(m_useAllocator) {
 			auto bufferCreateInfo = Anvil::BufferCreateInfo::create_no_alloc(&dev, static_cast<VkDeviceSize>(createInfo.size), queue_family_flags_to_anvil_queue_family(createInfo.queueFamilyMask), sharingMode, createFlags, static_cast<Anvil::BufferUsageFlagBits>(createInfo.usageFlags));
@@ -1128,7 +1633,7 @@ std::shared_ptr<prosper::IBuffer> VlkContext::CreateBuffer(const prosper::util::
 	return VlkBuffer::Create(*this, std::move(buf), createInfo, 0ull, createInfo.size);
 }
 
-static Anvil::ImageCreateInfoUniquePtr create_anvil_create_info(prosper::IPrContext &context, prosper::util::ImageCreateInfo &createInfo, bool &outUseDiscreteMemory, const std::vector<Anvil::MipmapRawData> *data = nullptr)
+static Anvil::ImageCreateInfoUniquePtr create_anvil_create_info(prosper::IPrContext &context, prosper::util::ImageCreateInfo &createInfo, bool &outUseDiscreteMemory, bool &outUseDedicatedAllocation, const std::vector<Anvil::MipmapRawData> *data = nullptr)
 {
 	// See https://vulkan.lunarg.com/doc/view/1.3.268.0/windows/1.3-extensions/vkspec.html#valid-imageview-imageusage
 	constexpr auto requiredFlags
@@ -1141,6 +1646,20 @@ static Anvil::ImageCreateInfoUniquePtr create_anvil_create_info(prosper::IPrCont
 		context.ValidationCallback(DebugMessageSeverityFlags::ErrorBit, "Attempted to create image with both HostCached and DeviceLocal flags, which is poorly supported. Removing DeviceLocal flag...");
 		pragma::math::remove_flag(createInfo.memoryFeatures, MemoryFeatureFlags::DeviceLocal);
 	}
+	// Attachments are never moved out of device-local memory
+	constexpr auto attachmentFlags = prosper::ImageUsageFlags::ColorAttachmentBit | prosper::ImageUsageFlags::DepthStencilAttachmentBit | prosper::ImageUsageFlags::InputAttachmentBit | prosper::ImageUsageFlags::TransientAttachmentBit;
+	if((createInfo.usage & attachmentFlags) == prosper::ImageUsageFlags::None && createInfo.tiling == prosper::ImageTiling::Linear)
+		createInfo.memoryFeatures = static_cast<prosper::VlkContext &>(context).GetMemoryBudgetGovernor().ApplyAllocationPolicy(createInfo.memoryFeatures);
+	// Transient attachments (e.g. multisampled targets that are resolved within the render pass) usually never leave tile memory,
+	// so they don't need to be backed by physical memory if the device has a lazily allocated memory type.
+	if(pragma::math::is_flag_set(createInfo.usage, prosper::ImageUsageFlags::TransientAttachmentBit) && (createInfo.memoryFeatures & prosper::MemoryFeatureFlags::HostAccessable) == prosper::MemoryFeatureFlags::None) {
+		constexpr auto lazyFlags = prosper::MemoryFeatureFlags::DeviceLocal | prosper::MemoryFeatureFlags::LazilyAllocated;
+		auto memType = static_cast<prosper::VlkContext &>(context).FindCompatibleMemoryType(lazyFlags);
+		if(memType.first != nullptr && memType.second == lazyFlags)
+			createInfo.memoryFeatures = lazyFlags;
+		else
+			pragma::math::remove_flag(createInfo.memoryFeatures, prosper::MemoryFeatureFlags::LazilyAllocated);
+	}
 	auto &layers = createInfo.layers;
 	auto imageCreateFlags = Anvil::ImageCreateFlags {};
 	if((createInfo.flags & prosper::util::ImageCreateInfo::Flags::Cubemap) != prosper::util::ImageCreateInfo::Flags::None) {
@@ -1152,6 +1671,10 @@ static Anvil::ImageCreateInfoUniquePtr create_anvil_create_info(prosper::IPrCont
 	if(postCreateLayout == prosper::ImageLayout::ColorAttachmentOptimal && prosper::util::is_depth_format(createInfo.format))
 		postCreateLayout = prosper::ImageLayout::DepthStencilAttachmentOptimal;
 
+	auto usage = static_cast<VkImageUsageFlags>(createInfo.usage);
+	if(static_cast<prosper::VlkContext &>(context).IsHostImageCopySupported(createInfo))
+		usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+
 	auto memoryFeatures = createInfo.memoryFeatures;
 	find_compatible_memory_feature_flags(static_cast<prosper::VlkContext &>(context), memoryFeatures);
 	auto queueFamilies = queue_family_flags_to_anvil_queue_family(createInfo.queueFamilyMask);
@@ -1161,25 +1684,51 @@ static Anvil::ImageCreateInfoUniquePtr create_anvil_create_info(prosper::IPrCont
 
 	auto &useDiscreteMemory = outUseDiscreteMemory;
 	useDiscreteMemory = pragma::math::is_flag_set(createInfo.flags, prosper::util::ImageCreateInfo::Flags::AllocateDiscreteMemory);
-	if(useDiscreteMemory == false && ((createInfo.memoryFeatures & prosper::MemoryFeatureFlags::HostAccessable) != prosper::MemoryFeatureFlags::None || (createInfo.memoryFeatures & prosper::MemoryFeatureFlags::DeviceLocal) == prosper::MemoryFeatureFlags::None))
-		useDiscreteMemory = true; // Pre-allocated memory currently only supported for device local memory
+	if(useDiscreteMemory == false
+	  && ((createInfo.memoryFeatures & prosper::MemoryFeatureFlags::HostAccessable) != prosper::MemoryFeatureFlags::None || (createInfo.memoryFeatures & prosper::MemoryFeatureFlags::DeviceLocal) == prosper::MemoryFeatureFlags::None
+	    || (createInfo.memoryFeatures & prosper::MemoryFeatureFlags::LazilyAllocated) != prosper::MemoryFeatureFlags::None))
+		useDiscreteMemory = true; // Pre-allocated memory currently only supported for (non-lazily allocated) device local memory
 
 	auto sparse = (createInfo.flags & prosper::util::ImageCreateInfo::Flags::Sparse) != prosper::util::ImageCreateInfo::Flags::None;
 	auto dontAllocateMemory = pragma::math::is_flag_set(createInfo.flags, prosper::util::ImageCreateInfo::Flags::DontAllocateMemory);
 
 	auto bUseFullMipmapChain = (createInfo.flags & prosper::util::ImageCreateInfo::Flags::FullMipmapChain) != prosper::util::ImageCreateInfo::Flags::None;
+	outUseDedicatedAllocation = false;
+	if(useDiscreteMemory == false && sparse == false && dontAllocateMemory == false && static_cast<prosper::VlkContext &>(context).GetMemoryAllocator()) {
+		// Large images the driver wants to have in their own allocation bypass the allocator (see VlkContext::AllocateDedicatedImageMemory)
+		VkImageCreateInfo vkCreateInfo {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+		vkCreateInfo.flags = pragma::math::is_flag_set(createInfo.flags, prosper::util::ImageCreateInfo::Flags::Cubemap) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+		vkCreateInfo.imageType = static_cast<VkImageType>(createInfo.type);
+		vkCreateInfo.format = static_cast<VkFormat>(createInfo.format);
+		vkCreateInfo.extent = {createInfo.width, createInfo.height, 1};
+		vkCreateInfo.mipLevels = bUseFullMipmapChain ? prosper::util::calculate_mipmap_count(createInfo.width, createInfo.height) : 1u;
+		vkCreateInfo.arrayLayers = layers;
+		vkCreateInfo.samples = static_cast<VkSampleCountFlagBits>(createInfo.samples);
+		vkCreateInfo.tiling = static_cast<VkImageTiling>(createInfo.tiling);
+		vkCreateInfo.usage = usage;
+		vkCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		vkCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		outUseDedicatedAllocation = static_cast<prosper::VlkContext &>(context).ShouldUseDedicatedAllocation(vkCreateInfo);
+	}
 	if(useDiscreteMemory == false || sparse || dontAllocateMemory) {
+		if(sparse) {
+			imageCreateFlags |= Anvil::ImageCreateFlagBits::SPARSE_BINDING_BIT;
+			// Residency allows binding individual blocks instead of the entire image
+			auto &features = *static_cast<prosper::VlkContext &>(context).GetDevice().get_physical_device_features().core_vk1_0_features_ptr;
+			if(createInfo.type == prosper::ImageType::e2D && features.sparse_residency_image_2D)
+				imageCreateFlags |= Anvil::ImageCreateFlagBits::SPARSE_RESIDENCY_BIT;
+		}
 		if((createInfo.flags & prosper::util::ImageCreateInfo::Flags::SparseAliasedResidency) != prosper::util::ImageCreateInfo::Flags::None)
 			imageCreateFlags |= Anvil::ImageCreateFlagBits::SPARSE_ALIASED_BIT | Anvil::ImageCreateFlagBits::SPARSE_RESIDENCY_BIT;
 
 		auto anvCreateInfo = Anvil::ImageCreateInfo::create_no_alloc(&static_cast<prosper::VlkContext &>(context).GetDevice(), static_cast<Anvil::ImageType>(createInfo.type), static_cast<Anvil::Format>(createInfo.format), static_cast<Anvil::ImageTiling>(createInfo.tiling),
-		  static_cast<Anvil::ImageUsageFlagBits>(createInfo.usage), createInfo.width, createInfo.height, 1u, layers, static_cast<Anvil::SampleCountFlagBits>(createInfo.samples), queueFamilies, sharingMode, bUseFullMipmapChain, imageCreateFlags,
+		  static_cast<Anvil::ImageUsageFlagBits>(usage), createInfo.width, createInfo.height, 1u, layers, static_cast<Anvil::SampleCountFlagBits>(createInfo.samples), queueFamilies, sharingMode, bUseFullMipmapChain, imageCreateFlags,
 		  static_cast<Anvil::ImageLayout>(postCreateLayout), data);
 		return anvCreateInfo;
 	}
 
 	auto anvCreateInfo = Anvil::ImageCreateInfo::create_alloc(&static_cast<prosper::VlkContext &>(context).GetDevice(), static_cast<Anvil::ImageType>(createInfo.type), static_cast<Anvil::Format>(createInfo.format), static_cast<Anvil::ImageTiling>(createInfo.tiling),
-	  static_cast<Anvil::ImageUsageFlagBits>(createInfo.usage), createInfo.width, createInfo.height, 1u, layers, static_cast<Anvil::SampleCountFlagBits>(createInfo.samples), queueFamilies, sharingMode, bUseFullMipmapChain, memory_feature_flags_to_anvil_flags(createInfo.memoryFeatures),
+	  static_cast<Anvil::ImageUsageFlagBits>(usage), createInfo.width, createInfo.height, 1u, layers, static_cast<Anvil::SampleCountFlagBits>(createInfo.samples), queueFamilies, sharingMode, bUseFullMipmapChain, memory_feature_flags_to_anvil_flags(createInfo.memoryFeatures),
 	  imageCreateFlags, static_cast<Anvil::ImageLayout>(postCreateLayout), data);
 	return anvCreateInfo;
 }
@@ -1188,7 +1737,8 @@ std::shared_ptr<prosper::IImage> create_image(prosper::IPrContext &context, cons
 {
 	auto createInfo = pCreateInfo;
 	auto useDiscreteMemory = false;
-	auto anvCreateInfo = create_anvil_create_info(context, createInfo, useDiscreteMemory, data);
+	auto useDedicatedAllocation = false;
+	auto anvCreateInfo = create_anvil_create_info(context, createInfo, useDiscreteMemory, useDedicatedAllocation, data);
 	auto sparse = (createInfo.flags & prosper::util::ImageCreateInfo::Flags::Sparse) != prosper::util::ImageCreateInfo::Flags::None;
 	auto dontAllocateMemory = pragma::math::is_flag_set(createInfo.flags, prosper::util::ImageCreateInfo::Flags::DontAllocateMemory);
 	if(useDiscreteMemory == false || sparse || dontAllocateMemory) {
@@ -1198,8 +1748,10 @@ std::shared_ptr<prosper::IImage> create_image(prosper::IPrContext &context, cons
 		auto *memAllocator = static_cast<prosper::VlkContext &>(context).GetMemoryAllocator();
 		if(memAllocator) {
 			if(sparse == false && dontAllocateMemory == false) {
-				auto memoryFeatureFlags = memory_feature_flags_to_anvil_flags(createInfo.memoryFeatures);
-				memAllocator->add_image_whole(anvImg.get(), memoryFeatureFlags);
+				if(useDedicatedAllocation == false || !static_cast<prosper::VlkContext &>(context).AllocateDedicatedImageMemory(*anvImg, createInfo.memoryFeatures)) {
+					auto memoryFeatureFlags = memory_feature_flags_to_anvil_flags(createInfo.memoryFeatures);
+					memAllocator->add_image_whole(anvImg.get(), memoryFeatureFlags);
+				}
 			}
 		}
 		auto img = prosper::VlkImage::Create(context, std::move(anvImg), createInfo, false);
@@ -1221,6 +1773,33 @@ std::shared_ptr<IImage> prosper::VlkContext::CreateImage(const util::ImageCreate
 		util::to_string(createInfo, ss);
 	}
 	auto byteSize = util::get_pixel_size(createInfo.format);
+	if(getImageData && !util::is_compressed_format(createInfo.format)) {
+		// Write the initial data directly from the CPU if possible, which avoids the staging buffer
+		auto hostCreateInfo = createInfo;
+		hostCreateInfo.usage |= ImageUsageFlags::TransferDstBit;
+		if(IsHostImageCopySupported(hostCreateInfo) && IsHostImageCopyDstLayout(hostCreateInfo.postCreateLayout)) {
+			auto img = static_cast<VlkContext *>(this)->CreateImage(hostCreateInfo, std::vector<Anvil::MipmapRawData> {});
+			auto *vkImg = img ? dynamic_cast<VlkImage *>(img.get()) : nullptr;
+			if(vkImg && vkImg->IsHostImageCopyEnabled()) {
+				auto numMipmaps = pragma::math::is_flag_set(createInfo.flags, util::ImageCreateInfo::Flags::FullMipmapChain) ? util::calculate_mipmap_count(createInfo.width, createInfo.height) : 1u;
+				auto numLayers = vkImg->GetLayerCount();
+				for(auto iLayer = decltype(numLayers) {0u}; iLayer < numLayers; ++iLayer) {
+					for(auto iMipmap = decltype(numMipmaps) {0u}; iMipmap < numMipmaps; ++iMipmap) {
+						auto wMipmap = util::calculate_mipmap_size(createInfo.width, iMipmap);
+						auto hMipmap = util::calculate_mipmap_size(createInfo.height, iMipmap);
+						auto dataSize = wMipmap * hMipmap * byteSize;
+						auto rowSize = wMipmap * byteSize;
+						auto *mipmapData = getImageData(iLayer, iMipmap, dataSize, rowSize);
+						if(mipmapData == nullptr)
+							continue;
+						if(!vkImg->CopyFromMemory(mipmapData, iMipmap, iLayer, 1, 0, 0, wMipmap, hMipmap, rowSize / byteSize))
+							return nullptr;
+					}
+				}
+				return img;
+			}
+		}
+	}
 	std::vector<Anvil::MipmapRawData> anvMipmapData {};
 	if(getImageData) {
 		auto numMipmaps = pragma::math::is_flag_set(createInfo.flags, util::ImageCreateInfo::Flags::FullMipmapChain) ? util::calculate_mipmap_count(createInfo.width, createInfo.height) : 1u;
@@ -1241,45 +1820,142 @@ std::shared_ptr<IImage> prosper::VlkContext::CreateImage(const util::ImageCreate
 	return static_cast<VlkContext *>(this)->CreateImage(createInfo, anvMipmapData);
 }
 
-std::pair<const Anvil::MemoryType *, prosper::MemoryFeatureFlags> VlkContext::FindCompatibleMemoryType(MemoryFeatureFlags featureFlags) const
+void VlkContext::SetExtendedDynamicStatesEnabled(bool enabled)
 {
-	auto r = std::pair<const Anvil::MemoryType *, prosper::MemoryFeatureFlags> {nullptr, featureFlags};
-	if(pragma::math::to_integral(featureFlags) == 0u)
-		return r;
-	prosper::MemoryFeatureFlags requiredFeatures {};
+	if(m_graphicsPipelineLibrary)
+		m_graphicsPipelineLibrary->SetExtendedDynamicStates(enabled ? m_supportedExtendedDynamicStates : ExtendedDynamicStateFlags::None);
+}
 
-	// Convert usage to requiredFlags and preferredFlags.
-	switch(featureFlags) {
-	case prosper::MemoryFeatureFlags::CPUToGPU:
-	case prosper::MemoryFeatureFlags::GPUToCPU:
-		requiredFeatures |= prosper::MemoryFeatureFlags::HostAccessable;
+ExtendedDynamicStateFlags VlkContext::GetExtendedDynamicStates() const { return m_graphicsPipelineLibrary ? m_graphicsPipelineLibrary->GetExtendedDynamicStates() : ExtendedDynamicStateFlags::None; }
+
+bool VlkContext::IsHostImageCopyDstLayout(ImageLayout layout) const { return std::find(m_hostImageCopyDstLayouts.begin(), m_hostImageCopyDstLayouts.end(), static_cast<VkImageLayout>(layout)) != m_hostImageCopyDstLayouts.end(); }
+bool VlkContext::IsHostImageCopySrcLayout(ImageLayout layout) const { return std::find(m_hostImageCopySrcLayouts.begin(), m_hostImageCopySrcLayouts.end(), static_cast<VkImageLayout>(layout)) != m_hostImageCopySrcLayouts.end(); }
+ImageLayout VlkContext::GetHostImageCopyDstLayout(ImageLayout preferredLayout) const
+{
+	for(auto layout : {preferredLayout, ImageLayout::ShaderReadOnlyOptimal, ImageLayout::General}) {
+		if(IsHostImageCopyDstLayout(layout))
+			return layout;
 	}
+	return m_hostImageCopyDstLayouts.empty() ? ImageLayout::General : static_cast<ImageLayout>(m_hostImageCopyDstLayouts.front());
+}
+
+bool VlkContext::IsHostImageCopySupported(const util::ImageCreateInfo &createInfo) const
+{
+	if(!m_hostImageCopyFunctions.IsValid() || createInfo.tiling != ImageTiling::Optimal || createInfo.samples != SampleCountFlags::e1Bit)
+		return false;
+	// Only images that receive data from the CPU; Render targets are better off with the default device layout
+	constexpr auto attachmentFlags = ImageUsageFlags::ColorAttachmentBit | ImageUsageFlags::DepthStencilAttachmentBit | ImageUsageFlags::InputAttachmentBit | ImageUsageFlags::TransientAttachmentBit;
+	if(!pragma::math::is_flag_set(createInfo.usage, ImageUsageFlags::TransferDstBit) || (createInfo.usage & attachmentFlags) != ImageUsageFlags::None)
+		return false;
+	constexpr auto sparseFlags = util::ImageCreateInfo::Flags::Sparse | util::ImageCreateInfo::Flags::SparseAliasedResidency;
+	if((createInfo.flags & sparseFlags) != util::ImageCreateInfo::Flags::None)
+		return false;
+	auto cubemap = pragma::math::is_flag_set(createInfo.flags, util::ImageCreateInfo::Flags::Cubemap);
+	auto key = std::make_tuple(createInfo.format, createInfo.type, createInfo.usage, cubemap);
+	std::scoped_lock lock {m_hostImageCopySupportMutex};
+	auto it = m_hostImageCopySupport.find(key);
+	if(it != m_hostImageCopySupport.end())
+		return it->second;
+	VkHostImageCopyDevicePerformanceQueryEXT perfQuery {VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT};
+	VkImageFormatProperties2 formatProps {VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2};
+	formatProps.pNext = &perfQuery;
+	VkPhysicalDeviceImageFormatInfo2 formatInfo {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2};
+	formatInfo.format = static_cast<VkFormat>(createInfo.format);
+	formatInfo.type = static_cast<VkImageType>(createInfo.type);
+	formatInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	formatInfo.usage = static_cast<VkImageUsageFlags>(createInfo.usage) | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+	if(cubemap)
+		formatInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	auto supported = vkGetPhysicalDeviceImageFormatProperties2(m_physicalDevicePtr->get_physical_device(), &formatInfo, &formatProps) == VK_SUCCESS && perfQuery.optimalDeviceAccess == VK_TRUE;
+	m_hostImageCopySupport[key] = supported;
+	return supported;
+}
+
+std::pair<const Anvil::MemoryType *, prosper::MemoryFeatureFlags> VlkContext::FindCompatibleMemoryType(MemoryFeatureFlags featureFlags) const
+{
+	auto &selection = m_memoryTypeTable.FindCompatibleMemoryType(featureFlags);
+	if(!selection.IsValid())
+		return {nullptr, featureFlags};
+	auto &memProps = GetDevice().get_physical_device_memory_properties();
+	return {&memProps.types[selection.memoryTypeIndex], selection.featureFlags};
+}
 
-	auto anvFlags = memory_feature_flags_to_anvil_flags(featureFlags);
-	auto anvRequiredFlags = memory_feature_flags_to_anvil_flags(requiredFeatures);
+bool VlkContext::ShouldUseDedicatedAllocation(const VkImageCreateInfo &createInfo) const
+{
+	if(!m_vkGetDeviceImageMemoryRequirements)
+		return false;
+	// Rough estimate to skip the query for small images, which are never allocated dedicated
+	auto estimatedSize = static_cast<DeviceSize>(createInfo.extent.width) * createInfo.extent.height * createInfo.extent.depth * createInfo.arrayLayers * util::get_byte_size(static_cast<Format>(createInfo.format));
+	if(util::is_compressed_format(static_cast<Format>(createInfo.format)))
+		estimatedSize /= 16;
+	if(estimatedSize < MemoryTypeTable::DEDICATED_ALLOCATION_MIN_SIZE)
+		return false;
+	VkMemoryDedicatedRequirements dedicatedReq {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+	VkMemoryRequirements2 memReq {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+	memReq.pNext = &dedicatedReq;
+	VkDeviceImageMemoryRequirementsKHR reqInfo {VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS_KHR};
+	reqInfo.pCreateInfo = &createInfo;
+	m_vkGetDeviceImageMemoryRequirements(GetDevice().get_device_vk(), &reqInfo, &memReq);
+	return MemoryTypeTable::ShouldUseDedicatedAllocation(dedicatedReq, memReq.memoryRequirements.size);
+}
+
+bool VlkContext::AllocateDedicatedImageMemory(Anvil::Image &img, MemoryFeatureFlags featureFlags)
+{
 	auto &dev = GetDevice();
-	auto &memProps = dev.get_physical_device_memory_properties();
-	for(auto &type : memProps.types) {
-		if((type.features & anvFlags) == anvFlags) {
-			// Found preferred flags
-			r.first = &type;
-			return r;
-		}
-		if((type.features & anvRequiredFlags) != Anvil::MemoryFeatureFlagBits::NONE)
-			r.first = &type; // Found required flags
+	auto vkDevice = dev.get_device_vk();
+	VkMemoryRequirements memReq;
+	vkGetImageMemoryRequirements(vkDevice, img.get_image(), &memReq);
+	auto selection = m_memoryTypeTable.Select(featureFlags, MemoryTypeTable::ResourceKind::Image, memReq.memoryTypeBits);
+	if(!selection.IsValid()) {
+		// Fall back to the features that can actually be provided
+		auto &compatible = m_memoryTypeTable.FindCompatibleMemoryType(featureFlags);
+		if(compatible.IsValid())
+			selection = m_memoryTypeTable.Select(compatible.featureFlags, MemoryTypeTable::ResourceKind::Image, memReq.memoryTypeBits);
+		if(!selection.IsValid())
+			return false;
 	}
-	r.second = requiredFeatures;
-	return r;
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+	dedicatedInfo.image = img.get_image();
+	VkMemoryAllocateInfo allocInfo {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+	allocInfo.pNext = &dedicatedInfo;
+	allocInfo.allocationSize = memReq.size;
+	allocInfo.memoryTypeIndex = selection.memoryTypeIndex;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if(vkAllocateMemory(vkDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		return false;
+	// The block owns the allocation
+	auto memBlock = Anvil::MemoryBlock::create(Anvil::MemoryBlockCreateInfo::create_derived_with_custom_delete_proc(&dev, memory, memReq.memoryTypeBits, memory_feature_flags_to_anvil_flags(selection.featureFlags), selection.memoryTypeIndex, memReq.size, 0,
+	  [vkDevice, memory](Anvil::MemoryBlock *) { vkFreeMemory(vkDevice, memory, nullptr); }));
+	if(memBlock == nullptr) {
+		vkFreeMemory(vkDevice, memory, nullptr);
+		return false;
+	}
+	return img.set_memory(std::move(memBlock));
 }
 
 Anvil::PipelineLayout *VlkContext::GetPipelineLayout(bool graphicsShader, Anvil::PipelineID pipelineId)
 {
 	auto &dev = GetDevice();
-	if(graphicsShader)
-		return dev.get_graphics_pipeline_manager()->get_pipeline_layout(m_prosperPipelineToAnvilPipeline[pipelineId]);
+	if(graphicsShader) {
+		auto anvPipelineId = m_prosperPipelineToAnvilPipeline[pipelineId];
+		if(anvPipelineId == std::numeric_limits<Anvil::PipelineID>::max())
+			return nullptr;
+		return dev.get_graphics_pipeline_manager()->get_pipeline_layout(anvPipelineId);
+	}
 	return dev.get_compute_pipeline_manager()->get_pipeline_layout(m_prosperPipelineToAnvilPipeline[pipelineId]);
 }
 
+VkPipelineLayout VlkContext::GetVkPipelineLayout(bool graphicsShader, PipelineID pipelineId)
+{
+	if(graphicsShader && m_graphicsPipelineLibrary) {
+		if(auto layout = m_graphicsPipelineLibrary->GetPipelineLayout(pipelineId))
+			return layout->vkPipelineLayout;
+	}
+	auto *anvLayout = GetPipelineLayout(graphicsShader, pipelineId);
+	return anvLayout ? anvLayout->get_pipeline_layout() : VK_NULL_HANDLE;
+}
+
 void *VlkContext::GetInternalDevice() const { return GetDevice().get_device_vk(); }
 void *VlkContext::GetInternalPhysicalDevice() const { return GetDevice().get_physical_device()->get_physical_device(); }
 void *VlkContext::GetInternalInstance() const { return GetDevice().get_parent_instance()->get_instance_vk(); }
@@ -1289,10 +1965,11 @@ bool VlkContext::IsInstanceExtensionEnabled(const std::string &ext) const { retu
 
 void VlkContext::SubmitCommandBuffer(prosper::ICommandBuffer &cmd, prosper::QueueFamilyType queueFamilyType, bool shouldBlock, prosper::IFence *fence)
 {
+	FlushMappedMemoryRanges();
 	auto res = VkResult::VK_SUCCESS;
 	switch(queueFamilyType) {
 	case prosper::QueueFamilyType::Universal:
-		res = m_devicePtr->get_universal_queue(0u)->submit(Anvil::SubmitInfo::create(&cmd.GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer(), 0u, nullptr, 0u, nullptr, nullptr, shouldBlock, fence ? &static_cast<VlkFence *>(fence)->GetAnvilFence() : nullptr));
+		res = submit_to_universal_queue(*this, cmd.GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer(), shouldBlock, fence ? &static_cast<VlkFence *>(fence)->GetAnvilFence() : nullptr);
 		break;
 	case prosper::QueueFamilyType::Compute:
 		res = m_devicePtr->get_compute_queue(0u)->submit(Anvil::SubmitInfo::create(&cmd.GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer(), 0u, nullptr, 0u, nullptr, nullptr, shouldBlock, fence ? &static_cast<VlkFence *>(fence)->GetAnvilFence() : nullptr));
@@ -1368,26 +2045,60 @@ static std::unique_ptr<Anvil::DescriptorSetCreateInfo> to_anv_descriptor_set_cre
 	return dsInfo;
 }
 
-static Anvil::ShaderModuleUniquePtr to_anv_shader_module(Anvil::BaseDevice &dev, const prosper::ShaderModule &module)
+static Anvil::ShaderModuleStageEntryPoint to_anv_entrypoint(Anvil::BaseDevice &dev, prosper::ShaderModuleStageEntryPoint &entrypoint, prosper::ShaderModuleCache &moduleCache, std::vector<std::shared_ptr<prosper::ShaderModuleCache::Entry>> &outModules)
 {
-	auto *shaderStageProgram = static_cast<const prosper::VlkShaderStageProgram *>(module.GetShaderStageProgram());
-	if(shaderStageProgram == nullptr)
-		return nullptr;
-	auto &spirvBlob = shaderStageProgram->GetSPIRVBlob();
-	if(spirvBlob.empty())
-		return nullptr;
-	return Anvil::ShaderModule::create_from_spirv_blob(&dev, spirvBlob.data(), spirvBlob.size(), module.GetCSEntrypointName(), module.GetFSEntrypointName(), module.GetGSEntrypointName(), module.GetTCEntrypointName(), module.GetTEEntrypointName(), module.GetVSEntrypointName());
+	// Pipelines with identical shader code share the same module
+	auto module = moduleCache.Acquire(dev, *entrypoint.shader_module_ptr);
+	if(!module)
+		return {};
+	outModules.push_back(module);
+	return Anvil::ShaderModuleStageEntryPoint {entrypoint.name, module->module.get(), static_cast<Anvil::ShaderStage>(entrypoint.stage)};
+}
+
+static VkShaderStageFlagBits to_vk_shader_stage(prosper::ShaderStage stage)
+{
+	switch(stage) {
+	case prosper::ShaderStage::Fragment:
+		return VK_SHADER_STAGE_FRAGMENT_BIT;
+	case prosper::ShaderStage::Geometry:
+		return VK_SHADER_STAGE_GEOMETRY_BIT;
+	case prosper::ShaderStage::TessellationControl:
+		return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	case prosper::ShaderStage::TessellationEvaluation:
+		return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	case prosper::ShaderStage::Vertex:
+		return VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	return VK_SHADER_STAGE_COMPUTE_BIT;
 }
 
-static Anvil::ShaderModuleStageEntryPoint to_anv_entrypoint(Anvil::BaseDevice &dev, prosper::ShaderModuleStageEntryPoint &entrypoint)
+// Compares the hand-written pipeline layout against the layout reflected from the SPIR-V of all stages
+static void validate_pipeline_layout(prosper::VlkContext &context, const prosper::BasePipelineCreateInfo &pipelineCreateInfo, const std::vector<prosper::ShaderStageData *> &stages)
 {
-	auto module = to_anv_shader_module(dev, *entrypoint.shader_module_ptr);
-	if(!module)
-		return {};
-	return Anvil::ShaderModuleStageEntryPoint {entrypoint.name, std::move(module), static_cast<Anvil::ShaderStage>(entrypoint.stage)};
+	prosper::spirv::ReflectionData reflectionData {};
+	for(auto *stage : stages) {
+		if(!stage || !stage->entryPoint || !stage->entryPoint->shader_module_ptr)
+			continue;
+		auto *shaderStageProgram = static_cast<const prosper::VlkShaderStageProgram *>(stage->entryPoint->shader_module_ptr->GetShaderStageProgram());
+		if(!shaderStageProgram)
+			continue;
+		std::string errMsg;
+		auto stageData = prosper::spirv::reflect(shaderStageProgram->GetSPIRVBlob(), &errMsg);
+		if(!stageData) {
+			context.ValidationCallback(prosper::DebugMessageSeverityFlags::WarningBit, "[VK] WARNING: Failed to reflect SPIR-V of pipeline '" + pipelineCreateInfo.GetName() + "': " + errMsg);
+			return;
+		}
+		reflectionData.Merge(*stageData);
+	}
+	for(auto &issue : prosper::spirv::validate_pipeline_layout(reflectionData, pipelineCreateInfo)) {
+		if(issue.severity == prosper::spirv::LayoutIssue::Severity::Error)
+			context.ValidationCallback(prosper::DebugMessageSeverityFlags::ErrorBit, "[VK] ERROR: Pipeline layout of '" + pipelineCreateInfo.GetName() + "' does not match shader: " + issue.message);
+		else if(context.ShouldLog(pragma::util::LogSeverity::Debug))
+			context.Log("Pipeline layout of '" + pipelineCreateInfo.GetName() + "': " + issue.message, pragma::util::LogSeverity::Debug);
+	}
 }
 
-static void init_base_pipeline_create_info(const prosper::BasePipelineCreateInfo &pipelineCreateInfo, Anvil::BasePipelineCreateInfo &anvPipelineCreateInfo, bool computePipeline)
+static std::shared_ptr<prosper::PipelineLayoutCache::PipelineLayout> init_base_pipeline_create_info(const prosper::BasePipelineCreateInfo &pipelineCreateInfo, Anvil::BasePipelineCreateInfo &anvPipelineCreateInfo, bool computePipeline, prosper::PipelineLayoutCache &layoutCache)
 {
 	anvPipelineCreateInfo.set_name(pipelineCreateInfo.GetName());
 	for(auto i = decltype(pragma::math::to_integral(prosper::ShaderStage::Count)) {0u}; i < pragma::math::to_integral(prosper::ShaderStage::Count); ++i) {
@@ -1414,16 +2125,10 @@ static void init_base_pipeline_create_info(const prosper::BasePipelineCreateInfo
 	for(auto &pushConstantRange : pushConstantRanges)
 		anvPipelineCreateInfo.attach_push_constant_range(pushConstantRange.offset, pushConstantRange.size, static_cast<Anvil::ShaderStageFlagBits>(pushConstantRange.stages));
 
-	auto *dsInfos = pipelineCreateInfo.GetDsCreateInfoItems();
-	std::vector<const Anvil::DescriptorSetCreateInfo *> anvDsInfos;
-	std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> anvDsInfosOwned;
-	anvDsInfos.reserve(dsInfos->size());
-	anvDsInfos.reserve(anvDsInfosOwned.size());
-	for(auto &dsCreateInfo : *dsInfos) {
-		anvDsInfosOwned.push_back(to_anv_descriptor_set_create_info(*dsCreateInfo));
-		anvDsInfos.push_back(anvDsInfosOwned.back().get());
-	}
-	anvPipelineCreateInfo.set_descriptor_set_create_info(&anvDsInfos);
+	// Identical layouts are shared between pipelines instead of being re-converted for every pipeline
+	auto layout = layoutCache.Acquire(pipelineCreateInfo);
+	anvPipelineCreateInfo.set_descriptor_set_create_info(&layout->descriptorSetCreateInfos);
+	return layout;
 }
 
 std::shared_ptr<prosper::IDescriptorSetGroup> prosper::VlkContext::CreateDescriptorSetGroup(DescriptorSetCreateInfo &descSetInfo) { return static_cast<VlkContext *>(this)->CreateDescriptorSetGroup(descSetInfo, to_anv_descriptor_set_create_info(descSetInfo)); }
@@ -1487,22 +2192,32 @@ std::optional<prosper::PipelineID> VlkContext::AddPipeline(prosper::Shader &shad
 	Anvil::PipelineID anvBasePipelineId;
 	if(bIsDerivative)
 		anvBasePipelineId = m_prosperPipelineToAnvilPipeline[basePipelineId];
-	auto ep = to_anv_entrypoint(dev, *stage.entryPoint);
-	if(ep.name.empty())
+	PipelineResources resources {};
+	auto ep = to_anv_entrypoint(dev, *stage.entryPoint, m_shaderModuleCache, resources.shaderModules);
+	if(ep.name.empty()) {
+		ReleasePipelineResources(resources);
 		return {};
+	}
 	auto computePipelineInfo = Anvil::ComputePipelineCreateInfo::create(createFlags, std::move(ep), bIsDerivative ? &anvBasePipelineId : nullptr);
-	if(computePipelineInfo == nullptr)
+	if(computePipelineInfo == nullptr) {
+		ReleasePipelineResources(resources);
 		return {};
-	init_base_pipeline_create_info(createInfo, *computePipelineInfo, true);
+	}
+	resources.layout = init_base_pipeline_create_info(createInfo, *computePipelineInfo, true, m_pipelineLayoutCache);
+	if(IsValidationEnabled())
+		validate_pipeline_layout(*this, createInfo, {&stage});
 	auto *computePipelineManager = dev.get_compute_pipeline_manager();
 	Anvil::PipelineID anvPipelineId;
 	auto r = computePipelineManager->add_pipeline(std::move(computePipelineInfo), &anvPipelineId);
-	if(r == false)
+	if(r == false) {
+		ReleasePipelineResources(resources);
 		return {};
+	}
 	AddShaderPipeline(shader, shaderPipelineId, pipelineId);
 	if(pipelineId >= m_prosperPipelineToAnvilPipeline.size())
 		m_prosperPipelineToAnvilPipeline.resize(pipelineId + 1, std::numeric_limits<Anvil::PipelineID>::max());
 	m_prosperPipelineToAnvilPipeline[pipelineId] = anvPipelineId;
+	SetPipelineResources(pipelineId, std::move(resources));
 	computePipelineManager->bake();
 	return pipelineId;
 }
@@ -1513,6 +2228,35 @@ std::optional<PipelineID> VlkContext::AddPipeline(prosper::Shader &shader, Pipel
 	return {};
 }
 
+// Attachment formats of a sub-pass, in the order of its color attachment locations (see VlkContext::CreateRenderPass)
+static void get_rendering_formats(const prosper::util::RenderPassCreateInfo &rpInfo, prosper::SubPassID subPassId, std::vector<VkFormat> &outColorFormats, VkFormat &outDepthFormat, VkFormat &outStencilFormat)
+{
+	outDepthFormat = VK_FORMAT_UNDEFINED;
+	outStencilFormat = VK_FORMAT_UNDEFINED;
+	auto useDepthStencil = true;
+	if(subPassId < rpInfo.subPasses.size()) {
+		auto &subPass = rpInfo.subPasses[subPassId];
+		for(auto attId : subPass.colorAttachments)
+			outColorFormats.push_back(static_cast<VkFormat>(rpInfo.attachments[attId].format));
+		useDepthStencil = subPass.useDepthStencilAttachment;
+	}
+	else {
+		for(auto &att : rpInfo.attachments) {
+			if(prosper::util::is_depth_format(static_cast<prosper::Format>(att.format)) == false)
+				outColorFormats.push_back(static_cast<VkFormat>(att.format));
+		}
+	}
+	if(!useDepthStencil)
+		return;
+	auto it = std::find_if(rpInfo.attachments.begin(), rpInfo.attachments.end(), [](const auto &att) { return prosper::util::is_depth_format(static_cast<prosper::Format>(att.format)); });
+	if(it == rpInfo.attachments.end())
+		return;
+	auto format = static_cast<VkFormat>(it->format);
+	if(format != VK_FORMAT_S8_UINT)
+		outDepthFormat = format;
+	if(prosper::util::has_stencil_aspect(static_cast<prosper::Format>(format)))
+		outStencilFormat = format;
+}
 std::optional<prosper::PipelineID> prosper::VlkContext::AddPipeline(prosper::Shader &shader, PipelineID shaderPipelineId, const prosper::GraphicsPipelineCreateInfo &createInfo, IRenderPass &rp, prosper::ShaderStageData *shaderStageFs, prosper::ShaderStageData *shaderStageVs,
   prosper::ShaderStageData *shaderStageGs, prosper::ShaderStageData *shaderStageTc, prosper::ShaderStageData *shaderStageTe, SubPassID subPassId, PipelineID basePipelineId)
 {
@@ -1522,19 +2266,26 @@ std::optional<prosper::PipelineID> prosper::VlkContext::AddPipeline(prosper::Sha
 	auto &dev = static_cast<VlkContext &>(*this).GetDevice();
 	Anvil::PipelineCreateFlags createFlags = Anvil::PipelineCreateFlagBits::ALLOW_DERIVATIVES_BIT;
 	auto bIsDerivative = basePipelineId != std::numeric_limits<PipelineID>::max();
+	// Pipelines that were built from pipeline libraries have no Anvil pipeline that could act as the base
+	if(bIsDerivative && (basePipelineId >= m_prosperPipelineToAnvilPipeline.size() || m_prosperPipelineToAnvilPipeline[basePipelineId] == std::numeric_limits<Anvil::PipelineID>::max()))
+		bIsDerivative = false;
 	if(bIsDerivative)
 		createFlags = createFlags | Anvil::PipelineCreateFlagBits::DERIVATIVE_BIT;
 	Anvil::PipelineID anvBasePipelineId;
 	if(bIsDerivative)
 		anvBasePipelineId = m_prosperPipelineToAnvilPipeline[basePipelineId];
 	auto valid = true;
-	auto toAnvEntrypoint = [&dev, &valid](prosper::ShaderStageData *shaderStage) -> Anvil::ShaderModuleStageEntryPoint {
+	auto rpSubPassId = subPassId;
+	PipelineResources resources {};
+	std::vector<GraphicsPipelineLibraryManager::ShaderStage> libraryStages;
+	auto toAnvEntrypoint = [this, &dev, &valid, &resources, &libraryStages](prosper::ShaderStageData *shaderStage) -> Anvil::ShaderModuleStageEntryPoint {
 		if(shaderStage) {
-			auto ep = to_anv_entrypoint(dev, *shaderStage->entryPoint);
+			auto ep = to_anv_entrypoint(dev, *shaderStage->entryPoint, m_shaderModuleCache, resources.shaderModules);
 			if(ep.name.empty()) {
 				valid = false;
 				return {};
 			}
+			libraryStages.push_back({to_vk_shader_stage(shaderStage->entryPoint->stage), resources.shaderModules.back(), shaderStage->entryPoint->name});
 			return ep;
 		}
 		return {};
@@ -1544,11 +2295,15 @@ std::optional<prosper::PipelineID> prosper::VlkContext::AddPipeline(prosper::Sha
 	auto epTc = toAnvEntrypoint(shaderStageTc);
 	auto epTe = toAnvEntrypoint(shaderStageTe);
 	auto epVs = toAnvEntrypoint(shaderStageVs);
-	if(!valid)
+	if(!valid) {
+		ReleasePipelineResources(resources);
 		return {};
+	}
 	auto gfxPipelineInfo = Anvil::GraphicsPipelineCreateInfo::create(createFlags, &static_cast<VlkRenderPass &>(rp).GetAnvilRenderPass(), subPassId, epFs, epGs, epTc, epTe, epVs, nullptr, bIsDerivative ? &anvBasePipelineId : nullptr);
-	if(gfxPipelineInfo == nullptr)
+	if(gfxPipelineInfo == nullptr) {
+		ReleasePipelineResources(resources);
 		return {};
+	}
 	gfxPipelineInfo->toggle_depth_writes(createInfo.AreDepthWritesEnabled());
 	gfxPipelineInfo->toggle_alpha_to_coverage(createInfo.IsAlphaToCoverageEnabled());
 	gfxPipelineInfo->toggle_alpha_to_one(createInfo.IsAlphaToOneEnabled());
@@ -1687,22 +2442,98 @@ std::optional<prosper::PipelineID> prosper::VlkContext::AddPipeline(prosper::Sha
 	  frontStencilCompareMask, frontStencilWriteMask, frontStencilReference);
 	gfxPipelineInfo->set_stencil_test_properties(false, static_cast<Anvil::StencilOp>(backStencilFailOp), static_cast<Anvil::StencilOp>(backStencilPassOp), static_cast<Anvil::StencilOp>(backStencilDepthFailOp), static_cast<Anvil::CompareOp>(backStencilCompareOp), backStencilCompareMask,
 	  backStencilWriteMask, backStencilReference);
-	init_base_pipeline_create_info(createInfo, *gfxPipelineInfo, false);
+	resources.layout = init_base_pipeline_create_info(createInfo, *gfxPipelineInfo, false, m_pipelineLayoutCache);
+	if(IsValidationEnabled())
+		validate_pipeline_layout(*this, createInfo, {shaderStageFs, shaderStageVs, shaderStageGs, shaderStageTc, shaderStageTe});
+
+	// Prefer pipeline libraries if available; Pipelines built from libraries are not registered with Anvil at all, otherwise
+	// the next bake of the Anvil pipeline manager would compile them monolithically as well
+	auto usesPipelineLibrary = false;
+	if(m_graphicsPipelineLibrary && resources.layout) {
+		auto vkLayout = m_pipelineLayoutCache.GetVkPipelineLayout(dev.get_device_vk(), *resources.layout);
+		auto vkRenderPass = static_cast<VlkRenderPass &>(rp).GetAnvilRenderPass().get_render_pass();
+		usesPipelineLibrary = m_graphicsPipelineLibrary->CreatePipeline(pipelineId, createInfo, vkRenderPass, rpSubPassId, libraryStages, resources.layout, vkLayout);
+		if(!usesPipelineLibrary)
+			m_graphicsPipelineLibrary->ClearPipeline(pipelineId);
+		else if(AreDynamicRenderingPipelinesEnabled()) {
+			// Dynamic rendering variant with the attachment formats of the sub-pass the pipeline was declared for
+			std::vector<VkFormat> colorFormats;
+			VkPipelineRenderingCreateInfo renderingInfo {VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+			get_rendering_formats(rp.GetCreateInfo(), rpSubPassId, colorFormats, renderingInfo.depthAttachmentFormat, renderingInfo.stencilAttachmentFormat);
+			renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+			renderingInfo.pColorAttachmentFormats = colorFormats.data();
+			if(!m_graphicsPipelineLibrary->CreatePipeline(pipelineId, createInfo, VK_NULL_HANDLE, 0, libraryStages, resources.layout, vkLayout, &renderingInfo))
+				Log("Failed to create dynamic rendering variant of pipeline " + std::to_string(pipelineId) + "!", pragma::util::LogSeverity::Warning);
+		}
+	}
 
 	auto *gfxPipelineManager = dev.get_graphics_pipeline_manager();
-	Anvil::PipelineID anvPipelineId;
-	auto r = gfxPipelineManager->add_pipeline(std::move(gfxPipelineInfo), &anvPipelineId);
-	if(r == false)
-		return {};
+	auto anvPipelineId = std::numeric_limits<Anvil::PipelineID>::max();
+	if(!usesPipelineLibrary) {
+		auto r = gfxPipelineManager->add_pipeline(std::move(gfxPipelineInfo), &anvPipelineId);
+		if(r == false) {
+			ReleasePipelineResources(resources);
+			return {};
+		}
+	}
 	AddShaderPipeline(shader, shaderPipelineId, pipelineId);
 	if(pipelineId >= m_prosperPipelineToAnvilPipeline.size())
 		m_prosperPipelineToAnvilPipeline.resize(pipelineId + 1, std::numeric_limits<Anvil::PipelineID>::max());
 	m_prosperPipelineToAnvilPipeline[pipelineId] = anvPipelineId;
-	if(IsValidationEnabled() || !m_loadShadersLazily)
+	SetPipelineResources(pipelineId, std::move(resources));
+	if(!usesPipelineLibrary && (IsValidationEnabled() || !m_loadShadersLazily))
 		gfxPipelineManager->bake();
 	return pipelineId;
 }
 
+// Uploads the packed pixel data as-is and expands it into the image with a compute shader. The conversion is recorded into the upload
+// command buffer of the context, which is executed before any command buffer that is submitted afterwards.
+// Returns nullptr if the GPU conversion is not possible, in which case the caller falls back to the CPU conversion.
+static std::shared_ptr<prosper::IImage> create_image_with_gpu_conversion(prosper::VlkContext &context, prosper::util::ImageCreateInfo imgCreateInfo, const std::vector<std::shared_ptr<pragma::image::ImageBuffer>> &imgBuffers, prosper::util::PixelConversion conversion)
+{
+	auto *converter = context.GetGpuFormatConverter();
+	if(!converter || !converter->IsSupported(conversion, imgCreateInfo.format))
+		return nullptr;
+	auto w = imgCreateInfo.width;
+	auto h = imgCreateInfo.height;
+	auto srcLayerSize = static_cast<prosper::DeviceSize>(w) * h * prosper::util::get_pixel_conversion_src_size(conversion);
+	// The shader reads 32-bit words, so each layer starts at a word boundary
+	auto srcLayerStride = (srcLayerSize + 3) & ~static_cast<prosper::DeviceSize>(3);
+	prosper::util::BufferCreateInfo bufCreateInfo {};
+	bufCreateInfo.size = srcLayerStride * imgBuffers.size();
+	bufCreateInfo.usageFlags = prosper::BufferUsageFlags::StorageBufferBit;
+	bufCreateInfo.memoryFeatures = prosper::MemoryFeatureFlags::CPUToGPU;
+	auto srcBuffer = context.CreateBuffer(bufCreateInfo);
+	if(!srcBuffer)
+		return nullptr;
+	for(auto iLayer = decltype(imgBuffers.size()) {0u}; iLayer < imgBuffers.size(); ++iLayer) {
+		if(!srcBuffer->Write(iLayer * srcLayerStride, srcLayerSize, imgBuffers[iLayer]->GetData()))
+			return nullptr;
+	}
+
+	// The conversion happens in a transient storage image, so the image itself only needs to be a transfer destination
+	imgCreateInfo.usage |= prosper::ImageUsageFlags::TransferDstBit;
+	auto finalLayout = (imgCreateInfo.postCreateLayout != prosper::ImageLayout::Undefined) ? imgCreateInfo.postCreateLayout : prosper::ImageLayout::ShaderReadOnlyOptimal;
+	auto img = context.CreateImage(imgCreateInfo, std::vector<Anvil::MipmapRawData> {});
+	if(!img)
+		return nullptr;
+
+	auto recorded = context.RecordUploadCommands([&](prosper::ICommandBuffer &cmd, std::vector<std::shared_ptr<void>> &keepAlive) {
+		// The image has to outlive the upload even if recording fails, since parts of the conversion may already have been recorded
+		keepAlive.push_back(img);
+		keepAlive.push_back(srcBuffer);
+		auto resources = converter->RecordConvertImage(cmd, conversion, *srcBuffer, srcLayerStride, *img, finalLayout);
+		if(!resources)
+			return false;
+		keepAlive.push_back(std::move(resources));
+		return true;
+	});
+	if(!recorded)
+		return nullptr;
+	static_cast<prosper::VlkImage &>(*img).SetHostLayout(finalLayout);
+	return img;
+}
+
 std::shared_ptr<prosper::IImage> create_image(prosper::IPrContext &context, const prosper::util::ImageCreateInfo &pImgCreateInfo, const std::vector<std::shared_ptr<pragma::image::ImageBuffer>> &imgBuffers, bool cubemap)
 {
 	if(imgBuffers.empty() || imgBuffers.size() != (cubemap ? 6 : 1))
@@ -1716,40 +2547,46 @@ std::shared_ptr<prosper::IImage> create_image(prosper::IPrContext &context, cons
 			return nullptr;
 	}
 	auto imgCreateInfo = pImgCreateInfo;
-	std::optional<pragma::image::Format> conversionFormatRequired = {};
+	auto conversion = prosper::util::PixelConversion::None;
 	auto &imgBuf = imgBuffers.front();
 	switch(imgBuf->GetFormat()) {
 	case pragma::image::Format::RGB8:
-		conversionFormatRequired = pragma::image::Format::RGBA8;
+		conversion = prosper::util::PixelConversion::Rgb8ToRgba8;
 		imgCreateInfo.format = prosper::Format::R8G8B8A8_UNorm;
 		break;
 	case pragma::image::Format::RGB16:
-		conversionFormatRequired = pragma::image::Format::RGBA16;
+		conversion = prosper::util::PixelConversion::Rgb16fToRgba16f;
 		imgCreateInfo.format = prosper::Format::R16G16B16A16_SFloat;
 		break;
 	}
 
 	static_assert(pragma::math::to_integral(pragma::image::Format::Count) == 13);
-	if(conversionFormatRequired.has_value()) {
-		std::vector<std::shared_ptr<pragma::image::ImageBuffer>> converted {};
-		converted.reserve(imgBuffers.size());
-		for(auto &img : imgBuffers) {
-			auto copy = img->Copy(*conversionFormatRequired);
-			converted.push_back(copy);
-		}
-		return create_image(context, imgCreateInfo, converted, cubemap);
+	if(conversion != prosper::util::PixelConversion::None && static_cast<prosper::VlkContext &>(context).IsGpuFormatConversionEnabled()) {
+		auto img = create_image_with_gpu_conversion(static_cast<prosper::VlkContext &>(context), imgCreateInfo, imgBuffers, conversion);
+		if(img)
+			return img;
 	}
-
 	auto byteSize = prosper::util::get_byte_size(imgCreateInfo.format);
+	auto layerSize = imgCreateInfo.width * imgCreateInfo.height * byteSize;
+	// Three-component formats are expanded directly into the upload buffers, without going through an intermediate image buffer
+	std::vector<std::vector<uint8_t>> convertedData {};
+	if(conversion != prosper::util::PixelConversion::None) {
+		convertedData.resize(imgBuffers.size());
+		for(auto iLayer = decltype(imgBuffers.size()) {0u}; iLayer < imgBuffers.size(); ++iLayer) {
+			auto &data = convertedData[iLayer];
+			data.resize(layerSize);
+			prosper::util::convert_image(conversion, imgBuffers[iLayer]->GetData(), data.data(), w, h);
+		}
+	}
 	std::vector<Anvil::MipmapRawData> layers {};
 	layers.reserve(imgBuffers.size());
 	for(auto iLayer = decltype(imgBuffers.size()) {0u}; iLayer < imgBuffers.size(); ++iLayer) {
-		auto &imgBuf = imgBuffers.at(iLayer);
+		auto *data = convertedData.empty() ? static_cast<uint8_t *>(imgBuffers.at(iLayer)->GetData()) : convertedData[iLayer].data();
 		if(cubemap) {
-			layers.push_back(Anvil::MipmapRawData::create_cube_map_from_uchar_ptr(Anvil::ImageAspectFlagBits::COLOR_BIT, iLayer, 0, static_cast<uint8_t *>(imgBuf->GetData()), imgCreateInfo.width * imgCreateInfo.height * byteSize, imgCreateInfo.width * byteSize));
+			layers.push_back(Anvil::MipmapRawData::create_cube_map_from_uchar_ptr(Anvil::ImageAspectFlagBits::COLOR_BIT, iLayer, 0, data, layerSize, imgCreateInfo.width * byteSize));
 		}
 		else {
-			layers.push_back(Anvil::MipmapRawData::create_2D_from_uchar_ptr(Anvil::ImageAspectFlagBits::COLOR_BIT, 0u, static_cast<uint8_t *>(imgBuf->GetData()), imgCreateInfo.width * imgCreateInfo.height * byteSize, imgCreateInfo.width * byteSize));
+			layers.push_back(Anvil::MipmapRawData::create_2D_from_uchar_ptr(Anvil::ImageAspectFlagBits::COLOR_BIT, 0u, data, layerSize, imgCreateInfo.width * byteSize));
 		}
 	}
 	return static_cast<VlkContext &>(context).CreateImage(imgCreateInfo, layers);
@@ -1760,64 +2597,66 @@ std::shared_ptr<prosper::IRenderPass> prosper::VlkContext::CreateRenderPass(cons
 {
 	return prosper::VlkRenderPass::Create(*this, renderPassInfo, Anvil::RenderPass::create(std::move(anvRenderPassInfo), &GetSwapchain()));
 }
-static void init_default_dsg_bindings(Anvil::BaseDevice &dev, Anvil::DescriptorSetGroup &dsg, const std::vector<bool> &cubemapBindings)
+static void init_default_ds_bindings(Anvil::BaseDevice &dev, Anvil::DescriptorSet &ds, Anvil::DescriptorSetLayout &dsLayout, const std::vector<bool> &cubemapBindings)
 {
 	// Initialize image sampler bindings with dummy texture
 	auto &context = prosper::VlkContext::GetContext(dev);
 	auto &dummyTex = context.GetDummyTexture();
 	auto &dummyCubemapTex = context.GetDummyCubemapTexture();
 	auto &dummyBuf = context.GetDummyBuffer();
-	auto numSets = dsg.get_n_descriptor_sets();
-	for(auto i = decltype(numSets) {0}; i < numSets; ++i) {
-		auto *descSet = dsg.get_descriptor_set(i);
-		auto *descSetLayout = dsg.get_descriptor_set_layout(i);
-		auto &info = *descSetLayout->get_create_info();
-		auto numBindings = info.get_n_bindings();
-		auto bindingIndex = 0u;
-		for(auto j = decltype(numBindings) {0}; j < numBindings; ++j) {
-			Anvil::DescriptorType descType;
-			uint32_t arraySize;
-			info.get_binding_properties_by_index_number(j, nullptr, &descType, &arraySize, nullptr, nullptr);
-			switch(descType) {
-			case Anvil::DescriptorType::COMBINED_IMAGE_SAMPLER:
-				{
-					auto &tex = cubemapBindings[j] ? dummyCubemapTex : dummyTex;
-					std::vector<Anvil::DescriptorSet::CombinedImageSamplerBindingElement> bindingElements(arraySize,
-					  Anvil::DescriptorSet::CombinedImageSamplerBindingElement {Anvil::ImageLayout::SHADER_READ_ONLY_OPTIMAL, &static_cast<prosper::VlkImageView &>(*tex->GetImageView()).GetAnvilImageView(), &static_cast<prosper::VlkSampler &>(*tex->GetSampler()).GetAnvilSampler()});
-					descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
-					break;
-				}
-			case Anvil::DescriptorType::UNIFORM_BUFFER:
-				{
-					std::vector<Anvil::DescriptorSet::UniformBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::UniformBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
-					descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
-					break;
-				}
-			case Anvil::DescriptorType::UNIFORM_BUFFER_DYNAMIC:
-				{
-					std::vector<Anvil::DescriptorSet::DynamicUniformBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::DynamicUniformBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
-					descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
-					break;
-				}
-			case Anvil::DescriptorType::STORAGE_BUFFER:
-				{
-					std::vector<Anvil::DescriptorSet::StorageBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::StorageBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
-					descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
-					break;
-				}
-			case Anvil::DescriptorType::STORAGE_BUFFER_DYNAMIC:
-				{
-					std::vector<Anvil::DescriptorSet::DynamicStorageBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::DynamicStorageBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
-					descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
-					break;
-				}
+	auto *descSet = &ds;
+	auto &info = *dsLayout.get_create_info();
+	auto numBindings = info.get_n_bindings();
+	auto bindingIndex = 0u;
+	for(auto j = decltype(numBindings) {0}; j < numBindings; ++j) {
+		Anvil::DescriptorType descType;
+		uint32_t arraySize;
+		info.get_binding_properties_by_index_number(j, nullptr, &descType, &arraySize, nullptr, nullptr);
+		switch(descType) {
+		case Anvil::DescriptorType::COMBINED_IMAGE_SAMPLER:
+			{
+				auto &tex = cubemapBindings[j] ? dummyCubemapTex : dummyTex;
+				std::vector<Anvil::DescriptorSet::CombinedImageSamplerBindingElement> bindingElements(arraySize,
+				  Anvil::DescriptorSet::CombinedImageSamplerBindingElement {Anvil::ImageLayout::SHADER_READ_ONLY_OPTIMAL, &static_cast<prosper::VlkImageView &>(*tex->GetImageView()).GetAnvilImageView(), &static_cast<prosper::VlkSampler &>(*tex->GetSampler()).GetAnvilSampler()});
+				descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
+				break;
+			}
+		case Anvil::DescriptorType::UNIFORM_BUFFER:
+			{
+				std::vector<Anvil::DescriptorSet::UniformBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::UniformBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
+				descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
+				break;
+			}
+		case Anvil::DescriptorType::UNIFORM_BUFFER_DYNAMIC:
+			{
+				std::vector<Anvil::DescriptorSet::DynamicUniformBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::DynamicUniformBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
+				descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
+				break;
+			}
+		case Anvil::DescriptorType::STORAGE_BUFFER:
+			{
+				std::vector<Anvil::DescriptorSet::StorageBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::StorageBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
+				descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
+				break;
+			}
+		case Anvil::DescriptorType::STORAGE_BUFFER_DYNAMIC:
+			{
+				std::vector<Anvil::DescriptorSet::DynamicStorageBufferBindingElement> bindingElements(arraySize, Anvil::DescriptorSet::DynamicStorageBufferBindingElement {&dummyBuf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer(), 0ull, dummyBuf->GetSize()});
+				descSet->set_binding_array_items(bindingIndex, {0u, arraySize}, bindingElements.data());
+				break;
 			}
-			//bindingIndex += arraySize;
-			++bindingIndex;
 		}
+		//bindingIndex += arraySize;
+		++bindingIndex;
 	}
 }
-std::shared_ptr<prosper::IDescriptorSetGroup> prosper::VlkContext::CreateDescriptorSetGroup(const DescriptorSetCreateInfo &descSetCreateInfo, std::unique_ptr<Anvil::DescriptorSetCreateInfo> descSetInfo)
+static void init_default_dsg_bindings(Anvil::BaseDevice &dev, Anvil::DescriptorSetGroup &dsg, const std::vector<bool> &cubemapBindings)
+{
+	auto numSets = dsg.get_n_descriptor_sets();
+	for(auto i = decltype(numSets) {0}; i < numSets; ++i)
+		init_default_ds_bindings(dev, *dsg.get_descriptor_set(i), *dsg.get_descriptor_set_layout(i), cubemapBindings);
+}
+static std::vector<bool> get_cubemap_bindings(const prosper::DescriptorSetCreateInfo &descSetCreateInfo)
 {
 	auto numBindings = descSetCreateInfo.GetBindingCount();
 	std::vector<bool> cubemapBindings;
@@ -1829,12 +2668,42 @@ std::shared_ptr<prosper::IDescriptorSetGroup> prosper::VlkContext::CreateDescrip
 				cubemapBindings[i] = true;
 		}
 	}
+	return cubemapBindings;
+}
+std::shared_ptr<prosper::IDescriptorSetGroup> prosper::VlkContext::CreateDescriptorSetGroup(const DescriptorSetCreateInfo &descSetCreateInfo, std::unique_ptr<Anvil::DescriptorSetCreateInfo> descSetInfo)
+{
+	auto cubemapBindings = get_cubemap_bindings(descSetCreateInfo);
+	auto t = std::chrono::steady_clock::now();
+	if(m_descriptorSetAllocator && m_descriptorSetPoolingEnabled) {
+		auto allocation = m_descriptorSetAllocator->Allocate(descSetCreateInfo, [&descSetCreateInfo]() { return to_anv_descriptor_set_create_info(const_cast<DescriptorSetCreateInfo &>(descSetCreateInfo)); });
+		if(allocation.IsValid()) {
+			// Sets are recycled, so any bindings of the previous owner are overwritten as well
+			init_default_ds_bindings(GetDevice(), *allocation.GetDescriptorSet(), *allocation.GetDescriptorSetLayout(), cubemapBindings);
+			auto dsg = prosper::VlkDescriptorSetGroup::Create(*this, descSetCreateInfo, std::move(allocation));
+			m_descriptorSetAllocator->AddTiming(true, true, std::chrono::steady_clock::now() - t);
+			return dsg;
+		}
+		// Fall back to a dedicated pool
+	}
 
 	std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> descSetInfos = {};
 	descSetInfos.push_back(std::move(descSetInfo));
 	auto dsg = Anvil::DescriptorSetGroup::create(&static_cast<VlkContext &>(*this).GetDevice(), descSetInfos, Anvil::DescriptorPoolCreateFlagBits::FREE_DESCRIPTOR_SET_BIT);
 	init_default_dsg_bindings(static_cast<VlkContext &>(*this).GetDevice(), *dsg, cubemapBindings);
-	return prosper::VlkDescriptorSetGroup::Create(*this, descSetCreateInfo, std::move(dsg));
+	auto result = prosper::VlkDescriptorSetGroup::Create(*this, descSetCreateInfo, std::move(dsg));
+	if(m_descriptorSetAllocator)
+		m_descriptorSetAllocator->AddTiming(false, true, std::chrono::steady_clock::now() - t);
+	return result;
+}
+std::shared_ptr<prosper::IDescriptorSetGroup> prosper::VlkContext::CreateTransientDescriptorSetGroup(const DescriptorSetCreateInfo &descSetCreateInfo)
+{
+	if(!m_descriptorSetAllocator)
+		return nullptr;
+	auto allocation = m_descriptorSetAllocator->AllocateTransient(descSetCreateInfo, [&descSetCreateInfo]() { return to_anv_descriptor_set_create_info(const_cast<DescriptorSetCreateInfo &>(descSetCreateInfo)); });
+	if(!allocation.IsValid())
+		return nullptr;
+	init_default_ds_bindings(GetDevice(), *allocation.GetDescriptorSet(), *allocation.GetDescriptorSetLayout(), get_cubemap_bindings(descSetCreateInfo));
+	return prosper::VlkDescriptorSetGroup::Create(*this, descSetCreateInfo, std::move(allocation));
 }
 
 std::shared_ptr<IQueryPool> VlkContext::CreateQueryPool(QueryType queryType, uint32_t maxConcurrentQueries)
@@ -1893,30 +2762,86 @@ std::shared_ptr<prosper::IEvent> prosper::VlkContext::CreateEvent() { return Vlk
 std::shared_ptr<prosper::IFence> prosper::VlkContext::CreateFence(bool createSignalled) { return VlkFence::Create(*this, createSignalled, nullptr); }
 std::shared_ptr<prosper::IImageView> prosper::VlkContext::DoCreateImageView(const prosper::util::ImageViewCreateInfo &createInfo, prosper::IImage &img, Format format, ImageViewType type, prosper::ImageAspectFlags aspectMask, uint32_t numLayers)
 {
+	auto &vlkImg = static_cast<VlkImage &>(img);
+	VlkImage::ViewCacheKey key {};
+	key.type = type;
+	key.format = format;
+	key.aspectMask = aspectMask;
+	key.baseMipmap = createInfo.baseMipmap;
+	key.mipmapCount = pragma::math::min(createInfo.baseMipmap + createInfo.mipmapLevels, img.GetMipmapCount()) - createInfo.baseMipmap;
+	key.baseLayer = createInfo.baseLayer.has_value() ? *createInfo.baseLayer : 0u;
 	switch(type) {
+	case ImageViewType::e1D:
 	case ImageViewType::e2D:
-		return VlkImageView::Create(*this, img, createInfo, type, aspectMask,
-		  Anvil::ImageView::create(Anvil::ImageViewCreateInfo::create_2D(&static_cast<VlkContext &>(*this).GetDevice(), &static_cast<VlkImage &>(img).GetAnvilImage(), createInfo.baseLayer.has_value() ? *createInfo.baseLayer : 0u, createInfo.baseMipmap,
-		    pragma::math::min(createInfo.baseMipmap + createInfo.mipmapLevels, img.GetMipmapCount()) - createInfo.baseMipmap, static_cast<Anvil::ImageAspectFlagBits>(aspectMask), static_cast<Anvil::Format>(format), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleRed),
-		    static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleGreen), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleBlue), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleAlpha))));
+	case ImageViewType::e3D:
+		key.layerCount = 1;
+		break;
 	case ImageViewType::Cube:
-		return VlkImageView::Create(*this, img, createInfo, type, aspectMask,
-		  Anvil::ImageView::create(Anvil::ImageViewCreateInfo::create_cube_map(&static_cast<VlkContext &>(*this).GetDevice(), &static_cast<VlkImage &>(img).GetAnvilImage(), createInfo.baseLayer.has_value() ? *createInfo.baseLayer : 0u, createInfo.baseMipmap,
-		    pragma::math::min(createInfo.baseMipmap + createInfo.mipmapLevels, img.GetMipmapCount()) - createInfo.baseMipmap, static_cast<Anvil::ImageAspectFlagBits>(aspectMask), static_cast<Anvil::Format>(format), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleRed),
-		    static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleGreen), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleBlue), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleAlpha))));
+		key.layerCount = 6;
+		break;
+	default:
+		key.layerCount = numLayers;
+		break;
+	}
+	key.swizzle = {createInfo.swizzleRed, createInfo.swizzleGreen, createInfo.swizzleBlue, createInfo.swizzleAlpha};
+
+	// Materials request the same views of an image repeatedly, so live views are shared instead of creating a new VkImageView every time
+	auto view = vlkImg.FindCachedView(key);
+	if(view) {
+		++m_imageViewCacheHits;
+		return view;
+	}
+	++m_imageViewCacheMisses;
+
+	auto *dev = &GetDevice();
+	auto *anvImg = &vlkImg.GetAnvilImage();
+	auto anvAspectMask = static_cast<Anvil::ImageAspectFlagBits>(aspectMask);
+	auto anvFormat = static_cast<Anvil::Format>(format);
+	auto swizzleR = static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleRed);
+	auto swizzleG = static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleGreen);
+	auto swizzleB = static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleBlue);
+	auto swizzleA = static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleAlpha);
+	Anvil::ImageViewCreateInfoUniquePtr anvCreateInfo = nullptr;
+	switch(type) {
+	case ImageViewType::e1D:
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_1D(dev, anvImg, key.baseLayer, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
+	case ImageViewType::e1DArray:
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_1D_array(dev, anvImg, key.baseLayer, key.layerCount, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
+	case ImageViewType::e2D:
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_2D(dev, anvImg, key.baseLayer, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
 	case ImageViewType::e2DArray:
-		return VlkImageView::Create(*this, img, createInfo, type, aspectMask,
-		  Anvil::ImageView::create(Anvil::ImageViewCreateInfo::create_2D_array(&static_cast<VlkContext &>(*this).GetDevice(), &static_cast<VlkImage &>(img).GetAnvilImage(), createInfo.baseLayer.has_value() ? *createInfo.baseLayer : 0u, numLayers, createInfo.baseMipmap,
-		    pragma::math::min(createInfo.baseMipmap + createInfo.mipmapLevels, img.GetMipmapCount()) - createInfo.baseMipmap, static_cast<Anvil::ImageAspectFlagBits>(aspectMask), static_cast<Anvil::Format>(format), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleRed),
-		    static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleGreen), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleBlue), static_cast<Anvil::ComponentSwizzle>(createInfo.swizzleAlpha))));
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_2D_array(dev, anvImg, key.baseLayer, key.layerCount, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
+	case ImageViewType::e3D:
+		// 3D views always cover all slices of the image
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_3D(dev, anvImg, 0u, anvImg->get_image_extent_3D(key.baseMipmap).depth, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
+	case ImageViewType::Cube:
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_cube_map(dev, anvImg, key.baseLayer, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
+	case ImageViewType::CubeArray:
+		if((key.layerCount % 6) != 0)
+			throw std::invalid_argument("Cube map array image view requires a multiple of 6 layers, got " + pragma::util::to_string(key.layerCount) + "!");
+		anvCreateInfo = Anvil::ImageViewCreateInfo::create_cube_map_array(dev, anvImg, key.baseLayer, key.layerCount / 6, key.baseMipmap, key.mipmapCount, anvAspectMask, anvFormat, swizzleR, swizzleG, swizzleB, swizzleA);
+		break;
 	default:
 		throw std::invalid_argument("Image view type " + pragma::util::to_string(pragma::math::to_integral(type)) + " is currently unsupported!");
 	}
+	view = VlkImageView::Create(*this, img, createInfo, type, aspectMask, Anvil::ImageView::create(std::move(anvCreateInfo)));
+	if(view == nullptr)
+		return nullptr;
+	return vlkImg.AddCachedView(key, view);
 }
 std::shared_ptr<prosper::IRenderPass> prosper::VlkContext::CreateRenderPass(const util::RenderPassCreateInfo &renderPassInfo)
 {
 	if(renderPassInfo.attachments.empty())
 		throw std::logic_error("Attempted to create render pass with 0 attachments, this is not allowed!");
+	auto cacheKey = make_render_pass_cache_key(renderPassInfo);
+	if(auto rp = m_renderPassCache.Find(cacheKey))
+		return rp;
 	auto rpInfo = std::make_unique<Anvil::RenderPassCreateInfo>(&static_cast<VlkContext &>(*this).GetDevice());
 	std::vector<Anvil::RenderPassAttachmentID> attachmentIds;
 	attachmentIds.reserve(renderPassInfo.attachments.size());
@@ -1969,21 +2894,131 @@ std::shared_ptr<prosper::IRenderPass> prosper::VlkContext::CreateRenderPass(cons
 			++attId;
 		}
 	}
-	return static_cast<VlkContext *>(this)->CreateRenderPass(renderPassInfo, std::move(rpInfo));
+	auto rp = static_cast<VlkContext *>(this)->CreateRenderPass(renderPassInfo, std::move(rpInfo));
+	if(!rp)
+		return nullptr;
+	return m_renderPassCache.Add(cacheKey, rp);
 }
 std::shared_ptr<prosper::IFramebuffer> prosper::VlkContext::CreateFramebuffer(uint32_t width, uint32_t height, uint32_t layers, const std::vector<prosper::IImageView *> &attachments)
 {
+	// Anvil creates the VkFramebuffer for each render pass the framebuffer is used with, so the render pass is not part of the key
+	auto cacheKey = make_framebuffer_cache_key(width, height, layers, attachments);
+	if(auto fb = m_framebufferCache.Find(cacheKey))
+		return fb;
 	auto createInfo = Anvil::FramebufferCreateInfo::create(&static_cast<VlkContext &>(*this).GetDevice(), width, height, layers);
 	uint32_t depth = 1u;
 	for(auto *att : attachments)
 		createInfo->add_attachment(&static_cast<prosper::VlkImageView *>(att)->GetAnvilImageView(), nullptr);
-	return prosper::VlkFramebuffer::Create(*this, attachments, width, height, depth, layers, Anvil::Framebuffer::create(std::move(createInfo)));
+	std::shared_ptr<IFramebuffer> fb = prosper::VlkFramebuffer::Create(*this, attachments, width, height, depth, layers, Anvil::Framebuffer::create(std::move(createInfo)));
+	if(!fb)
+		return nullptr;
+	return m_framebufferCache.Add(cacheKey, fb);
 }
 std::unique_ptr<IShaderPipelineLayout> prosper::VlkContext::GetShaderPipelineLayout(const Shader &shader, uint32_t pipelineIdx) const { return VlkShaderPipelineLayout::Create(shader, pipelineIdx); }
 std::shared_ptr<prosper::IRenderBuffer> prosper::VlkContext::CreateRenderBuffer(const prosper::GraphicsPipelineCreateInfo &pipelineCreateInfo, const std::vector<prosper::IBuffer *> &buffers, const std::vector<prosper::DeviceSize> &offsets,
   const std::optional<IndexBufferInfo> &indexBufferInfo)
 {
-	return VlkRenderBuffer::Create(*this, pipelineCreateInfo, buffers, offsets, indexBufferInfo);
+	auto renderBuffer = VlkRenderBuffer::Create(*this, pipelineCreateInfo, buffers, offsets, indexBufferInfo);
+	if(m_memoryDefragmenter) {
+		std::scoped_lock lock {m_renderBufferMutex};
+		// Expired entries are removed before the vector has to grow, which keeps the cost amortized constant
+		if(m_renderBuffers.size() == m_renderBuffers.capacity())
+			std::erase_if(m_renderBuffers, [](const std::weak_ptr<VlkRenderBuffer> &renderBuffer) { return renderBuffer.expired(); });
+		m_renderBuffers.push_back(renderBuffer);
+	}
+	return renderBuffer;
+}
+void prosper::VlkContext::AddUniversalQueueWaitSemaphore(const std::shared_ptr<Anvil::Semaphore> &semaphore)
+{
+	std::scoped_lock lock {m_universalQueueWaitSemaphoreMutex};
+	m_universalQueueWaitSemaphores.push_back(semaphore);
+}
+
+bool prosper::VlkContext::RecordUploadCommands(const std::function<bool(ICommandBuffer &, std::vector<std::shared_ptr<void>> &)> &record)
+{
+	std::scoped_lock lock {m_uploadMutex};
+	if(!m_uploadBatch.cmd) {
+		uint32_t queueFamilyIndex;
+		auto cmd = AllocatePrimaryLevelCommandBuffer(QueueFamilyType::Universal, queueFamilyIndex);
+		if(!cmd || !cmd->StartRecording(true, false))
+			return false;
+		m_uploadBatch.cmd = std::move(cmd);
+	}
+	return record(*m_uploadBatch.cmd, m_uploadBatch.resources);
+}
+
+void prosper::VlkContext::SubmitUploadCommands()
+{
+	UploadBatch batch;
+	{
+		std::scoped_lock lock {m_uploadMutex};
+		if(!m_uploadBatch.cmd)
+			return;
+		batch = std::move(m_uploadBatch);
+		m_uploadBatch = {};
+		batch.cmd->StopRecording();
+		batch.fence = CreateFence();
+		if(!batch.fence) {
+			// The commands are discarded without having been submitted, so the resources can be released right away
+			Log("Failed to create fence for upload command buffer!", pragma::util::LogSeverity::Error);
+			return;
+		}
+		FlushMappedMemoryRanges();
+		// Must not go through submit_to_universal_queue, since the uploads don't depend on the semaphores the next frame waits for
+		auto &anvCmd = batch.cmd->GetAPITypeRef<VlkCommandBuffer>().GetAnvilCommandBuffer();
+		auto res = GetDevice().get_universal_queue(0)->submit(Anvil::SubmitInfo::create(&anvCmd, 0u, nullptr, 0u, nullptr, nullptr, false, &static_cast<VlkFence &>(*batch.fence).GetAnvilFence()));
+		if(res != VK_SUCCESS) {
+			Log("Failed to submit upload command buffer: " + std::to_string(pragma::math::to_integral(res)), pragma::util::LogSeverity::Error);
+			// Nothing has been executed, so the resources can be released right away
+			return;
+		}
+		SetDeviceBusy(true);
+	}
+	std::scoped_lock lock {m_pendingUploadMutex};
+	m_pendingUploads.push_back(std::move(batch));
+}
+
+void prosper::VlkContext::ReleaseCompletedUploads(bool waitIdle)
+{
+	std::vector<std::shared_ptr<void>> resources;
+	{
+		std::scoped_lock lock {m_pendingUploadMutex};
+		for(auto it = m_pendingUploads.begin(); it != m_pendingUploads.end();) {
+			if(!waitIdle && !it->fence->IsSet()) {
+				++it;
+				continue;
+			}
+			for(auto &resource : it->resources)
+				resources.push_back(std::move(resource));
+			resources.push_back(std::move(it->cmd));
+			resources.push_back(std::move(it->fence));
+			it = m_pendingUploads.erase(it);
+		}
+	}
+	// The command buffers have to be freed on the rendering thread
+	m_deferredDestructionQueue->Retire(std::move(resources), DeferredDestructionQueue::DestructionThread::UpdateThread);
+}
+
+std::vector<std::shared_ptr<Anvil::Semaphore>> prosper::VlkContext::TakeUniversalQueueWaitSemaphores()
+{
+	std::scoped_lock lock {m_universalQueueWaitSemaphoreMutex};
+	auto semaphores = std::move(m_universalQueueWaitSemaphores);
+	m_universalQueueWaitSemaphores.clear();
+	return semaphores;
+}
+
+void prosper::VlkContext::ReloadRenderBuffers(const std::unordered_set<const IBuffer *> &buffers)
+{
+	std::scoped_lock lock {m_renderBufferMutex};
+	for(auto it = m_renderBuffers.begin(); it != m_renderBuffers.end();) {
+		auto renderBuffer = it->lock();
+		if(!renderBuffer) {
+			it = m_renderBuffers.erase(it);
+			continue;
+		}
+		renderBuffer->OnBuffersRelocated(buffers);
+		++it;
+	}
 }
 
 std::shared_ptr<prosper::ISwapCommandBufferGroup> prosper::VlkContext::CreateSwapCommandBufferGroup(Window &window, bool allowMt, const std::string &debugName)
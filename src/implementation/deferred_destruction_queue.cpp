@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+module pragma.prosper.vulkan;
+
+import :deferred_destruction_queue;
+
+#undef max
+#undef min
+
+using namespace prosper;
+
+// Number of objects that are popped from the queue at once; The time budget is checked after each batch
+static constexpr size_t DESTRUCTION_BATCH_SIZE = 32;
+
+static void lower_current_thread_priority()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+DeferredDestructionQueue::DeferredDestructionQueue(const Settings &settings) : m_settings {settings}
+{
+	if(m_settings.useDestructionThread)
+		StartDestructionThread();
+}
+
+DeferredDestructionQueue::~DeferredDestructionQueue()
+{
+	StopDestructionThread();
+	Flush();
+}
+
+void DeferredDestructionQueue::SetSettings(const Settings &settings)
+{
+	auto useDestructionThread = false;
+	{
+		std::scoped_lock lock {m_mutex};
+		useDestructionThread = m_settings.useDestructionThread;
+		m_settings = settings;
+	}
+	if(settings.useDestructionThread == useDestructionThread)
+		return;
+	if(settings.useDestructionThread)
+		StartDestructionThread();
+	else
+		StopDestructionThread();
+}
+
+DeferredDestructionQueue::Settings DeferredDestructionQueue::GetSettings() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_settings;
+}
+
+void DeferredDestructionQueue::StartDestructionThread()
+{
+	std::scoped_lock lock {m_mutex};
+	if(m_threadRunning)
+		return;
+	m_threadRunning = true;
+	m_thread = std::thread {[this]() { RunDestructionThread(); }};
+}
+
+void DeferredDestructionQueue::StopDestructionThread()
+{
+	{
+		std::scoped_lock lock {m_mutex};
+		if(!m_threadRunning)
+			return;
+		m_threadRunning = false;
+	}
+	m_condition.notify_one();
+	m_thread.join();
+}
+
+void DeferredDestructionQueue::Retire(std::vector<std::shared_ptr<void>> &&objects, DestructionThread thread)
+{
+	if(objects.empty())
+		return;
+	std::scoped_lock lock {m_mutex};
+	m_stats.retiredObjects += objects.size();
+	auto &pendingObjects = (thread == DestructionThread::Any) ? m_pendingObjects : m_pendingUpdateThreadObjects;
+	for(auto &obj : objects)
+		pendingObjects.push_back(std::move(obj));
+	objects.clear();
+}
+
+void DeferredDestructionQueue::Retire(std::shared_ptr<void> object, DestructionThread thread)
+{
+	if(!object)
+		return;
+	std::scoped_lock lock {m_mutex};
+	++m_stats.retiredObjects;
+	auto &pendingObjects = (thread == DestructionThread::Any) ? m_pendingObjects : m_pendingUpdateThreadObjects;
+	pendingObjects.push_back(std::move(object));
+}
+
+void DeferredDestructionQueue::Update()
+{
+	std::unique_lock lock {m_mutex};
+	if(m_pendingObjects.empty() && m_pendingUpdateThreadObjects.empty())
+		return;
+	auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli> {m_settings.timeBudgetPerFrameMs});
+	auto threadRunning = m_threadRunning;
+	if(threadRunning && !m_pendingObjects.empty())
+		m_frameBudgetAvailable = true;
+	lock.unlock();
+	if(threadRunning)
+		m_condition.notify_one();
+	else
+		DestroyObjects(m_pendingObjects, deadline);
+	DestroyObjects(m_pendingUpdateThreadObjects, deadline);
+}
+
+void DeferredDestructionQueue::Flush()
+{
+	DestroyObjects(m_pendingUpdateThreadObjects, {});
+	DestroyObjects(m_pendingObjects, {});
+	std::unique_lock lock {m_mutex};
+	m_idleCondition.wait(lock, [this]() { return m_objectsInDestruction == 0; });
+}
+
+DeferredDestructionQueue::Stats DeferredDestructionQueue::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	auto stats = m_stats;
+	stats.pendingObjects = m_pendingObjects.size() + m_pendingUpdateThreadObjects.size();
+	return stats;
+}
+
+void DeferredDestructionQueue::DestroyObjects(std::deque<std::shared_ptr<void>> &objects, std::optional<Clock::time_point> deadline)
+{
+	auto tStart = Clock::now();
+	std::vector<std::shared_ptr<void>> batch;
+	batch.reserve(DESTRUCTION_BATCH_SIZE);
+	for(;;) {
+		{
+			std::scoped_lock lock {m_mutex};
+			m_objectsInDestruction -= batch.size();
+			m_stats.destroyedObjects += batch.size();
+			batch.clear();
+			if(objects.empty() || (deadline && Clock::now() >= *deadline))
+				break;
+			auto n = pragma::math::min(objects.size(), DESTRUCTION_BATCH_SIZE);
+			for(auto i = decltype(n) {0u}; i < n; ++i) {
+				batch.push_back(std::move(objects.front()));
+				objects.pop_front();
+			}
+			m_objectsInDestruction += batch.size();
+		}
+		// Destructors may retire further objects, so the lock must not be held here
+		for(auto &obj : batch)
+			obj = nullptr;
+	}
+	std::scoped_lock lock {m_mutex};
+	m_stats.lastFrameDestructionTimeMs = std::chrono::duration<float, std::milli> {Clock::now() - tStart}.count();
+	if(m_objectsInDestruction == 0)
+		m_idleCondition.notify_all();
+}
+
+void DeferredDestructionQueue::RunDestructionThread()
+{
+	lower_current_thread_priority();
+	std::unique_lock lock {m_mutex};
+	for(;;) {
+		m_condition.wait(lock, [this]() { return m_frameBudgetAvailable || !m_threadRunning; });
+		if(!m_threadRunning)
+			break;
+		m_frameBudgetAvailable = false;
+		auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli> {m_settings.timeBudgetPerFrameMs});
+		lock.unlock();
+		DestroyObjects(m_pendingObjects, deadline);
+		lock.lock();
+	}
+}
@@ -0,0 +1,220 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <misc/descriptor_set_create_info.h>
+#include <wrappers/descriptor_set_group.h>
+
+module pragma.prosper.vulkan;
+
+import :descriptor_set_allocator;
+
+#undef max
+#undef min
+
+using namespace prosper;
+
+static ObjectCacheKey get_layout_key(const DescriptorSetCreateInfo &createInfo)
+{
+	auto &dsInfo = const_cast<DescriptorSetCreateInfo &>(createInfo);
+	ObjectCacheKey key {};
+	auto numBindings = dsInfo.GetBindingCount();
+	for(auto i = decltype(numBindings) {0u}; i < numBindings; ++i) {
+		uint32_t bindingIndex;
+		prosper::DescriptorType descType;
+		uint32_t descArraySize;
+		prosper::ShaderStageFlags stageFlags;
+		bool immutableSamplersEnabled;
+		prosper::DescriptorBindingFlags flags;
+		if(!dsInfo.GetBindingPropertiesByIndexNumber(i, &bindingIndex, &descType, &descArraySize, &stageFlags, &immutableSamplersEnabled, &flags))
+			continue;
+		key.Add((static_cast<uint64_t>(bindingIndex) << 32) | static_cast<uint32_t>(descType));
+		key.Add((static_cast<uint64_t>(descArraySize) << 32) | static_cast<uint32_t>(stageFlags));
+		key.Add(static_cast<uint32_t>(flags));
+	}
+	key.ComputeHash();
+	return key;
+}
+
+DescriptorSetAllocator::DescriptorSetAllocator(VlkContext &context, uint32_t frameCount) : m_context {context}, m_frameCount {pragma::math::max(frameCount, 1u)} { m_freedSets.resize(m_frameCount); }
+// Blocks that are still referenced by descriptor set groups are kept alive by them
+DescriptorSetAllocator::~DescriptorSetAllocator() = default;
+
+DescriptorSetAllocator::Layout &DescriptorSetAllocator::GetLayout(const DescriptorSetCreateInfo &createInfo)
+{
+	auto key = get_layout_key(createInfo);
+	auto range = m_layouts.equal_range(key.hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second->key == key)
+			return *it->second;
+	}
+	auto layout = std::make_unique<Layout>();
+	layout->key = std::move(key);
+	layout->transientBlocks.resize(m_frameCount);
+	auto &ref = *layout;
+	m_layouts.insert({ref.key.hash, std::move(layout)});
+	return ref;
+}
+
+std::shared_ptr<DescriptorSetAllocator::Block> DescriptorSetAllocator::CreateBlock(uint32_t capacity, const AnvilCreateInfoFactory &fCreateInfo)
+{
+	// Anvil sizes the descriptor pool of the group for all of its sets, so the whole block is backed by a single pool
+	std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> descSetInfos;
+	descSetInfos.reserve(capacity);
+	for(auto i = decltype(capacity) {0u}; i < capacity; ++i)
+		descSetInfos.push_back(fCreateInfo());
+	auto dsg = Anvil::DescriptorSetGroup::create(&m_context.GetDevice(), descSetInfos, Anvil::DescriptorPoolCreateFlagBits::NONE);
+	if(dsg == nullptr) {
+		m_context.Log("Failed to create descriptor set block with " + std::to_string(capacity) + " sets!", pragma::util::LogSeverity::Warning);
+		return nullptr;
+	}
+	auto block = std::make_shared<Block>();
+	block->descriptorSetGroup = std::move(dsg);
+	block->capacity = capacity;
+	block->freeIndices.reserve(capacity);
+	for(auto i = capacity; i > 0; --i)
+		block->freeIndices.push_back(i - 1);
+	return block;
+}
+
+DescriptorSetAllocator::Allocation DescriptorSetAllocator::Allocate(const DescriptorSetCreateInfo &createInfo, const AnvilCreateInfoFactory &fCreateInfo)
+{
+	std::scoped_lock lock {m_mutex};
+	auto &layout = GetLayout(createInfo);
+	// The most recently created block is the largest one, and the most likely one to have free sets
+	for(auto it = layout.blocks.rbegin(); it != layout.blocks.rend(); ++it) {
+		auto &block = *it;
+		std::scoped_lock blockLock {block->mutex};
+		if(block->freeIndices.empty())
+			continue;
+		auto index = block->freeIndices.back();
+		block->freeIndices.pop_back();
+		++m_allocations;
+		return Allocation {block, index, false};
+	}
+	auto block = CreateBlock(BLOCK_SIZE_CLASSES[layout.nextSizeClass], fCreateInfo);
+	if(block == nullptr)
+		return {};
+	layout.nextSizeClass = pragma::math::min(layout.nextSizeClass + 1, static_cast<uint32_t>(BLOCK_SIZE_CLASSES.size() - 1));
+	layout.blocks.push_back(block);
+	auto index = block->freeIndices.back();
+	block->freeIndices.pop_back();
+	++m_allocations;
+	return Allocation {block, index, false};
+}
+
+DescriptorSetAllocator::Allocation DescriptorSetAllocator::AllocateTransient(const DescriptorSetCreateInfo &createInfo, const AnvilCreateInfoFactory &fCreateInfo)
+{
+	std::scoped_lock lock {m_mutex};
+	auto &layout = GetLayout(createInfo);
+	auto &blocks = layout.transientBlocks[m_frameIndex];
+	for(auto &block : blocks) {
+		if(block->head == block->capacity)
+			continue;
+		++m_transientAllocations;
+		return Allocation {block, block->head++, true};
+	}
+	auto sizeClass = pragma::math::min(static_cast<uint32_t>(blocks.size()), static_cast<uint32_t>(BLOCK_SIZE_CLASSES.size() - 1));
+	auto block = CreateBlock(BLOCK_SIZE_CLASSES[sizeClass], fCreateInfo);
+	if(block == nullptr)
+		return {};
+	if(std::find(m_transientLayouts.begin(), m_transientLayouts.end(), &layout) == m_transientLayouts.end())
+		m_transientLayouts.push_back(&layout);
+	blocks.push_back(block);
+	++m_transientAllocations;
+	return Allocation {block, block->head++, true};
+}
+
+void DescriptorSetAllocator::Free(Allocation &&allocation)
+{
+	if(!allocation.IsValid() || allocation.transient)
+		return;
+	// The set may still be referenced by command buffers of this frame or of earlier frames that are still in flight
+	std::scoped_lock lock {m_mutex};
+	m_freedSets[m_frameIndex].push_back(std::move(allocation));
+}
+
+void DescriptorSetAllocator::ReleaseFreedSets(std::vector<Allocation> &allocations)
+{
+	for(auto &allocation : allocations) {
+		std::scoped_lock blockLock {allocation.block->mutex};
+		allocation.block->freeIndices.push_back(allocation.index);
+	}
+	allocations.clear();
+}
+
+void DescriptorSetAllocator::BeginFrame(uint32_t frameIndex)
+{
+	std::scoped_lock lock {m_mutex};
+	m_frameIndex = frameIndex % m_frameCount;
+	// Transient sets of this frame are no longer in use, so the blocks can be reused from the start
+	for(auto *layout : m_transientLayouts) {
+		for(auto &block : layout->transientBlocks[m_frameIndex])
+			block->head = 0;
+	}
+	// The frame's fence has been waited on, which also covers everything that was submitted before it
+	ReleaseFreedSets(m_freedSets[m_frameIndex]);
+}
+
+void DescriptorSetAllocator::SetFrameCount(uint32_t frameCount)
+{
+	frameCount = pragma::math::max(frameCount, 1u);
+	{
+		std::scoped_lock lock {m_mutex};
+		if(frameCount == m_frameCount)
+			return;
+	}
+	// Transient blocks and freed sets may still be in use by frames in flight
+	m_context.WaitIdle();
+	std::scoped_lock lock {m_mutex};
+	for(auto &allocations : m_freedSets)
+		ReleaseFreedSets(allocations);
+	m_frameCount = frameCount;
+	m_frameIndex = 0;
+	m_freedSets.resize(m_frameCount);
+	for(auto *layout : m_transientLayouts) {
+		layout->transientBlocks.clear();
+		layout->transientBlocks.resize(m_frameCount);
+	}
+	m_transientLayouts.clear();
+}
+
+void DescriptorSetAllocator::AddTiming(bool pooled, bool create, std::chrono::nanoseconds duration)
+{
+	m_timings[pooled ? 1 : 0][create ? 1 : 0] += duration.count();
+	++m_timingCounts[pooled ? 1 : 0][create ? 1 : 0];
+}
+
+DescriptorSetAllocator::Stats DescriptorSetAllocator::GetStats() const
+{
+	Stats stats {};
+	{
+		std::scoped_lock lock {m_mutex};
+		stats.layoutCount = m_layouts.size();
+		stats.allocations = m_allocations;
+		stats.transientAllocations = m_transientAllocations;
+		for(auto &[hash, layout] : m_layouts) {
+			stats.blockCount += layout->blocks.size();
+			for(auto &block : layout->blocks) {
+				std::scoped_lock blockLock {block->mutex};
+				stats.setCapacity += block->capacity;
+				stats.liveSets += block->capacity - block->freeIndices.size();
+			}
+			for(auto &blocks : layout->transientBlocks) {
+				stats.transientBlockCount += blocks.size();
+				for(auto &block : blocks)
+					stats.setCapacity += block->capacity;
+			}
+		}
+	}
+	stats.pooledCreateTime = std::chrono::nanoseconds {m_timings[1][1].load()};
+	stats.pooledDestroyTime = std::chrono::nanoseconds {m_timings[1][0].load()};
+	stats.pooledCreateCount = m_timingCounts[1][1];
+	stats.pooledDestroyCount = m_timingCounts[1][0];
+	stats.dedicatedCreateTime = std::chrono::nanoseconds {m_timings[0][1].load()};
+	stats.dedicatedDestroyTime = std::chrono::nanoseconds {m_timings[0][0].load()};
+	stats.dedicatedCreateCount = m_timingCounts[0][1];
+	stats.dedicatedDestroyCount = m_timingCounts[0][0];
+	return stats;
+}
@@ -24,6 +24,19 @@ std::shared_ptr<VlkDescriptorSetGroup> VlkDescriptorSetGroup::Create(IPrContext
 	});
 }
 
+std::shared_ptr<VlkDescriptorSetGroup> VlkDescriptorSetGroup::Create(IPrContext &context, const DescriptorSetCreateInfo &createInfo, DescriptorSetAllocator::Allocation allocation, const std::function<void(IDescriptorSetGroup &)> &onDestroyedCallback)
+{
+	if(!allocation.IsValid())
+		return nullptr;
+	if(onDestroyedCallback == nullptr)
+		return std::shared_ptr<VlkDescriptorSetGroup>(new VlkDescriptorSetGroup(context, createInfo, std::move(allocation)));
+	return std::shared_ptr<VlkDescriptorSetGroup>(new VlkDescriptorSetGroup(context, createInfo, std::move(allocation)), [onDestroyedCallback](VlkDescriptorSetGroup *buf) {
+		buf->OnRelease();
+		onDestroyedCallback(*buf);
+		delete buf;
+	});
+}
+
 VlkDescriptorSetGroup::VlkDescriptorSetGroup(IPrContext &context, const DescriptorSetCreateInfo &createInfo, Anvil::DescriptorSetGroupUniquePtr imgView) : IDescriptorSetGroup {context, createInfo}, m_descriptorSetGroup(std::move(imgView))
 {
 	auto numSets = m_descriptorSetGroup->get_n_descriptor_sets();
@@ -46,8 +59,29 @@ VlkDescriptorSetGroup::VlkDescriptorSetGroup(IPrContext &context, const Descript
 		                                                            }};
 	}
 }
+VlkDescriptorSetGroup::VlkDescriptorSetGroup(IPrContext &context, const DescriptorSetCreateInfo &createInfo, DescriptorSetAllocator::Allocation allocation) : IDescriptorSetGroup {context, createInfo}, m_allocation {std::move(allocation)}
+{
+	// The pool is shared with other groups, so only the set itself belongs to this group
+	auto *ds = m_allocation.GetDescriptorSet();
+	if(prosper::debug::is_debug_mode_enabled())
+		prosper::debug::register_debug_object(ds->get_descriptor_set_vk(), *this, prosper::debug::ObjectType::DescriptorSet);
+	m_descriptorSets.push_back(std::shared_ptr<VlkDescriptorSet> {new VlkDescriptorSet {*this, *ds}, [](VlkDescriptorSet *ds) { delete ds; }});
+}
 VlkDescriptorSetGroup::~VlkDescriptorSetGroup()
 {
+	auto &context = static_cast<VlkContext &>(GetContext());
+	auto *allocator = context.GetDescriptorSetAllocator();
+	auto t = std::chrono::steady_clock::now();
+	if(m_allocation.IsValid()) {
+		if(prosper::debug::is_debug_mode_enabled())
+			prosper::debug::deregister_debug_object(m_allocation.GetDescriptorSet()->get_descriptor_set_vk(false));
+		// Transient sets are reclaimed with the rest of their frame
+		if(allocator && !m_allocation.transient)
+			allocator->Free(std::move(m_allocation));
+		if(allocator)
+			allocator->AddTiming(true, false, std::chrono::steady_clock::now() - t);
+		return;
+	}
 	if(prosper::debug::is_debug_mode_enabled()) {
 		auto numSets = m_descriptorSetGroup->get_n_descriptor_sets();
 		for(auto i = decltype(numSets) {0}; i < numSets; ++i)
@@ -59,6 +93,9 @@ VlkDescriptorSetGroup::~VlkDescriptorSetGroup()
 				prosper::debug::deregister_debug_object(vkPool);
 		}
 	}
+	m_descriptorSetGroup = nullptr;
+	if(allocator)
+		allocator->AddTiming(false, false, std::chrono::steady_clock::now() - t);
 }
 
 VlkDescriptorSet::VlkDescriptorSet(VlkDescriptorSetGroup &dsg, Anvil::DescriptorSet &ds) : IDescriptorSet {dsg}, m_descSet {ds}
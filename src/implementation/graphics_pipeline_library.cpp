@@ -0,0 +1,805 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/physical_device.h>
+#include <wrappers/shader_module.h>
+#include <misc/types.h>
+#include <cassert>
+
+module pragma.prosper.vulkan;
+
+import :graphics_pipeline_library;
+
+#undef max
+
+using namespace prosper;
+
+namespace {
+	// Serializes the state that is relevant for a library into a byte string that can be used as cache key
+	class KeyBuilder {
+	  public:
+		template<typename T>
+		    requires(std::is_trivially_copyable_v<T>)
+		KeyBuilder &operator<<(const T &value)
+		{
+			m_key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+			return *this;
+		}
+		KeyBuilder &operator<<(const std::string &value)
+		{
+			*this << value.size();
+			m_key += value;
+			return *this;
+		}
+		const std::string &GetKey() const { return m_key; }
+	  private:
+		std::string m_key;
+	};
+
+	enum LibraryIndex : uint8_t { VertexInput = 0, PreRasterization, FragmentShader, FragmentOutput };
+};
+
+static VkShaderStageFlags get_pre_rasterization_stages() { return VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_GEOMETRY_BIT; }
+
+static prosper::ShaderStage to_prosper_shader_stage(VkShaderStageFlagBits stage)
+{
+	switch(stage) {
+	case VK_SHADER_STAGE_FRAGMENT_BIT:
+		return prosper::ShaderStage::Fragment;
+	case VK_SHADER_STAGE_GEOMETRY_BIT:
+		return prosper::ShaderStage::Geometry;
+	case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+		return prosper::ShaderStage::TessellationControl;
+	case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+		return prosper::ShaderStage::TessellationEvaluation;
+	case VK_SHADER_STAGE_VERTEX_BIT:
+		return prosper::ShaderStage::Vertex;
+	}
+	return prosper::ShaderStage::Compute;
+}
+
+static constexpr std::array<std::pair<ExtendedDynamicStateFlags, VkDynamicState>, 12> g_extendedDynamicStates {{
+  {ExtendedDynamicStateFlags::CullModeBit, VK_DYNAMIC_STATE_CULL_MODE_EXT},
+  {ExtendedDynamicStateFlags::FrontFaceBit, VK_DYNAMIC_STATE_FRONT_FACE_EXT},
+  {ExtendedDynamicStateFlags::PrimitiveTopologyBit, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT},
+  {ExtendedDynamicStateFlags::DepthTestEnableBit, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::DepthWriteEnableBit, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::DepthCompareOpBit, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT},
+  {ExtendedDynamicStateFlags::StencilTestEnableBit, VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::StencilOpBit, VK_DYNAMIC_STATE_STENCIL_OP_EXT},
+  {ExtendedDynamicStateFlags::DepthBiasEnableBit, VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::PrimitiveRestartEnableBit, VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::RasterizerDiscardEnableBit, VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT},
+  {ExtendedDynamicStateFlags::PolygonModeBit, VK_DYNAMIC_STATE_POLYGON_MODE_EXT},
+}};
+
+// With a dynamic primitive topology, the pipeline only determines the topology class
+static uint32_t get_topology_class(VkPrimitiveTopology topology)
+{
+	switch(topology) {
+	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+		return 0;
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+		return 1;
+	case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+bool GraphicsPipelineLibraryManager::IsSupported(const Anvil::PhysicalDevice &physDev) { return physDev.is_device_extension_supported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && physDev.is_device_extension_supported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME); }
+
+GraphicsPipelineLibraryManager::Library::~Library()
+{
+	if(pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, nullptr);
+}
+
+GraphicsPipelineLibraryManager::LinkedPipeline::~LinkedPipeline() { manager->DestroyPipelineDeferred(pipeline); }
+
+GraphicsPipelineLibraryManager::GraphicsPipelineLibraryManager(IPrContext &context, VkDevice device, VkPipelineCache pipelineCache) : m_context {context}, m_device {device}, m_pipelineCache {pipelineCache}
+{
+	m_linkThread = std::thread {[this]() { RunLinkThread(); }};
+}
+
+GraphicsPipelineLibraryManager::~GraphicsPipelineLibraryManager()
+{
+	{
+		std::scoped_lock lock {m_linkJobMutex};
+		m_linkThreadRunning = false;
+	}
+	m_linkJobCondition.notify_one();
+	m_linkThread.join();
+	// The pipelines are destroyed immediately, so there is nothing left to destroy for the linked pipelines once they're released
+	auto destroy = [this](LinkedPipeline &linkedPipeline) {
+		if(linkedPipeline.pipeline == VK_NULL_HANDLE)
+			return;
+		vkDestroyPipeline(m_device, linkedPipeline.pipeline, nullptr);
+		linkedPipeline.pipeline = VK_NULL_HANDLE;
+	};
+	for(auto &job : m_completedLinkJobs) {
+		if(job.result != VK_NULL_HANDLE)
+			vkDestroyPipeline(m_device, job.result, nullptr);
+		destroy(*job.linkedPipeline);
+	}
+	for(; !m_pendingLinkJobs.empty(); m_pendingLinkJobs.pop())
+		destroy(*m_pendingLinkJobs.front().linkedPipeline);
+	for(auto *pipelines : {&m_pipelines, &m_dynamicRenderingPipelines}) {
+		for(auto &[id, pipeline] : *pipelines)
+			destroy(*pipeline.linkedPipeline);
+	}
+}
+
+void GraphicsPipelineLibraryManager::RunLinkThread()
+{
+	for(;;) {
+		LinkJob job;
+		{
+			std::unique_lock lock {m_linkJobMutex};
+			m_linkJobCondition.wait(lock, [this]() { return !m_linkThreadRunning || !m_pendingLinkJobs.empty(); });
+			if(!m_linkThreadRunning)
+				return;
+			job = std::move(m_pendingLinkJobs.front());
+			m_pendingLinkJobs.pop();
+			m_linkThreadBusy = true;
+		}
+		job.result = Link(job.linkedPipeline->libraries, job.linkedPipeline->layout->vkPipelineLayout, true);
+		std::scoped_lock lock {m_linkJobMutex};
+		m_completedLinkJobs.push_back(std::move(job));
+		m_linkThreadBusy = false;
+	}
+}
+
+void GraphicsPipelineLibraryManager::DestroyPipelineDeferred(VkPipeline pipeline)
+{
+	if(pipeline == VK_NULL_HANDLE)
+		return;
+	// The pipeline may still be referenced by command buffers that are in flight
+	auto device = m_device;
+	static_cast<VlkContext &>(m_context).KeepThreadSafeResourceAliveUntilPresentationComplete(std::shared_ptr<void> {new VkPipeline {pipeline}, [device](void *ptr) {
+		auto *pipeline = static_cast<VkPipeline *>(ptr);
+		vkDestroyPipeline(device, *pipeline, nullptr);
+		delete pipeline;
+	}});
+}
+
+std::shared_ptr<GraphicsPipelineLibraryManager::Library> GraphicsPipelineLibraryManager::GetOrCreateLibrary(const std::string &key, VkGraphicsPipelineCreateInfo &createInfo, VkGraphicsPipelineLibraryFlagsEXT flags, VkRenderPass renderPass,
+  const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout, std::vector<std::shared_ptr<ShaderModuleCache::Entry>> &&modules)
+{
+	std::scoped_lock lock {m_libraryMutex};
+	auto it = m_libraries.find(key);
+	if(it != m_libraries.end()) {
+		if(auto lib = it->second.lock()) {
+			std::scoped_lock statsLock {m_statsMutex};
+			++m_stats.libraryHits;
+			return lib;
+		}
+	}
+	{
+		std::scoped_lock statsLock {m_statsMutex};
+		++m_stats.libraryMisses;
+	}
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT};
+	libraryInfo.flags = flags;
+	libraryInfo.pNext = createInfo.pNext;
+	createInfo.pNext = &libraryInfo;
+	createInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+	auto lib = std::make_shared<Library>();
+	lib->device = m_device;
+	auto result = VK_PIPELINE_COMPILE_REQUIRED;
+	// If the library is already in the pipeline cache, it can be created from the shader module identifiers alone, in which case the
+	// driver doesn't have to look at the SPIR-V code at all. Otherwise the creation fails and the library is compiled from the modules.
+	auto hasIdentifiers = m_pipelineCache != VK_NULL_HANDLE && !modules.empty() && modules.size() == createInfo.stageCount && std::all_of(modules.begin(), modules.end(), [](const std::shared_ptr<ShaderModuleCache::Entry> &module) { return !module->identifier.empty(); });
+	if(hasIdentifiers) {
+		std::vector<VkPipelineShaderStageModuleIdentifierCreateInfoEXT> identifierInfos;
+		identifierInfos.reserve(modules.size());
+		std::vector<VkPipelineShaderStageCreateInfo> stages {createInfo.pStages, createInfo.pStages + createInfo.stageCount};
+		for(auto i = decltype(stages.size()) {0u}; i < stages.size(); ++i) {
+			auto &identifierInfo = identifierInfos.emplace_back(VkPipelineShaderStageModuleIdentifierCreateInfoEXT {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT});
+			identifierInfo.pNext = stages[i].pNext;
+			identifierInfo.identifierSize = static_cast<uint32_t>(modules[i]->identifier.size());
+			identifierInfo.pIdentifier = modules[i]->identifier.data();
+			stages[i].pNext = &identifierInfo;
+			stages[i].module = VK_NULL_HANDLE;
+		}
+		auto identifierCreateInfo = createInfo;
+		identifierCreateInfo.pStages = stages.data();
+		identifierCreateInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+		result = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &identifierCreateInfo, nullptr, &lib->pipeline);
+		if(result == VK_SUCCESS) {
+			std::scoped_lock statsLock {m_statsMutex};
+			++m_stats.moduleIdentifierHits;
+		}
+	}
+	if(result == VK_PIPELINE_COMPILE_REQUIRED) {
+		lib->pipeline = VK_NULL_HANDLE;
+		result = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &createInfo, nullptr, &lib->pipeline);
+	}
+	createInfo.pNext = libraryInfo.pNext;
+	if(result != VK_SUCCESS)
+		return nullptr;
+	lib->renderPass = renderPass;
+	lib->layout = layout;
+	lib->modules = std::move(modules);
+	m_libraries[key] = lib;
+	return lib;
+}
+
+std::shared_ptr<GraphicsPipelineLibraryManager::LinkedPipeline> GraphicsPipelineLibraryManager::GetOrLinkPipeline(const std::array<std::shared_ptr<Library>, 4> &libraries, const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout, VkPipelineLayout vkLayout)
+{
+	KeyBuilder linkKey {};
+	for(auto &lib : libraries)
+		linkKey << lib.get();
+	linkKey << layout.get();
+	auto &key = linkKey.GetKey();
+	{
+		std::shared_lock lock {m_pipelineMutex};
+		auto it = m_linkedPipelines.find(key);
+		if(it != m_linkedPipelines.end()) {
+			if(auto linkedPipeline = it->second.lock()) {
+				std::scoped_lock statsLock {m_statsMutex};
+				++m_stats.linkedPipelineHits;
+				return linkedPipeline;
+			}
+		}
+	}
+	auto pipeline = Link(libraries, vkLayout, false);
+	if(pipeline == VK_NULL_HANDLE)
+		return nullptr;
+	auto linkedPipeline = std::make_shared<LinkedPipeline>();
+	linkedPipeline->manager = this;
+	linkedPipeline->pipeline = pipeline;
+	linkedPipeline->libraries = libraries;
+	linkedPipeline->layout = layout;
+	{
+		std::unique_lock lock {m_pipelineMutex};
+		auto &entry = m_linkedPipelines[key];
+		// The same pipeline may have been linked on another thread in the meantime
+		if(auto existing = entry.lock()) {
+			std::scoped_lock statsLock {m_statsMutex};
+			++m_stats.linkedPipelineHits;
+			return existing;
+		}
+		entry = linkedPipeline;
+	}
+	{
+		std::scoped_lock statsLock {m_statsMutex};
+		++m_stats.fastLinkedPipelines;
+	}
+	{
+		std::scoped_lock lock {m_linkJobMutex};
+		m_pendingLinkJobs.push({linkedPipeline});
+	}
+	m_linkJobCondition.notify_one();
+	return linkedPipeline;
+}
+
+VkPipeline GraphicsPipelineLibraryManager::Link(const std::array<std::shared_ptr<Library>, 4> &libraries, VkPipelineLayout layout, bool optimize) const
+{
+	std::array<VkPipeline, 4> vkLibraries;
+	for(auto i = decltype(libraries.size()) {0u}; i < libraries.size(); ++i)
+		vkLibraries[i] = libraries[i]->pipeline;
+	VkPipelineLibraryCreateInfoKHR libraryInfo {VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR};
+	libraryInfo.libraryCount = static_cast<uint32_t>(vkLibraries.size());
+	libraryInfo.pLibraries = vkLibraries.data();
+	VkGraphicsPipelineCreateInfo createInfo {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+	createInfo.pNext = &libraryInfo;
+	createInfo.layout = layout;
+	if(optimize)
+		createInfo.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return pipeline;
+}
+
+bool GraphicsPipelineLibraryManager::CreatePipeline(PipelineID pipelineId, const GraphicsPipelineCreateInfo &createInfo, VkRenderPass renderPass, uint32_t subPass, const std::vector<ShaderStage> &stages, const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout,
+  VkPipelineLayout vkLayout, const VkPipelineRenderingCreateInfo *renderingInfo)
+{
+	// Dynamic rendering pipelines are not associated with a render pass
+	if(renderingInfo) {
+		renderPass = VK_NULL_HANDLE;
+		subPass = 0;
+	}
+	if(vkLayout == VK_NULL_HANDLE)
+		return false;
+	// Non-default depth clipping requires VK_EXT_depth_clip_enable state, which is only handled by the monolithic path
+	if(createInfo.IsDepthClipEnabled() == createInfo.IsDepthClampEnabled())
+		return false;
+
+	// States that are dynamic through VK_EXT_extended_dynamic_state are excluded from the library keys, so that pipelines which only differ
+	// in these states share their libraries
+	auto extendedDynamicStates = m_extendedDynamicStates.load();
+	auto isDynamic = [extendedDynamicStates](ExtendedDynamicStateFlags state) { return pragma::math::is_flag_set(extendedDynamicStates, state); };
+	const DynamicState *enabledDynamicStates;
+	uint32_t numEnabledDynamicStates;
+	createInfo.GetEnabledDynamicStates(&enabledDynamicStates, &numEnabledDynamicStates);
+	std::vector<VkDynamicState> dynamicStates {reinterpret_cast<const VkDynamicState *>(enabledDynamicStates), reinterpret_cast<const VkDynamicState *>(enabledDynamicStates) + numEnabledDynamicStates};
+	for(auto &[state, vkState] : g_extendedDynamicStates) {
+		if(isDynamic(state))
+			dynamicStates.push_back(vkState);
+	}
+	VkPipelineDynamicStateCreateInfo dynamicStateInfo {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+	dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateInfo.pDynamicStates = dynamicStates.data();
+	KeyBuilder dynamicStateKey {};
+	for(auto state : dynamicStates)
+		dynamicStateKey << state;
+
+	uint32_t numScissors;
+	uint32_t numViewports;
+	uint32_t numVertexBindings;
+	const IRenderPass *rp;
+	SubPassID subPassId;
+	createInfo.GetGraphicsPipelineProperties(&numScissors, &numViewports, &numVertexBindings, &rp, &subPassId);
+
+	// Vertex input
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	KeyBuilder vertexInputKey {};
+	for(auto i = decltype(numVertexBindings) {0u}; i < numVertexBindings; ++i) {
+		uint32_t bindingIndex;
+		uint32_t stride;
+		prosper::VertexInputRate rate;
+		uint32_t numAttributes;
+		const prosper::VertexInputAttribute *attributes;
+		uint32_t divisor;
+		if(createInfo.GetVertexBindingProperties(i, &bindingIndex, &stride, &rate, &numAttributes, &attributes, &divisor) == false)
+			continue;
+		if(divisor != 1)
+			return false; // Requires VK_EXT_vertex_attribute_divisor state, which is only handled by the monolithic path
+		vertexBindings.push_back({i, stride, static_cast<VkVertexInputRate>(rate)});
+		auto *anvAttributes = reinterpret_cast<const Anvil::VertexInputAttribute *>(attributes);
+		for(auto j = decltype(numAttributes) {0u}; j < numAttributes; ++j) {
+			auto &attr = anvAttributes[j];
+			vertexAttributes.push_back({attr.location, i, static_cast<VkFormat>(attr.format), attr.offset_in_bytes});
+		}
+	}
+	for(auto &binding : vertexBindings)
+		vertexInputKey << binding;
+	for(auto &attr : vertexAttributes)
+		vertexInputKey << attr;
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = vertexBindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+	inputAssemblyInfo.topology = static_cast<VkPrimitiveTopology>(createInfo.GetPrimitiveTopology());
+	inputAssemblyInfo.primitiveRestartEnable = createInfo.IsPrimitiveRestartEnabled();
+	KeyBuilder topologyKey {};
+	if(isDynamic(ExtendedDynamicStateFlags::PrimitiveTopologyBit))
+		topologyKey << get_topology_class(inputAssemblyInfo.topology);
+	else
+		topologyKey << inputAssemblyInfo.topology;
+	vertexInputKey << topologyKey.GetKey() << dynamicStateKey.GetKey();
+	if(!isDynamic(ExtendedDynamicStateFlags::PrimitiveRestartEnableBit))
+		vertexInputKey << inputAssemblyInfo.primitiveRestartEnable;
+
+	// Shader stages
+	struct StageData {
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		VkSpecializationInfo specializationInfo {};
+	};
+	std::vector<StageData> stageData;
+	stageData.resize(stages.size());
+	std::vector<VkPipelineShaderStageCreateInfo> preRasterizationStages;
+	std::vector<VkPipelineShaderStageCreateInfo> fragmentStages;
+	std::vector<std::shared_ptr<ShaderModuleCache::Entry>> preRasterizationModules;
+	std::vector<std::shared_ptr<ShaderModuleCache::Entry>> fragmentModules;
+	KeyBuilder preRasterizationKey {};
+	KeyBuilder fragmentShaderKey {};
+	for(auto i = decltype(stages.size()) {0u}; i < stages.size(); ++i) {
+		auto &stage = stages[i];
+		auto &data = stageData[i];
+		auto &stageKey = (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) ? fragmentShaderKey : preRasterizationKey;
+		stageKey << stage.stage << stage.module.get() << stage.entrypoint;
+
+		const std::vector<prosper::SpecializationConstant> *specializationConstants;
+		const uint8_t *dataBuffer;
+		if(createInfo.GetSpecializationConstants(to_prosper_shader_stage(stage.stage), &specializationConstants, &dataBuffer) && !specializationConstants->empty()) {
+			size_t dataSize = 0;
+			for(auto &constant : *specializationConstants) {
+				data.mapEntries.push_back({constant.constantId, constant.startOffset, constant.numBytes});
+				dataSize = std::max<size_t>(dataSize, constant.startOffset + constant.numBytes);
+				stageKey << constant.constantId << constant.startOffset << constant.numBytes;
+			}
+			stageKey << std::string {reinterpret_cast<const char *>(dataBuffer), dataSize};
+			data.specializationInfo.mapEntryCount = static_cast<uint32_t>(data.mapEntries.size());
+			data.specializationInfo.pMapEntries = data.mapEntries.data();
+			data.specializationInfo.dataSize = dataSize;
+			data.specializationInfo.pData = dataBuffer;
+		}
+
+		VkPipelineShaderStageCreateInfo stageInfo {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+		stageInfo.stage = stage.stage;
+		stageInfo.module = stage.module->module->get_module();
+		stageInfo.pName = stage.entrypoint.c_str();
+		stageInfo.pSpecializationInfo = data.mapEntries.empty() ? nullptr : &data.specializationInfo;
+		if(stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+			fragmentStages.push_back(stageInfo);
+			fragmentModules.push_back(stage.module);
+		}
+		else if((stage.stage & get_pre_rasterization_stages()) != 0) {
+			preRasterizationStages.push_back(stageInfo);
+			preRasterizationModules.push_back(stage.module);
+		}
+	}
+
+	// Pre-rasterization state
+	std::vector<VkViewport> viewports;
+	std::vector<VkRect2D> scissors;
+	for(auto i = decltype(numViewports) {0u}; i < numViewports; ++i) {
+		VkViewport viewport {};
+		if(createInfo.GetViewportProperties(i, &viewport.x, &viewport.y, &viewport.width, &viewport.height, &viewport.minDepth, &viewport.maxDepth))
+			viewports.push_back(viewport);
+	}
+	for(auto i = decltype(numScissors) {0u}; i < numScissors; ++i) {
+		VkRect2D scissor {};
+		if(createInfo.GetScissorBoxProperties(i, &scissor.offset.x, &scissor.offset.y, &scissor.extent.width, &scissor.extent.height))
+			scissors.push_back(scissor);
+	}
+	VkPipelineViewportStateCreateInfo viewportInfo {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+	viewportInfo.viewportCount = std::max<uint32_t>({static_cast<uint32_t>(viewports.size()), createInfo.GetDynamicViewportsCount(), 1u});
+	viewportInfo.pViewports = (viewports.size() == viewportInfo.viewportCount) ? viewports.data() : nullptr;
+	viewportInfo.scissorCount = std::max<uint32_t>({static_cast<uint32_t>(scissors.size()), createInfo.GetDynamicScissorBoxesCount(), 1u});
+	viewportInfo.pScissors = (scissors.size() == viewportInfo.scissorCount) ? scissors.data() : nullptr;
+	for(auto &viewport : viewports)
+		preRasterizationKey << viewport;
+	for(auto &scissor : scissors)
+		preRasterizationKey << scissor;
+	preRasterizationKey << viewportInfo.viewportCount << viewportInfo.scissorCount;
+
+	PolygonMode polygonMode;
+	CullModeFlags cullMode;
+	FrontFace frontFace;
+	float lineWidth;
+	createInfo.GetRasterizationProperties(&polygonMode, &cullMode, &frontFace, &lineWidth);
+	bool isDepthBiasStateEnabled;
+	float depthBiasConstantFactor;
+	float depthBiasClamp;
+	float depthBiasSlopeFactor;
+	createInfo.GetDepthBiasState(&isDepthBiasStateEnabled, &depthBiasConstantFactor, &depthBiasClamp, &depthBiasSlopeFactor);
+	VkPipelineRasterizationStateCreateInfo rasterizationInfo {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+	rasterizationInfo.depthClampEnable = createInfo.IsDepthClampEnabled();
+	rasterizationInfo.rasterizerDiscardEnable = createInfo.IsRasterizerDiscardEnabled();
+	rasterizationInfo.polygonMode = static_cast<VkPolygonMode>(polygonMode);
+	rasterizationInfo.cullMode = static_cast<VkCullModeFlags>(cullMode);
+	rasterizationInfo.frontFace = static_cast<VkFrontFace>(frontFace);
+	rasterizationInfo.depthBiasEnable = isDepthBiasStateEnabled;
+	rasterizationInfo.depthBiasConstantFactor = depthBiasConstantFactor;
+	rasterizationInfo.depthBiasClamp = depthBiasClamp;
+	rasterizationInfo.depthBiasSlopeFactor = depthBiasSlopeFactor;
+	rasterizationInfo.lineWidth = lineWidth;
+	preRasterizationKey << rasterizationInfo.depthClampEnable << depthBiasConstantFactor << depthBiasClamp << depthBiasSlopeFactor << lineWidth << topologyKey.GetKey();
+	if(!isDynamic(ExtendedDynamicStateFlags::RasterizerDiscardEnableBit))
+		preRasterizationKey << rasterizationInfo.rasterizerDiscardEnable;
+	if(!isDynamic(ExtendedDynamicStateFlags::PolygonModeBit))
+		preRasterizationKey << rasterizationInfo.polygonMode;
+	if(!isDynamic(ExtendedDynamicStateFlags::CullModeBit))
+		preRasterizationKey << rasterizationInfo.cullMode;
+	if(!isDynamic(ExtendedDynamicStateFlags::FrontFaceBit))
+		preRasterizationKey << rasterizationInfo.frontFace;
+	if(!isDynamic(ExtendedDynamicStateFlags::DepthBiasEnableBit))
+		preRasterizationKey << rasterizationInfo.depthBiasEnable;
+
+	VkPipelineTessellationStateCreateInfo tessellationInfo {VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO};
+	tessellationInfo.patchControlPoints = createInfo.GetTessellationPatchControlPoints();
+	preRasterizationKey << tessellationInfo.patchControlPoints;
+
+	// Fragment shader state
+	bool isDepthTestEnabled;
+	CompareOp depthCompareOp;
+	createInfo.GetDepthTestState(&isDepthTestEnabled, &depthCompareOp);
+	bool isDepthBoundsStateEnabled;
+	float minDepthBounds;
+	float maxDepthBounds;
+	createInfo.GetDepthBoundsState(&isDepthBoundsStateEnabled, &minDepthBounds, &maxDepthBounds);
+	bool isStencilTestEnabled;
+	StencilOp frontStencilFailOp, frontStencilPassOp, frontStencilDepthFailOp;
+	CompareOp frontStencilCompareOp;
+	uint32_t frontStencilCompareMask, frontStencilWriteMask, frontStencilReference;
+	StencilOp backStencilFailOp, backStencilPassOp, backStencilDepthFailOp;
+	CompareOp backStencilCompareOp;
+	uint32_t backStencilCompareMask, backStencilWriteMask, backStencilReference;
+	createInfo.GetStencilTestProperties(&isStencilTestEnabled, &frontStencilFailOp, &frontStencilPassOp, &frontStencilDepthFailOp, &frontStencilCompareOp, &frontStencilCompareMask, &frontStencilWriteMask, &frontStencilReference, &backStencilFailOp, &backStencilPassOp,
+	  &backStencilDepthFailOp, &backStencilCompareOp, &backStencilCompareMask, &backStencilWriteMask, &backStencilReference);
+	VkPipelineDepthStencilStateCreateInfo depthStencilInfo {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+	depthStencilInfo.depthTestEnable = isDepthTestEnabled;
+	depthStencilInfo.depthWriteEnable = createInfo.AreDepthWritesEnabled();
+	depthStencilInfo.depthCompareOp = static_cast<VkCompareOp>(depthCompareOp);
+	depthStencilInfo.depthBoundsTestEnable = isDepthBoundsStateEnabled;
+	depthStencilInfo.stencilTestEnable = isStencilTestEnabled;
+	depthStencilInfo.front = {static_cast<VkStencilOp>(frontStencilFailOp), static_cast<VkStencilOp>(frontStencilPassOp), static_cast<VkStencilOp>(frontStencilDepthFailOp), static_cast<VkCompareOp>(frontStencilCompareOp), frontStencilCompareMask, frontStencilWriteMask,
+	  frontStencilReference};
+	depthStencilInfo.back = {static_cast<VkStencilOp>(backStencilFailOp), static_cast<VkStencilOp>(backStencilPassOp), static_cast<VkStencilOp>(backStencilDepthFailOp), static_cast<VkCompareOp>(backStencilCompareOp), backStencilCompareMask, backStencilWriteMask,
+	  backStencilReference};
+	depthStencilInfo.minDepthBounds = minDepthBounds;
+	depthStencilInfo.maxDepthBounds = maxDepthBounds;
+	fragmentShaderKey << depthStencilInfo.depthBoundsTestEnable << minDepthBounds << maxDepthBounds;
+	if(!isDynamic(ExtendedDynamicStateFlags::DepthTestEnableBit))
+		fragmentShaderKey << depthStencilInfo.depthTestEnable;
+	if(!isDynamic(ExtendedDynamicStateFlags::DepthWriteEnableBit))
+		fragmentShaderKey << depthStencilInfo.depthWriteEnable;
+	if(!isDynamic(ExtendedDynamicStateFlags::DepthCompareOpBit))
+		fragmentShaderKey << depthStencilInfo.depthCompareOp;
+	if(!isDynamic(ExtendedDynamicStateFlags::StencilTestEnableBit))
+		fragmentShaderKey << depthStencilInfo.stencilTestEnable;
+	if(isDynamic(ExtendedDynamicStateFlags::StencilOpBit)) {
+		for(auto *face : {&depthStencilInfo.front, &depthStencilInfo.back})
+			fragmentShaderKey << face->compareMask << face->writeMask << face->reference;
+	}
+	else
+		fragmentShaderKey << depthStencilInfo.front << depthStencilInfo.back;
+
+	ExtendedDynamicStateValues dynamicStateValues {};
+	dynamicStateValues.cullMode = rasterizationInfo.cullMode;
+	dynamicStateValues.frontFace = rasterizationInfo.frontFace;
+	dynamicStateValues.primitiveTopology = inputAssemblyInfo.topology;
+	dynamicStateValues.depthTestEnable = depthStencilInfo.depthTestEnable;
+	dynamicStateValues.depthWriteEnable = depthStencilInfo.depthWriteEnable;
+	dynamicStateValues.depthCompareOp = depthStencilInfo.depthCompareOp;
+	dynamicStateValues.stencilTestEnable = depthStencilInfo.stencilTestEnable;
+	dynamicStateValues.front = depthStencilInfo.front;
+	dynamicStateValues.back = depthStencilInfo.back;
+	dynamicStateValues.depthBiasEnable = rasterizationInfo.depthBiasEnable;
+	dynamicStateValues.primitiveRestartEnable = inputAssemblyInfo.primitiveRestartEnable;
+	dynamicStateValues.rasterizerDiscardEnable = rasterizationInfo.rasterizerDiscardEnable;
+	dynamicStateValues.polygonMode = rasterizationInfo.polygonMode;
+
+	// Multisampling state is required by both the fragment shader and the fragment output library
+	bool isSampleShadingEnabled;
+	float minSampleShading;
+	createInfo.GetSampleShadingState(&isSampleShadingEnabled, &minSampleShading);
+	SampleCountFlags sampleCount;
+	const SampleMask *sampleMask;
+	createInfo.GetMultisamplingProperties(&sampleCount, &sampleMask);
+	VkPipelineMultisampleStateCreateInfo multisampleInfo {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+	multisampleInfo.rasterizationSamples = static_cast<VkSampleCountFlagBits>(sampleCount);
+	multisampleInfo.sampleShadingEnable = isSampleShadingEnabled;
+	multisampleInfo.minSampleShading = minSampleShading;
+	multisampleInfo.pSampleMask = createInfo.IsSampleMaskEnabled() ? reinterpret_cast<const VkSampleMask *>(sampleMask) : nullptr;
+	multisampleInfo.alphaToCoverageEnable = createInfo.IsAlphaToCoverageEnabled();
+	multisampleInfo.alphaToOneEnable = createInfo.IsAlphaToOneEnabled();
+	KeyBuilder multisampleKey {};
+	multisampleKey << multisampleInfo.rasterizationSamples << multisampleInfo.sampleShadingEnable << minSampleShading << multisampleInfo.alphaToCoverageEnable << multisampleInfo.alphaToOneEnable;
+	if(multisampleInfo.pSampleMask)
+		multisampleKey << *sampleMask;
+	fragmentShaderKey << multisampleKey.GetKey();
+
+	// Fragment output state
+	const float *blendConstants;
+	uint32_t numBlendAttachments;
+	createInfo.GetBlendingProperties(&blendConstants, &numBlendAttachments);
+	std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+	blendAttachments.reserve(numBlendAttachments);
+	for(auto attId = decltype(numBlendAttachments) {0u}; attId < numBlendAttachments; ++attId) {
+		bool blendingEnabled;
+		BlendOp blendOpColor;
+		BlendOp blendOpAlpha;
+		BlendFactor srcColorBlendFactor;
+		BlendFactor dstColorBlendFactor;
+		BlendFactor srcAlphaBlendFactor;
+		BlendFactor dstAlphaBlendFactor;
+		ColorComponentFlags channelWriteMask;
+		if(!createInfo.GetColorBlendAttachmentProperties(attId, &blendingEnabled, &blendOpColor, &blendOpAlpha, &srcColorBlendFactor, &dstColorBlendFactor, &srcAlphaBlendFactor, &dstAlphaBlendFactor, &channelWriteMask))
+			return false;
+		blendAttachments.push_back({blendingEnabled, static_cast<VkBlendFactor>(srcColorBlendFactor), static_cast<VkBlendFactor>(dstColorBlendFactor), static_cast<VkBlendOp>(blendOpColor), static_cast<VkBlendFactor>(srcAlphaBlendFactor),
+		  static_cast<VkBlendFactor>(dstAlphaBlendFactor), static_cast<VkBlendOp>(blendOpAlpha), static_cast<VkColorComponentFlags>(channelWriteMask)});
+	}
+	bool isLogicOpEnabled;
+	LogicOp logicOp;
+	createInfo.GetLogicOpState(&isLogicOpEnabled, &logicOp);
+	VkPipelineColorBlendStateCreateInfo colorBlendInfo {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+	colorBlendInfo.logicOpEnable = isLogicOpEnabled;
+	colorBlendInfo.logicOp = static_cast<VkLogicOp>(logicOp);
+	colorBlendInfo.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+	colorBlendInfo.pAttachments = blendAttachments.data();
+	for(auto i = 0u; i < 4u; ++i)
+		colorBlendInfo.blendConstants[i] = blendConstants[i];
+	KeyBuilder fragmentOutputKey {};
+	for(auto &att : blendAttachments)
+		fragmentOutputKey << att;
+	fragmentOutputKey << colorBlendInfo.logicOpEnable << colorBlendInfo.logicOp << colorBlendInfo.blendConstants << multisampleKey.GetKey();
+
+	// Libraries that depend on the render pass or the pipeline layout include them in their key
+	KeyBuilder renderPassKey {};
+	renderPassKey << renderPass << subPass;
+	if(renderingInfo) {
+		renderPassKey << renderingInfo->viewMask << renderingInfo->colorAttachmentCount;
+		for(auto i = decltype(renderingInfo->colorAttachmentCount) {0u}; i < renderingInfo->colorAttachmentCount; ++i)
+			renderPassKey << renderingInfo->pColorAttachmentFormats[i];
+		renderPassKey << renderingInfo->depthAttachmentFormat << renderingInfo->stencilAttachmentFormat;
+	}
+	preRasterizationKey << renderPassKey.GetKey() << layout.get() << dynamicStateKey.GetKey();
+	fragmentShaderKey << renderPassKey.GetKey() << layout.get() << dynamicStateKey.GetKey();
+	fragmentOutputKey << renderPassKey.GetKey() << dynamicStateKey.GetKey();
+
+	std::array<std::shared_ptr<Library>, 4> libraries;
+	{
+		VkGraphicsPipelineCreateInfo info {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+		info.pVertexInputState = &vertexInputInfo;
+		info.pInputAssemblyState = &inputAssemblyInfo;
+		info.pDynamicState = &dynamicStateInfo;
+		libraries[VertexInput] = GetOrCreateLibrary(vertexInputKey.GetKey(), info, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, VK_NULL_HANDLE, nullptr, {});
+	}
+	{
+		VkGraphicsPipelineCreateInfo info {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+		info.stageCount = static_cast<uint32_t>(preRasterizationStages.size());
+		info.pStages = preRasterizationStages.data();
+		info.pViewportState = &viewportInfo;
+		info.pRasterizationState = &rasterizationInfo;
+		info.pTessellationState = &tessellationInfo;
+		info.pInputAssemblyState = &inputAssemblyInfo;
+		info.pDynamicState = &dynamicStateInfo;
+		info.pNext = renderingInfo;
+		info.layout = vkLayout;
+		info.renderPass = renderPass;
+		info.subpass = subPass;
+		libraries[PreRasterization] = GetOrCreateLibrary(preRasterizationKey.GetKey(), info, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, renderPass, layout, std::move(preRasterizationModules));
+	}
+	{
+		VkGraphicsPipelineCreateInfo info {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+		info.stageCount = static_cast<uint32_t>(fragmentStages.size());
+		info.pStages = fragmentStages.data();
+		info.pDepthStencilState = &depthStencilInfo;
+		info.pMultisampleState = &multisampleInfo;
+		info.pDynamicState = &dynamicStateInfo;
+		info.pNext = renderingInfo;
+		info.layout = vkLayout;
+		info.renderPass = renderPass;
+		info.subpass = subPass;
+		libraries[FragmentShader] = GetOrCreateLibrary(fragmentShaderKey.GetKey(), info, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, renderPass, layout, std::move(fragmentModules));
+	}
+	{
+		VkGraphicsPipelineCreateInfo info {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+		info.pColorBlendState = &colorBlendInfo;
+		info.pMultisampleState = &multisampleInfo;
+		info.pDynamicState = &dynamicStateInfo;
+		info.pNext = renderingInfo;
+		info.renderPass = renderPass;
+		info.subpass = subPass;
+		libraries[FragmentOutput] = GetOrCreateLibrary(fragmentOutputKey.GetKey(), info, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, renderPass, nullptr, {});
+	}
+	for(auto &lib : libraries) {
+		if(!lib)
+			return false;
+	}
+
+	auto linkedPipeline = GetOrLinkPipeline(libraries, layout, vkLayout);
+	if(!linkedPipeline)
+		return false;
+	// Only used to determine how many pipelines have been collapsed by the extended dynamic states
+	KeyBuilder staticStateKey {};
+	staticStateKey << vertexInputKey.GetKey() << preRasterizationKey.GetKey() << fragmentShaderKey.GetKey() << fragmentOutputKey.GetKey();
+	KeyBuilder stateKey {};
+	stateKey << staticStateKey.GetKey() << dynamicStateValues;
+	auto dynamicRendering = (renderingInfo != nullptr);
+	{
+		std::unique_lock lock {m_pipelineMutex};
+		auto &pipelines = dynamicRendering ? m_dynamicRenderingPipelines : m_pipelines;
+		// The previous linked pipeline is destroyed once it's no longer referenced by any other pipeline id
+		pipelines[pipelineId] = {std::move(linkedPipeline), extendedDynamicStates, dynamicStateValues};
+		m_pipelineStates.insert(std::hash<std::string> {}(stateKey.GetKey()));
+		m_staticPipelineStates.insert(std::hash<std::string> {}(staticStateKey.GetKey()));
+		std::scoped_lock statsLock {m_statsMutex};
+		m_stats.uniquePipelineStates = m_pipelineStates.size();
+		m_stats.uniqueStaticPipelineStates = m_staticPipelineStates.size();
+	}
+	return true;
+}
+
+VkPipeline GraphicsPipelineLibraryManager::GetPipeline(PipelineID pipelineId, bool dynamicRendering) const
+{
+	std::shared_lock lock {m_pipelineMutex};
+	auto &pipelines = dynamicRendering ? m_dynamicRenderingPipelines : m_pipelines;
+	auto it = pipelines.find(pipelineId);
+	return (it != pipelines.end()) ? it->second.linkedPipeline->pipeline : VK_NULL_HANDLE;
+}
+
+VkPipeline GraphicsPipelineLibraryManager::GetPipeline(PipelineID pipelineId, bool dynamicRendering, ExtendedDynamicStateFlags &outDynamicStates, ExtendedDynamicStateValues &outDynamicStateValues) const
+{
+	std::shared_lock lock {m_pipelineMutex};
+	auto &pipelines = dynamicRendering ? m_dynamicRenderingPipelines : m_pipelines;
+	auto it = pipelines.find(pipelineId);
+	if(it == pipelines.end())
+		return VK_NULL_HANDLE;
+	outDynamicStates = it->second.dynamicStates;
+	outDynamicStateValues = it->second.dynamicStateValues;
+	return it->second.linkedPipeline->pipeline;
+}
+
+std::shared_ptr<PipelineLayoutCache::PipelineLayout> GraphicsPipelineLibraryManager::GetPipelineLayout(PipelineID pipelineId) const
+{
+	std::shared_lock lock {m_pipelineMutex};
+	auto it = m_pipelines.find(pipelineId);
+	return (it != m_pipelines.end()) ? it->second.linkedPipeline->layout : nullptr;
+}
+
+void GraphicsPipelineLibraryManager::ClearPipeline(PipelineID pipelineId)
+{
+	std::unique_lock lock {m_pipelineMutex};
+	for(auto *pipelines : {&m_pipelines, &m_dynamicRenderingPipelines}) {
+		auto it = pipelines->find(pipelineId);
+		if(it == pipelines->end())
+			continue;
+		pipelines->erase(it);
+	}
+	std::erase_if(m_linkedPipelines, [](const auto &pair) { return pair.second.expired(); });
+}
+
+void GraphicsPipelineLibraryManager::OnRenderPassDestroyed(VkRenderPass renderPass)
+{
+	// Render pass handles may be re-used by the driver, so libraries referencing a destroyed render pass must not be found anymore
+	std::scoped_lock lock {m_libraryMutex};
+	for(auto it = m_libraries.begin(); it != m_libraries.end();) {
+		auto lib = it->second.lock();
+		if(!lib || lib->renderPass == renderPass) {
+			it = m_libraries.erase(it);
+			continue;
+		}
+		++it;
+	}
+}
+
+void GraphicsPipelineLibraryManager::Update()
+{
+	std::vector<LinkJob> completedJobs;
+	auto linkQueueIdle = false;
+	{
+		std::scoped_lock lock {m_linkJobMutex};
+		if(m_completedLinkJobs.empty())
+			return;
+		completedJobs = std::move(m_completedLinkJobs);
+		m_completedLinkJobs.clear();
+		linkQueueIdle = m_pendingLinkJobs.empty() && !m_linkThreadBusy;
+	}
+	std::unique_lock lock {m_pipelineMutex};
+	for(auto &job : completedJobs) {
+		if(job.result == VK_NULL_HANDLE)
+			continue;
+		// All pipeline ids that referenced the linked pipeline may have been cleared or re-created in the meantime
+		if(job.linkedPipeline.use_count() == 1) {
+			vkDestroyPipeline(m_device, job.result, nullptr);
+			continue;
+		}
+		auto &linkedPipeline = *job.linkedPipeline;
+		DestroyPipelineDeferred(linkedPipeline.pipeline);
+		linkedPipeline.pipeline = job.result;
+		std::scoped_lock statsLock {m_statsMutex};
+		++m_stats.optimizedPipelines;
+	}
+	// The first time the link queue runs empty, all pipelines that were created on startup are available
+	if(!m_collapseRatioReported && linkQueueIdle && m_extendedDynamicStates.load() != ExtendedDynamicStateFlags::None) {
+		m_collapseRatioReported = true;
+		Stats stats;
+		{
+			std::scoped_lock statsLock {m_statsMutex};
+			stats = m_stats;
+		}
+		auto collapsed = stats.uniquePipelineStates - stats.uniqueStaticPipelineStates;
+		m_context.Log("Extended dynamic state collapsed " + std::to_string(stats.uniquePipelineStates) + " pipeline permutations into " + std::to_string(stats.uniqueStaticPipelineStates) + " (" + std::to_string(collapsed) + " fewer pipeline bakes, ratio "
+		    + std::to_string(stats.GetCollapseRatio()) + ":1, " + std::to_string(stats.linkedPipelineHits) + " pipelines re-used an existing linked pipeline)",
+		  pragma::util::LogSeverity::Info);
+	}
+}
+
+GraphicsPipelineLibraryManager::Stats GraphicsPipelineLibraryManager::GetStats() const
+{
+	Stats stats;
+	{
+		std::scoped_lock lock {m_statsMutex};
+		stats = m_stats;
+	}
+	std::scoped_lock lock {m_libraryMutex};
+	stats.libraryCount = m_libraries.size();
+	return stats;
+}
@@ -0,0 +1,704 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <cstring>
+#include <cmath>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PROSPER_VULKAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+module pragma.prosper.vulkan;
+
+import :image.format_conversion;
+
+#undef max
+#undef min
+
+using namespace prosper;
+
+#ifdef PROSPER_VULKAN_X86
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define TARGET_SSE4
+#define TARGET_AVX2
+#define TARGET_F16C
+#endif
+
+struct CpuFeatures {
+	bool sse4 = false;
+	bool avx2 = false;
+	bool f16c = false;
+};
+static CpuFeatures detect_cpu_features()
+{
+	CpuFeatures features {};
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	auto maxLeaf = info[0];
+	__cpuid(info, 1);
+	features.sse4 = (info[2] & (1 << 19)) != 0;
+	auto osxsave = (info[2] & (1 << 27)) != 0;
+	auto avx = (info[2] & (1 << 28)) != 0;
+	// The OS has to save the AVX registers on context switches
+	auto avxEnabled = osxsave && avx && (_xgetbv(0) & 6) == 6;
+	features.f16c = avxEnabled && (info[2] & (1 << 29)) != 0;
+	if(maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		features.avx2 = avxEnabled && (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	features.sse4 = __builtin_cpu_supports("sse4.1");
+	features.avx2 = __builtin_cpu_supports("avx2");
+	features.f16c = __builtin_cpu_supports("f16c");
+#endif
+	return features;
+}
+static const CpuFeatures &get_cpu_features()
+{
+	static auto features = detect_cpu_features();
+	return features;
+}
+#endif
+
+static std::atomic<util::SimdLevel> &get_active_simd_level()
+{
+	static std::atomic<util::SimdLevel> level {util::get_supported_simd_level()};
+	return level;
+}
+
+util::SimdLevel util::get_supported_simd_level()
+{
+#ifdef PROSPER_VULKAN_X86
+	auto &features = get_cpu_features();
+	if(features.avx2)
+		return SimdLevel::AVX2;
+	if(features.sse4)
+		return SimdLevel::SSE4;
+#endif
+	return SimdLevel::Scalar;
+}
+util::SimdLevel util::get_simd_level() { return get_active_simd_level(); }
+void util::set_simd_level(SimdLevel level) { get_active_simd_level() = static_cast<SimdLevel>(pragma::math::min(pragma::math::to_integral(level), pragma::math::to_integral(get_supported_simd_level()))); }
+
+//////////////////////
+
+namespace {
+	// Small pool for row-parallel conversions. The calling thread participates in the work.
+	class RowWorkerPool {
+	  public:
+		static RowWorkerPool &GetInstance()
+		{
+			static RowWorkerPool pool {};
+			return pool;
+		}
+		~RowWorkerPool()
+		{
+			{
+				std::scoped_lock lock {m_mutex};
+				m_running = false;
+			}
+			m_condition.notify_all();
+			for(auto &thread : m_threads)
+				thread.join();
+		}
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+		void Run(uint32_t numJobs, const std::function<void(uint32_t)> &job)
+		{
+			// Every call has its own task, so concurrent (or nested) calls are processed side by side. The calling thread
+			// always works on its own task, which guarantees progress even if all workers are busy with other tasks.
+			auto task = std::make_shared<Task>();
+			task->job = &job;
+			task->numJobs = numJobs;
+			{
+				std::scoped_lock lock {m_mutex};
+				m_tasks.push_back(task);
+			}
+			m_condition.notify_all();
+			Work(*task);
+			std::unique_lock lock {m_mutex};
+			RemoveTask(task);
+			task->doneCondition.wait(lock, [&task]() { return task->completedJobs == task->numJobs; });
+		}
+	  private:
+		struct Task {
+			const std::function<void(uint32_t)> *job = nullptr;
+			uint32_t numJobs = 0;
+			std::atomic<uint32_t> nextJob = 0;
+			uint32_t completedJobs = 0; // Protected by m_mutex
+			std::condition_variable doneCondition;
+		};
+		RowWorkerPool()
+		{
+			auto numThreads = pragma::math::min(pragma::math::max(std::thread::hardware_concurrency(), 2u), 8u) - 1;
+			m_threads.reserve(numThreads);
+			for(auto i = decltype(numThreads) {0u}; i < numThreads; ++i)
+				m_threads.emplace_back([this]() { RunWorker(); });
+		}
+		// Has to be called with m_mutex locked
+		void RemoveTask(const std::shared_ptr<Task> &task)
+		{
+			auto it = std::find(m_tasks.begin(), m_tasks.end(), task);
+			if(it != m_tasks.end())
+				m_tasks.erase(it);
+		}
+		void Work(Task &task)
+		{
+			uint32_t numCompleted = 0;
+			for(;;) {
+				auto jobIdx = task.nextJob++;
+				if(jobIdx >= task.numJobs)
+					break;
+				(*task.job)(jobIdx);
+				++numCompleted;
+			}
+			if(numCompleted == 0)
+				return;
+			std::scoped_lock lock {m_mutex};
+			task.completedJobs += numCompleted;
+			if(task.completedJobs == task.numJobs)
+				task.doneCondition.notify_all();
+		}
+		void RunWorker()
+		{
+			for(;;) {
+				std::shared_ptr<Task> task;
+				{
+					std::unique_lock lock {m_mutex};
+					m_condition.wait(lock, [this]() { return !m_running || !m_tasks.empty(); });
+					if(!m_running)
+						return;
+					task = m_tasks.front();
+				}
+				Work(*task);
+				// All jobs of the task have been claimed at this point
+				std::scoped_lock lock {m_mutex};
+				RemoveTask(task);
+			}
+		}
+		std::vector<std::thread> m_threads;
+		std::deque<std::shared_ptr<Task>> m_tasks;
+		bool m_running = true;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+	};
+};
+
+// Images below this size are converted on the calling thread
+static constexpr size_t PARALLEL_MIN_SIZE = 1024 * 1024;
+
+void util::parallel_for_rows(uint32_t rowCount, size_t rowSize, const std::function<void(uint32_t rowBegin, uint32_t rowEnd)> &fn)
+{
+	if(rowCount == 0)
+		return;
+	if(rowCount < 2 || rowCount * rowSize < PARALLEL_MIN_SIZE) {
+		fn(0, rowCount);
+		return;
+	}
+	auto &pool = RowWorkerPool::GetInstance();
+	// A few jobs per thread to balance out uneven scheduling
+	auto numJobs = pragma::math::min(rowCount, pool.GetThreadCount() * 4);
+	auto rowsPerJob = (rowCount + numJobs - 1) / numJobs;
+	numJobs = (rowCount + rowsPerJob - 1) / rowsPerJob;
+	pool.Run(numJobs, [&fn, rowCount, rowsPerJob](uint32_t job) {
+		auto rowBegin = job * rowsPerJob;
+		fn(rowBegin, pragma::math::min(rowBegin + rowsPerJob, rowCount));
+	});
+}
+
+util::ParallelForRowsBenchmarkResult util::run_parallel_for_rows_benchmark(uint32_t callerCount, uint32_t callsPerCaller, uint32_t rowCount, size_t rowSize)
+{
+	ParallelForRowsBenchmarkResult result {};
+	result.callerCount = pragma::math::max(callerCount, 1u);
+	result.callsPerCaller = callsPerCaller;
+	struct CallerData {
+		std::vector<uint8_t> data;
+		std::vector<std::atomic<uint32_t>> rowVisits;
+	};
+	std::vector<CallerData> callers(result.callerCount);
+	for(auto &caller : callers) {
+		caller.data.resize(rowCount * rowSize);
+		caller.rowVisits = std::vector<std::atomic<uint32_t>>(rowCount);
+	}
+	std::atomic<bool> valid = true;
+	// Swizzles every row in place and checks that each row was processed exactly once per call
+	auto runCalls = [&valid, callsPerCaller, rowCount, rowSize](CallerData &caller) {
+		for(auto i = decltype(callsPerCaller) {0u}; i < callsPerCaller; ++i) {
+			for(auto &visits : caller.rowVisits)
+				visits = 0;
+			parallel_for_rows(rowCount, rowSize, [&caller, rowSize](uint32_t rowBegin, uint32_t rowEnd) {
+				for(auto y = rowBegin; y < rowEnd; ++y) {
+					auto *row = caller.data.data() + y * rowSize;
+					convert_pixels(PixelConversion::SwizzleRbRgba8, row, row, rowSize / 4);
+					++caller.rowVisits[y];
+				}
+			});
+			for(auto &visits : caller.rowVisits) {
+				if(visits != 1)
+					valid = false;
+			}
+		}
+	};
+
+	auto t = std::chrono::steady_clock::now();
+	for(auto &caller : callers)
+		runCalls(caller);
+	result.sequentialDuration = std::chrono::steady_clock::now() - t;
+
+	t = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	threads.reserve(callers.size());
+	for(auto &caller : callers)
+		threads.emplace_back([&runCalls, &caller]() { runCalls(caller); });
+	for(auto &thread : threads)
+		thread.join();
+	result.concurrentDuration = std::chrono::steady_clock::now() - t;
+
+	// Calls from within a job must not wait for the outer call to finish
+	std::atomic<uint32_t> nestedRows = 0;
+	parallel_for_rows(rowCount, rowSize, [&nestedRows, rowCount, rowSize](uint32_t rowBegin, uint32_t rowEnd) {
+		if(rowBegin != 0)
+			return;
+		parallel_for_rows(rowCount, rowSize, [&nestedRows](uint32_t innerRowBegin, uint32_t innerRowEnd) { nestedRows += innerRowEnd - innerRowBegin; });
+	});
+	result.valid = valid && nestedRows == rowCount;
+	return result;
+}
+
+//////////////////////
+
+static constexpr uint16_t HALF_ONE = 0x3C00;
+
+static uint16_t float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t absx = x & 0x7FFFFFFF;
+	if(absx >= 0x7F800000) // Inf / NaN
+		return static_cast<uint16_t>(sign | ((absx > 0x7F800000) ? 0x7E00 : 0x7C00));
+	if(absx >= 0x477FF000) // Rounds to infinity
+		return static_cast<uint16_t>(sign | 0x7C00);
+	if(absx < 0x38800000) {
+		// Subnormal half
+		if(absx <= 0x33000000)
+			return static_cast<uint16_t>(sign);
+		auto e = absx >> 23;
+		auto mant = (absx & 0x7FFFFF) | 0x800000;
+		auto shift = 126 - e;
+		auto h = mant >> shift;
+		auto rem = mant & ((1u << shift) - 1);
+		auto halfway = 1u << (shift - 1);
+		if(rem > halfway || (rem == halfway && (h & 1)))
+			++h;
+		return static_cast<uint16_t>(sign | h);
+	}
+	auto h = (((absx >> 23) - 112) << 10) | ((absx >> 13) & 0x3FF);
+	auto rem = absx & 0x1FFF;
+	// Round to nearest even; A carry into the exponent is intended
+	if(rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+		++h;
+	return static_cast<uint16_t>(sign | h);
+}
+
+static float half_to_float(uint16_t h)
+{
+	uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1F;
+	uint32_t mant = h & 0x3FF;
+	uint32_t x;
+	if(exp == 0) {
+		if(mant == 0)
+			x = sign;
+		else {
+			exp = 113;
+			while((mant & 0x400) == 0) {
+				mant <<= 1;
+				--exp;
+			}
+			x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+		}
+	}
+	else if(exp == 31)
+		x = sign | 0x7F800000 | (mant << 13);
+	else
+		x = sign | ((exp + 112) << 23) | (mant << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+// Scalar kernels; Also used for the remainders of the vectorized kernels
+static void rgb8_to_rgba8_scalar(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = std::numeric_limits<uint8_t>::max();
+		src += 3;
+		dst += 4;
+	}
+}
+static void rgba8_to_rgb8_scalar(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		src += 4;
+		dst += 3;
+	}
+}
+static void rgb16f_to_rgba16f_scalar(const uint16_t *src, uint16_t *dst, size_t count)
+{
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = HALF_ONE;
+		src += 3;
+		dst += 4;
+	}
+}
+static void swizzle_rb_scalar(const uint8_t *src, uint8_t *dst, size_t count, uint32_t pixelSize)
+{
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		auto r = src[0];
+		auto g = src[1];
+		auto b = src[2];
+		dst[0] = b;
+		dst[1] = g;
+		dst[2] = r;
+		if(pixelSize == 4)
+			dst[3] = src[3];
+		src += pixelSize;
+		dst += pixelSize;
+	}
+}
+
+#ifdef PROSPER_VULKAN_X86
+TARGET_SSE4 static size_t rgb8_to_rgba8_sse4(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	const auto mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const auto alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	// 16 pixels (48 bytes) per iteration
+	for(; i + 16 <= count; i += 16) {
+		auto in0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		auto in1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+		auto in2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+		auto p0 = _mm_shuffle_epi8(in0, mask);
+		auto p1 = _mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), mask);
+		auto p2 = _mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), mask);
+		auto p3 = _mm_shuffle_epi8(_mm_srli_si128(in2, 4), mask);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_or_si128(p0, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_or_si128(p1, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), _mm_or_si128(p2, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 48), _mm_or_si128(p3, alpha));
+		src += 48;
+		dst += 64;
+	}
+	return i;
+}
+TARGET_AVX2 static size_t rgb8_to_rgba8_avx2(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	const auto mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const auto alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	// 8 pixels (24 bytes) per iteration; Each 128-bit lane loads 16 bytes, so 4 bytes past the pixels have to be readable
+	for(; i + 10 <= count; i += 8) {
+		auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12));
+		auto in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_or_si256(_mm256_shuffle_epi8(in, mask), alpha));
+		src += 24;
+		dst += 32;
+	}
+	return i;
+}
+TARGET_SSE4 static size_t rgba8_to_rgb8_sse4(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	const auto mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	size_t i = 0;
+	// 4 pixels per iteration; The 16 byte store writes 4 bytes past the 12 output bytes, which are overwritten by the next iteration
+	for(; i + 6 <= count; i += 4) {
+		auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(in, mask));
+		src += 16;
+		dst += 12;
+	}
+	return i;
+}
+TARGET_SSE4 static size_t rgb16f_to_rgba16f_sse4(const uint16_t *src, uint16_t *dst, size_t count)
+{
+	const auto mask = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+	const auto alpha = _mm_set1_epi64x(static_cast<int64_t>(HALF_ONE) << 48);
+	size_t i = 0;
+	// 2 pixels (12 bytes) per iteration; 4 bytes past the pixels have to be readable
+	for(; i + 3 <= count; i += 2) {
+		auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_or_si128(_mm_shuffle_epi8(in, mask), alpha));
+		src += 6;
+		dst += 8;
+	}
+	return i;
+}
+TARGET_AVX2 static size_t rgb16f_to_rgba16f_avx2(const uint16_t *src, uint16_t *dst, size_t count)
+{
+	const auto mask = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1, 0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+	const auto alpha = _mm256_set1_epi64x(static_cast<int64_t>(HALF_ONE) << 48);
+	size_t i = 0;
+	// 4 pixels (24 bytes) per iteration
+	for(; i + 5 <= count; i += 4) {
+		auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 6));
+		auto in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_or_si256(_mm256_shuffle_epi8(in, mask), alpha));
+		src += 12;
+		dst += 16;
+	}
+	return i;
+}
+TARGET_SSE4 static size_t swizzle_rb_rgba8_sse4(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	const auto mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(in, mask));
+		src += 16;
+		dst += 16;
+	}
+	return i;
+}
+TARGET_AVX2 static size_t swizzle_rb_rgba8_avx2(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	const auto mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		auto in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_shuffle_epi8(in, mask));
+		src += 32;
+		dst += 32;
+	}
+	return i;
+}
+TARGET_SSE4 static size_t swizzle_rb_rgb8_sse4(const uint8_t *src, uint8_t *dst, size_t count)
+{
+	// 5 pixels (15 bytes) per iteration; The 16th byte belongs to the next pixel and is written back unchanged
+	const auto mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+	size_t i = 0;
+	for(; i + 6 <= count; i += 5) {
+		auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(in, mask));
+		src += 15;
+		dst += 15;
+	}
+	return i;
+}
+TARGET_F16C static size_t float32_to_float16_f16c(const float *src, uint16_t *dst, size_t count)
+{
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+	return i;
+}
+TARGET_F16C static size_t float16_to_float32_f16c(const uint16_t *src, float *dst, size_t count)
+{
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+	return i;
+}
+#endif
+
+uint32_t util::get_pixel_conversion_src_size(PixelConversion conversion)
+{
+	switch(conversion) {
+	case PixelConversion::Rgb8ToRgba8:
+	case PixelConversion::SwizzleRbRgb8:
+		return 3;
+	case PixelConversion::Rgba8ToRgb8:
+	case PixelConversion::SwizzleRbRgba8:
+		return 4;
+	case PixelConversion::Rgb16fToRgba16f:
+		return 6;
+	}
+	return 0;
+}
+uint32_t util::get_pixel_conversion_dst_size(PixelConversion conversion)
+{
+	switch(conversion) {
+	case PixelConversion::Rgba8ToRgb8:
+	case PixelConversion::SwizzleRbRgb8:
+		return 3;
+	case PixelConversion::Rgb8ToRgba8:
+	case PixelConversion::SwizzleRbRgba8:
+		return 4;
+	case PixelConversion::Rgb16fToRgba16f:
+		return 8;
+	}
+	return 0;
+}
+
+void util::convert_pixels(PixelConversion conversion, const void *src, void *dst, size_t pixelCount)
+{
+	auto *s = static_cast<const uint8_t *>(src);
+	auto *d = static_cast<uint8_t *>(dst);
+	size_t n = 0;
+	[[maybe_unused]] auto level = get_simd_level();
+	switch(conversion) {
+	case PixelConversion::Rgb8ToRgba8:
+#ifdef PROSPER_VULKAN_X86
+		if(level == SimdLevel::AVX2)
+			n = rgb8_to_rgba8_avx2(s, d, pixelCount);
+		else if(level == SimdLevel::SSE4)
+			n = rgb8_to_rgba8_sse4(s, d, pixelCount);
+#endif
+		rgb8_to_rgba8_scalar(s + n * 3, d + n * 4, pixelCount - n);
+		break;
+	case PixelConversion::Rgba8ToRgb8:
+#ifdef PROSPER_VULKAN_X86
+		if(level != SimdLevel::Scalar)
+			n = rgba8_to_rgb8_sse4(s, d, pixelCount);
+#endif
+		rgba8_to_rgb8_scalar(s + n * 4, d + n * 3, pixelCount - n);
+		break;
+	case PixelConversion::Rgb16fToRgba16f:
+		{
+			auto *s16 = reinterpret_cast<const uint16_t *>(s);
+			auto *d16 = reinterpret_cast<uint16_t *>(d);
+#ifdef PROSPER_VULKAN_X86
+			if(level == SimdLevel::AVX2)
+				n = rgb16f_to_rgba16f_avx2(s16, d16, pixelCount);
+			else if(level == SimdLevel::SSE4)
+				n = rgb16f_to_rgba16f_sse4(s16, d16, pixelCount);
+#endif
+			rgb16f_to_rgba16f_scalar(s16 + n * 3, d16 + n * 4, pixelCount - n);
+			break;
+		}
+	case PixelConversion::SwizzleRbRgb8:
+#ifdef PROSPER_VULKAN_X86
+		if(level != SimdLevel::Scalar)
+			n = swizzle_rb_rgb8_sse4(s, d, pixelCount);
+#endif
+		swizzle_rb_scalar(s + n * 3, d + n * 3, pixelCount - n, 3);
+		break;
+	case PixelConversion::SwizzleRbRgba8:
+#ifdef PROSPER_VULKAN_X86
+		if(level == SimdLevel::AVX2)
+			n = swizzle_rb_rgba8_avx2(s, d, pixelCount);
+		else if(level == SimdLevel::SSE4)
+			n = swizzle_rb_rgba8_sse4(s, d, pixelCount);
+#endif
+		swizzle_rb_scalar(s + n * 4, d + n * 4, pixelCount - n, 4);
+		break;
+	default:
+		if(s != d)
+			memcpy(d, s, pixelCount * get_pixel_conversion_src_size(conversion));
+		break;
+	}
+}
+
+void util::convert_image(PixelConversion conversion, const void *src, void *dst, uint32_t width, uint32_t height, bool flipVertically)
+{
+	if(conversion == PixelConversion::None)
+		return;
+	size_t srcRowSize = width * get_pixel_conversion_src_size(conversion);
+	size_t dstRowSize = width * get_pixel_conversion_dst_size(conversion);
+	auto *s = static_cast<const uint8_t *>(src);
+	auto *d = static_cast<uint8_t *>(dst);
+	parallel_for_rows(height, pragma::math::max(srcRowSize, dstRowSize), [=](uint32_t rowBegin, uint32_t rowEnd) {
+		for(auto y = rowBegin; y < rowEnd; ++y) {
+			auto dstY = flipVertically ? (height - 1 - y) : y;
+			convert_pixels(conversion, s + y * srcRowSize, d + dstY * dstRowSize, width);
+		}
+	});
+}
+
+void util::flip_image_vertically(void *data, size_t rowSize, uint32_t rowCount)
+{
+	auto *d = static_cast<uint8_t *>(data);
+	parallel_for_rows(rowCount / 2, rowSize * 2, [=](uint32_t rowBegin, uint32_t rowEnd) {
+		std::vector<uint8_t> tmp(rowSize);
+		for(auto y = rowBegin; y < rowEnd; ++y) {
+			auto *row0 = d + y * rowSize;
+			auto *row1 = d + (rowCount - 1 - y) * rowSize;
+			memcpy(tmp.data(), row0, rowSize);
+			memcpy(row0, row1, rowSize);
+			memcpy(row1, tmp.data(), rowSize);
+		}
+	});
+}
+
+void util::convert_float32_to_float16(const float *src, uint16_t *dst, size_t count)
+{
+	size_t n = 0;
+#ifdef PROSPER_VULKAN_X86
+	if(get_simd_level() == SimdLevel::AVX2 && get_cpu_features().f16c)
+		n = float32_to_float16_f16c(src, dst, count);
+#endif
+	for(auto i = n; i < count; ++i)
+		dst[i] = float_to_half(src[i]);
+}
+
+void util::convert_float16_to_float32(const uint16_t *src, float *dst, size_t count)
+{
+	size_t n = 0;
+#ifdef PROSPER_VULKAN_X86
+	if(get_simd_level() == SimdLevel::AVX2 && get_cpu_features().f16c)
+		n = float16_to_float32_f16c(src, dst, count);
+#endif
+	for(auto i = n; i < count; ++i)
+		dst[i] = half_to_float(src[i]);
+}
+
+// 8-bit transfer functions are table lookups, which are faster than any vectorized evaluation of the curve
+static const std::array<uint8_t, 256> &get_srgb_to_linear_table()
+{
+	static auto table = []() {
+		std::array<uint8_t, 256> table {};
+		for(auto i = 0u; i < table.size(); ++i) {
+			auto c = i / 255.0;
+			auto l = (c <= 0.04045) ? (c / 12.92) : std::pow((c + 0.055) / 1.055, 2.4);
+			table[i] = static_cast<uint8_t>(std::lround(l * 255.0));
+		}
+		return table;
+	}();
+	return table;
+}
+static const std::array<uint8_t, 256> &get_linear_to_srgb_table()
+{
+	static auto table = []() {
+		std::array<uint8_t, 256> table {};
+		for(auto i = 0u; i < table.size(); ++i) {
+			auto l = i / 255.0;
+			auto c = (l <= 0.0031308) ? (l * 12.92) : (1.055 * std::pow(l, 1.0 / 2.4) - 0.055);
+			table[i] = static_cast<uint8_t>(std::lround(c * 255.0));
+		}
+		return table;
+	}();
+	return table;
+}
+static void apply_table(uint8_t *data, size_t pixelCount, uint32_t numChannels, const std::array<uint8_t, 256> &table)
+{
+	auto numColorChannels = pragma::math::min(numChannels, 3u);
+	for(auto i = decltype(pixelCount) {0u}; i < pixelCount; ++i) {
+		for(auto c = decltype(numColorChannels) {0u}; c < numColorChannels; ++c)
+			data[c] = table[data[c]];
+		data += numChannels;
+	}
+}
+void util::convert_srgb_to_linear(uint8_t *data, size_t pixelCount, uint32_t numChannels) { apply_table(data, pixelCount, numChannels, get_srgb_to_linear_table()); }
+void util::convert_linear_to_srgb(uint8_t *data, size_t pixelCount, uint32_t numChannels) { apply_table(data, pixelCount, numChannels, get_linear_to_srgb_table()); }
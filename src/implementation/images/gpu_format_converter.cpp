@@ -0,0 +1,452 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <cstring>
+#include <wrappers/device.h>
+#include <wrappers/image.h>
+#include <wrappers/shader_module.h>
+#include <misc/glsl_to_spirv.h>
+
+module pragma.prosper.vulkan;
+
+import :image.gpu_format_converter;
+
+using namespace prosper;
+
+static constexpr uint32_t WORKGROUP_SIZE = 8;
+static constexpr uint32_t DESCRIPTOR_POOL_SIZE = 64;
+
+// The source is bound as an array of 32-bit words, since 8- and 16-bit storage buffer access is optional
+static constexpr const char *CONVERSION_SHADER_SOURCE = R"(#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(constant_id = 0) const bool SWIZZLE_RB = false;
+
+layout(std430, set = 0, binding = 0) readonly buffer SourceData { uint words[]; } u_src;
+layout(set = 0, binding = 1, DST_FORMAT) uniform writeonly image2D u_dst;
+
+layout(push_constant) uniform PushConstants {
+	uint width;
+	uint height;
+	uint srcOffset; // In bytes
+} u_pushConstants;
+
+uint read_u8(uint offset) { return (u_src.words[offset >> 2] >> ((offset & 3u) * 8u)) & 0xFFu; }
+// offset has to be a multiple of 2
+uint read_u16(uint offset) { return (u_src.words[offset >> 2] >> ((offset & 2u) * 8u)) & 0xFFFFu; }
+
+void main()
+{
+	uvec2 px = gl_GlobalInvocationID.xy;
+	if(px.x >= u_pushConstants.width || px.y >= u_pushConstants.height)
+		return;
+	uint pxIdx = px.y * u_pushConstants.width + px.x;
+#ifdef SRC_RGB16F
+	uint offset = u_pushConstants.srcOffset + pxIdx * 6u;
+	vec4 color = vec4(unpackHalf2x16(read_u16(offset)).x, unpackHalf2x16(read_u16(offset + 2u)).x, unpackHalf2x16(read_u16(offset + 4u)).x, 1.0);
+#else
+	uint offset = u_pushConstants.srcOffset + pxIdx * 3u;
+	vec4 color = vec4(read_u8(offset), read_u8(offset + 1u), read_u8(offset + 2u), 255.0) / 255.0;
+#endif
+	if(SWIZZLE_RB)
+		color = color.bgra;
+	imageStore(u_dst, ivec2(px), color);
+}
+)";
+
+struct ConversionPushConstants {
+	uint32_t width;
+	uint32_t height;
+	uint32_t srcOffset;
+};
+
+namespace {
+	struct DispatchResources {
+		VkDevice device = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		std::function<void(VkDescriptorPool, VkDescriptorSet)> freeDescriptorSet;
+		~DispatchResources()
+		{
+			if(descriptorSet != VK_NULL_HANDLE)
+				freeDescriptorSet(descriptorPool, descriptorSet);
+			if(imageView != VK_NULL_HANDLE)
+				vkDestroyImageView(device, imageView, nullptr);
+		}
+	};
+};
+
+std::unique_ptr<GpuFormatConverter> GpuFormatConverter::Create(VlkContext &context)
+{
+	auto converter = std::unique_ptr<GpuFormatConverter> {new GpuFormatConverter {context}};
+	if(!converter->Initialize())
+		return nullptr;
+	return converter;
+}
+
+GpuFormatConverter::GpuFormatConverter(VlkContext &context) : m_context {context}, m_device {context.GetDevice().get_device_vk()} {}
+
+GpuFormatConverter::~GpuFormatConverter()
+{
+	for(auto &[key, pipeline] : m_pipelines)
+		vkDestroyPipeline(m_device, pipeline, nullptr);
+	for(auto pool : m_descriptorPools)
+		vkDestroyDescriptorPool(m_device, pool, nullptr);
+	if(m_pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+	if(m_descriptorSetLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+bool GpuFormatConverter::Initialize()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	VkDescriptorSetLayoutCreateInfo dsLayoutCreateInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+	dsLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	dsLayoutCreateInfo.pBindings = bindings.data();
+	if(vkCreateDescriptorSetLayout(m_device, &dsLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+		return false;
+
+	VkPushConstantRange pushConstantRange {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConversionPushConstants)};
+	VkPipelineLayoutCreateInfo layoutCreateInfo {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+	layoutCreateInfo.setLayoutCount = 1;
+	layoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+	layoutCreateInfo.pushConstantRangeCount = 1;
+	layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	return vkCreatePipelineLayout(m_device, &layoutCreateInfo, nullptr, &m_pipelineLayout) == VK_SUCCESS;
+}
+
+bool GpuFormatConverter::IsSupported(util::PixelConversion conversion, Format dstFormat) const
+{
+	switch(conversion) {
+	case util::PixelConversion::Rgb8ToRgba8:
+		if(dstFormat != Format::R8G8B8A8_UNorm)
+			return false;
+		break;
+	case util::PixelConversion::Rgb16fToRgba16f:
+		if(dstFormat != Format::R16G16B16A16_SFloat)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return m_context.IsStorageImageFormatSupported(dstFormat);
+}
+
+VkPipeline GpuFormatConverter::GetPipeline(const PipelineKey &key)
+{
+	auto it = std::find_if(m_pipelines.begin(), m_pipelines.end(), [&key](const std::pair<PipelineKey, VkPipeline> &pair) { return pair.first == key; });
+	if(it != m_pipelines.end())
+		return it->second;
+
+	std::string source = CONVERSION_SHADER_SOURCE;
+	std::string defines;
+	std::string dstFormat;
+	if(key.conversion == util::PixelConversion::Rgb16fToRgba16f) {
+		defines = "#define SRC_RGB16F\n";
+		dstFormat = "rgba16f";
+	}
+	else
+		dstFormat = "rgba8";
+	// The defines have to come after the #version directive
+	auto versionEnd = source.find('\n') + 1;
+	source.insert(versionEnd, defines + "#define DST_FORMAT " + dstFormat + "\n");
+
+	auto &dev = m_context.GetDevice();
+	auto generator = Anvil::GLSLShaderToSPIRVGenerator::create(&dev, Anvil::GLSLShaderToSPIRVGenerator::MODE_USE_SPECIFIED_SOURCE, source, static_cast<Anvil::ShaderStage>(prosper::ShaderStage::Compute));
+	if(generator == nullptr || generator->get_spirv_blob_size() == 0u) {
+		m_context.Log("Failed to compile format conversion shader: " + (generator ? generator->get_shader_info_log() : std::string {}), pragma::util::LogSeverity::Error);
+		return VK_NULL_HANDLE;
+	}
+	auto shaderModule = Anvil::ShaderModule::create_from_spirv_generator(&dev, generator.get());
+	if(shaderModule == nullptr)
+		return VK_NULL_HANDLE;
+
+	VkBool32 swizzleRb = key.swizzleRb ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry specEntry {0, 0, sizeof(swizzleRb)};
+	VkSpecializationInfo specInfo {1, &specEntry, sizeof(swizzleRb), &swizzleRb};
+
+	VkComputePipelineCreateInfo createInfo {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+	createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	createInfo.stage.module = shaderModule->get_module();
+	createInfo.stage.pName = "main";
+	createInfo.stage.pSpecializationInfo = &specInfo;
+	createInfo.layout = m_pipelineLayout;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	m_pipelines.push_back({key, pipeline});
+	return pipeline;
+}
+
+VkDescriptorSet GpuFormatConverter::AllocateDescriptorSet(VkDescriptorPool &outPool)
+{
+	VkDescriptorSetAllocateInfo allocInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
+	VkDescriptorSet descSet = VK_NULL_HANDLE;
+	for(auto pool : m_descriptorPools) {
+		allocInfo.descriptorPool = pool;
+		if(vkAllocateDescriptorSets(m_device, &allocInfo, &descSet) == VK_SUCCESS) {
+			outPool = pool;
+			return descSet;
+		}
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes {VkDescriptorPoolSize {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SIZE}, VkDescriptorPoolSize {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DESCRIPTOR_POOL_SIZE}};
+	VkDescriptorPoolCreateInfo poolCreateInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = DESCRIPTOR_POOL_SIZE;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if(vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, &pool) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	m_descriptorPools.push_back(pool);
+	allocInfo.descriptorPool = pool;
+	if(vkAllocateDescriptorSets(m_device, &allocInfo, &descSet) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	outPool = pool;
+	return descSet;
+}
+
+void GpuFormatConverter::FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descSet)
+{
+	std::scoped_lock lock {m_mutex};
+	vkFreeDescriptorSets(m_device, pool, 1, &descSet);
+}
+
+std::shared_ptr<void> GpuFormatConverter::RecordConvert(ICommandBuffer &cmd, util::PixelConversion conversion, IBuffer &srcBuffer, DeviceSize srcOffset, IImage &dstImage, uint32_t layer, uint32_t mipmap, uint32_t width, uint32_t height, bool swizzleRb)
+{
+	if(!IsSupported(conversion, dstImage.GetFormat()) || !pragma::math::is_flag_set(dstImage.GetCreateInfo().usage, ImageUsageFlags::StorageBit))
+		return nullptr;
+	auto &vkBuffer = srcBuffer.GetAPITypeRef<VlkBuffer>();
+	auto bufferOffset = srcBuffer.GetStartOffset();
+	auto bufferSize = srcBuffer.GetSize();
+	auto requiredSize = srcOffset + static_cast<DeviceSize>(width) * height * util::get_pixel_conversion_src_size(conversion);
+	auto &limits = m_context.GetDevice().get_physical_device_properties().core_vk1_0_properties_ptr->limits;
+	if(requiredSize > bufferSize || bufferSize > limits.max_storage_buffer_range || (bufferOffset % limits.min_storage_buffer_offset_alignment) != 0)
+		return nullptr;
+
+	auto resources = std::make_shared<DispatchResources>();
+	resources->device = m_device;
+	resources->freeDescriptorSet = [this](VkDescriptorPool pool, VkDescriptorSet descSet) { FreeDescriptorSet(pool, descSet); };
+
+	VkImageViewCreateInfo viewCreateInfo {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+	viewCreateInfo.image = static_cast<VlkImage &>(dstImage).GetAnvilImage().get_image();
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = static_cast<VkFormat>(dstImage.GetFormat());
+	viewCreateInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mipmap, 1, layer, 1};
+	if(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &resources->imageView) != VK_SUCCESS)
+		return nullptr;
+
+	VkPipeline pipeline;
+	{
+		std::scoped_lock lock {m_mutex};
+		pipeline = GetPipeline({conversion, swizzleRb});
+		if(pipeline != VK_NULL_HANDLE)
+			resources->descriptorSet = AllocateDescriptorSet(resources->descriptorPool);
+	}
+	if(pipeline == VK_NULL_HANDLE || resources->descriptorSet == VK_NULL_HANDLE)
+		return nullptr;
+
+	VkDescriptorBufferInfo bufferInfo {vkBuffer.GetVkBuffer(), bufferOffset, bufferSize};
+	VkDescriptorImageInfo imageInfo {VK_NULL_HANDLE, resources->imageView, VK_IMAGE_LAYOUT_GENERAL};
+	std::array<VkWriteDescriptorSet, 2> writes {};
+	for(auto &write : writes) {
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = resources->descriptorSet;
+		write.descriptorCount = 1;
+	}
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[0].pBufferInfo = &bufferInfo;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	ConversionPushConstants pushConstants {width, height, static_cast<uint32_t>(srcOffset)};
+	auto vkCmd = cmd.GetAPITypeRef<VlkCommandBuffer>().GetVkCommandBuffer();
+	vkCmdBindPipeline(vkCmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(vkCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &resources->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(vkCmd, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(vkCmd, (width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+	std::scoped_lock lock {m_mutex};
+	++m_stats.dispatchCount;
+	m_stats.convertedPixels += static_cast<uint64_t>(width) * height;
+	return resources;
+}
+
+static void record_image_barrier(ICommandBuffer &cmd, IImage &img, ImageLayout oldLayout, ImageLayout newLayout, AccessFlags srcAccessMask, AccessFlags dstAccessMask, PipelineStageFlags srcStageMask, PipelineStageFlags dstStageMask)
+{
+	util::ImageBarrierInfo imgBarrierInfo {};
+	imgBarrierInfo.srcAccessMask = srcAccessMask;
+	imgBarrierInfo.dstAccessMask = dstAccessMask;
+	imgBarrierInfo.oldLayout = oldLayout;
+	imgBarrierInfo.newLayout = newLayout;
+	imgBarrierInfo.subresourceRange = {0, 1, 0, img.GetLayerCount()};
+	imgBarrierInfo.srcQueueFamilyIndex = imgBarrierInfo.dstQueueFamilyIndex = img.GetContext().GetUniversalQueueFamilyIndex();
+
+	util::PipelineBarrierInfo barrierInfo {};
+	barrierInfo.srcStageMask = srcStageMask;
+	barrierInfo.dstStageMask = dstStageMask;
+	barrierInfo.imageBarriers.push_back(util::create_image_barrier(img, imgBarrierInfo));
+	cmd.RecordPipelineBarrier(barrierInfo);
+}
+
+std::shared_ptr<void> GpuFormatConverter::RecordConvertImage(ICommandBuffer &cmd, util::PixelConversion conversion, IBuffer &srcBuffer, DeviceSize srcLayerStride, IImage &dstImage, ImageLayout dstLayout)
+{
+	if(!IsSupported(conversion, dstImage.GetFormat()) || !pragma::math::is_flag_set(dstImage.GetCreateInfo().usage, ImageUsageFlags::TransferDstBit))
+		return nullptr;
+	auto w = dstImage.GetWidth();
+	auto h = dstImage.GetHeight();
+	auto numLayers = dstImage.GetLayerCount();
+	util::ImageCreateInfo createInfo {};
+	createInfo.format = dstImage.GetFormat();
+	createInfo.width = w;
+	createInfo.height = h;
+	createInfo.layers = numLayers;
+	createInfo.usage = GetRequiredImageUsage() | ImageUsageFlags::TransferSrcBit;
+	createInfo.memoryFeatures = MemoryFeatureFlags::DeviceLocal;
+	createInfo.postCreateLayout = ImageLayout::Undefined;
+	auto tmpImage = m_context.CreateImage(createInfo);
+	if(!tmpImage)
+		return nullptr;
+
+	struct ConversionResources {
+		std::shared_ptr<IImage> image;
+		std::vector<std::shared_ptr<void>> dispatchResources;
+	};
+	auto resources = std::make_shared<ConversionResources>();
+	resources->image = tmpImage;
+	resources->dispatchResources.reserve(numLayers);
+	record_image_barrier(cmd, *tmpImage, ImageLayout::Undefined, ImageLayout::General, AccessFlags {}, AccessFlags::ShaderWriteBit, PipelineStageFlags::TopOfPipeBit, PipelineStageFlags::ComputeShaderBit);
+	for(auto iLayer = decltype(numLayers) {0u}; iLayer < numLayers; ++iLayer) {
+		auto dispatchResources = RecordConvert(cmd, conversion, srcBuffer, iLayer * srcLayerStride, *tmpImage, iLayer, 0, w, h);
+		if(!dispatchResources)
+			return nullptr;
+		resources->dispatchResources.push_back(std::move(dispatchResources));
+	}
+	record_image_barrier(cmd, *tmpImage, ImageLayout::General, ImageLayout::TransferSrcOptimal, AccessFlags::ShaderWriteBit, AccessFlags::TransferReadBit, PipelineStageFlags::ComputeShaderBit, PipelineStageFlags::TransferBit);
+	record_image_barrier(cmd, dstImage, ImageLayout::Undefined, ImageLayout::TransferDstOptimal, AccessFlags {}, AccessFlags::TransferWriteBit, PipelineStageFlags::TopOfPipeBit, PipelineStageFlags::TransferBit);
+
+	util::CopyInfo copyInfo {};
+	copyInfo.srcSubresource.layerCount = numLayers;
+	copyInfo.dstSubresource.layerCount = numLayers;
+	copyInfo.srcImageLayout = ImageLayout::TransferSrcOptimal;
+	copyInfo.dstImageLayout = ImageLayout::TransferDstOptimal;
+	if(!cmd.RecordCopyImage(copyInfo, *tmpImage, dstImage))
+		return nullptr;
+	record_image_barrier(cmd, dstImage, ImageLayout::TransferDstOptimal, dstLayout, AccessFlags::TransferWriteBit, AccessFlags::ShaderReadBit | AccessFlags::TransferReadBit, PipelineStageFlags::TransferBit, PipelineStageFlags::AllCommands);
+	return resources;
+}
+
+GpuFormatConverter::ReferenceComparisonResult GpuFormatConverter::RunCpuReferenceComparison(VlkContext &context, util::PixelConversion conversion, uint32_t width, uint32_t height, uint32_t layerCount)
+{
+	ReferenceComparisonResult result {};
+	auto *converter = context.GetGpuFormatConverter();
+	auto dstFormat = (conversion == util::PixelConversion::Rgb16fToRgba16f) ? Format::R16G16B16A16_SFloat : Format::R8G8B8A8_UNorm;
+	if(!converter || !converter->IsSupported(conversion, dstFormat) || width == 0 || height == 0 || layerCount == 0)
+		return result;
+
+	// Deterministic source data; Half-float sources are generated from finite floats, so that NaN payloads don't affect the comparison
+	auto srcPixelSize = util::get_pixel_conversion_src_size(conversion);
+	auto dstPixelSize = util::get_pixel_conversion_dst_size(conversion);
+	auto srcLayerSize = static_cast<DeviceSize>(width) * height * srcPixelSize;
+	auto srcLayerStride = (srcLayerSize + 3) & ~static_cast<DeviceSize>(3);
+	std::vector<uint8_t> srcData(srcLayerStride * layerCount);
+	uint32_t seed = 12345;
+	auto next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	for(auto iLayer = decltype(layerCount) {0u}; iLayer < layerCount; ++iLayer) {
+		auto *layerData = srcData.data() + iLayer * srcLayerStride;
+		if(conversion == util::PixelConversion::Rgb16fToRgba16f) {
+			std::vector<float> values(static_cast<size_t>(width) * height * 3);
+			for(auto &v : values)
+				v = (static_cast<float>(next() % 20001) - 10000.f) / 100.f;
+			util::convert_float32_to_float16(values.data(), reinterpret_cast<uint16_t *>(layerData), values.size());
+		}
+		else {
+			for(auto i = decltype(srcLayerSize) {0u}; i < srcLayerSize; ++i)
+				layerData[i] = static_cast<uint8_t>(next());
+		}
+	}
+
+	util::BufferCreateInfo bufCreateInfo {};
+	bufCreateInfo.size = srcData.size();
+	bufCreateInfo.usageFlags = BufferUsageFlags::StorageBufferBit;
+	bufCreateInfo.memoryFeatures = MemoryFeatureFlags::CPUToGPU;
+	auto srcBuffer = context.CreateBuffer(bufCreateInfo, srcData.data());
+	auto dstLayerSize = static_cast<DeviceSize>(width) * height * dstPixelSize;
+	bufCreateInfo.size = dstLayerSize * layerCount;
+	bufCreateInfo.usageFlags = BufferUsageFlags::TransferDstBit;
+	bufCreateInfo.memoryFeatures = MemoryFeatureFlags::GPUToCPU;
+	auto readbackBuffer = context.CreateBuffer(bufCreateInfo);
+	util::ImageCreateInfo imgCreateInfo {};
+	imgCreateInfo.format = dstFormat;
+	imgCreateInfo.width = width;
+	imgCreateInfo.height = height;
+	imgCreateInfo.layers = layerCount;
+	imgCreateInfo.usage = ImageUsageFlags::TransferDstBit | ImageUsageFlags::TransferSrcBit;
+	imgCreateInfo.memoryFeatures = MemoryFeatureFlags::DeviceLocal;
+	imgCreateInfo.postCreateLayout = ImageLayout::Undefined;
+	auto img = context.CreateImage(imgCreateInfo);
+	if(!srcBuffer || !readbackBuffer || !img)
+		return result;
+
+	uint32_t queueFamilyIndex;
+	auto cmd = context.AllocatePrimaryLevelCommandBuffer(QueueFamilyType::Universal, queueFamilyIndex);
+	if(!cmd || !cmd->StartRecording(true, false))
+		return result;
+	auto resources = converter->RecordConvertImage(*cmd, conversion, *srcBuffer, srcLayerStride, *img, ImageLayout::TransferSrcOptimal);
+	if(!resources) {
+		cmd->StopRecording();
+		return result;
+	}
+	for(auto iLayer = decltype(layerCount) {0u}; iLayer < layerCount; ++iLayer) {
+		util::BufferImageCopyInfo copyInfo {};
+		copyInfo.baseArrayLayer = iLayer;
+		copyInfo.bufferOffset = iLayer * dstLayerSize;
+		cmd->RecordCopyImageToBuffer(copyInfo, *img, ImageLayout::TransferSrcOptimal, *readbackBuffer);
+	}
+	context.FlushCommandBuffer(*cmd);
+
+	std::vector<uint8_t> gpuData(dstLayerSize * layerCount);
+	if(!readbackBuffer->Read(0, gpuData.size(), gpuData.data()))
+		return result;
+	std::vector<uint8_t> cpuData(dstLayerSize);
+	for(auto iLayer = decltype(layerCount) {0u}; iLayer < layerCount; ++iLayer) {
+		util::convert_image(conversion, srcData.data() + iLayer * srcLayerStride, cpuData.data(), width, height);
+		auto *gpuLayerData = gpuData.data() + iLayer * dstLayerSize;
+		for(auto i = decltype(dstLayerSize) {0u}; i < dstLayerSize; i += dstPixelSize) {
+			if(memcmp(cpuData.data() + i, gpuLayerData + i, dstPixelSize) != 0)
+				++result.mismatchedPixels;
+		}
+	}
+	result.pixelCount = static_cast<uint64_t>(width) * height * layerCount;
+	result.executed = true;
+	return result;
+}
+
+GpuFormatConverter::Stats GpuFormatConverter::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_stats;
+}
@@ -36,15 +36,13 @@ std::shared_ptr<VlkImage> VlkImage::Create(IPrContext &context, std::unique_ptr<
 		img->GetContext().ReleaseResource<VlkImage>(img);
 	});
 }
-static std::mutex g_memAllocMutex {};
-std::mutex &get_mem_alloc_mutex() { return g_memAllocMutex; }
 VlkImage::VlkImage(IPrContext &context, std::unique_ptr<Anvil::Image, std::function<void(Anvil::Image *)>> img, const prosper::util::ImageCreateInfo &createInfo, bool isSwapchainImage) : IImage {context, createInfo}, m_image {std::move(img)}, m_swapchainImage {isSwapchainImage}
 {
 	if(m_swapchainImage)
 		return;
-	g_memAllocMutex.lock();
-	m_image->get_image(); // This will invoke memory allocation and is not thread-safe!
-	g_memAllocMutex.unlock();
+	// This will invoke the memory allocation. The memory allocator is created with the thread-safety of the device
+	// (ENABLE_ANVIL_THREAD_SAFETY) and VMA is internally synchronized, so no additional lock is required.
+	m_image->get_image();
 
 	if(prosper::debug::is_debug_mode_enabled()) {
 		s_imageMapMutex.lock();
@@ -53,6 +51,9 @@ VlkImage::VlkImage(IPrContext &context, std::unique_ptr<Anvil::Image, std::funct
 		(*s_imageMap)[m_image.get()] = this;
 		s_imageMapMutex.unlock();
 	}
+	// Has to match the usage the image was created with (see create_anvil_create_info)
+	m_hostImageCopy = static_cast<VlkContext &>(context).IsHostImageCopySupported(createInfo);
+	m_hostLayout = createInfo.postCreateLayout;
 	prosper::debug::register_debug_object(m_image->get_image(), *this, prosper::debug::ObjectType::Image);
 	MemoryTracker::GetInstance().AddResource(*this);
 	if(GetContext().IsValidationEnabled())
@@ -101,8 +102,121 @@ std::optional<prosper::util::SubresourceLayout> VlkImage::GetSubresourceLayout(u
 	return reinterpret_cast<prosper::util::SubresourceLayout &>(subresourceLayout);
 }
 
+ImageLayout VlkImage::GetHostLayout() const
+{
+	std::scoped_lock lock {m_hostLayoutMutex};
+	return m_hostLayout;
+}
+void VlkImage::SetHostLayout(ImageLayout layout)
+{
+	std::scoped_lock lock {m_hostLayoutMutex};
+	m_hostLayout = layout;
+}
+
+bool VlkImage::TransitionLayoutOnHost(ImageLayout newLayout)
+{
+	std::scoped_lock lock {m_hostLayoutMutex};
+	return DoTransitionLayoutOnHost(newLayout);
+}
+bool VlkImage::DoTransitionLayoutOnHost(ImageLayout newLayout)
+{
+	if(!m_hostImageCopy)
+		return false;
+	if(newLayout == m_hostLayout)
+		return true;
+	auto &context = static_cast<VlkContext &>(GetContext());
+	if(!context.IsHostImageCopyDstLayout(newLayout))
+		return false;
+	if(m_hostLayout != ImageLayout::Undefined && m_hostLayout != ImageLayout::Preinitialized && !context.IsHostImageCopySrcLayout(m_hostLayout))
+		return false;
+	VkHostImageLayoutTransitionInfoEXT transitionInfo {VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT};
+	transitionInfo.image = m_image->get_image();
+	transitionInfo.oldLayout = static_cast<VkImageLayout>(m_hostLayout);
+	transitionInfo.newLayout = static_cast<VkImageLayout>(newLayout);
+	transitionInfo.subresourceRange = {static_cast<VkImageAspectFlags>(util::get_aspect_mask(*this)), 0, GetMipmapCount(), 0, GetLayerCount()};
+	if(context.GetHostImageCopyFunctions().vkTransitionImageLayoutEXT(context.GetDevice().get_device_vk(), 1, &transitionInfo) != VK_SUCCESS)
+		return false;
+	m_hostLayout = newLayout;
+	return true;
+}
+
+// Size of the depth part and offset of the stencil byte of a texel of a combined depth/stencil format in host memory
+static std::optional<std::pair<uint32_t, uint32_t>> get_depth_stencil_texel_layout(Format format)
+{
+	switch(static_cast<VkFormat>(format)) {
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+		return std::pair {2u, 2u};
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		// The depth aspect is copied as X8_D24, so the whole texel can be passed, the stencil bits are ignored
+		return std::pair {4u, 3u};
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return std::pair {4u, 4u};
+	default:
+		break;
+	}
+	return {};
+}
+
+bool VlkImage::CopyFromMemory(const void *data, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rowLength)
+{
+	auto aspect = util::get_aspect_mask(*this);
+	auto depthStencil = (pragma::math::is_flag_set(aspect, ImageAspectFlags::DepthBit) && pragma::math::is_flag_set(aspect, ImageAspectFlags::StencilBit)) ? get_depth_stencil_texel_layout(GetFormat()) : std::nullopt;
+	if(!depthStencil)
+		return CopyFromMemory(data, aspect, mipLevel, baseLayer, layerCount, x, y, w, h, rowLength);
+	// Only one aspect can be written at a time, so the interleaved texels are split into their depth and stencil parts
+	auto [depthSize, stencilOffset] = *depthStencil;
+	auto texelSize = prosper::util::get_byte_size(GetFormat());
+	auto numTexels = static_cast<size_t>((rowLength > 0) ? rowLength : w) * h * layerCount;
+	std::vector<uint8_t> depthData(numTexels * depthSize);
+	std::vector<uint8_t> stencilData(numTexels);
+	auto *src = static_cast<const uint8_t *>(data);
+	for(auto i = decltype(numTexels) {0u}; i < numTexels; ++i) {
+		memcpy(depthData.data() + i * depthSize, src + i * texelSize, depthSize);
+		stencilData[i] = src[i * texelSize + stencilOffset];
+	}
+	return CopyFromMemory(depthData.data(), ImageAspectFlags::DepthBit, mipLevel, baseLayer, layerCount, x, y, w, h, rowLength) && CopyFromMemory(stencilData.data(), ImageAspectFlags::StencilBit, mipLevel, baseLayer, layerCount, x, y, w, h, rowLength);
+}
+
+bool VlkImage::CopyFromMemory(const void *data, ImageAspectFlags aspect, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rowLength)
+{
+	if(!m_hostImageCopy)
+		return false;
+	auto &context = static_cast<VlkContext &>(GetContext());
+	std::scoped_lock lock {m_hostLayoutMutex};
+	// Images that are still in their initial (undefined) layout, or in a layout host copies can't write to, are transitioned on the host first
+	if(!context.IsHostImageCopyDstLayout(m_hostLayout)) {
+		auto &createInfo = GetCreateInfo();
+		auto preferredLayout = (createInfo.postCreateLayout != ImageLayout::Undefined) ? createInfo.postCreateLayout : ImageLayout::ShaderReadOnlyOptimal;
+		if(!DoTransitionLayoutOnHost(context.GetHostImageCopyDstLayout(preferredLayout)))
+			return false;
+	}
+	VkMemoryToImageCopyEXT region {VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT};
+	region.pHostPointer = data;
+	region.memoryRowLength = rowLength;
+	region.memoryImageHeight = 0;
+	region.imageSubresource.aspectMask = static_cast<VkImageAspectFlags>(aspect);
+	region.imageSubresource.mipLevel = mipLevel;
+	region.imageSubresource.baseArrayLayer = baseLayer;
+	region.imageSubresource.layerCount = layerCount;
+	region.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y), 0};
+	region.imageExtent = {w, h, 1};
+
+	VkCopyMemoryToImageInfoEXT copyInfo {VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT};
+	copyInfo.dstImage = m_image->get_image();
+	copyInfo.dstImageLayout = static_cast<VkImageLayout>(m_hostLayout);
+	copyInfo.regionCount = 1;
+	copyInfo.pRegions = &region;
+	return context.GetHostImageCopyFunctions().vkCopyMemoryToImageEXT(context.GetDevice().get_device_vk(), &copyInfo) == VK_SUCCESS;
+}
+
 bool VlkImage::WriteImageData(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t layerIndex, uint32_t mipLevel, uint64_t size, const uint8_t *data)
 {
+	// Optimally tiled images can be written directly if they were created with host transfer usage (see VlkImage::GetHostLayout for the
+	// layout the image is expected to be in). Otherwise the image has to be linear and host-visible.
+	if(m_hostImageCopy && h > 0) {
+		auto rowLength = util::is_compressed_format(GetFormat()) ? 0u : static_cast<uint32_t>((size / h) / prosper::util::get_byte_size(GetFormat()));
+		return CopyFromMemory(data, mipLevel, layerIndex, 1, x, y, w, h, rowLength);
+	}
 	auto layout = GetSubresourceLayout(layerIndex, mipLevel);
 	if(layout.has_value() == false)
 		return false;
@@ -122,7 +236,32 @@ bool VlkImage::WriteImageData(uint32_t x, uint32_t y, uint32_t w, uint32_t h, ui
 	return Unmap();
 }
 
-bool VlkImage::DoSetMemoryBuffer(prosper::IBuffer &buffer) { return m_image->set_memory(buffer.GetAPITypeRef<VlkBuffer>().GetAnvilBuffer().get_memory_block(0)); }
+bool VlkImage::DoSetMemoryBuffer(prosper::IBuffer &buffer)
+{
+	if(!m_image->set_memory(buffer.GetAPITypeRef<VlkBuffer>().GetAnvilBuffer().get_memory_block(0)))
+		return false;
+	MemoryTracker::GetInstance().UpdateResource(*this);
+	return true;
+}
+
+std::shared_ptr<prosper::IImageView> VlkImage::FindCachedView(const ViewCacheKey &key) const
+{
+	std::scoped_lock lock {m_viewCacheMutex};
+	auto it = std::find_if(m_viewCache.begin(), m_viewCache.end(), [&key](const std::pair<ViewCacheKey, std::weak_ptr<IImageView>> &pair) { return pair.first == key; });
+	return (it != m_viewCache.end()) ? it->second.lock() : nullptr;
+}
+
+std::shared_ptr<prosper::IImageView> VlkImage::AddCachedView(const ViewCacheKey &key, const std::shared_ptr<IImageView> &view)
+{
+	std::scoped_lock lock {m_viewCacheMutex};
+	// Drop the entries of views that have since been released
+	m_viewCache.erase(std::remove_if(m_viewCache.begin(), m_viewCache.end(), [](const std::pair<ViewCacheKey, std::weak_ptr<IImageView>> &pair) { return pair.second.expired(); }), m_viewCache.end());
+	auto it = std::find_if(m_viewCache.begin(), m_viewCache.end(), [&key](const std::pair<ViewCacheKey, std::weak_ptr<IImageView>> &pair) { return pair.first == key; });
+	if(it != m_viewCache.end())
+		return it->second.lock();
+	m_viewCache.push_back({key, view});
+	return view;
+}
 
 Anvil::Image &VlkImage::GetAnvilImage() const { return *m_image; }
 Anvil::Image &VlkImage::operator*() { return *m_image; }
@@ -12,6 +12,9 @@ import :image.view;
 
 using namespace prosper;
 
+static std::atomic<uint32_t> g_liveViewCount = 0;
+uint32_t VlkImageView::GetLiveViewCount() { return g_liveViewCount; }
+
 std::shared_ptr<VlkImageView> VlkImageView::Create(IPrContext &context, IImage &img, const prosper::util::ImageViewCreateInfo &createInfo, ImageViewType type, ImageAspectFlags aspectFlags, Anvil::ImageViewUniquePtr imgView, const std::function<void(IImageView &)> &onDestroyedCallback)
 {
 	if(imgView == nullptr)
@@ -31,12 +34,14 @@ VlkImageView::VlkImageView(IPrContext &context, IImage &img, const prosper::util
 	if(GetContext().IsValidationEnabled())
 		VlkDebugObject::Init(GetContext(), debug::ObjectType::ImageView, GetInternalHandle());
 	prosper::debug::register_debug_object(m_imageView->get_image_view(), *this, prosper::debug::ObjectType::ImageView);
+	++g_liveViewCount;
 }
 VlkImageView::~VlkImageView()
 {
 	if(GetContext().IsValidationEnabled())
 		VlkDebugObject::Clear(GetContext(), debug::ObjectType::ImageView, GetInternalHandle());
 	prosper::debug::deregister_debug_object(m_imageView->get_image_view());
+	--g_liveViewCount;
 }
 void VlkImageView::Bake() { GetAnvilImageView().get_image_view(); }
 Anvil::ImageView &VlkImageView::GetAnvilImageView() const { return *m_imageView; }
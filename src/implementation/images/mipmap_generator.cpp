@@ -0,0 +1,515 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/device.h>
+#include <wrappers/image.h>
+#include <wrappers/shader_module.h>
+#include <misc/glsl_to_spirv.h>
+
+module pragma.prosper.vulkan;
+
+import :image.mipmap_generator;
+
+using namespace prosper;
+
+static constexpr uint32_t DESCRIPTOR_POOL_SIZE = 32;
+static constexpr uint32_t TILE_SIZE = 64;
+
+static constexpr const char *DOWNSAMPLE_SHADER_SOURCE = R"(#version 450
+layout(local_size_x = 256) in;
+
+layout(constant_id = 0) const uint FILTER = 0; // 0 = Average, 1 = Min, 2 = Max
+
+layout(set = 0, binding = 0, IMAGE_FORMAT) uniform readonly image2DArray u_mip0;
+layout(set = 0, binding = 1, IMAGE_FORMAT) uniform writeonly image2DArray u_mips[12]; // Mipmaps 1 to 12
+// Mipmap 6 is written by all workgroups and read by the last one
+layout(set = 0, binding = 2, IMAGE_FORMAT) uniform coherent image2DArray u_mip6;
+layout(std430, set = 0, binding = 3) coherent buffer Counters { uint counters[]; } u_counters;
+
+layout(push_constant) uniform PushConstants {
+	uint numMips; // Number of mipmaps to generate, excluding mipmap 0
+	uint numWorkGroups; // Per layer
+	uint width;
+	uint height;
+} u_pushConstants;
+
+shared vec4 s_a[32 * 32];
+shared vec4 s_b[16 * 16];
+shared bool s_isLastWorkGroup;
+
+vec4 reduce(vec4 a, vec4 b, vec4 c, vec4 d)
+{
+	if(FILTER == 1)
+		return min(min(a, b), min(c, d));
+	if(FILTER == 2)
+		return max(max(a, b), max(c, d));
+	return (a + b + c + d) * 0.25;
+}
+
+ivec2 get_mip_size(uint mip) { return ivec2(max(uvec2(u_pushConstants.width, u_pushConstants.height) >> mip, uvec2(1))); }
+
+// Indexing the image array with a constant in every branch avoids requiring shaderStorageImageArrayDynamicIndexing
+void store(uint mip, ivec2 coord, uint layer, vec4 value)
+{
+	if(mip > u_pushConstants.numMips || any(greaterThanEqual(coord, get_mip_size(mip))))
+		return;
+	ivec3 c = ivec3(coord, layer);
+	switch(mip) {
+	case 1u: imageStore(u_mips[0], c, value); break;
+	case 2u: imageStore(u_mips[1], c, value); break;
+	case 3u: imageStore(u_mips[2], c, value); break;
+	case 4u: imageStore(u_mips[3], c, value); break;
+	case 5u: imageStore(u_mips[4], c, value); break;
+	case 6u: imageStore(u_mip6, c, value); break;
+	case 7u: imageStore(u_mips[6], c, value); break;
+	case 8u: imageStore(u_mips[7], c, value); break;
+	case 9u: imageStore(u_mips[8], c, value); break;
+	case 10u: imageStore(u_mips[9], c, value); break;
+	case 11u: imageStore(u_mips[10], c, value); break;
+	case 12u: imageStore(u_mips[11], c, value); break;
+	}
+}
+
+// Out-of-bounds reads are clamped to the edge, which handles non-power-of-two extents
+vec4 load_source(bool fromMip6, ivec2 coord, uint layer)
+{
+	ivec2 size = get_mip_size(fromMip6 ? 6 : 0);
+	ivec3 c = ivec3(clamp(coord, ivec2(0), size - 1), layer);
+	return fromMip6 ? imageLoad(u_mip6, c) : imageLoad(u_mip0, c);
+}
+
+vec4 reduce_shared_a(uint srcStride, ivec2 srcCoord)
+{
+	uint idx = srcCoord.y * srcStride + srcCoord.x;
+	return reduce(s_a[idx], s_a[idx + 1], s_a[idx + srcStride], s_a[idx + srcStride + 1]);
+}
+vec4 reduce_shared_b(uint srcStride, ivec2 srcCoord)
+{
+	uint idx = srcCoord.y * srcStride + srcCoord.x;
+	return reduce(s_b[idx], s_b[idx + 1], s_b[idx + srcStride], s_b[idx + srcStride + 1]);
+}
+
+// Reduces a 64x64 tile of the base mipmap (0 or 6) to the next six mipmaps
+void downsample_tile(bool fromMip6, ivec2 tile, uint layer, uint localIdx)
+{
+	uint baseMip = fromMip6 ? 6 : 0;
+	for(uint i = 0; i < 4; ++i) {
+		uint idx = localIdx + i * 256;
+		ivec2 local = ivec2(idx % 32, idx / 32);
+		ivec2 src = tile * 64 + local * 2;
+		vec4 v = reduce(load_source(fromMip6, src, layer), load_source(fromMip6, src + ivec2(1, 0), layer), load_source(fromMip6, src + ivec2(0, 1), layer), load_source(fromMip6, src + ivec2(1, 1), layer));
+		store(baseMip + 1, tile * 32 + local, layer, v);
+		s_a[idx] = v;
+	}
+	barrier();
+	{
+		ivec2 local = ivec2(localIdx % 16, localIdx / 16);
+		vec4 v = reduce_shared_a(32, local * 2);
+		store(baseMip + 2, tile * 16 + local, layer, v);
+		s_b[localIdx] = v;
+	}
+	barrier();
+	if(localIdx < 64) {
+		ivec2 local = ivec2(localIdx % 8, localIdx / 8);
+		vec4 v = reduce_shared_b(16, local * 2);
+		store(baseMip + 3, tile * 8 + local, layer, v);
+		s_a[localIdx] = v;
+	}
+	barrier();
+	if(localIdx < 16) {
+		ivec2 local = ivec2(localIdx % 4, localIdx / 4);
+		vec4 v = reduce_shared_a(8, local * 2);
+		store(baseMip + 4, tile * 4 + local, layer, v);
+		s_b[localIdx] = v;
+	}
+	barrier();
+	if(localIdx < 4) {
+		ivec2 local = ivec2(localIdx % 2, localIdx / 2);
+		vec4 v = reduce_shared_b(4, local * 2);
+		store(baseMip + 5, tile * 2 + local, layer, v);
+		s_a[localIdx] = v;
+	}
+	barrier();
+	if(localIdx == 0)
+		store(baseMip + 6, tile, layer, reduce_shared_a(2, ivec2(0)));
+}
+
+void main()
+{
+	uint layer = gl_WorkGroupID.z;
+	uint localIdx = gl_LocalInvocationIndex;
+	downsample_tile(false, ivec2(gl_WorkGroupID.xy), layer, localIdx);
+	if(u_pushConstants.numMips <= 6)
+		return;
+
+	if(localIdx == 0) {
+		// Makes the mipmap 6 texel of this workgroup visible to the last workgroup
+		memoryBarrierImage();
+		s_isLastWorkGroup = atomicAdd(u_counters.counters[layer], 1) == u_pushConstants.numWorkGroups - 1;
+	}
+	barrier();
+	if(!s_isLastWorkGroup)
+		return;
+	// Reset for the next dispatch
+	if(localIdx == 0)
+		u_counters.counters[layer] = 0;
+	memoryBarrierImage();
+	downsample_tile(true, ivec2(0), layer, localIdx);
+}
+)";
+
+struct DownsamplePushConstants {
+	uint32_t numMips;
+	uint32_t numWorkGroups;
+	uint32_t width;
+	uint32_t height;
+};
+
+static const char *get_glsl_image_format(VkFormat format)
+{
+	switch(format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return "rgba8";
+	case VK_FORMAT_R8G8B8A8_SNORM:
+		return "rgba8_snorm";
+	case VK_FORMAT_R8G8_UNORM:
+		return "rg8";
+	case VK_FORMAT_R8_UNORM:
+		return "r8";
+	case VK_FORMAT_R16G16B16A16_UNORM:
+		return "rgba16";
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return "rgba16f";
+	case VK_FORMAT_R16G16_SFLOAT:
+		return "rg16f";
+	case VK_FORMAT_R16_SFLOAT:
+		return "r16f";
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return "rgba32f";
+	case VK_FORMAT_R32G32_SFLOAT:
+		return "rg32f";
+	case VK_FORMAT_R32_SFLOAT:
+		return "r32f";
+	case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		return "r11f_g11f_b10f";
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		return "rgb10_a2";
+	}
+	return nullptr;
+}
+
+static void record_mipmap_barrier(ICommandBuffer &cmd, IImage &img, uint32_t baseMip, uint32_t numMips, ImageLayout oldLayout, ImageLayout newLayout, AccessFlags srcAccessMask, AccessFlags dstAccessMask, PipelineStageFlags srcStageMask, PipelineStageFlags dstStageMask)
+{
+	prosper::util::ImageBarrierInfo imgBarrierInfo {};
+	imgBarrierInfo.srcAccessMask = srcAccessMask;
+	imgBarrierInfo.dstAccessMask = dstAccessMask;
+	imgBarrierInfo.oldLayout = oldLayout;
+	imgBarrierInfo.newLayout = newLayout;
+	imgBarrierInfo.subresourceRange = {baseMip, numMips, 0, img.GetLayerCount()};
+	imgBarrierInfo.srcQueueFamilyIndex = imgBarrierInfo.dstQueueFamilyIndex = img.GetContext().GetUniversalQueueFamilyIndex();
+
+	prosper::util::PipelineBarrierInfo barrierInfo {};
+	barrierInfo.srcStageMask = srcStageMask;
+	barrierInfo.dstStageMask = dstStageMask;
+	barrierInfo.imageBarriers.push_back(prosper::util::create_image_barrier(img, imgBarrierInfo));
+	cmd.RecordPipelineBarrier(barrierInfo);
+}
+
+namespace {
+	struct DownsampleResources {
+		VkDevice device = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		std::vector<VkImageView> imageViews;
+		std::shared_ptr<IBuffer> counterBuffer;
+		std::function<void(VkDescriptorPool, VkDescriptorSet)> freeDescriptorSet;
+		~DownsampleResources()
+		{
+			if(descriptorSet != VK_NULL_HANDLE)
+				freeDescriptorSet(descriptorPool, descriptorSet);
+			for(auto view : imageViews)
+				vkDestroyImageView(device, view, nullptr);
+		}
+	};
+};
+
+std::unique_ptr<MipmapGenerator> MipmapGenerator::Create(VlkContext &context)
+{
+	auto generator = std::unique_ptr<MipmapGenerator> {new MipmapGenerator {context}};
+	if(!generator->Initialize())
+		return nullptr;
+	return generator;
+}
+
+MipmapGenerator::MipmapGenerator(VlkContext &context) : m_context {context}, m_device {context.GetDevice().get_device_vk()} {}
+
+MipmapGenerator::~MipmapGenerator()
+{
+	for(auto &[key, pipeline] : m_pipelines)
+		vkDestroyPipeline(m_device, pipeline, nullptr);
+	for(auto pool : m_descriptorPools)
+		vkDestroyDescriptorPool(m_device, pool, nullptr);
+	if(m_pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+	if(m_descriptorSetLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+bool MipmapGenerator::Initialize()
+{
+	std::array<VkDescriptorSetLayoutBinding, 4> bindings {};
+	bindings[0] = {0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	bindings[1] = {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_MIPMAPS_PER_DISPATCH, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	bindings[2] = {2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	bindings[3] = {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	VkDescriptorSetLayoutCreateInfo dsLayoutCreateInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+	dsLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	dsLayoutCreateInfo.pBindings = bindings.data();
+	if(vkCreateDescriptorSetLayout(m_device, &dsLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+		return false;
+
+	VkPushConstantRange pushConstantRange {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConstants)};
+	VkPipelineLayoutCreateInfo layoutCreateInfo {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+	layoutCreateInfo.setLayoutCount = 1;
+	layoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+	layoutCreateInfo.pushConstantRangeCount = 1;
+	layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	return vkCreatePipelineLayout(m_device, &layoutCreateInfo, nullptr, &m_pipelineLayout) == VK_SUCCESS;
+}
+
+bool MipmapGenerator::IsSinglePassSupported(const IImage &img) const
+{
+	auto extents = img.GetExtents();
+	if(extents.width > MAX_SINGLE_PASS_EXTENT || extents.height > MAX_SINGLE_PASS_EXTENT || img.GetCreateInfo().samples != SampleCountFlags::e1Bit)
+		return false;
+	if(!pragma::math::is_flag_set(img.GetCreateInfo().usage, ImageUsageFlags::StorageBit) || !get_glsl_image_format(static_cast<VkFormat>(img.GetFormat())))
+		return false;
+	return m_context.IsStorageImageFormatSupported(img.GetFormat());
+}
+
+VkPipeline MipmapGenerator::GetPipeline(const PipelineKey &key)
+{
+	auto it = std::find_if(m_pipelines.begin(), m_pipelines.end(), [&key](const std::pair<PipelineKey, VkPipeline> &pair) { return pair.first == key; });
+	if(it != m_pipelines.end())
+		return it->second;
+
+	std::string source = DOWNSAMPLE_SHADER_SOURCE;
+	auto versionEnd = source.find('\n') + 1;
+	source.insert(versionEnd, std::string {"#define IMAGE_FORMAT "} + get_glsl_image_format(static_cast<VkFormat>(key.format)) + "\n");
+
+	auto &dev = m_context.GetDevice();
+	auto generator = Anvil::GLSLShaderToSPIRVGenerator::create(&dev, Anvil::GLSLShaderToSPIRVGenerator::MODE_USE_SPECIFIED_SOURCE, source, static_cast<Anvil::ShaderStage>(prosper::ShaderStage::Compute));
+	if(generator == nullptr || generator->get_spirv_blob_size() == 0u) {
+		m_context.Log("Failed to compile mipmap downsampling shader: " + (generator ? generator->get_shader_info_log() : std::string {}), pragma::util::LogSeverity::Error);
+		return VK_NULL_HANDLE;
+	}
+	auto shaderModule = Anvil::ShaderModule::create_from_spirv_generator(&dev, generator.get());
+	if(shaderModule == nullptr)
+		return VK_NULL_HANDLE;
+
+	uint32_t filter = pragma::math::to_integral(key.filter);
+	VkSpecializationMapEntry specEntry {0, 0, sizeof(filter)};
+	VkSpecializationInfo specInfo {1, &specEntry, sizeof(filter), &filter};
+
+	VkComputePipelineCreateInfo createInfo {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+	createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	createInfo.stage.module = shaderModule->get_module();
+	createInfo.stage.pName = "main";
+	createInfo.stage.pSpecializationInfo = &specInfo;
+	createInfo.layout = m_pipelineLayout;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	m_pipelines.push_back({key, pipeline});
+	return pipeline;
+}
+
+VkDescriptorSet MipmapGenerator::AllocateDescriptorSet(VkDescriptorPool &outPool)
+{
+	VkDescriptorSetAllocateInfo allocInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
+	VkDescriptorSet descSet = VK_NULL_HANDLE;
+	for(auto pool : m_descriptorPools) {
+		allocInfo.descriptorPool = pool;
+		if(vkAllocateDescriptorSets(m_device, &allocInfo, &descSet) == VK_SUCCESS) {
+			outPool = pool;
+			return descSet;
+		}
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes {VkDescriptorPoolSize {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DESCRIPTOR_POOL_SIZE * (MAX_MIPMAPS_PER_DISPATCH + 2)}, VkDescriptorPoolSize {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SIZE}};
+	VkDescriptorPoolCreateInfo poolCreateInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = DESCRIPTOR_POOL_SIZE;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if(vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, &pool) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	m_descriptorPools.push_back(pool);
+	allocInfo.descriptorPool = pool;
+	if(vkAllocateDescriptorSets(m_device, &allocInfo, &descSet) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	outPool = pool;
+	return descSet;
+}
+
+void MipmapGenerator::FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descSet)
+{
+	std::scoped_lock lock {m_mutex};
+	vkFreeDescriptorSets(m_device, pool, 1, &descSet);
+}
+
+bool MipmapGenerator::ReserveCounters(uint32_t layerCount)
+{
+	if(layerCount <= m_counterCapacity)
+		return true;
+	// The counters have to start out at zero; The shader resets them after every dispatch
+	std::vector<uint32_t> zeroes(layerCount, 0);
+	prosper::util::BufferCreateInfo createInfo {};
+	createInfo.size = zeroes.size() * sizeof(zeroes.front());
+	createInfo.usageFlags = BufferUsageFlags::StorageBufferBit;
+	createInfo.memoryFeatures = MemoryFeatureFlags::CPUToGPU;
+	auto buffer = m_context.CreateBuffer(createInfo, zeroes.data());
+	if(!buffer)
+		return false;
+	// Previously recorded dispatches hold their own reference to the old buffer
+	m_counterBuffer = std::move(buffer);
+	m_counterCapacity = layerCount;
+	return true;
+}
+
+bool MipmapGenerator::RecordGenerateMipmaps(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout, std::shared_ptr<void> &outResources, Filter filter)
+{
+	outResources = nullptr;
+	if(img.GetMipmapCount() <= 1)
+		return true;
+	if(IsSinglePassSupported(img)) {
+		outResources = RecordSinglePass(cmd, img, currentLayout, srcAccessMask, srcStageMask, finalLayout, filter);
+		if(outResources)
+			return true;
+	}
+	if(filter != Filter::Average)
+		return false;
+	return RecordBlitChain(cmd, img, currentLayout, srcAccessMask, srcStageMask, finalLayout);
+}
+
+std::shared_ptr<void> MipmapGenerator::RecordSinglePass(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout, Filter filter)
+{
+	auto extents = img.GetExtents();
+	auto numLayers = img.GetLayerCount();
+	auto numMips = pragma::math::min(img.GetMipmapCount() - 1, MAX_MIPMAPS_PER_DISPATCH);
+	auto resources = std::make_shared<DownsampleResources>();
+	resources->device = m_device;
+	resources->freeDescriptorSet = [this](VkDescriptorPool pool, VkDescriptorSet descSet) { FreeDescriptorSet(pool, descSet); };
+	VkPipeline pipeline;
+	{
+		std::scoped_lock lock {m_mutex};
+		pipeline = GetPipeline({img.GetFormat(), filter});
+		if(pipeline == VK_NULL_HANDLE || !ReserveCounters(numLayers))
+			return nullptr;
+		resources->descriptorSet = AllocateDescriptorSet(resources->descriptorPool);
+		resources->counterBuffer = m_counterBuffer;
+	}
+	if(resources->descriptorSet == VK_NULL_HANDLE)
+		return nullptr;
+
+	// One view per mipmap, covering all layers
+	auto vkImage = static_cast<VlkImage &>(img).GetAnvilImage().get_image();
+	resources->imageViews.reserve(numMips + 1);
+	for(auto mip = decltype(numMips) {0u}; mip <= numMips; ++mip) {
+		VkImageViewCreateInfo viewCreateInfo {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+		viewCreateInfo.image = vkImage;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCreateInfo.format = static_cast<VkFormat>(img.GetFormat());
+		viewCreateInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, numLayers};
+		VkImageView view;
+		if(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &view) != VK_SUCCESS)
+			return nullptr;
+		resources->imageViews.push_back(view);
+	}
+
+	// Unused slots are filled with the last mipmap; The shader never writes to them
+	auto getView = [&resources, numMips](uint32_t mip) { return resources->imageViews[pragma::math::min(mip, numMips)]; };
+	VkDescriptorImageInfo mip0Info {VK_NULL_HANDLE, getView(0), VK_IMAGE_LAYOUT_GENERAL};
+	std::array<VkDescriptorImageInfo, MAX_MIPMAPS_PER_DISPATCH> mipInfos {};
+	for(auto i = decltype(mipInfos.size()) {0u}; i < mipInfos.size(); ++i)
+		mipInfos[i] = {VK_NULL_HANDLE, getView(static_cast<uint32_t>(i) + 1), VK_IMAGE_LAYOUT_GENERAL};
+	VkDescriptorImageInfo mip6Info {VK_NULL_HANDLE, getView(6), VK_IMAGE_LAYOUT_GENERAL};
+	auto &counterBuffer = resources->counterBuffer->GetAPITypeRef<VlkBuffer>();
+	VkDescriptorBufferInfo counterInfo {counterBuffer.GetVkBuffer(), resources->counterBuffer->GetStartOffset(), numLayers * sizeof(uint32_t)};
+	std::array<VkWriteDescriptorSet, 4> writes {};
+	for(auto i = decltype(writes.size()) {0u}; i < writes.size(); ++i) {
+		auto &write = writes[i];
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = resources->descriptorSet;
+		write.dstBinding = static_cast<uint32_t>(i);
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	}
+	writes[0].pImageInfo = &mip0Info;
+	writes[1].pImageInfo = mipInfos.data();
+	writes[1].descriptorCount = static_cast<uint32_t>(mipInfos.size());
+	writes[2].pImageInfo = &mip6Info;
+	writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[3].pBufferInfo = &counterInfo;
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	auto numMipsTotal = img.GetMipmapCount();
+	record_mipmap_barrier(cmd, img, 0, 1, currentLayout, ImageLayout::General, srcAccessMask, AccessFlags::ShaderReadBit, srcStageMask, PipelineStageFlags::ComputeShaderBit);
+	record_mipmap_barrier(cmd, img, 1, numMipsTotal - 1, ImageLayout::Undefined, ImageLayout::General, AccessFlags {}, AccessFlags::ShaderWriteBit, PipelineStageFlags::TopOfPipeBit, PipelineStageFlags::ComputeShaderBit);
+
+	auto vkCmd = cmd.GetAPITypeRef<VlkCommandBuffer>().GetVkCommandBuffer();
+	// Previous dispatches that use the same counters have to be complete, since the counters are only reset by the last workgroup
+	VkMemoryBarrier counterBarrier {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+	counterBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vkCmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+	auto numWorkGroupsX = (extents.width + TILE_SIZE - 1) / TILE_SIZE;
+	auto numWorkGroupsY = (extents.height + TILE_SIZE - 1) / TILE_SIZE;
+	DownsamplePushConstants pushConstants {numMips, numWorkGroupsX * numWorkGroupsY, extents.width, extents.height};
+	vkCmdBindPipeline(vkCmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(vkCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &resources->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(vkCmd, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(vkCmd, numWorkGroupsX, numWorkGroupsY, numLayers);
+
+	// Mipmaps beyond MAX_MIPMAPS_PER_DISPATCH can't exist, since the extent is limited to MAX_SINGLE_PASS_EXTENT
+	record_mipmap_barrier(cmd, img, 0, numMipsTotal, ImageLayout::General, finalLayout, AccessFlags::ShaderWriteBit, AccessFlags::ShaderReadBit | AccessFlags::TransferReadBit, PipelineStageFlags::ComputeShaderBit, PipelineStageFlags::AllCommands);
+	return resources;
+}
+
+bool MipmapGenerator::RecordBlitChain(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout)
+{
+	constexpr auto transferUsage = ImageUsageFlags::TransferSrcBit | ImageUsageFlags::TransferDstBit;
+	if((img.GetCreateInfo().usage & transferUsage) != transferUsage)
+		return false;
+	constexpr VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if((m_context.GetFormatProperties(img.GetFormat()).optimal_tiling_capabilities.get_vk() & blitFeatures) != blitFeatures)
+		return false;
+	auto extents = img.GetExtents();
+	auto numLayers = img.GetLayerCount();
+	auto numMips = img.GetMipmapCount();
+	auto vkImage = static_cast<VlkImage &>(img).GetAnvilImage().get_image();
+	auto vkCmd = cmd.GetAPITypeRef<VlkCommandBuffer>().GetVkCommandBuffer();
+	record_mipmap_barrier(cmd, img, 0, 1, currentLayout, ImageLayout::TransferSrcOptimal, srcAccessMask, AccessFlags::TransferReadBit, srcStageMask, PipelineStageFlags::TransferBit);
+	record_mipmap_barrier(cmd, img, 1, numMips - 1, ImageLayout::Undefined, ImageLayout::TransferDstOptimal, AccessFlags {}, AccessFlags::TransferWriteBit, PipelineStageFlags::TopOfPipeBit, PipelineStageFlags::TransferBit);
+	for(auto mip = decltype(numMips) {1u}; mip < numMips; ++mip) {
+		if(mip > 1)
+			record_mipmap_barrier(cmd, img, mip - 1, 1, ImageLayout::TransferDstOptimal, ImageLayout::TransferSrcOptimal, AccessFlags::TransferWriteBit, AccessFlags::TransferReadBit, PipelineStageFlags::TransferBit, PipelineStageFlags::TransferBit);
+		VkImageBlit blit {};
+		blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, numLayers};
+		blit.srcOffsets[1] = {static_cast<int32_t>(util::calculate_mipmap_size(extents.width, mip - 1)), static_cast<int32_t>(util::calculate_mipmap_size(extents.height, mip - 1)), 1};
+		blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, numLayers};
+		blit.dstOffsets[1] = {static_cast<int32_t>(util::calculate_mipmap_size(extents.width, mip)), static_cast<int32_t>(util::calculate_mipmap_size(extents.height, mip)), 1};
+		vkCmdBlitImage(vkCmd, vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+	}
+	record_mipmap_barrier(cmd, img, 0, numMips - 1, ImageLayout::TransferSrcOptimal, finalLayout, AccessFlags::TransferReadBit, AccessFlags::ShaderReadBit, PipelineStageFlags::TransferBit, PipelineStageFlags::AllCommands);
+	record_mipmap_barrier(cmd, img, numMips - 1, 1, ImageLayout::TransferDstOptimal, finalLayout, AccessFlags::TransferWriteBit, AccessFlags::ShaderReadBit, PipelineStageFlags::TransferBit, PipelineStageFlags::AllCommands);
+	return true;
+}
@@ -30,10 +30,14 @@ std::shared_ptr<VlkSampler> VlkSampler::Create(IPrContext &context, const prospe
 VlkSampler::VlkSampler(IPrContext &context, const prosper::util::SamplerCreateInfo &samplerCreateInfo) : ISampler {context, samplerCreateInfo} {}
 VlkSampler::~VlkSampler()
 {
-	if(GetContext().IsValidationEnabled())
-		VlkDebugObject::Clear(GetContext(), debug::ObjectType::Sampler, GetInternalHandle());
-	if(m_sampler != nullptr)
-		prosper::debug::deregister_debug_object(m_sampler->get_sampler());
+	if(m_samplerEntry == nullptr)
+		return;
+	if(m_debugObjectOwner) {
+		if(GetContext().IsValidationEnabled())
+			VlkDebugObject::Clear(GetContext(), debug::ObjectType::Sampler, GetInternalHandle());
+		prosper::debug::deregister_debug_object(m_samplerEntry->sampler->get_sampler());
+	}
+	static_cast<VlkContext &>(GetContext()).GetSamplerCache().Release(m_samplerEntry);
 }
 void VlkSampler::Bake() { GetAnvilSampler().get_sampler(); }
 bool VlkSampler::DoUpdate()
@@ -48,25 +52,51 @@ bool VlkSampler::DoUpdate()
 		anisotropy = 0.f;
 	else if(anisotropy == std::numeric_limits<decltype(anisotropy)>::max() || anisotropy > maxDeviceAnisotropy)
 		anisotropy = maxDeviceAnisotropy;
-	auto newSampler = Anvil::Sampler::create(Anvil::SamplerCreateInfo::create(&dev, static_cast<Anvil::Filter>(createInfo.magFilter), static_cast<Anvil::Filter>(createInfo.minFilter), static_cast<Anvil::SamplerMipmapMode>(createInfo.mipmapMode),
-	  static_cast<Anvil::SamplerAddressMode>(createInfo.addressModeU), static_cast<Anvil::SamplerAddressMode>(createInfo.addressModeV), static_cast<Anvil::SamplerAddressMode>(createInfo.addressModeW), createInfo.mipLodBias, anisotropy, createInfo.compareEnable,
-	  static_cast<Anvil::CompareOp>(createInfo.compareOp), createInfo.minLod, createInfo.maxLod, static_cast<Anvil::BorderColor>(createInfo.borderColor), false //,createInfo.useUnnormalizedCoordinates
-	  ));
-	if(newSampler != nullptr) {
-		if(m_sampler != nullptr) {
-			prosper::debug::deregister_debug_object(m_sampler->get_sampler());
+	SamplerCache::Key key {};
+	key.magFilter = static_cast<VkFilter>(createInfo.magFilter);
+	key.minFilter = static_cast<VkFilter>(createInfo.minFilter);
+	key.mipmapMode = static_cast<VkSamplerMipmapMode>(createInfo.mipmapMode);
+	key.addressModes = {static_cast<VkSamplerAddressMode>(createInfo.addressModeU), static_cast<VkSamplerAddressMode>(createInfo.addressModeV), static_cast<VkSamplerAddressMode>(createInfo.addressModeW)};
+	key.mipLodBias = createInfo.mipLodBias;
+	key.maxAnisotropy = anisotropy;
+	key.compareEnable = createInfo.compareEnable;
+	key.compareOp = static_cast<VkCompareOp>(createInfo.compareOp);
+	key.minLod = createInfo.minLod;
+	key.maxLod = createInfo.maxLod;
+	key.borderColor = static_cast<VkBorderColor>(createInfo.borderColor);
+	//key.unnormalizedCoordinates = createInfo.useUnnormalizedCoordinates;
+	key.Normalize();
+
+	auto &context = static_cast<VlkContext &>(GetContext());
+	auto &cache = context.GetSamplerCache();
+	auto newSamplerCreated = false;
+	auto newEntry = cache.Acquire(context, key, &newSamplerCreated);
+	if(newEntry == nullptr)
+		return false;
+	if(newEntry == m_samplerEntry) {
+		// Sampler state hasn't changed
+		cache.Release(newEntry);
+		return true;
+	}
+	if(m_samplerEntry != nullptr) {
+		if(m_debugObjectOwner) {
+			prosper::debug::deregister_debug_object(m_samplerEntry->sampler->get_sampler());
 			if(GetContext().IsValidationEnabled())
 				VlkDebugObject::Clear(GetContext(), debug::ObjectType::Sampler, GetInternalHandle());
 		}
-		m_sampler = std::move(newSampler);
-		prosper::debug::register_debug_object(m_sampler->get_sampler(), *this, prosper::debug::ObjectType::Sampler);
+		cache.Release(m_samplerEntry);
+	}
+	m_samplerEntry = std::move(newEntry);
+	// Registering a shared sampler again would leave a dangling debug object once its owner is destroyed
+	m_debugObjectOwner = newSamplerCreated;
+	if(m_debugObjectOwner) {
+		prosper::debug::register_debug_object(m_samplerEntry->sampler->get_sampler(), *this, prosper::debug::ObjectType::Sampler);
 		Init(GetContext(), debug::ObjectType::Sampler, GetInternalHandle());
-		return true;
 	}
-	return false;
+	return true;
 }
-Anvil::Sampler &VlkSampler::GetAnvilSampler() const { return *m_sampler; }
-Anvil::Sampler &VlkSampler::operator*() { return *m_sampler; }
+Anvil::Sampler &VlkSampler::GetAnvilSampler() const { return *m_samplerEntry->sampler; }
+Anvil::Sampler &VlkSampler::operator*() { return *m_samplerEntry->sampler; }
 const Anvil::Sampler &VlkSampler::operator*() const { return const_cast<VlkSampler *>(this)->operator*(); }
-Anvil::Sampler *VlkSampler::operator->() { return m_sampler.get(); }
+Anvil::Sampler *VlkSampler::operator->() { return m_samplerEntry->sampler.get(); }
 const Anvil::Sampler *VlkSampler::operator->() const { return const_cast<VlkSampler *>(this)->operator->(); }
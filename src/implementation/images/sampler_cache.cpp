@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/sampler_create_info.h>
+#include <wrappers/device.h>
+#include <wrappers/sampler.h>
+#include <cassert>
+
+module pragma.prosper.vulkan;
+
+import :image.sampler_cache;
+
+using namespace prosper;
+
+void SamplerCache::Key::Normalize()
+{
+	if(!compareEnable)
+		compareOp = VK_COMPARE_OP_NEVER;
+	if(std::find(addressModes.begin(), addressModes.end(), VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER) == addressModes.end())
+		borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	// -0 and +0 compare equal, but don't hash equally
+	for(auto *v : {&mipLodBias, &maxAnisotropy, &minLod, &maxLod}) {
+		if(*v == 0.f)
+			*v = 0.f;
+	}
+}
+
+size_t SamplerCache::Key::Hash() const
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto hashValue = [&hash](uint32_t v) {
+		hash ^= v;
+		hash *= 1099511628211ull;
+	};
+	hashValue(magFilter);
+	hashValue(minFilter);
+	hashValue(mipmapMode);
+	for(auto mode : addressModes)
+		hashValue(mode);
+	hashValue(std::bit_cast<uint32_t>(mipLodBias));
+	hashValue(std::bit_cast<uint32_t>(maxAnisotropy));
+	hashValue(compareEnable);
+	hashValue(compareOp);
+	hashValue(std::bit_cast<uint32_t>(minLod));
+	hashValue(std::bit_cast<uint32_t>(maxLod));
+	hashValue(borderColor);
+	return static_cast<size_t>(hash);
+}
+
+void SamplerCache::SetSamplerLimit(uint32_t maxSamplers)
+{
+	std::scoped_lock lock {m_mutex};
+	m_samplerLimit = maxSamplers;
+}
+
+std::shared_ptr<SamplerCache::Entry> SamplerCache::Acquire(VlkContext &context, const Key &key, bool *outCreated)
+{
+	if(outCreated)
+		*outCreated = false;
+	auto hash = key.Hash();
+
+	std::scoped_lock lock {m_mutex};
+	auto range = m_entries.equal_range(hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		auto &entry = *it->second;
+		if(entry.key != key)
+			continue;
+		++entry.refCount;
+		++m_hits;
+		return it->second;
+	}
+	auto &dev = context.GetDevice();
+	auto sampler = Anvil::Sampler::create(Anvil::SamplerCreateInfo::create(&dev, static_cast<Anvil::Filter>(key.magFilter), static_cast<Anvil::Filter>(key.minFilter), static_cast<Anvil::SamplerMipmapMode>(key.mipmapMode),
+	  static_cast<Anvil::SamplerAddressMode>(key.addressModes[0]), static_cast<Anvil::SamplerAddressMode>(key.addressModes[1]), static_cast<Anvil::SamplerAddressMode>(key.addressModes[2]), key.mipLodBias, key.maxAnisotropy, key.compareEnable,
+	  static_cast<Anvil::CompareOp>(key.compareOp), key.minLod, key.maxLod, static_cast<Anvil::BorderColor>(key.borderColor), false));
+	if(sampler == nullptr)
+		return nullptr;
+	++m_misses;
+	auto entry = std::make_shared<Entry>();
+	entry->hash = hash;
+	entry->key = key;
+	entry->sampler = std::move(sampler);
+	entry->refCount = 1;
+	m_entries.insert({hash, entry});
+	if(outCreated)
+		*outCreated = true;
+
+	if(m_samplerLimit > 0) {
+		// Warn at 90% of the limit, and again if the count drops below 80% and rises back up afterwards
+		auto count = m_entries.size();
+		if(!m_limitWarningIssued && count * 10 >= static_cast<size_t>(m_samplerLimit) * 9) {
+			m_limitWarningIssued = true;
+			context.Log("Number of unique samplers (" + std::to_string(count) + ") is approaching the device limit of " + std::to_string(m_samplerLimit) + "!", pragma::util::LogSeverity::Warning);
+		}
+	}
+	return entry;
+}
+
+void SamplerCache::Release(const std::shared_ptr<Entry> &entry)
+{
+	if(!entry)
+		return;
+	std::scoped_lock lock {m_mutex};
+	assert(entry->refCount > 0);
+	if(--entry->refCount > 0)
+		return;
+	auto range = m_entries.equal_range(entry->hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second != entry)
+			continue;
+		m_entries.erase(it);
+		break;
+	}
+	if(m_limitWarningIssued && m_entries.size() * 10 < static_cast<size_t>(m_samplerLimit) * 8)
+		m_limitWarningIssued = false;
+}
+
+void SamplerCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+}
+
+SamplerCache::Stats SamplerCache::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	Stats stats {};
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.samplerCount = m_entries.size();
+	for(auto &[hash, entry] : m_entries)
+		stats.samplerReferenceCount += entry->refCount;
+	return stats;
+}
@@ -0,0 +1,149 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module pragma.prosper.vulkan;
+
+import :memory_budget;
+
+using namespace prosper;
+
+void MemoryBudgetGovernor::SetSettings(const Settings &settings)
+{
+	std::scoped_lock lock {m_mutex};
+	m_settings = settings;
+}
+
+MemoryBudgetGovernor::CallbackHandle MemoryBudgetGovernor::AddEvictionCallback(std::string name, int32_t priority, const EvictionCallback &callback)
+{
+	std::scoped_lock lock {m_mutex};
+	auto handle = m_nextCallbackHandle++;
+	auto it = std::upper_bound(m_callbacks.begin(), m_callbacks.end(), priority, [](int32_t priority, const Callback &cb) { return priority < cb.priority; });
+	m_callbacks.insert(it, Callback {handle, std::move(name), priority, callback});
+	return handle;
+}
+
+void MemoryBudgetGovernor::RemoveEvictionCallback(CallbackHandle handle)
+{
+	std::scoped_lock lock {m_mutex};
+	auto it = std::find_if(m_callbacks.begin(), m_callbacks.end(), [handle](const Callback &cb) { return cb.handle == handle; });
+	if(it != m_callbacks.end())
+		m_callbacks.erase(it);
+}
+
+void MemoryBudgetGovernor::Update(const std::vector<HeapBudget> &budgets)
+{
+	std::vector<std::pair<uint32_t, uint64_t>> evictions;
+	std::vector<Callback> callbacks;
+	{
+		std::scoped_lock lock {m_mutex};
+		m_heaps.resize(budgets.size());
+		auto downgrade = false;
+		for(auto i = decltype(budgets.size()) {0u}; i < budgets.size(); ++i) {
+			auto &budget = budgets[i];
+			auto &heap = m_heaps[i];
+			heap.budget = budget;
+			if(heap.cooldown > 0)
+				--heap.cooldown;
+			if(budget.budget == 0) {
+				heap.pressure = Pressure::Normal;
+				continue;
+			}
+			auto usage = static_cast<double>(budget.usage) / static_cast<double>(budget.budget);
+			auto prevPressure = heap.pressure;
+			if(usage >= m_settings.downgradeWatermark)
+				heap.pressure = Pressure::Critical;
+			else if(usage >= m_settings.evictionWatermark)
+				heap.pressure = Pressure::Elevated;
+			else if(usage < m_settings.targetWatermark || prevPressure == Pressure::Normal)
+				heap.pressure = Pressure::Normal;
+			else
+				heap.pressure = Pressure::Elevated; // Keep the pressure state until we're below the target again
+
+			if(heap.pressure == Pressure::Critical && budget.deviceLocal)
+				downgrade = true;
+			if(heap.pressure == Pressure::Normal || heap.cooldown > 0 || usage < m_settings.evictionWatermark)
+				continue;
+			auto target = static_cast<uint64_t>(static_cast<double>(budget.budget) * m_settings.targetWatermark);
+			if(budget.usage > target) {
+				evictions.push_back({static_cast<uint32_t>(i), budget.usage - target});
+				heap.cooldown = m_settings.evictionCooldown;
+			}
+		}
+		m_downgradeDeviceLocalAllocations = downgrade && m_settings.downgradeDeviceLocalAllocations;
+		if(!evictions.empty())
+			callbacks = m_callbacks;
+	}
+
+	// Callbacks are invoked without holding the lock, since they're likely to free resources
+	for(auto &[heapIndex, bytesToFree] : evictions) {
+		for(auto &cb : callbacks) {
+			auto freed = cb.callback(heapIndex, bytesToFree);
+			if(freed >= bytesToFree)
+				break;
+			bytesToFree -= freed;
+		}
+	}
+}
+
+MemoryBudgetGovernor::Pressure MemoryBudgetGovernor::GetPressure(uint32_t heapIndex) const
+{
+	std::scoped_lock lock {m_mutex};
+	return (heapIndex < m_heaps.size()) ? m_heaps[heapIndex].pressure : Pressure::Normal;
+}
+
+std::optional<MemoryBudgetGovernor::HeapBudget> MemoryBudgetGovernor::GetHeapBudget(uint32_t heapIndex) const
+{
+	std::scoped_lock lock {m_mutex};
+	if(heapIndex >= m_heaps.size())
+		return {};
+	return m_heaps[heapIndex].budget;
+}
+
+MemoryFeatureFlags MemoryBudgetGovernor::ApplyAllocationPolicy(MemoryFeatureFlags featureFlags) const
+{
+	if(!m_downgradeDeviceLocalAllocations || (featureFlags & MemoryFeatureFlags::DeviceLocal) == MemoryFeatureFlags::None)
+		return featureFlags;
+	// Device-local memory is about to run out, so we'll move the allocation to host-visible memory instead of failing it
+	pragma::math::remove_flag(featureFlags, MemoryFeatureFlags::DeviceLocal | MemoryFeatureFlags::HostCached);
+	return featureFlags | MemoryFeatureFlags::HostAccessable;
+}
+
+bool MemoryBudgetGovernor::CanDemoteBuffer(BufferUsageFlags usageFlags)
+{
+	constexpr auto demotableUsageFlags = BufferUsageFlags::TransferSrcBit | BufferUsageFlags::TransferDstBit | BufferUsageFlags::UniformBufferBit;
+	return (usageFlags | demotableUsageFlags) == demotableUsageFlags;
+}
+
+MemoryFeatureFlags MemoryBudgetGovernor::ApplyAllocationPolicy(MemoryFeatureFlags featureFlags, BufferUsageFlags usageFlags) const
+{
+	if(!CanDemoteBuffer(usageFlags))
+		return featureFlags;
+	return ApplyAllocationPolicy(featureFlags);
+}
+
+std::string MemoryBudgetGovernor::ToString() const
+{
+	std::scoped_lock lock {m_mutex};
+	std::stringstream ss;
+	for(auto i = decltype(m_heaps.size()) {0u}; i < m_heaps.size(); ++i) {
+		auto &heap = m_heaps[i];
+		ss << "Heap " << i << (heap.budget.deviceLocal ? " (device local)" : "") << ": " << pragma::util::get_pretty_bytes(heap.budget.usage) << " / " << pragma::util::get_pretty_bytes(heap.budget.budget) << " [";
+		switch(heap.pressure) {
+		case Pressure::Normal:
+			ss << "normal";
+			break;
+		case Pressure::Elevated:
+			ss << "elevated";
+			break;
+		case Pressure::Critical:
+			ss << "critical";
+			break;
+		}
+		ss << "]\n";
+	}
+	ss << "Eviction callbacks: " << m_callbacks.size() << "\n";
+	ss << "Downgrading device-local allocations: " << (m_downgradeDeviceLocalAllocations ? "yes" : "no") << "\n";
+	return ss.str();
+}
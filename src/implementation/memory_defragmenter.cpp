@@ -0,0 +1,279 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/memory_allocator.h>
+#include <misc/memalloc_backends/backend_vma.h>
+#include <misc/memory_block_create_info.h>
+#include <wrappers/buffer.h>
+#include <wrappers/memory_block.h>
+
+module pragma.prosper.vulkan;
+
+import :memory_defragmenter;
+
+#undef max
+
+using namespace prosper;
+
+static VmaAllocator get_vma_allocator(VlkContext &context)
+{
+	auto *memAllocator = context.GetMemoryAllocator();
+	if(memAllocator == nullptr)
+		return VK_NULL_HANDLE;
+	auto *backend = memAllocator->GetAllocatorBackend();
+	if(backend == nullptr)
+		return VK_NULL_HANDLE;
+	return static_cast<Anvil::MemoryAllocatorBackends::VMA *>(backend)->GetVmaHandle();
+}
+
+float MemoryDefragmenter::FragmentationMetrics::GetFragmentation() const
+{
+	auto unusedBytes = GetUnusedBytes();
+	if(unusedBytes == 0)
+		return 0.f;
+	return 1.f - (static_cast<float>(largestUnusedRange) / static_cast<float>(unusedBytes));
+}
+std::string MemoryDefragmenter::FragmentationMetrics::ToString() const
+{
+	std::stringstream ss;
+	ss << "Block Bytes: " << pragma::util::get_pretty_bytes(blockBytes) << " (" << blockCount << " blocks)\n";
+	ss << "Allocation Bytes: " << pragma::util::get_pretty_bytes(allocationBytes) << " (" << allocationCount << " allocations)\n";
+	ss << "Unused Bytes: " << pragma::util::get_pretty_bytes(GetUnusedBytes()) << " (" << unusedRangeCount << " ranges, largest: " << pragma::util::get_pretty_bytes(largestUnusedRange) << ")\n";
+	ss << "Fragmentation: " << (GetFragmentation() * 100.f) << "%\n";
+	return ss.str();
+}
+
+struct MemoryDefragmenter::PendingPass {
+	VmaDefragmentationContext defragContext = VK_NULL_HANDLE;
+	VmaDefragmentationPassMoveInfo passInfo {};
+	std::shared_ptr<IPrimaryCommandBuffer> cmd;
+	std::shared_ptr<IFence> fence;
+	// The relocated buffers must not be destroyed before the pass has ended, since VMA still refers to their allocations
+	std::vector<std::shared_ptr<IBuffer>> buffers;
+	// Number of frames that have to be retired before the previous locations can be released
+	uint32_t framesRemaining = 0;
+	PassResult result {};
+};
+
+MemoryDefragmenter::MemoryDefragmenter(VlkContext &context) : m_context {context} {}
+MemoryDefragmenter::~MemoryDefragmenter()
+{
+	if(!m_pendingPass)
+		return;
+	m_context.WaitIdle();
+	EndPass();
+}
+
+void MemoryDefragmenter::RegisterRelocatableBuffer(const std::shared_ptr<IBuffer> &buffer, const RelocationCallback &callback)
+{
+	std::scoped_lock lock {m_bufferMutex};
+	m_buffers[buffer.get()] = {buffer, callback};
+}
+void MemoryDefragmenter::UnregisterRelocatableBuffer(IBuffer &buffer)
+{
+	std::scoped_lock lock {m_bufferMutex};
+	m_buffers.erase(&buffer);
+}
+
+MemoryDefragmenter::FragmentationMetrics MemoryDefragmenter::CalcFragmentationMetrics() const
+{
+	FragmentationMetrics metrics {};
+	auto vmaHandle = get_vma_allocator(m_context);
+	if(!vmaHandle)
+		return metrics;
+	VmaTotalStatistics stats;
+	vmaCalculateStatistics(vmaHandle, &stats);
+	auto &total = stats.total;
+	metrics.blockBytes = total.statistics.blockBytes;
+	metrics.allocationBytes = total.statistics.allocationBytes;
+	metrics.blockCount = total.statistics.blockCount;
+	metrics.allocationCount = total.statistics.allocationCount;
+	metrics.unusedRangeCount = total.unusedRangeCount;
+	metrics.largestUnusedRange = (total.unusedRangeCount > 0) ? total.unusedRangeSizeMax : 0;
+	return metrics;
+}
+
+bool MemoryDefragmenter::BeginPass()
+{
+	auto vmaHandle = get_vma_allocator(m_context);
+	if(!vmaHandle)
+		return false;
+
+	// Map the memory locations of all relocatable buffers, so we can find the buffers VMA wants to move
+	using MemoryLocation = std::pair<VkDeviceMemory, VkDeviceSize>;
+	std::map<MemoryLocation, std::pair<std::shared_ptr<IBuffer>, RelocationCallback>> locations;
+	{
+		std::scoped_lock lock {m_bufferMutex};
+		for(auto it = m_buffers.begin(); it != m_buffers.end();) {
+			auto buf = it->second.buffer.lock();
+			if(!buf) {
+				it = m_buffers.erase(it);
+				continue;
+			}
+			auto &callback = it->second.callback;
+			++it;
+			if(buf->GetParent() != nullptr)
+				continue;
+			auto &type = typeid(*buf);
+			if(type == typeid(VkDynamicResizableBuffer) || type == typeid(VkUniformResizableBuffer))
+				continue; // Sub-buffers would still reference the old allocation
+			auto usage = buf->GetUsageFlags();
+			if(!pragma::math::is_flag_set(usage, BufferUsageFlags::TransferSrcBit) || !pragma::math::is_flag_set(usage, BufferUsageFlags::TransferDstBit))
+				continue;
+			// VMA may keep host-visible blocks persistently mapped, which the buffer at the new location could not map again
+			if(pragma::math::is_flag_set(buf->GetCreateInfo().memoryFeatures, MemoryFeatureFlags::HostAccessable))
+				continue;
+			auto *memBlock = buf->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer().get_memory_block(0u);
+			if(memBlock == nullptr)
+				continue;
+			locations[{memBlock->get_memory(), memBlock->get_start_offset()}] = {buf, callback};
+		}
+	}
+	if(locations.empty())
+		return false;
+
+	auto pass = std::make_unique<PendingPass>();
+	pass->result.before = CalcFragmentationMetrics();
+
+	VmaDefragmentationInfo defragInfo {};
+	defragInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT;
+	defragInfo.maxBytesPerPass = m_settings.maxBytesPerPass;
+	defragInfo.maxAllocationsPerPass = m_settings.maxMovesPerPass;
+	if(vmaBeginDefragmentation(vmaHandle, &defragInfo, &pass->defragContext) != VK_SUCCESS)
+		return false;
+	if(vmaBeginDefragmentationPass(vmaHandle, pass->defragContext, &pass->passInfo) != VK_INCOMPLETE) {
+		// Nothing to move
+		vmaEndDefragmentation(vmaHandle, pass->defragContext, nullptr);
+		return false;
+	}
+	auto &passInfo = pass->passInfo;
+	pass->result.movesRequested = passInfo.moveCount;
+
+	uint32_t queueFamilyIndex;
+	pass->cmd = m_context.AllocatePrimaryLevelCommandBuffer(QueueFamilyType::Universal, queueFamilyIndex);
+	auto recording = pass->cmd && pass->cmd->StartRecording(true, false);
+
+	// Allocations that don't belong to a registered buffer, or don't fit into the pass, stay where they are.
+	// Anvil binds buffers to their memory on creation and cannot re-bind them, so each moved buffer gets a new internal buffer
+	// that is bound to the location VMA has reserved for it. Once the pass has ended, the buffer's VMA allocation refers to
+	// the new location, and the previous location is released by VMA.
+	auto &dev = m_context.GetDevice();
+	util::PipelineBarrierInfo barrierInfo {};
+	barrierInfo.srcStageMask = PipelineStageFlags::TransferBit;
+	barrierInfo.dstStageMask = PipelineStageFlags::AllCommands;
+	std::vector<std::tuple<std::shared_ptr<IBuffer>, RelocationCallback, std::shared_ptr<IBuffer>>> relocations;
+	for(auto i = decltype(passInfo.moveCount) {0u}; i < passInfo.moveCount; ++i) {
+		auto &move = passInfo.pMoves[i];
+		move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+		if(!recording)
+			continue;
+		VmaAllocationInfo srcInfo;
+		vmaGetAllocationInfo(vmaHandle, move.srcAllocation, &srcInfo);
+		auto it = locations.find({srcInfo.deviceMemory, srcInfo.offset});
+		if(it == locations.end())
+			continue;
+		auto &[buf, callback] = it->second;
+		auto size = buf->GetSize();
+		if(pass->result.bytesMoved + size > m_settings.maxBytesPerPass)
+			continue;
+		auto &vkBuffer = buf->GetAPITypeRef<VlkBuffer>();
+		auto &srcMemCreateInfo = *vkBuffer.GetAnvilBuffer().get_memory_block(0u)->get_create_info_ptr();
+
+		auto createInfo = buf->GetCreateInfo();
+		createInfo.flags |= util::BufferCreateInfo::Flags::DontAllocateMemory;
+		auto dstBuffer = m_context.CreateBuffer(createInfo);
+		if(!dstBuffer)
+			continue;
+		VmaAllocationInfo dstInfo;
+		vmaGetAllocationInfo(vmaHandle, move.dstTmpAllocation, &dstInfo);
+		// The memory is owned by the VMA allocation of the buffer (see VlkBuffer::m_memoryOwner), so the block must not release it
+		auto memBlock = Anvil::MemoryBlock::create(Anvil::MemoryBlockCreateInfo::create_derived_with_custom_delete_proc(&dev, dstInfo.deviceMemory, srcMemCreateInfo.get_allowed_memory_bits(), srcMemCreateInfo.get_memory_features(), dstInfo.memoryType,
+		  srcMemCreateInfo.get_size(), dstInfo.offset, [](Anvil::MemoryBlock *) {}));
+		if(memBlock == nullptr || !dstBuffer->GetAPITypeRef<VlkBuffer>().GetAnvilBuffer().set_nonsparse_memory(std::move(memBlock)))
+			continue;
+		util::BufferCopy copyInfo {};
+		copyInfo.size = size;
+		if(!pass->cmd->RecordCopyBuffer(copyInfo, *buf, *dstBuffer))
+			continue;
+		barrierInfo.bufferBarriers.push_back({});
+		auto &barrier = barrierInfo.bufferBarriers.back();
+		barrier.srcAccessMask = AccessFlags::TransferWriteBit;
+		barrier.dstAccessMask = AccessFlags::MemoryReadBit | AccessFlags::MemoryWriteBit;
+		barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = queueFamilyIndex;
+		barrier.buffer = dstBuffer.get();
+		barrier.offset = 0;
+		barrier.size = size;
+		move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+		pass->result.bytesMoved += size;
+		relocations.push_back({buf, callback, std::move(dstBuffer)});
+	}
+	if(recording) {
+		// Makes the copies visible to the command buffers of the following frames
+		pass->cmd->RecordPipelineBarrier(barrierInfo);
+		pass->cmd->StopRecording();
+	}
+	if(relocations.empty()) {
+		vmaEndDefragmentationPass(vmaHandle, pass->defragContext, &passInfo);
+		vmaEndDefragmentation(vmaHandle, pass->defragContext, nullptr);
+		return false;
+	}
+	pass->fence = m_context.CreateFence();
+	m_context.SubmitCommandBuffer(*pass->cmd, QueueFamilyType::Universal, false, pass->fence.get());
+
+	// The new buffers can be used right away, since the copies are submitted before any of the following frames
+	std::unordered_set<const IBuffer *> relocatedBuffers;
+	for(auto &[buf, callback, dstBuffer] : relocations) {
+		auto &vkBuffer = buf->GetAPITypeRef<VlkBuffer>();
+		auto oldBuffer = vkBuffer.ReplaceBuffer(dstBuffer->GetAPITypeRef<VlkBuffer>().ReleaseBuffer());
+		// The first internal buffer owns the VMA allocation, which refers to the current location of the buffer once the pass has ended
+		if(!vkBuffer.m_memoryOwner)
+			vkBuffer.m_memoryOwner = std::move(oldBuffer);
+		else {
+			// Command buffers of frames that are still in flight may reference the old buffer
+			m_context.KeepThreadSafeResourceAliveUntilPresentationComplete(std::shared_ptr<Anvil::Buffer> {std::move(oldBuffer)});
+		}
+		relocatedBuffers.insert(buf.get());
+		++pass->result.buffersRelocated;
+		if(callback)
+			callback(*buf);
+		pass->buffers.push_back(buf);
+	}
+	// Render buffers cache the Vulkan handles of their buffers
+	m_context.ReloadRenderBuffers(relocatedBuffers);
+	pass->framesRemaining = pragma::math::max(static_cast<VlkWindow &>(m_context.GetWindow()).GetSwapchainImageCount(), 1u);
+	m_pendingPass = std::move(pass);
+	return true;
+}
+
+void MemoryDefragmenter::EndPass()
+{
+	auto pass = std::move(m_pendingPass);
+	auto vmaHandle = get_vma_allocator(m_context);
+	vmaEndDefragmentationPass(vmaHandle, pass->defragContext, &pass->passInfo);
+	vmaEndDefragmentation(vmaHandle, pass->defragContext, nullptr);
+	auto &result = pass->result;
+	result.after = CalcFragmentationMetrics();
+	m_context.Log("Defragmentation pass relocated " + std::to_string(result.buffersRelocated) + " buffers (" + pragma::util::get_pretty_bytes(result.bytesMoved) + "), fragmentation: " + std::to_string(result.before.GetFragmentation() * 100.f) + "% -> "
+	    + std::to_string(result.after.GetFragmentation() * 100.f) + "%",
+	  pragma::util::LogSeverity::Debug);
+	m_lastPassResult = result;
+}
+
+std::optional<MemoryDefragmenter::PassResult> MemoryDefragmenter::RunPass()
+{
+	if(m_pendingPass) {
+		if(m_pendingPass->framesRemaining > 0)
+			--m_pendingPass->framesRemaining;
+		if(m_pendingPass->framesRemaining > 0 || !m_pendingPass->fence->IsSet())
+			return {};
+		EndPass();
+		return m_lastPassResult;
+	}
+	if(!m_settings.enabled)
+		return {};
+	BeginPass();
+	return {};
+}
@@ -10,6 +10,9 @@ module pragma.prosper.vulkan;
 
 import :memory_tracker;
 
+#undef max
+#undef min
+
 using namespace prosper;
 
 Anvil::MemoryBlock *MemoryTracker::Resource::GetMemoryBlock(uint32_t i) const
@@ -45,74 +48,212 @@ MemoryTracker &MemoryTracker::GetInstance()
 	static MemoryTracker r {};
 	return r;
 }
+MemoryTracker::BenchmarkResult MemoryTracker::RunStressBenchmark(uint32_t operations, uint32_t threadCount)
+{
+	threadCount = pragma::math::max(threadCount, 1u);
+	auto operationsPerThread = operations / threadCount;
+	// Keys only have to be unique addresses with the alignment of real resources
+	struct alignas(16) Key {
+		uint8_t data[16];
+	};
+	std::vector<Key> keys;
+	keys.resize(static_cast<size_t>(operationsPerThread) * threadCount);
+	std::unique_ptr<MemoryTracker> tracker {new MemoryTracker {}};
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	auto t = std::chrono::steady_clock::now();
+	for(auto i = decltype(threadCount) {0u}; i < threadCount; ++i) {
+		threads.push_back(std::thread {[&tracker, &keys, i, operationsPerThread]() {
+			auto *threadKeys = keys.data() + static_cast<size_t>(i) * operationsPerThread;
+			constexpr uint32_t batchSize = 1'024;
+			for(auto offset = decltype(operationsPerThread) {0u}; offset < operationsPerThread; offset += batchSize) {
+				auto end = pragma::math::min(offset + batchSize, operationsPerThread);
+				for(auto j = offset; j < end; ++j) {
+					auto typeFlags = (j % 2 == 0) ? (Resource::TypeFlags::BufferBit | Resource::TypeFlags::StandAloneBufferBit) : Resource::TypeFlags::ImageBit;
+					tracker->AddResource(&threadKeys[j], Resource {nullptr, typeFlags, {{j % MAX_MEMORY_TYPES, 256ull}}});
+				}
+				for(auto j = offset; j < end; ++j)
+					tracker->RemoveResource(&threadKeys[j]);
+			}
+		}});
+	}
+	for(auto &thread : threads)
+		thread.join();
+	BenchmarkResult result {};
+	result.duration = std::chrono::steady_clock::now() - t;
+	result.operations = static_cast<uint64_t>(operationsPerThread) * threadCount * 2;
+	result.consistent = (tracker->GetResourceCount() == 0);
+	for(auto &sizes : tracker->m_allocatedSizes) {
+		for(auto &size : sizes) {
+			if(size.load() != 0)
+				result.consistent = false;
+		}
+	}
+	return result;
+}
+MemoryTracker::Category MemoryTracker::GetCategory(Resource::TypeFlags typeFlags)
+{
+	if((typeFlags & Resource::TypeFlags::ImageBit) != Resource::TypeFlags::None)
+		return Category::Image;
+	if((typeFlags & Resource::TypeFlags::DynamicBufferBit) != Resource::TypeFlags::None)
+		return Category::DynamicBuffer;
+	if((typeFlags & Resource::TypeFlags::UniformBufferBit) != Resource::TypeFlags::None)
+		return Category::UniformBuffer;
+	return Category::StandAloneBuffer;
+}
+static MemoryTracker::Resource::TypeFlags get_category_type_flags(uint32_t category)
+{
+	using TypeFlags = MemoryTracker::Resource::TypeFlags;
+	switch(category) {
+	case 0:
+		return TypeFlags::ImageBit;
+	case 1:
+		return TypeFlags::BufferBit | TypeFlags::DynamicBufferBit;
+	case 2:
+		return TypeFlags::BufferBit | TypeFlags::UniformBufferBit;
+	default:
+		return TypeFlags::BufferBit | TypeFlags::StandAloneBufferBit;
+	}
+}
+void MemoryTracker::CollectAllocations(Resource &resource)
+{
+	// Synthetic resources (without a backing object) keep the allocations they were created with
+	if(resource.resource == nullptr)
+		return;
+	resource.allocations.clear();
+	auto numMemoryBlocks = resource.GetMemoryBlockCount();
+	resource.allocations.reserve(numMemoryBlocks);
+	for(auto i = decltype(numMemoryBlocks) {0u}; i < numMemoryBlocks; ++i) {
+		auto *mem = resource.GetMemoryBlock(i);
+		auto *pInfo = (mem != nullptr) ? mem->get_create_info_ptr() : nullptr;
+		if(pInfo == nullptr || pInfo->get_memory_type_index() >= MAX_MEMORY_TYPES)
+			continue;
+		resource.allocations.push_back({pInfo->get_memory_type_index(), pInfo->get_size()});
+	}
+}
+MemoryTracker::Shard &MemoryTracker::GetShard(const void *key)
+{
+	// The lower bits are always zero due to alignment
+	return m_shards[(reinterpret_cast<uintptr_t>(key) >> 4) % SHARD_COUNT];
+}
+const MemoryTracker::Shard &MemoryTracker::GetShard(const void *key) const { return const_cast<MemoryTracker *>(this)->GetShard(key); }
+void MemoryTracker::ApplyAllocations(const Resource &resource, bool add)
+{
+	auto &sizes = m_allocatedSizes;
+	auto category = pragma::math::to_integral(GetCategory(resource.typeFlags));
+	for(auto &alloc : resource.allocations) {
+		auto &size = sizes[alloc.memoryType][category];
+		if(add)
+			size.fetch_add(alloc.size, std::memory_order_relaxed);
+		else
+			size.fetch_sub(alloc.size, std::memory_order_relaxed);
+	}
+}
 bool MemoryTracker::GetMemoryStats(prosper::IPrContext &context, uint32_t memType, uint64_t &allocatedSize, uint64_t &totalSize, Resource::TypeFlags typeFlags) const
 {
 	auto &dev = static_cast<VlkContext &>(context).GetDevice();
 	auto &memProps = dev.get_physical_device_memory_properties();
-	if(memType >= memProps.types.size() || memProps.types.at(memType).heap_ptr == nullptr)
+	if(memType >= memProps.types.size() || memType >= MAX_MEMORY_TYPES || memProps.types.at(memType).heap_ptr == nullptr)
 		return false;
 	totalSize = memProps.types.at(memType).heap_ptr->size;
 	allocatedSize = 0ull;
-	std::scoped_lock lock {m_resourceMutex};
-	for(auto &res : m_resources) {
-		if(res.resource == nullptr || (res.typeFlags & typeFlags) == Resource::TypeFlags::None)
+	auto &sizes = m_allocatedSizes[memType];
+	for(auto i = decltype(sizes.size()) {0u}; i < sizes.size(); ++i) {
+		if((get_category_type_flags(i) & typeFlags) == Resource::TypeFlags::None)
 			continue;
-		auto numMemoryBlocks = res.GetMemoryBlockCount();
-		for(auto i = decltype(numMemoryBlocks) {0u}; i < numMemoryBlocks; ++i) {
-			auto *mem = res.GetMemoryBlock(i);
-			auto *pInfo = (mem != nullptr) ? mem->get_create_info_ptr() : nullptr;
-			if(pInfo == nullptr || pInfo->get_memory_type_index() != memType)
-				continue;
-			allocatedSize += pInfo->get_size();
-		}
+		allocatedSize += sizes[i].load(std::memory_order_relaxed);
 	}
 	return true;
 }
-const std::vector<MemoryTracker::Resource> &MemoryTracker::GetResources() const { return m_resources; };
-void MemoryTracker::GetResources(uint32_t memType, std::vector<const Resource *> &outResources, Resource::TypeFlags typeFlags) const
+std::vector<MemoryTracker::Resource> MemoryTracker::GetResources() const
 {
-	std::scoped_lock lock {m_resourceMutex};
-	outResources.reserve(m_resources.size());
-	for(auto &res : m_resources) {
-		if(res.resource == nullptr || (res.typeFlags & typeFlags) == Resource::TypeFlags::None)
-			continue;
-		auto numMemoryBlocks = res.GetMemoryBlockCount();
-		for(auto i = decltype(numMemoryBlocks) {0u}; i < numMemoryBlocks; ++i) {
-			auto *mem = res.GetMemoryBlock(i);
-			auto *pInfo = (mem != nullptr) ? mem->get_create_info_ptr() : nullptr;
-			if(pInfo == nullptr || pInfo->get_memory_type_index() != memType)
+	std::vector<Resource> resources;
+	resources.reserve(GetResourceCount());
+	for(auto &shard : m_shards) {
+		std::scoped_lock lock {shard.mutex};
+		for(auto &[key, res] : shard.resources)
+			resources.push_back(res);
+	}
+	return resources;
+}
+size_t MemoryTracker::GetResourceCount() const { return m_resourceCount.load(std::memory_order_relaxed); }
+void MemoryTracker::GetResources(uint32_t memType, std::vector<Resource> &outResources, Resource::TypeFlags typeFlags) const
+{
+	outResources.reserve(outResources.size() + GetResourceCount());
+	IterateResources(
+	  [memType, &outResources](const Resource &res) {
+		  auto it = std::find_if(res.allocations.begin(), res.allocations.end(), [memType](const Resource::Allocation &alloc) { return alloc.memoryType == memType; });
+		  if(it != res.allocations.end())
+			  outResources.push_back(res);
+	  },
+	  typeFlags);
+}
+void MemoryTracker::IterateResources(const std::function<void(const Resource &)> &f, Resource::TypeFlags typeFlags) const
+{
+	for(auto &shard : m_shards) {
+		std::scoped_lock lock {shard.mutex};
+		for(auto &[key, res] : shard.resources) {
+			if(res.resource == nullptr || (res.typeFlags & typeFlags) == Resource::TypeFlags::None)
 				continue;
-			outResources.push_back(&res);
-			break;
+			f(res);
 		}
 	}
 }
+void MemoryTracker::AddResource(const void *key, Resource &&resource)
+{
+	CollectAllocations(resource);
+	auto &shard = GetShard(key);
+	std::scoped_lock lock {shard.mutex};
+	auto it = shard.resources.find(key);
+	if(it != shard.resources.end()) {
+		ApplyAllocations(it->second, false);
+		it->second = std::move(resource);
+	}
+	else {
+		it = shard.resources.insert({key, std::move(resource)}).first;
+		++m_resourceCount;
+	}
+	ApplyAllocations(it->second, true);
+}
 void MemoryTracker::AddResource(IBuffer &buffer)
 {
 	if(buffer.GetParent() != nullptr)
 		return; // We're already tracking the top-most buffer, we usually don't care about child-buffers
 	auto typeFlags = Resource::TypeFlags::BufferBit;
-	if(dynamic_cast<VkDynamicResizableBuffer *>(&buffer) != nullptr)
+	// Resizable buffers are never derived from any further, so comparing the exact type is sufficient and cheaper than a cross-cast
+	auto &type = typeid(buffer);
+	if(type == typeid(VkDynamicResizableBuffer))
 		typeFlags |= Resource::TypeFlags::DynamicBufferBit;
-	else if(dynamic_cast<VkUniformResizableBuffer *>(&buffer) != nullptr)
+	else if(type == typeid(VkUniformResizableBuffer))
 		typeFlags |= Resource::TypeFlags::UniformBufferBit;
 	else
 		typeFlags |= Resource::TypeFlags::StandAloneBufferBit;
-	std::scoped_lock lock {m_resourceMutex};
-	m_resources.push_back(Resource {&buffer, typeFlags});
+	AddResource(&buffer, Resource {&buffer.GetAPITypeRef<VlkBuffer>(), typeFlags});
 }
-void MemoryTracker::AddResource(IImage &image)
+void MemoryTracker::AddResource(IImage &image) { AddResource(&image, Resource {&static_cast<VlkImage &>(image), Resource::TypeFlags::ImageBit}); }
+void MemoryTracker::UpdateResource(const void *key)
 {
-	std::scoped_lock lock {m_resourceMutex};
-	m_resources.push_back(Resource {&image, Resource::TypeFlags::ImageBit});
+	auto &shard = GetShard(key);
+	std::scoped_lock lock {shard.mutex};
+	auto it = shard.resources.find(key);
+	if(it == shard.resources.end())
+		return;
+	ApplyAllocations(it->second, false);
+	CollectAllocations(it->second);
+	ApplyAllocations(it->second, true);
 }
-void MemoryTracker::RemoveResource(void *ptrResource)
+void MemoryTracker::UpdateResource(IBuffer &buffer) { UpdateResource(static_cast<const void *>(&buffer)); }
+void MemoryTracker::UpdateResource(IImage &image) { UpdateResource(static_cast<const void *>(&image)); }
+void MemoryTracker::RemoveResource(const void *key)
 {
-	std::scoped_lock lock {m_resourceMutex};
-	auto it = std::find_if(m_resources.begin(), m_resources.end(), [&ptrResource](const Resource &resource) { return ptrResource == resource.resource; });
-	if(it == m_resources.end())
+	auto &shard = GetShard(key);
+	std::scoped_lock lock {shard.mutex};
+	auto it = shard.resources.find(key);
+	if(it == shard.resources.end())
 		return;
-	m_resources.erase(it);
+	ApplyAllocations(it->second, false);
+	shard.resources.erase(it);
+	--m_resourceCount;
 }
-void MemoryTracker::RemoveResource(IBuffer &buffer) { RemoveResource(&buffer); }
-void MemoryTracker::RemoveResource(IImage &image) { RemoveResource(&image); }
+void MemoryTracker::RemoveResource(IBuffer &buffer) { RemoveResource(static_cast<const void *>(&buffer)); }
+void MemoryTracker::RemoveResource(IImage &image) { RemoveResource(static_cast<const void *>(&image)); }
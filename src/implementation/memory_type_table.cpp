@@ -0,0 +1,242 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+module pragma.prosper.vulkan;
+
+import :memory_type_table;
+
+using namespace prosper;
+
+static constexpr std::array<std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits>, 5> g_featureFlags = {
+  std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits> {MemoryFeatureFlags::DeviceLocal, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+  std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits> {MemoryFeatureFlags::HostCached, VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+  std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits> {MemoryFeatureFlags::HostCoherent, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+  std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits> {MemoryFeatureFlags::LazilyAllocated, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT},
+  std::pair<MemoryFeatureFlags, VkMemoryPropertyFlagBits> {MemoryFeatureFlags::HostAccessable, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT},
+};
+
+static MemoryFeatureFlags get_feature_flags_from_index(uint32_t index)
+{
+	auto featureFlags = MemoryFeatureFlags::None;
+	for(auto i = decltype(g_featureFlags.size()) {0u}; i < g_featureFlags.size(); ++i) {
+		if(index & (1u << i))
+			featureFlags |= g_featureFlags[i].first;
+	}
+	return featureFlags;
+}
+
+static uint32_t count_bits(uint32_t v)
+{
+	auto n = 0u;
+	for(; v != 0; v &= v - 1)
+		++n;
+	return n;
+}
+
+MemoryFeatureFlags MemoryTypeTable::ToMemoryFeatureFlags(VkMemoryPropertyFlags propertyFlags)
+{
+	auto featureFlags = MemoryFeatureFlags::None;
+	for(auto &[feature, property] : g_featureFlags) {
+		if(propertyFlags & property)
+			featureFlags |= feature;
+	}
+	return featureFlags;
+}
+
+VkMemoryPropertyFlags MemoryTypeTable::ToMemoryPropertyFlags(MemoryFeatureFlags featureFlags)
+{
+	VkMemoryPropertyFlags propertyFlags = 0;
+	for(auto &[feature, property] : g_featureFlags) {
+		if(pragma::math::is_flag_set(featureFlags, feature))
+			propertyFlags |= property;
+	}
+	return propertyFlags;
+}
+
+bool MemoryTypeTable::ShouldUseDedicatedAllocation(const VkMemoryDedicatedRequirements &requirements, DeviceSize size)
+{
+	if(requirements.requiresDedicatedAllocation)
+		return true;
+	// Small resources are better off sub-allocated, even if the driver would prefer a dedicated allocation
+	return requirements.prefersDedicatedAllocation && size >= DEDICATED_ALLOCATION_MIN_SIZE;
+}
+
+uint32_t MemoryTypeTable::GetFeatureIndex(MemoryFeatureFlags featureFlags)
+{
+	auto index = 0u;
+	for(auto i = decltype(g_featureFlags.size()) {0u}; i < g_featureFlags.size(); ++i) {
+		if(pragma::math::is_flag_set(featureFlags, g_featureFlags[i].first))
+			index |= 1u << i;
+	}
+	return index;
+}
+
+void MemoryTypeTable::RankMemoryTypes(MemoryFeatureFlags featureFlags, ResourceKind kind, std::vector<uint32_t> &outTypes) const
+{
+	outTypes.clear();
+	if(featureFlags == MemoryFeatureFlags::None)
+		return;
+	auto requiredProps = ToMemoryPropertyFlags(featureFlags);
+	for(auto i = decltype(m_memProps.memoryTypeCount) {0u}; i < m_memProps.memoryTypeCount; ++i) {
+		if((m_memProps.memoryTypes[i].propertyFlags & requiredProps) == requiredProps)
+			outTypes.push_back(i);
+	}
+	// Types with the fewest features beyond the requested ones come first. Images should not occupy the (possibly small)
+	// host-visible device-local heap unless they have to, since they can't be mapped anyway if they are optimally tiled.
+	// Ties are resolved by the type index, which the driver orders by performance.
+	auto getRank = [this, requiredProps, kind](uint32_t typeIndex) -> std::pair<uint32_t, uint32_t> {
+		auto props = m_memProps.memoryTypes[typeIndex].propertyFlags;
+		auto extraProps = props & ~requiredProps & ToMemoryPropertyFlags(get_feature_flags_from_index(FEATURE_COMBINATION_COUNT - 1));
+		auto penalty = (kind == ResourceKind::Image && (extraProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) ? 1u : 0u;
+		return {penalty, count_bits(extraProps)};
+	};
+	std::stable_sort(outTypes.begin(), outTypes.end(), [&getRank](uint32_t a, uint32_t b) { return getRank(a) < getRank(b); });
+}
+
+void MemoryTypeTable::Initialize(const VkPhysicalDeviceMemoryProperties &memProps)
+{
+	m_memProps = memProps;
+	m_resizableBarHeapIndex = INVALID_MEMORY_TYPE;
+	m_barHeapSize = 0;
+	for(auto i = decltype(m_memProps.memoryTypeCount) {0u}; i < m_memProps.memoryTypeCount; ++i) {
+		auto &type = m_memProps.memoryTypes[i];
+		constexpr VkMemoryPropertyFlags barProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		if((type.propertyFlags & barProps) != barProps || type.heapIndex >= m_memProps.memoryHeapCount)
+			continue;
+		auto heapSize = m_memProps.memoryHeaps[type.heapIndex].size;
+		if(heapSize <= m_barHeapSize)
+			continue;
+		m_barHeapSize = heapSize;
+		if(heapSize > RESIZABLE_BAR_MIN_HEAP_SIZE)
+			m_resizableBarHeapIndex = type.heapIndex;
+	}
+
+	for(auto i = 0u; i < FEATURE_COMBINATION_COUNT; ++i) {
+		auto featureFlags = get_feature_flags_from_index(i);
+		for(auto kind = 0u; kind < static_cast<uint32_t>(ResourceKind::Count); ++kind)
+			RankMemoryTypes(featureFlags, static_cast<ResourceKind>(kind), m_rankedTypes[i][kind]);
+
+		auto &selection = m_compatibleTypes[i];
+		selection = {};
+		auto &ranked = m_rankedTypes[i][static_cast<uint32_t>(ResourceKind::Buffer)];
+		if(!ranked.empty()) {
+			selection.memoryTypeIndex = ranked.front();
+			selection.featureFlags = featureFlags;
+			continue;
+		}
+		// None of the types support all of the requested features. For host transfer usages we can fall back to any host-visible type,
+		// all other requests are unsatisfiable.
+		if(featureFlags != MemoryFeatureFlags::CPUToGPU && featureFlags != MemoryFeatureFlags::GPUToCPU)
+			continue;
+		auto &hostRanked = m_rankedTypes[GetFeatureIndex(MemoryFeatureFlags::HostAccessable)][static_cast<uint32_t>(ResourceKind::Buffer)];
+		if(hostRanked.empty())
+			continue;
+		selection.memoryTypeIndex = hostRanked.front();
+		selection.featureFlags = MemoryFeatureFlags::HostAccessable;
+	}
+}
+
+const MemoryTypeTable::Selection &MemoryTypeTable::FindCompatibleMemoryType(MemoryFeatureFlags featureFlags) const { return m_compatibleTypes[GetFeatureIndex(featureFlags)]; }
+
+const std::vector<uint32_t> &MemoryTypeTable::GetRankedMemoryTypes(MemoryFeatureFlags featureFlags, ResourceKind kind) const { return m_rankedTypes[GetFeatureIndex(featureFlags)][static_cast<uint32_t>(kind)]; }
+
+MemoryTypeTable::Selection MemoryTypeTable::Select(MemoryFeatureFlags featureFlags, ResourceKind kind, uint32_t memoryTypeBits) const
+{
+	for(auto typeIndex : GetRankedMemoryTypes(featureFlags, kind)) {
+		if(memoryTypeBits & (1u << typeIndex))
+			return {typeIndex, featureFlags};
+	}
+	return {};
+}
+
+bool MemoryTypeTable::RunSelectionTests(std::vector<std::string> &outFailures)
+{
+	auto numFailures = outFailures.size();
+	auto check = [&outFailures](bool condition, const std::string &description) {
+		if(!condition)
+			outFailures.push_back(description);
+	};
+	using Heap = std::pair<DeviceSize, VkMemoryHeapFlags>;
+	using Type = std::pair<VkMemoryPropertyFlags, uint32_t>;
+	auto createMemoryProperties = [](const std::vector<Heap> &heaps, const std::vector<Type> &types) {
+		VkPhysicalDeviceMemoryProperties memProps {};
+		memProps.memoryHeapCount = heaps.size();
+		for(auto i = decltype(heaps.size()) {0u}; i < heaps.size(); ++i)
+			memProps.memoryHeaps[i] = {heaps[i].first, heaps[i].second};
+		memProps.memoryTypeCount = types.size();
+		for(auto i = decltype(types.size()) {0u}; i < types.size(); ++i)
+			memProps.memoryTypes[i] = {types[i].first, types[i].second};
+		return memProps;
+	};
+	constexpr VkMemoryPropertyFlags deviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	constexpr VkMemoryPropertyFlags hostCached = hostVisible | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	constexpr DeviceSize mib = 1024 * 1024;
+
+	// Discrete GPU with the legacy 256 MiB BAR window
+	MemoryTypeTable table {};
+	table.Initialize(createMemoryProperties({{8192 * mib, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}, {16384 * mib, 0}, {256 * mib, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}}, {{deviceLocal, 0}, {hostVisible, 1}, {hostCached, 1}, {deviceLocal | hostVisible, 2}}));
+	check(!table.IsResizableBarAvailable(), "Discrete: 256 MiB BAR must not be detected as resizable BAR");
+	check(table.GetBarHeapSize() == 256 * mib, "Discrete: BAR heap size must be 256 MiB");
+	check(table.FindCompatibleMemoryType(MemoryFeatureFlags::DeviceLocal).memoryTypeIndex == 0, "Discrete: DeviceLocal must select the type without host features");
+	check(table.FindCompatibleMemoryType(MemoryFeatureFlags::HostAccessable | MemoryFeatureFlags::HostCoherent).memoryTypeIndex == 1, "Discrete: HostAccessable must select the uncached host type");
+	check(table.FindCompatibleMemoryType(MemoryFeatureFlags::HostAccessable | MemoryFeatureFlags::HostCached).memoryTypeIndex == 2, "Discrete: HostCached must select the cached host type");
+	check(table.FindCompatibleMemoryType(MemoryFeatureFlags::DeviceLocal | MemoryFeatureFlags::HostAccessable).memoryTypeIndex == 3, "Discrete: DeviceLocal | HostAccessable must select the BAR type");
+	check(!table.FindCompatibleMemoryType(MemoryFeatureFlags::DeviceLocal | MemoryFeatureFlags::LazilyAllocated).IsValid(), "Discrete: LazilyAllocated must be unsatisfiable");
+	check(table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Buffer, 1u << 3).memoryTypeIndex == 3, "Discrete: Select must respect memoryTypeBits");
+	check(!table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Buffer, 1u << 1).IsValid(), "Discrete: Select must fail if memoryTypeBits excludes all compatible types");
+
+	// Discrete GPU with resizable BAR, where the host-visible device-local type comes first
+	table.Initialize(createMemoryProperties({{8192 * mib, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}, {16384 * mib, 0}}, {{deviceLocal | hostVisible, 0}, {deviceLocal, 0}, {hostVisible, 1}}));
+	check(table.IsResizableBarAvailable(), "ReBAR: Resizable BAR must be detected");
+	check(table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Buffer).memoryTypeIndex == 1, "ReBAR: Buffers must prefer the type without additional features");
+	check(table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Image).memoryTypeIndex == 1, "ReBAR: Images must prefer the type that is not host-visible");
+	check(table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Image, 1u << 0).memoryTypeIndex == 0, "ReBAR: Images must fall back to the host-visible type if it is the only allowed one");
+	auto &ranked = table.GetRankedMemoryTypes(MemoryFeatureFlags::DeviceLocal, ResourceKind::Image);
+	check(ranked.size() == 2 && ranked.front() == 1 && ranked.back() == 0, "ReBAR: Image ranking must contain both device-local types, host-visible last");
+
+	// Integrated GPU, where all memory is device-local and host-visible
+	table.Initialize(createMemoryProperties({{4096 * mib, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}}, {{deviceLocal | hostVisible, 0}, {deviceLocal | hostCached, 0}}));
+	check(table.Select(MemoryFeatureFlags::DeviceLocal, ResourceKind::Image).memoryTypeIndex == 0, "Integrated: Images must select the type with the fewest additional features");
+	check(table.FindCompatibleMemoryType(MemoryFeatureFlags::HostAccessable | MemoryFeatureFlags::HostCached).memoryTypeIndex == 1, "Integrated: HostCached must select the cached type");
+
+	// Dedicated allocation decisions
+	VkMemoryDedicatedRequirements dedicatedReq {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+	check(!ShouldUseDedicatedAllocation(dedicatedReq, DEDICATED_ALLOCATION_MIN_SIZE), "Dedicated: No hint must not use a dedicated allocation");
+	dedicatedReq.prefersDedicatedAllocation = VK_TRUE;
+	check(!ShouldUseDedicatedAllocation(dedicatedReq, DEDICATED_ALLOCATION_MIN_SIZE - 1), "Dedicated: Small preferred resources must be sub-allocated");
+	check(ShouldUseDedicatedAllocation(dedicatedReq, DEDICATED_ALLOCATION_MIN_SIZE), "Dedicated: Large preferred resources must use a dedicated allocation");
+	dedicatedReq.prefersDedicatedAllocation = VK_FALSE;
+	dedicatedReq.requiresDedicatedAllocation = VK_TRUE;
+	check(ShouldUseDedicatedAllocation(dedicatedReq, 1), "Dedicated: Required dedicated allocations must always be honored");
+	return outFailures.size() == numFailures;
+}
+
+std::string MemoryTypeTable::ToString() const
+{
+	std::stringstream ss;
+	ss << "Memory types:\n";
+	for(auto i = decltype(m_memProps.memoryTypeCount) {0u}; i < m_memProps.memoryTypeCount; ++i) {
+		auto &type = m_memProps.memoryTypes[i];
+		ss << "[" << i << "] Heap " << type.heapIndex << ":";
+		auto featureFlags = ToMemoryFeatureFlags(type.propertyFlags);
+		for(auto &[feature, property] : g_featureFlags) {
+			if(pragma::math::is_flag_set(featureFlags, feature))
+				ss << " " << magic_enum::enum_name(property);
+		}
+		ss << "\n";
+	}
+	ss << "Resizable BAR: ";
+	if(IsResizableBarAvailable())
+		ss << "Yes (" << pragma::util::get_pretty_bytes(m_barHeapSize) << ")";
+	else if(m_barHeapSize > 0)
+		ss << "No (" << pragma::util::get_pretty_bytes(m_barHeapSize) << " BAR)";
+	else
+		ss << "No";
+	ss << "\n";
+	return ss.str();
+}
@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module pragma.prosper.vulkan;
+
+import :object_cache;
+
+using namespace prosper;
+
+void ObjectCacheKey::ComputeHash()
+{
+	// FNV-1a
+	uint64_t h = 14695981039346656037ull;
+	for(auto w : words) {
+		h ^= w;
+		h *= 1099511628211ull;
+	}
+	hash = static_cast<size_t>(h);
+}
+
+ObjectCacheKey prosper::make_render_pass_cache_key(const util::RenderPassCreateInfo &createInfo)
+{
+	ObjectCacheKey key {};
+	key.Add(createInfo.attachments.size());
+	for(auto &att : createInfo.attachments) {
+		key.Add(static_cast<uint64_t>(att.format));
+		key.Add(static_cast<uint64_t>(att.sampleCount));
+		key.Add(static_cast<uint64_t>(att.loadOp));
+		key.Add(static_cast<uint64_t>(att.storeOp));
+		// Stencil operations are only used for depth-stencil attachments (see VlkContext::CreateRenderPass)
+		auto isDepth = util::is_depth_format(static_cast<prosper::Format>(att.format));
+		key.Add(isDepth ? static_cast<uint64_t>(att.stencilLoadOp) : 0);
+		key.Add(isDepth ? static_cast<uint64_t>(att.stencilStoreOp) : 0);
+		key.Add(static_cast<uint64_t>(att.initialLayout));
+		key.Add(static_cast<uint64_t>(att.finalLayout));
+	}
+	key.Add(createInfo.subPasses.size());
+	for(auto &subPass : createInfo.subPasses) {
+		key.Add(subPass.colorAttachments.size());
+		for(auto attId : subPass.colorAttachments)
+			key.Add(static_cast<uint64_t>(attId));
+		key.Add(subPass.useDepthStencilAttachment);
+		key.Add(subPass.dependencies.size());
+		for(auto &dependency : subPass.dependencies) {
+			key.Add(static_cast<uint64_t>(dependency.sourceSubPassId));
+			key.Add(static_cast<uint64_t>(dependency.destinationSubPassId));
+			key.Add(static_cast<uint64_t>(dependency.sourceStageMask));
+			key.Add(static_cast<uint64_t>(dependency.destinationStageMask));
+			key.Add(static_cast<uint64_t>(dependency.sourceAccessMask));
+			key.Add(static_cast<uint64_t>(dependency.destinationAccessMask));
+		}
+	}
+	key.ComputeHash();
+	return key;
+}
+
+ObjectCacheKey prosper::make_framebuffer_cache_key(uint32_t width, uint32_t height, uint32_t layers, const std::vector<IImageView *> &attachments)
+{
+	ObjectCacheKey key {};
+	key.words.reserve(4 + attachments.size());
+	key.Add(width);
+	key.Add(height);
+	key.Add(layers);
+	key.Add(attachments.size());
+	for(auto *att : attachments)
+		key.Add(reinterpret_cast<uintptr_t>(att->GetInternalHandle()));
+	key.ComputeHash();
+	return key;
+}
@@ -0,0 +1,232 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/descriptor_set_create_info.h>
+#include <cassert>
+
+module pragma.prosper.vulkan;
+
+import :pipeline_layout_cache;
+
+using namespace prosper;
+
+static void hash_combine(size_t &seed, size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+
+static size_t hash_words(const std::vector<uint32_t> &words)
+{
+	size_t hash = words.size();
+	for(auto w : words)
+		hash_combine(hash, w);
+	return hash;
+}
+
+PipelineLayoutCache::DescriptorSetLayout::~DescriptorSetLayout()
+{
+	if(vkDescriptorSetLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(device, vkDescriptorSetLayout, nullptr);
+}
+
+PipelineLayoutCache::PipelineLayout::~PipelineLayout()
+{
+	if(vkPipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, vkPipelineLayout, nullptr);
+}
+
+std::shared_ptr<PipelineLayoutCache::DescriptorSetLayout> PipelineLayoutCache::AcquireDescriptorSetLayout(DescriptorSetCreateInfo &dsInfo)
+{
+	constexpr uint32_t wordsPerBinding = 5;
+	auto numBindings = dsInfo.GetBindingCount();
+	std::vector<uint32_t> key;
+	key.reserve(numBindings * wordsPerBinding);
+	for(auto i = decltype(numBindings) {0u}; i < numBindings; ++i) {
+		uint32_t bindingIndex;
+		prosper::DescriptorType descType;
+		uint32_t descArraySize;
+		prosper::ShaderStageFlags stageFlags;
+		bool immutableSamplersEnabled;
+		prosper::DescriptorBindingFlags flags;
+		auto result = dsInfo.GetBindingPropertiesByIndexNumber(i, &bindingIndex, &descType, &descArraySize, &stageFlags, &immutableSamplersEnabled, &flags);
+		assert(result && !immutableSamplersEnabled);
+		key.insert(key.end(), {bindingIndex, static_cast<uint32_t>(descType), descArraySize, static_cast<uint32_t>(stageFlags), static_cast<uint32_t>(flags)});
+	}
+
+	// Sort the bindings by binding index, so that layouts which only differ in declaration order are merged
+	std::vector<uint32_t> order(numBindings);
+	for(auto i = decltype(numBindings) {0u}; i < numBindings; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key[a * wordsPerBinding] < key[b * wordsPerBinding]; });
+	std::vector<uint32_t> canonicalKey;
+	canonicalKey.reserve(key.size());
+	for(auto idx : order)
+		canonicalKey.insert(canonicalKey.end(), key.begin() + idx * wordsPerBinding, key.begin() + (idx + 1) * wordsPerBinding);
+
+	auto hash = hash_words(canonicalKey);
+	auto range = m_descriptorSetLayouts.equal_range(hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second->key != canonicalKey)
+			continue;
+		++it->second->refCount;
+		++m_stats.descriptorSetLayoutHits;
+		return it->second;
+	}
+	++m_stats.descriptorSetLayoutMisses;
+	auto layout = std::make_shared<DescriptorSetLayout>();
+	layout->hash = hash;
+	layout->createInfo = Anvil::DescriptorSetCreateInfo::create();
+	for(size_t i = 0; i < canonicalKey.size(); i += wordsPerBinding) {
+		layout->createInfo->add_binding(canonicalKey[i], static_cast<Anvil::DescriptorType>(canonicalKey[i + 1]), canonicalKey[i + 2], static_cast<Anvil::ShaderStageFlagBits>(canonicalKey[i + 3]), static_cast<Anvil::DescriptorBindingFlagBits>(canonicalKey[i + 4]),
+		  nullptr);
+	}
+	layout->key = std::move(canonicalKey);
+	layout->refCount = 1;
+	m_descriptorSetLayouts.insert({hash, layout});
+	return layout;
+}
+
+void PipelineLayoutCache::ReleaseDescriptorSetLayout(const std::shared_ptr<DescriptorSetLayout> &layout)
+{
+	assert(layout->refCount > 0);
+	if(--layout->refCount > 0)
+		return;
+	auto range = m_descriptorSetLayouts.equal_range(layout->hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second != layout)
+			continue;
+		m_descriptorSetLayouts.erase(it);
+		break;
+	}
+}
+
+std::shared_ptr<PipelineLayoutCache::PipelineLayout> PipelineLayoutCache::Acquire(const BasePipelineCreateInfo &pipelineCreateInfo)
+{
+	std::scoped_lock lock {m_mutex};
+	auto *dsInfos = pipelineCreateInfo.GetDsCreateInfoItems();
+	std::vector<std::shared_ptr<DescriptorSetLayout>> dsLayouts;
+	dsLayouts.reserve(dsInfos->size());
+	for(auto &dsCreateInfo : *dsInfos)
+		dsLayouts.push_back(AcquireDescriptorSetLayout(*dsCreateInfo));
+
+	auto &pushConstantRanges = pipelineCreateInfo.GetPushConstantRanges();
+	std::vector<std::array<uint32_t, 3>> ranges;
+	ranges.reserve(pushConstantRanges.size());
+	for(auto &range : pushConstantRanges)
+		ranges.push_back({range.offset, range.size, static_cast<uint32_t>(range.stages)});
+	std::sort(ranges.begin(), ranges.end());
+	std::vector<uint32_t> pushConstantKey;
+	pushConstantKey.reserve(ranges.size() * 3);
+	for(auto &range : ranges)
+		pushConstantKey.insert(pushConstantKey.end(), range.begin(), range.end());
+
+	// Descriptor set layouts are interned, so they can be compared by identity
+	auto hash = hash_words(pushConstantKey);
+	for(auto &dsLayout : dsLayouts)
+		hash_combine(hash, std::hash<const void *> {}(dsLayout.get()));
+	auto range = m_pipelineLayouts.equal_range(hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		auto &layout = *it->second;
+		if(layout.descriptorSetLayouts != dsLayouts || layout.pushConstantKey != pushConstantKey)
+			continue;
+		// The pipeline layout already holds references to its descriptor set layouts
+		for(auto &dsLayout : dsLayouts)
+			ReleaseDescriptorSetLayout(dsLayout);
+		++layout.refCount;
+		++m_stats.pipelineLayoutHits;
+		return it->second;
+	}
+	++m_stats.pipelineLayoutMisses;
+	auto layout = std::make_shared<PipelineLayout>();
+	layout->hash = hash;
+	layout->pushConstantKey = std::move(pushConstantKey);
+	layout->descriptorSetCreateInfos.reserve(dsLayouts.size());
+	for(auto &dsLayout : dsLayouts)
+		layout->descriptorSetCreateInfos.push_back(dsLayout->createInfo.get());
+	layout->descriptorSetLayouts = std::move(dsLayouts);
+	layout->refCount = 1;
+	m_pipelineLayouts.insert({hash, layout});
+	return layout;
+}
+
+void PipelineLayoutCache::Release(const std::shared_ptr<PipelineLayout> &layout)
+{
+	if(!layout)
+		return;
+	std::scoped_lock lock {m_mutex};
+	assert(layout->refCount > 0);
+	if(--layout->refCount > 0)
+		return;
+	for(auto &dsLayout : layout->descriptorSetLayouts)
+		ReleaseDescriptorSetLayout(dsLayout);
+	auto range = m_pipelineLayouts.equal_range(layout->hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second != layout)
+			continue;
+		m_pipelineLayouts.erase(it);
+		break;
+	}
+}
+
+VkPipelineLayout PipelineLayoutCache::GetVkPipelineLayout(VkDevice device, PipelineLayout &layout)
+{
+	std::scoped_lock lock {m_mutex};
+	if(layout.vkPipelineLayout != VK_NULL_HANDLE)
+		return layout.vkPipelineLayout;
+	std::vector<VkDescriptorSetLayout> vkSetLayouts;
+	vkSetLayouts.reserve(layout.descriptorSetLayouts.size());
+	for(auto &dsLayout : layout.descriptorSetLayouts) {
+		if(dsLayout->vkDescriptorSetLayout == VK_NULL_HANDLE) {
+			auto &key = dsLayout->key;
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+			std::vector<VkDescriptorBindingFlags> bindingFlags;
+			auto hasBindingFlags = false;
+			for(size_t i = 0; i < key.size(); i += 5) {
+				bindings.push_back({key[i], static_cast<VkDescriptorType>(key[i + 1]), key[i + 2], static_cast<VkShaderStageFlags>(key[i + 3]), nullptr});
+				bindingFlags.push_back(static_cast<VkDescriptorBindingFlags>(key[i + 4]));
+				hasBindingFlags = hasBindingFlags || (key[i + 4] != 0);
+			}
+			VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+			bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+			VkDescriptorSetLayoutCreateInfo createInfo {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+			createInfo.pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr;
+			createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+			createInfo.pBindings = bindings.data();
+			if(hasBindingFlags && std::find_if(bindingFlags.begin(), bindingFlags.end(), [](VkDescriptorBindingFlags flags) { return (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0; }) != bindingFlags.end())
+				createInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			if(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &dsLayout->vkDescriptorSetLayout) != VK_SUCCESS)
+				return VK_NULL_HANDLE;
+			dsLayout->device = device;
+		}
+		vkSetLayouts.push_back(dsLayout->vkDescriptorSetLayout);
+	}
+	std::vector<VkPushConstantRange> pushConstantRanges;
+	for(size_t i = 0; i < layout.pushConstantKey.size(); i += 3)
+		pushConstantRanges.push_back({static_cast<VkShaderStageFlags>(layout.pushConstantKey[i + 2]), layout.pushConstantKey[i], layout.pushConstantKey[i + 1]});
+	VkPipelineLayoutCreateInfo createInfo {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+	createInfo.setLayoutCount = static_cast<uint32_t>(vkSetLayouts.size());
+	createInfo.pSetLayouts = vkSetLayouts.data();
+	createInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	createInfo.pPushConstantRanges = pushConstantRanges.data();
+	if(vkCreatePipelineLayout(device, &createInfo, nullptr, &layout.vkPipelineLayout) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	layout.device = device;
+	return layout.vkPipelineLayout;
+}
+
+void PipelineLayoutCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_pipelineLayouts.clear();
+	m_descriptorSetLayouts.clear();
+}
+
+PipelineLayoutCache::Stats PipelineLayoutCache::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	auto stats = m_stats;
+	stats.pipelineLayoutCount = m_pipelineLayouts.size();
+	stats.descriptorSetLayoutCount = m_descriptorSetLayouts.size();
+	return stats;
+}
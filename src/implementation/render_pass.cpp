@@ -33,6 +33,8 @@ VlkRenderPass::~VlkRenderPass()
 	if(GetContext().IsValidationEnabled())
 		VlkDebugObject::Clear(GetContext(), debug::ObjectType::RenderPass, GetInternalHandle());
 	prosper::debug::deregister_debug_object(m_renderPass->get_render_pass());
+	if(auto *gpl = static_cast<VlkContext &>(GetContext()).GetGraphicsPipelineLibraryManager())
+		gpl->OnRenderPassDestroyed(m_renderPass->get_render_pass());
 }
 void VlkRenderPass::Bake()
 {
@@ -46,3 +48,44 @@ Anvil::RenderPass &VlkRenderPass::operator*() { return *m_renderPass; }
 const Anvil::RenderPass &VlkRenderPass::operator*() const { return const_cast<VlkRenderPass *>(this)->operator*(); }
 Anvil::RenderPass *VlkRenderPass::operator->() { return m_renderPass.get(); }
 const Anvil::RenderPass *VlkRenderPass::operator->() const { return const_cast<VlkRenderPass *>(this)->operator->(); }
+
+uint64_t VlkRenderPass::GetDiscardableAttachmentMask(const IFramebuffer &fb) const
+{
+	auto &attachments = GetCreateInfo().attachments;
+	uint64_t mask = 0;
+	auto numAttachments = pragma::math::min(static_cast<size_t>(fb.GetAttachmentCount()), pragma::math::min(attachments.size(), static_cast<size_t>(64)));
+	for(auto i = decltype(numAttachments) {0u}; i < numAttachments; ++i) {
+		auto &attInfo = attachments[i];
+		if(attInfo.storeOp == AttachmentStoreOp::DontCare && attInfo.stencilStoreOp == AttachmentStoreOp::DontCare)
+			continue;
+		auto *imgView = const_cast<IFramebuffer &>(fb).GetAttachment(i);
+		if(imgView == nullptr || !pragma::math::is_flag_set(imgView->GetImage().GetCreateInfo().usage, ImageUsageFlags::TransientAttachmentBit))
+			continue;
+		mask |= (1ull << i);
+	}
+	return mask;
+}
+
+VlkRenderPass &VlkRenderPass::GetDontCareStoreVariant(uint64_t attachmentMask)
+{
+	if(attachmentMask == 0)
+		return *this;
+	std::scoped_lock lock {m_variantMutex};
+	auto it = m_dontCareStoreVariants.find(attachmentMask);
+	if(it != m_dontCareStoreVariants.end())
+		return static_cast<VlkRenderPass &>(*it->second);
+	// Store operations don't affect render pass compatibility, so the variant can be used with the same framebuffers and pipelines
+	auto createInfo = GetCreateInfo();
+	for(auto i = decltype(createInfo.attachments.size()) {0u}; i < createInfo.attachments.size(); ++i) {
+		if((attachmentMask & (1ull << i)) == 0)
+			continue;
+		createInfo.attachments[i].storeOp = AttachmentStoreOp::DontCare;
+		createInfo.attachments[i].stencilStoreOp = AttachmentStoreOp::DontCare;
+	}
+	auto rp = GetContext().CreateRenderPass(createInfo);
+	// Render passes are shared through the render pass cache, so if all of the attachments already discard their contents, this render pass is returned
+	if(!rp || rp.get() == this)
+		return *this;
+	m_dontCareStoreVariants[attachmentMask] = rp;
+	return static_cast<VlkRenderPass &>(*rp);
+}
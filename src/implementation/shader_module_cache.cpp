@@ -0,0 +1,114 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/device.h>
+#include <wrappers/shader_module.h>
+#include <cassert>
+
+module pragma.prosper.vulkan;
+
+import :shader_module_cache;
+
+using namespace prosper;
+
+static size_t hash_spirv(const std::vector<unsigned int> &spirv, const std::string &entrypoints)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for(auto w : spirv) {
+		hash ^= w;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash) ^ std::hash<std::string> {}(entrypoints);
+}
+
+void ShaderModuleCache::SetShaderModuleIdentifiersEnabled(Anvil::BaseDevice &dev, bool enabled)
+{
+	std::scoped_lock lock {m_mutex};
+	m_vkGetShaderModuleIdentifierEXT = enabled ? reinterpret_cast<PFN_vkGetShaderModuleIdentifierEXT>(vkGetDeviceProcAddr(dev.get_device_vk(), "vkGetShaderModuleIdentifierEXT")) : nullptr;
+}
+
+std::shared_ptr<ShaderModuleCache::Entry> ShaderModuleCache::Acquire(Anvil::BaseDevice &dev, const ShaderModule &module)
+{
+	auto *shaderStageProgram = static_cast<const VlkShaderStageProgram *>(module.GetShaderStageProgram());
+	if(shaderStageProgram == nullptr)
+		return nullptr;
+	auto &spirvBlob = shaderStageProgram->GetSPIRVBlob();
+	if(spirvBlob.empty())
+		return nullptr;
+	// The entry point names are baked into the Anvil shader module, so they're part of the key
+	auto entrypoints = module.GetCSEntrypointName() + ';' + module.GetFSEntrypointName() + ';' + module.GetGSEntrypointName() + ';' + module.GetTCEntrypointName() + ';' + module.GetTEEntrypointName() + ';' + module.GetVSEntrypointName();
+	auto hash = hash_spirv(spirvBlob, entrypoints);
+
+	std::scoped_lock lock {m_mutex};
+	auto range = m_entries.equal_range(hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		auto &entry = *it->second;
+		if(entry.entrypoints != entrypoints || entry.spirv != spirvBlob)
+			continue;
+		++entry.refCount;
+		++m_hits;
+		return it->second;
+	}
+	auto anvModule
+	  = Anvil::ShaderModule::create_from_spirv_blob(&dev, spirvBlob.data(), spirvBlob.size(), module.GetCSEntrypointName(), module.GetFSEntrypointName(), module.GetGSEntrypointName(), module.GetTCEntrypointName(), module.GetTEEntrypointName(), module.GetVSEntrypointName());
+	if(anvModule == nullptr)
+		return nullptr;
+	++m_misses;
+	auto entry = std::make_shared<Entry>();
+	entry->hash = hash;
+	entry->spirv = spirvBlob;
+	entry->entrypoints = std::move(entrypoints);
+	if(m_vkGetShaderModuleIdentifierEXT) {
+		VkShaderModuleIdentifierEXT identifier {};
+		identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+		m_vkGetShaderModuleIdentifierEXT(dev.get_device_vk(), anvModule->get_module(), &identifier);
+		entry->identifier.assign(identifier.identifier, identifier.identifier + identifier.identifierSize);
+	}
+	entry->module = std::move(anvModule);
+	entry->refCount = 1;
+	m_entries.insert({hash, entry});
+	return entry;
+}
+
+void ShaderModuleCache::Release(const std::shared_ptr<Entry> &entry)
+{
+	if(!entry)
+		return;
+	std::scoped_lock lock {m_mutex};
+	assert(entry->refCount > 0);
+	if(--entry->refCount > 0)
+		return;
+	auto range = m_entries.equal_range(entry->hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		if(it->second != entry)
+			continue;
+		m_entries.erase(it);
+		break;
+	}
+}
+
+void ShaderModuleCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+}
+
+ShaderModuleCache::Stats ShaderModuleCache::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	Stats stats {};
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.moduleCount = m_entries.size();
+	for(auto &[hash, entry] : m_entries) {
+		auto size = entry->spirv.size() * sizeof(entry->spirv.front());
+		stats.moduleReferenceCount += entry->refCount;
+		stats.spirvSize += size;
+		stats.spirvSizeSaved += (entry->refCount - 1) * size;
+	}
+	return stats;
+}
@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <spirv-tools/optimizer.hpp>
+
+module pragma.prosper.vulkan;
+
+import :spirv.optimizer;
+import pragma.filesystem;
+
+using namespace prosper;
+
+static constexpr uint32_t SPIRV_HEADER_WORD_COUNT = 5;
+static constexpr uint32_t SPIRV_MAGIC_NUMBER = 0x07230203;
+
+uint32_t prosper::spirv::count_instructions(const std::vector<unsigned int> &spirv)
+{
+	if(spirv.size() < SPIRV_HEADER_WORD_COUNT || spirv.front() != SPIRV_MAGIC_NUMBER)
+		return 0;
+	uint32_t count = 0;
+	for(size_t offset = SPIRV_HEADER_WORD_COUNT; offset < spirv.size();) {
+		auto wordCount = spirv[offset] >> 16;
+		if(wordCount == 0)
+			break; // Malformed module
+		offset += wordCount;
+		++count;
+	}
+	return count;
+}
+
+bool prosper::spirv::optimize(const std::vector<unsigned int> &spirv, std::vector<unsigned int> &outSpirv, OptimizationFlags flags, std::string *optOutErrMsg)
+{
+	if(flags == OptimizationFlags::None) {
+		outSpirv = spirv;
+		return true;
+	}
+	spvtools::Optimizer optimizer {SPV_ENV_VULKAN_1_2};
+	optimizer.SetMessageConsumer([optOutErrMsg](spv_message_level_t level, const char *source, const spv_position_t &position, const char *message) {
+		if(!optOutErrMsg || level > SPV_MSG_ERROR)
+			return;
+		if(!optOutErrMsg->empty())
+			*optOutErrMsg += '\n';
+		*optOutErrMsg += std::string {message} + " (" + std::to_string(position.index) + ")";
+	});
+
+	// Specialization constants have to be frozen first, otherwise the subsequent passes
+	// cannot fold the branches that depend on them
+	if(pragma::math::is_flag_set(flags, OptimizationFlags::FreezeSpecializationConstantsBit)) {
+		optimizer.RegisterPass(spvtools::CreateFreezeSpecConstantValuePass());
+		optimizer.RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass());
+		optimizer.RegisterPass(spvtools::CreateUnifyConstantPass());
+	}
+	if(pragma::math::is_flag_set(flags, OptimizationFlags::PerformancePassesBit))
+		optimizer.RegisterPerformancePasses();
+	if(pragma::math::is_flag_set(flags, OptimizationFlags::StripDeadCodeBit)) {
+		optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+		optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+		optimizer.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+	}
+	if(pragma::math::is_flag_set(flags, OptimizationFlags::StripUnusedBindingsBit)) {
+		// Removes descriptor and interface variables that are never referenced. The declared pipeline layout
+		// remains valid, since a layout may contain bindings that the shader does not use.
+		optimizer.RegisterPass(spvtools::CreateDeadVariableEliminationPass());
+		optimizer.RegisterPass(spvtools::CreateRemoveUnusedInterfaceVariablesPass());
+	}
+
+	spvtools::OptimizerOptions options {};
+	options.set_run_validator(false);
+	std::vector<uint32_t> result;
+	if(!optimizer.Run(spirv.data(), spirv.size(), &result, options))
+		return false;
+	outSpirv.assign(result.begin(), result.end());
+	return true;
+}
+
+std::string prosper::spirv::OptimizationReport::ToString() const
+{
+	std::stringstream ss;
+	ss << shader << ": ";
+	if(!success) {
+		ss << "optimization failed";
+		return ss.str();
+	}
+	auto percent = (instructionCountBefore > 0) ? (100.0 * (static_cast<double>(instructionCountBefore) - static_cast<double>(instructionCountAfter)) / static_cast<double>(instructionCountBefore)) : 0.0;
+	ss << instructionCountBefore << " -> " << instructionCountAfter << " instructions (" << std::fixed << std::setprecision(1) << percent << "% fewer), ";
+	ss << pragma::util::get_pretty_bytes(sizeBefore) << " -> " << pragma::util::get_pretty_bytes(sizeAfter);
+	return ss.str();
+}
+
+std::string prosper::spirv::get_optimized_cache_path(const std::string &shaderRootPath, OptimizationFlags flags)
+{
+	std::stringstream ss;
+	ss << std::hex << static_cast<uint32_t>(flags);
+	return pragma::util::DirPath("cache", shaderRootPath, "spirv_opt", ss.str()).GetString();
+}
+
+static bool read_spirv_file(const std::string &fileName, std::vector<unsigned int> &outSpirv)
+{
+	auto f = pragma::fs::open_file(fileName, pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
+	if(f == nullptr)
+		return false;
+	auto sz = f->GetSize();
+	if((sz % sizeof(unsigned int)) != 0)
+		return false;
+	outSpirv.resize(sz / sizeof(unsigned int));
+	f->Read(outSpirv.data(), sz);
+	return true;
+}
+
+static void find_spirv_files(const std::string &path, std::vector<std::string> &outFiles)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+	pragma::fs::find_files(pragma::util::FilePath(path, "*").GetString(), &files, &dirs);
+	for(auto &f : files) {
+		std::string ext;
+		if(ufile::get_extension(f, &ext) && ext == "spv")
+			outFiles.push_back(pragma::util::FilePath(path, f).GetString());
+	}
+	for(auto &d : dirs)
+		find_spirv_files(pragma::util::DirPath(path, d).GetString(), outFiles);
+}
+
+std::vector<prosper::spirv::OptimizationReport> prosper::spirv::optimize_cache(const std::string &shaderRootPath, OptimizationFlags flags, bool writeResults)
+{
+	auto srcPath = pragma::util::DirPath("cache", shaderRootPath, "spirv").GetString();
+	auto dstPath = get_optimized_cache_path(shaderRootPath, flags);
+	std::vector<std::string> files;
+	find_spirv_files(srcPath, files);
+
+	std::vector<OptimizationReport> reports;
+	reports.reserve(files.size());
+	std::vector<unsigned int> spirv;
+	std::vector<unsigned int> optimized;
+	for(auto &fileName : files) {
+		auto relPath = fileName.substr(srcPath.length());
+		reports.push_back({});
+		auto &report = reports.back();
+		report.shader = relPath;
+		if(!read_spirv_file(fileName, spirv))
+			continue;
+		report.instructionCountBefore = count_instructions(spirv);
+		report.sizeBefore = spirv.size() * sizeof(unsigned int);
+		if(!optimize(spirv, optimized, flags))
+			continue;
+		report.success = true;
+		report.instructionCountAfter = count_instructions(optimized);
+		report.sizeAfter = optimized.size() * sizeof(unsigned int);
+		if(!writeResults)
+			continue;
+		auto outFileName = pragma::util::FilePath(dstPath, relPath).GetString();
+		pragma::fs::create_path(ufile::get_path_from_filename(outFileName));
+		auto fOut = pragma::fs::open_file<pragma::fs::VFilePtrReal>(outFileName, pragma::fs::FileMode::Write | pragma::fs::FileMode::Binary);
+		if(fOut)
+			fOut->Write(optimized.data(), optimized.size() * sizeof(unsigned int));
+	}
+	return reports;
+}
@@ -0,0 +1,510 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/descriptor_set_create_info.h>
+
+module pragma.prosper.vulkan;
+
+import :spirv.reflection;
+
+#undef max
+
+using namespace prosper;
+
+namespace spv {
+	// Subset of the SPIR-V specification that is relevant for reflecting resource layouts
+	// See https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+	constexpr uint32_t MAGIC_NUMBER = 0x07230203;
+	constexpr uint32_t HEADER_WORD_COUNT = 5;
+	enum class Op : uint16_t {
+		Name = 5,
+		EntryPoint = 15,
+		TypeBool = 20,
+		TypeInt = 21,
+		TypeFloat = 22,
+		TypeVector = 23,
+		TypeMatrix = 24,
+		TypeImage = 25,
+		TypeSampler = 26,
+		TypeSampledImage = 27,
+		TypeArray = 28,
+		TypeRuntimeArray = 29,
+		TypeStruct = 30,
+		TypePointer = 32,
+		Constant = 43,
+		SpecConstant = 50,
+		Variable = 59,
+		Decorate = 71,
+		MemberDecorate = 72,
+		TypeAccelerationStructureKHR = 5341,
+	};
+	enum class Decoration : uint32_t {
+		Block = 2,
+		BufferBlock = 3,
+		RowMajor = 4,
+		ArrayStride = 6,
+		MatrixStride = 7,
+		Binding = 33,
+		DescriptorSet = 34,
+		Offset = 35,
+	};
+	enum class StorageClass : uint32_t {
+		UniformConstant = 0,
+		Uniform = 2,
+		PushConstant = 9,
+		StorageBuffer = 12,
+	};
+	enum class Dim : uint32_t {
+		Buffer = 5,
+		SubpassData = 6,
+	};
+};
+
+namespace {
+	struct TypeInfo {
+		spv::Op op {};
+		std::vector<uint32_t> operands; // Operands following the result id
+	};
+	struct MemberInfo {
+		std::optional<uint32_t> offset {};
+		std::optional<uint32_t> matrixStride {};
+		bool rowMajor = false;
+	};
+	struct IdInfo {
+		std::optional<TypeInfo> type {};
+		std::optional<uint32_t> constantValue {};
+		std::optional<uint32_t> set {};
+		std::optional<uint32_t> binding {};
+		std::optional<uint32_t> arrayStride {};
+		bool block = false;
+		bool bufferBlock = false;
+		std::vector<MemberInfo> members;
+		std::string name;
+	};
+	struct Variable {
+		uint32_t id;
+		uint32_t pointerTypeId;
+		spv::StorageClass storageClass;
+	};
+};
+
+static ShaderStageFlags execution_model_to_stage(uint32_t executionModel)
+{
+	switch(executionModel) {
+	case 0:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_VERTEX_BIT);
+	case 1:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
+	case 2:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
+	case 3:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_GEOMETRY_BIT);
+	case 4:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_FRAGMENT_BIT);
+	case 5:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_COMPUTE_BIT);
+	case 5313:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_RAYGEN_BIT_KHR);
+	case 5314:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_INTERSECTION_BIT_KHR);
+	case 5315:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
+	case 5316:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+	case 5317:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_MISS_BIT_KHR);
+	case 5318:
+		return static_cast<ShaderStageFlags>(VK_SHADER_STAGE_CALLABLE_BIT_KHR);
+	}
+	return static_cast<ShaderStageFlags>(0);
+}
+
+static IdInfo &get_id_info(std::vector<IdInfo> &ids, uint32_t id)
+{
+	if(id >= ids.size())
+		ids.resize(id + 1);
+	return ids[id];
+}
+
+static std::optional<uint32_t> calc_type_size(const std::vector<IdInfo> &ids, uint32_t typeId, const MemberInfo *memberInfo = nullptr)
+{
+	if(typeId >= ids.size() || !ids[typeId].type)
+		return {};
+	auto &idInfo = ids[typeId];
+	auto &type = *idInfo.type;
+	switch(type.op) {
+	case spv::Op::TypeBool:
+		return 4;
+	case spv::Op::TypeInt:
+	case spv::Op::TypeFloat:
+		return type.operands.at(0) / 8;
+	case spv::Op::TypeVector:
+		{
+			auto componentSize = calc_type_size(ids, type.operands.at(0));
+			if(!componentSize)
+				return {};
+			return *componentSize * type.operands.at(1);
+		}
+	case spv::Op::TypeMatrix:
+		{
+			auto columnCount = type.operands.at(1);
+			if(!memberInfo || !memberInfo->matrixStride) {
+				auto columnSize = calc_type_size(ids, type.operands.at(0));
+				if(!columnSize)
+					return {};
+				return *columnSize * columnCount;
+			}
+			if(memberInfo->rowMajor) {
+				auto &columnType = ids[type.operands.at(0)].type;
+				if(!columnType)
+					return {};
+				auto rowCount = columnType->operands.at(1);
+				return *memberInfo->matrixStride * rowCount;
+			}
+			return *memberInfo->matrixStride * columnCount;
+		}
+	case spv::Op::TypeArray:
+		{
+			auto lengthId = type.operands.at(1);
+			if(lengthId >= ids.size() || !ids[lengthId].constantValue)
+				return {};
+			auto length = *ids[lengthId].constantValue;
+			if(idInfo.arrayStride)
+				return *idInfo.arrayStride * length;
+			auto elementSize = calc_type_size(ids, type.operands.at(0), memberInfo);
+			if(!elementSize)
+				return {};
+			return *elementSize * length;
+		}
+	case spv::Op::TypeStruct:
+		{
+			uint32_t size = 0;
+			for(auto i = decltype(type.operands.size()) {0u}; i < type.operands.size(); ++i) {
+				auto *member = (i < idInfo.members.size()) ? &idInfo.members[i] : nullptr;
+				auto memberSize = calc_type_size(ids, type.operands[i], member);
+				if(!memberSize)
+					return {};
+				auto offset = (member && member->offset) ? *member->offset : size;
+				size = std::max(size, offset + *memberSize);
+			}
+			return size;
+		}
+	}
+	return {};
+}
+
+static std::optional<DescriptorType> get_descriptor_type(const std::vector<IdInfo> &ids, uint32_t typeId, spv::StorageClass storageClass)
+{
+	auto &type = *ids[typeId].type;
+	switch(type.op) {
+	case spv::Op::TypeSampler:
+		return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_SAMPLER);
+	case spv::Op::TypeSampledImage:
+		return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	case spv::Op::TypeImage:
+		{
+			auto dim = static_cast<spv::Dim>(type.operands.at(1));
+			auto sampled = type.operands.at(5);
+			if(dim == spv::Dim::SubpassData)
+				return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+			if(dim == spv::Dim::Buffer)
+				return static_cast<DescriptorType>((sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+			return static_cast<DescriptorType>((sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+		}
+	case spv::Op::TypeAccelerationStructureKHR:
+		return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR);
+	case spv::Op::TypeStruct:
+		{
+			if(storageClass == spv::StorageClass::StorageBuffer || ids[typeId].bufferBlock)
+				return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			return static_cast<DescriptorType>(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		}
+	}
+	return {};
+}
+
+std::optional<spirv::ReflectionData> prosper::spirv::reflect(const std::vector<unsigned int> &spirv, std::string *optOutErrMsg)
+{
+	auto fail = [optOutErrMsg](const std::string &msg) -> std::optional<ReflectionData> {
+		if(optOutErrMsg)
+			*optOutErrMsg = msg;
+		return {};
+	};
+	if(spirv.size() < spv::HEADER_WORD_COUNT || spirv.front() != spv::MAGIC_NUMBER)
+		return fail("Invalid SPIR-V header");
+	auto idBound = spirv[3];
+	std::vector<IdInfo> ids;
+	ids.resize(idBound);
+	std::vector<Variable> variables;
+	ReflectionData reflectionData {};
+	for(size_t offset = spv::HEADER_WORD_COUNT; offset < spirv.size();) {
+		auto wordCount = spirv[offset] >> 16;
+		auto op = static_cast<spv::Op>(spirv[offset] & 0xFFFF);
+		if(wordCount == 0 || offset + wordCount > spirv.size())
+			return fail("Malformed instruction at word " + std::to_string(offset));
+		auto *args = spirv.data() + offset + 1;
+		auto numArgs = wordCount - 1;
+		switch(op) {
+		case spv::Op::Name:
+			get_id_info(ids, args[0]).name = reinterpret_cast<const char *>(args + 1);
+			break;
+		case spv::Op::EntryPoint:
+			reflectionData.stages |= execution_model_to_stage(args[0]);
+			break;
+		case spv::Op::TypeBool:
+		case spv::Op::TypeInt:
+		case spv::Op::TypeFloat:
+		case spv::Op::TypeVector:
+		case spv::Op::TypeMatrix:
+		case spv::Op::TypeImage:
+		case spv::Op::TypeSampler:
+		case spv::Op::TypeSampledImage:
+		case spv::Op::TypeArray:
+		case spv::Op::TypeRuntimeArray:
+		case spv::Op::TypeStruct:
+		case spv::Op::TypePointer:
+		case spv::Op::TypeAccelerationStructureKHR:
+			get_id_info(ids, args[0]).type = TypeInfo {op, std::vector<uint32_t> {args + 1, args + numArgs}};
+			break;
+		case spv::Op::Constant:
+		case spv::Op::SpecConstant:
+			// Array lengths are 32-bit integer constants; For specialization constants this is the default value
+			if(numArgs >= 3)
+				get_id_info(ids, args[1]).constantValue = args[2];
+			break;
+		case spv::Op::Variable:
+			variables.push_back({args[1], args[0], static_cast<spv::StorageClass>(args[2])});
+			break;
+		case spv::Op::Decorate:
+			{
+				auto &idInfo = get_id_info(ids, args[0]);
+				switch(static_cast<spv::Decoration>(args[1])) {
+				case spv::Decoration::Block:
+					idInfo.block = true;
+					break;
+				case spv::Decoration::BufferBlock:
+					idInfo.bufferBlock = true;
+					break;
+				case spv::Decoration::ArrayStride:
+					idInfo.arrayStride = args[2];
+					break;
+				case spv::Decoration::Binding:
+					idInfo.binding = args[2];
+					break;
+				case spv::Decoration::DescriptorSet:
+					idInfo.set = args[2];
+					break;
+				}
+				break;
+			}
+		case spv::Op::MemberDecorate:
+			{
+				auto &idInfo = get_id_info(ids, args[0]);
+				auto memberIdx = args[1];
+				if(memberIdx >= idInfo.members.size())
+					idInfo.members.resize(memberIdx + 1);
+				auto &member = idInfo.members[memberIdx];
+				switch(static_cast<spv::Decoration>(args[2])) {
+				case spv::Decoration::Offset:
+					member.offset = args[3];
+					break;
+				case spv::Decoration::MatrixStride:
+					member.matrixStride = args[3];
+					break;
+				case spv::Decoration::RowMajor:
+					member.rowMajor = true;
+					break;
+				}
+				break;
+			}
+		}
+		offset += wordCount;
+	}
+
+	for(auto &var : variables) {
+		auto &ptrType = ids[var.pointerTypeId].type;
+		if(!ptrType || ptrType->op != spv::Op::TypePointer)
+			continue;
+		auto typeId = ptrType->operands.at(1);
+		if(var.storageClass == spv::StorageClass::PushConstant) {
+			auto &structInfo = ids[typeId];
+			auto size = calc_type_size(ids, typeId);
+			if(!size)
+				return fail("Unable to determine size of push constant block '" + structInfo.name + "'");
+			uint32_t minOffset = std::numeric_limits<uint32_t>::max();
+			for(auto &member : structInfo.members)
+				minOffset = std::min(minOffset, member.offset.value_or(0));
+			if(minOffset == std::numeric_limits<uint32_t>::max())
+				minOffset = 0;
+			reflectionData.pushConstantRanges.push_back({minOffset, *size - minOffset, reflectionData.stages});
+			continue;
+		}
+		if(var.storageClass != spv::StorageClass::UniformConstant && var.storageClass != spv::StorageClass::Uniform && var.storageClass != spv::StorageClass::StorageBuffer)
+			continue;
+		auto &varInfo = ids[var.id];
+		if(!varInfo.set || !varInfo.binding)
+			continue;
+		DescriptorBinding binding {};
+		binding.set = *varInfo.set;
+		binding.binding = *varInfo.binding;
+		binding.stages = reflectionData.stages;
+		binding.name = varInfo.name;
+		while(ids[typeId].type && (ids[typeId].type->op == spv::Op::TypeArray || ids[typeId].type->op == spv::Op::TypeRuntimeArray)) {
+			auto &arrayType = *ids[typeId].type;
+			if(arrayType.op == spv::Op::TypeRuntimeArray)
+				binding.arraySize = 0;
+			else {
+				auto lengthId = arrayType.operands.at(1);
+				binding.arraySize *= ids[lengthId].constantValue.value_or(1);
+			}
+			typeId = arrayType.operands.at(0);
+		}
+		if(!ids[typeId].type)
+			continue;
+		if(binding.name.empty())
+			binding.name = ids[typeId].name;
+		auto type = get_descriptor_type(ids, typeId, var.storageClass);
+		if(!type)
+			return fail("Unsupported descriptor type for binding '" + binding.name + "'");
+		binding.type = *type;
+		reflectionData.bindings.push_back(std::move(binding));
+	}
+	std::sort(reflectionData.bindings.begin(), reflectionData.bindings.end(), [](const DescriptorBinding &a, const DescriptorBinding &b) { return (a.set != b.set) ? (a.set < b.set) : (a.binding < b.binding); });
+	return reflectionData;
+}
+
+void prosper::spirv::ReflectionData::Merge(const ReflectionData &other)
+{
+	stages |= other.stages;
+	for(auto &binding : other.bindings) {
+		auto it = std::find_if(bindings.begin(), bindings.end(), [&binding](const DescriptorBinding &b) { return b.set == binding.set && b.binding == binding.binding; });
+		if(it != bindings.end()) {
+			it->stages |= binding.stages;
+			if(binding.arraySize == 0 || (it->arraySize != 0 && binding.arraySize > it->arraySize))
+				it->arraySize = binding.arraySize;
+			continue;
+		}
+		bindings.push_back(binding);
+	}
+	std::sort(bindings.begin(), bindings.end(), [](const DescriptorBinding &a, const DescriptorBinding &b) { return (a.set != b.set) ? (a.set < b.set) : (a.binding < b.binding); });
+	for(auto &range : other.pushConstantRanges) {
+		auto it = std::find_if(pushConstantRanges.begin(), pushConstantRanges.end(), [&range](const PushConstantRange &r) { return r.offset == range.offset && r.size == range.size; });
+		if(it != pushConstantRanges.end()) {
+			it->stages |= range.stages;
+			continue;
+		}
+		pushConstantRanges.push_back(range);
+	}
+}
+
+const spirv::DescriptorBinding *prosper::spirv::ReflectionData::FindBinding(uint32_t set, uint32_t binding) const
+{
+	auto it = std::find_if(bindings.begin(), bindings.end(), [set, binding](const DescriptorBinding &b) { return b.set == set && b.binding == binding; });
+	return (it != bindings.end()) ? &*it : nullptr;
+}
+
+uint32_t prosper::spirv::ReflectionData::GetSetCount() const { return bindings.empty() ? 0 : (bindings.back().set + 1); }
+
+static bool is_descriptor_type_compatible(DescriptorType declared, DescriptorType reflected)
+{
+	if(declared == reflected)
+		return true;
+	// Dynamic buffers cannot be distinguished from regular buffers in SPIR-V
+	auto vkDeclared = static_cast<VkDescriptorType>(declared);
+	auto vkReflected = static_cast<VkDescriptorType>(reflected);
+	return (vkDeclared == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && vkReflected == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) || (vkDeclared == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC && vkReflected == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+}
+
+std::vector<spirv::LayoutIssue> prosper::spirv::validate_pipeline_layout(const ReflectionData &reflectionData, const BasePipelineCreateInfo &pipelineCreateInfo)
+{
+	std::vector<LayoutIssue> issues;
+	auto addIssue = [&issues](LayoutIssue::Severity severity, const std::string &msg) { issues.push_back({severity, msg}); };
+	auto *dsInfos = pipelineCreateInfo.GetDsCreateInfoItems();
+	auto numSets = dsInfos ? dsInfos->size() : 0;
+
+	struct DeclaredBinding {
+		DescriptorType type;
+		uint32_t arraySize;
+		ShaderStageFlags stages;
+	};
+	std::vector<std::unordered_map<uint32_t, DeclaredBinding>> declaredBindings;
+	declaredBindings.resize(numSets);
+	for(auto setIdx = decltype(numSets) {0u}; setIdx < numSets; ++setIdx) {
+		auto &dsInfo = dsInfos->at(setIdx);
+		if(!dsInfo)
+			continue;
+		auto numBindings = dsInfo->GetBindingCount();
+		for(auto i = decltype(numBindings) {0u}; i < numBindings; ++i) {
+			uint32_t bindingIndex;
+			DeclaredBinding declared;
+			bool immutableSamplersEnabled;
+			DescriptorBindingFlags flags;
+			if(dsInfo->GetBindingPropertiesByIndexNumber(i, &bindingIndex, &declared.type, &declared.arraySize, &declared.stages, &immutableSamplersEnabled, &flags))
+				declaredBindings[setIdx][bindingIndex] = declared;
+		}
+	}
+
+	// Every binding used by the shader must be declared
+	for(auto &binding : reflectionData.bindings) {
+		auto prefix = "Binding '" + binding.name + "' (set " + std::to_string(binding.set) + ", binding " + std::to_string(binding.binding) + ")";
+		if(binding.set >= numSets || !dsInfos->at(binding.set)) {
+			addIssue(LayoutIssue::Severity::Error, prefix + " is used by the shader, but the descriptor set is not declared");
+			continue;
+		}
+		auto it = declaredBindings[binding.set].find(binding.binding);
+		if(it == declaredBindings[binding.set].end()) {
+			addIssue(LayoutIssue::Severity::Error, prefix + " is used by the shader, but is not declared");
+			continue;
+		}
+		auto &declared = it->second;
+		if(!is_descriptor_type_compatible(declared.type, binding.type))
+			addIssue(LayoutIssue::Severity::Error, prefix + " is declared with descriptor type " + std::to_string(pragma::math::to_integral(declared.type)) + ", but the shader expects " + std::to_string(pragma::math::to_integral(binding.type)));
+		if(binding.arraySize != 0 && declared.arraySize < binding.arraySize)
+			addIssue(LayoutIssue::Severity::Error, prefix + " is declared with " + std::to_string(declared.arraySize) + " descriptors, but the shader expects " + std::to_string(binding.arraySize));
+		else if(binding.arraySize != 0 && declared.arraySize > binding.arraySize)
+			addIssue(LayoutIssue::Severity::Redundant, prefix + " is declared with " + std::to_string(declared.arraySize) + " descriptors, but the shader only uses " + std::to_string(binding.arraySize));
+		if((declared.stages & binding.stages) != binding.stages)
+			addIssue(LayoutIssue::Severity::Error, prefix + " is not visible to all shader stages that use it");
+	}
+
+	// Declared bindings that no stage uses only waste descriptor pool space
+	for(auto setIdx = decltype(numSets) {0u}; setIdx < numSets; ++setIdx) {
+		for(auto &[bindingIndex, declared] : declaredBindings[setIdx]) {
+			if(!reflectionData.FindBinding(setIdx, bindingIndex))
+				addIssue(LayoutIssue::Severity::Redundant, "Binding " + std::to_string(bindingIndex) + " of set " + std::to_string(setIdx) + " is declared, but not used by any shader stage");
+		}
+	}
+
+	auto &declaredRanges = pipelineCreateInfo.GetPushConstantRanges();
+	for(auto &range : reflectionData.pushConstantRanges) {
+		auto covered = std::find_if(declaredRanges.begin(), declaredRanges.end(), [&range](const auto &declared) {
+			return declared.offset <= range.offset && declared.offset + declared.size >= range.offset + range.size && (declared.stages & range.stages) == range.stages;
+		}) != declaredRanges.end();
+		if(!covered)
+			addIssue(LayoutIssue::Severity::Error, "Push constant range [" + std::to_string(range.offset) + ", " + std::to_string(range.offset + range.size) + ") is not covered by the declared push constant ranges");
+	}
+	return issues;
+}
+
+std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> prosper::spirv::to_anvil_descriptor_set_create_infos(const ReflectionData &reflectionData)
+{
+	std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> dsInfos;
+	auto numSets = reflectionData.GetSetCount();
+	dsInfos.reserve(numSets);
+	for(auto i = decltype(numSets) {0u}; i < numSets; ++i)
+		dsInfos.push_back(Anvil::DescriptorSetCreateInfo::create());
+	for(auto &binding : reflectionData.bindings) {
+		auto arraySize = binding.arraySize;
+		Anvil::DescriptorBindingFlags flags = Anvil::DescriptorBindingFlagBits::NONE;
+		if(arraySize == 0) {
+			// Runtime-sized arrays require descriptor indexing, the actual upper bound has to be provided by the caller
+			arraySize = 1;
+			flags = Anvil::DescriptorBindingFlagBits::VARIABLE_DESCRIPTOR_COUNT_BIT | Anvil::DescriptorBindingFlagBits::PARTIALLY_BOUND_BIT;
+		}
+		dsInfos[binding.set]->add_binding(binding.binding, static_cast<Anvil::DescriptorType>(binding.type), arraySize, static_cast<Anvil::ShaderStageFlagBits>(binding.stages), flags, nullptr);
+	}
+	return dsInfos;
+}
@@ -14,9 +14,15 @@ module;
 #include <misc/descriptor_set_create_info.h>
 #include <misc/glsl_to_spirv.h>
 #include <cassert>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROSPER_VULKAN_SSE2
+#endif
 
 module pragma.prosper.vulkan;
 
+import :image.format_conversion;
 import :util;
 import pragma.filesystem;
 
@@ -77,12 +83,46 @@ static bool glsl_to_spv(prosper::IPrContext &context, prosper::ShaderStage stage
 
 static std::string get_cache_path(const std::string &shaderRootPath, bool withDebugInfo) { return pragma::util::DirPath("cache", shaderRootPath, withDebugInfo ? "spirv_full" : "spirv").GetString(); }
 
+static bool write_spirv_cache_file(const std::string &fileName, const std::vector<unsigned int> &spirv)
+{
+	pragma::fs::create_path(ufile::get_path_from_filename(fileName));
+	auto fOut = pragma::fs::open_file<pragma::fs::VFilePtrReal>(fileName, pragma::fs::FileMode::Write | pragma::fs::FileMode::Binary);
+	if(fOut == nullptr)
+		return false;
+	fOut->Write(spirv.data(), spirv.size() * sizeof(unsigned int));
+	return true;
+}
+
+// Runs the SPIR-V optimizer over the specified range of the blob and stores the result in the optimized cache.
+// The unoptimized blob is kept as-is, so the optimization stage can be toggled without recompiling.
+static void optimize_spirv(prosper::IPrContext &context, std::vector<unsigned int> &spirv, size_t offset, const std::string &shaderRootPath, const std::string &cacheFileName)
+{
+	auto &settings = static_cast<prosper::VlkContext &>(context).GetSpirvOptimizationSettings();
+	std::vector<unsigned int> input {spirv.begin() + offset, spirv.end()};
+	std::vector<unsigned int> optimized;
+	std::string errMsg;
+	if(!prosper::spirv::optimize(input, optimized, settings.flags, &errMsg)) {
+		context.Log("Failed to optimize SPIR-V for shader '" + cacheFileName + "': " + errMsg, pragma::util::LogSeverity::Warning);
+		return;
+	}
+	if(settings.report) {
+		prosper::spirv::OptimizationReport report {cacheFileName, prosper::spirv::count_instructions(input), prosper::spirv::count_instructions(optimized), input.size() * sizeof(unsigned int), optimized.size() * sizeof(unsigned int), true};
+		context.Log("SPIR-V optimization: " + report.ToString(), pragma::util::LogSeverity::Info);
+	}
+	write_spirv_cache_file(pragma::util::FilePath(prosper::spirv::get_optimized_cache_path(shaderRootPath, settings.flags), cacheFileName).GetString(), optimized);
+	spirv.resize(offset);
+	spirv.insert(spirv.end(), optimized.begin(), optimized.end());
+}
+
 bool prosper::glsl_to_spv(IPrContext &context, prosper::ShaderStage stage, const std::string &shaderRootPath, const std::string &relFileName, std::vector<unsigned int> &spirv, std::string *infoLog, std::string *debugInfoLog, bool bReload, const std::string &prefixCode,
   const std::unordered_map<std::string, std::string> &definitions, bool withDebugInfo)
 {
 	auto spvCachePath = get_cache_path(shaderRootPath, withDebugInfo);
 	auto fileName = pragma::util::FilePath(shaderRootPath, relFileName).GetString();
 	auto fName = fileName;
+	// Shaders with debug information are used for diagnostics, so we don't want the optimizer to touch them
+	auto optimize = !withDebugInfo && static_cast<VlkContext &>(context).GetSpirvOptimizationSettings().flags != prosper::spirv::OptimizationFlags::None;
+	std::optional<std::string> spvCacheFileName {};
 	std::string ext;
 	if(!ufile::get_extension(fileName, &ext)) {
 		auto stageExt = prosper::glsl::get_shader_file_extension(stage);
@@ -92,11 +132,20 @@ bool prosper::glsl_to_spv(IPrContext &context, prosper::ShaderStage stage, const
 		if(bSpvExists == true) {
 			ext = "spv";
 			fName = fNameSpv;
+			spvCacheFileName = fullFileName + ".spv";
+			if(optimize) {
+				auto fNameSpvOpt = pragma::util::FilePath(prosper::spirv::get_optimized_cache_path(shaderRootPath, static_cast<VlkContext &>(context).GetSpirvOptimizationSettings().flags), *spvCacheFileName).GetString();
+				if(pragma::fs::exists(fNameSpvOpt)) {
+					fName = fNameSpvOpt;
+					spvCacheFileName = {}; // Already optimized
+				}
+			}
 		}
 		if(bSpvExists == false || bReload == true) {
 			if(pragma::fs::exists(fullFileName)) {
 				ext = stageExt;
 				fName = fullFileName;
+				spvCacheFileName = {};
 			}
 		}
 	}
@@ -123,6 +172,8 @@ bool prosper::glsl_to_spv(IPrContext &context, prosper::ShaderStage stage, const
 		auto origSize = spirv.size();
 		spirv.resize(origSize + sz / sizeof(unsigned int));
 		f->Read(spirv.data() + origSize, sz);
+		if(optimize && spvCacheFileName.has_value()) // Cache entry predates the optimization stage
+			optimize_spirv(context, spirv, origSize, shaderRootPath, *spvCacheFileName);
 		return true;
 	}
 
@@ -166,11 +217,9 @@ bool prosper::glsl_to_spv(IPrContext &context, prosper::ShaderStage stage, const
 	if(r == false)
 		return r;
 	auto spirvName = pragma::util::FilePath(spvCachePath, fName + ".spv").GetString();
-	pragma::fs::create_path(ufile::get_path_from_filename(spirvName));
-	auto fOut = pragma::fs::open_file<pragma::fs::VFilePtrReal>(spirvName, pragma::fs::FileMode::Write | pragma::fs::FileMode::Binary);
-	if(fOut == nullptr)
-		return r;
-	fOut->Write(spirv.data(), spirv.size() * sizeof(unsigned int));
+	write_spirv_cache_file(spirvName, spirv);
+	if(optimize)
+		optimize_spirv(context, spirv, 0, shaderRootPath, fName + ".spv");
 	return r;
 }
 
@@ -335,37 +384,21 @@ void prosper::util::initialize_image(Anvil::BaseDevice &dev, const pragma::image
 	uint8_t *outDataPtr = nullptr;
 	memBlock->map(0ull, size, reinterpret_cast<void **>(&outDataPtr));
 
-	auto *imgData = static_cast<const uint8_t *>(imgSrc.GetData());
-	auto pos = decltype(imgSrc.GetSize()) {0};
-	auto tgaFormat = imgSrc.GetFormat();
-	auto srcPxSize = get_byte_size(srcFormat);
-	auto rowPitch = w * srcPxSize;
-	for(auto y = h; y > 0;) {
-		--y;
-		auto *row = outDataPtr + y * rowPitch;
-		for(auto x = decltype(w) {0}; x < w; ++x) {
-			auto *px = row;
-			px[0] = imgData[pos];
-			px[1] = imgData[pos + 1];
-			px[2] = imgData[pos + 2];
-			switch(tgaFormat) {
-			case pragma::image::Format::RGBA8:
-				{
-					pos += 4;
-					if(srcFormat == Format::R8G8B8A8_UNorm)
-						px[3] = imgData[pos + 3];
-					break;
-				}
-			default:
-				{
-					if(srcFormat == Format::R8G8B8A8_UNorm)
-						px[3] = std::numeric_limits<uint8_t>::max();
-					pos += 3;
-					break;
-				}
-			}
-			row += srcPxSize;
-		}
+	auto conversion = util::PixelConversion::None;
+	if(imgSrc.GetFormat() == pragma::image::Format::RGBA8) {
+		if(srcFormat == Format::R8G8B8_UNorm_PoorCoverage)
+			conversion = util::PixelConversion::Rgba8ToRgb8;
+	}
+	else if(srcFormat == Format::R8G8B8A8_UNorm)
+		conversion = util::PixelConversion::Rgb8ToRgba8;
+	// The tga rows are stored bottom-up
+	if(conversion != util::PixelConversion::None)
+		util::convert_image(conversion, imgSrc.GetData(), outDataPtr, w, h, true);
+	else {
+		auto rowPitch = w * get_byte_size(srcFormat);
+		auto *imgData = static_cast<const uint8_t *>(imgSrc.GetData());
+		for(auto y = decltype(h) {0u}; y < h; ++y)
+			memcpy(outDataPtr + (h - 1 - y) * rowPitch, imgData + y * rowPitch, rowPitch);
 	}
 
 	memBlock->unmap();
@@ -499,3 +532,54 @@ bool prosper::util::get_memory_stats(IPrContext &context, MemoryPropertyFlags me
 		*optOutMemIndices = deviceLocalTypes;
 	return true;
 }
+
+void prosper::util::copy_write_combined(void *dst, const void *src, size_t size)
+{
+#ifdef PROSPER_VULKAN_SSE2
+	auto *d = static_cast<uint8_t *>(dst);
+	auto *s = static_cast<const uint8_t *>(src);
+	// Streaming stores require a 16 byte aligned destination
+	auto head = static_cast<size_t>((16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15);
+	if(size < head + 64) {
+		memcpy(d, s, size);
+		return;
+	}
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+	// Write full 64 byte blocks so that each write-combining buffer is flushed as a whole
+	auto numBlocks = size / 64;
+	for(auto i = decltype(numBlocks) {0u}; i < numBlocks; ++i) {
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+		auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+		auto e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d), a);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 48), e);
+		d += 64;
+		s += 64;
+	}
+	memcpy(d, s, size % 64);
+	// Non-temporal stores are weakly ordered
+	_mm_sfence();
+#else
+	memcpy(dst, src, size);
+#endif
+}
+
+bool prosper::util::has_stencil_aspect(Format format)
+{
+	switch(format) {
+	case Format::S8_UInt:
+	case Format::D16_UNorm_S8_UInt:
+	case Format::D24_UNorm_S8_UInt:
+	case Format::D32_SFloat_S8_UInt:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
@@ -0,0 +1,680 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/memory_allocator.h>
+#include <misc/memalloc_backends/backend_vma.h>
+#include <wrappers/device.h>
+#include <wrappers/image.h>
+#include <wrappers/physical_device.h>
+#include <wrappers/queue.h>
+#include <wrappers/semaphore.h>
+
+module pragma.prosper.vulkan;
+
+import :virtual_texture;
+
+using namespace prosper;
+
+static void record_image_transition(ICommandBuffer &cmd, IImage &img, ImageLayout oldLayout, ImageLayout newLayout, AccessFlags srcAccessMask, AccessFlags dstAccessMask, PipelineStageFlags srcStageMask, PipelineStageFlags dstStageMask)
+{
+	prosper::util::ImageBarrierInfo imgBarrierInfo {};
+	imgBarrierInfo.srcAccessMask = srcAccessMask;
+	imgBarrierInfo.dstAccessMask = dstAccessMask;
+	imgBarrierInfo.oldLayout = oldLayout;
+	imgBarrierInfo.newLayout = newLayout;
+	imgBarrierInfo.subresourceRange = {0, img.GetMipmapCount(), 0, img.GetLayerCount()};
+	imgBarrierInfo.srcQueueFamilyIndex = imgBarrierInfo.dstQueueFamilyIndex = img.GetContext().GetUniversalQueueFamilyIndex();
+
+	prosper::util::PipelineBarrierInfo barrierInfo {};
+	barrierInfo.srcStageMask = srcStageMask;
+	barrierInfo.dstStageMask = dstStageMask;
+	barrierInfo.imageBarriers.push_back(prosper::util::create_image_barrier(img, imgBarrierInfo));
+	cmd.RecordPipelineBarrier(barrierInfo);
+}
+static void record_begin_upload(ICommandBuffer &cmd, IImage &img, bool initialized)
+{
+	if(initialized)
+		record_image_transition(cmd, img, ImageLayout::ShaderReadOnlyOptimal, ImageLayout::TransferDstOptimal, AccessFlags::ShaderReadBit, AccessFlags::TransferWriteBit, PipelineStageFlags::AllCommands, PipelineStageFlags::TransferBit);
+	else
+		record_image_transition(cmd, img, ImageLayout::Undefined, ImageLayout::TransferDstOptimal, AccessFlags {}, AccessFlags::TransferWriteBit, PipelineStageFlags::TopOfPipeBit, PipelineStageFlags::TransferBit);
+}
+static void record_end_upload(ICommandBuffer &cmd, IImage &img)
+{
+	record_image_transition(cmd, img, ImageLayout::TransferDstOptimal, ImageLayout::ShaderReadOnlyOptimal, AccessFlags::TransferWriteBit, AccessFlags::ShaderReadBit, PipelineStageFlags::TransferBit, PipelineStageFlags::AllCommands);
+}
+static void record_copy_region(ICommandBuffer &cmd, IBuffer &stagingBuffer, DeviceSize stagingOffset, IImage &img, uint32_t mipLevel, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+	prosper::util::BufferImageCopyInfo copyInfo {};
+	copyInfo.bufferOffset = stagingOffset;
+	copyInfo.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y)};
+	copyInfo.imageExtent = Vector2i {static_cast<int32_t>(w), static_cast<int32_t>(h)};
+	copyInfo.mipLevel = mipLevel;
+	copyInfo.dstImageLayout = ImageLayout::TransferDstOptimal;
+	cmd.RecordCopyBufferToImage(copyInfo, stagingBuffer, img);
+}
+
+namespace prosper {
+	// Tiles are bound to a sparse image through vkQueueBindSparse. Each slot of the tile cache owns one sparse block of device memory.
+	// The binds are submitted to a sparse binding queue and signal a semaphore, which the next submission to the universal queue waits on.
+	class SparseVirtualTexture : public VirtualTexture {
+	  public:
+		static bool IsSupported(VlkContext &context, const CreateInfo &createInfo);
+		SparseVirtualTexture(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader) : VirtualTexture {context, createInfo, tileLoader} {}
+		virtual ~SparseVirtualTexture() override;
+		bool Initialize();
+		virtual bool IsSparse() const override { return true; }
+	  protected:
+		virtual bool CommitUploads(const std::vector<Upload> &uploads, uint32_t frameIndex) override;
+		virtual void RecordUploads(ICommandBuffer &cmd, IBuffer &stagingBuffer, const std::vector<Upload> &uploads, DeviceSize extraStagingOffset) override;
+	  private:
+		// Released once the image is no longer in use by any frame
+		struct PageMemory {
+			~PageMemory();
+			VmaAllocator allocator = VK_NULL_HANDLE;
+			std::vector<VmaAllocation> pages;
+			VmaAllocation mipTail = VK_NULL_HANDLE;
+		};
+		bool SubmitBind(VkBindSparseInfo bindInfo, uint32_t semaphoreIndex);
+		Anvil::Queue *m_queue = nullptr;
+		// One per frame index, plus one for the initial bind of the mip tail. A semaphore can only be re-used once the frame that waited on it has completed.
+		std::vector<std::shared_ptr<Anvil::Semaphore>> m_bindSemaphores;
+		std::shared_ptr<PageMemory> m_pageMemory;
+		std::vector<VmaAllocationInfo> m_pageInfos;
+		uint32_t m_mipTailFirstLod = 0;
+		bool m_mipTailUploaded = false;
+		bool m_initialized = false;
+	};
+
+	// Fallback for devices without sparse residency: Tiles are placed in a physical tile atlas, and an indirection texture
+	// maps each virtual tile to its atlas slot (or to the slot of the closest resident ancestor).
+	class SoftwareVirtualTexture : public VirtualTexture {
+	  public:
+		SoftwareVirtualTexture(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader) : VirtualTexture {context, createInfo, tileLoader} {}
+		bool Initialize();
+		virtual bool IsSparse() const override { return false; }
+	  protected:
+		virtual bool CommitUploads(const std::vector<Upload> &uploads, uint32_t frameIndex) override;
+		virtual void RecordUploads(ICommandBuffer &cmd, IBuffer &stagingBuffer, const std::vector<Upload> &uploads, DeviceSize extraStagingOffset) override;
+	  private:
+		void UpdateIndirection();
+		uint32_t m_slotsPerRow = 0;
+		std::vector<std::vector<std::array<uint8_t, 4>>> m_indirection;
+		bool m_indirectionDirty = true;
+		bool m_atlasInitialized = false;
+		bool m_indirectionInitialized = false;
+	};
+};
+
+static VmaAllocator get_vma_allocator(VlkContext &context)
+{
+	auto *memAllocator = context.GetMemoryAllocator();
+	if(memAllocator == nullptr)
+		return VK_NULL_HANDLE;
+	auto *backend = memAllocator->GetAllocatorBackend();
+	if(backend == nullptr)
+		return VK_NULL_HANDLE;
+	return static_cast<Anvil::MemoryAllocatorBackends::VMA *>(backend)->GetVmaHandle();
+}
+
+std::shared_ptr<VirtualTexture> VirtualTexture::Create(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader)
+{
+	if(createInfo.width == 0 || createInfo.height == 0 || createInfo.physicalTileCount == 0 || createInfo.frameCount == 0 || !tileLoader)
+		return nullptr;
+	if(util::is_compressed_format(createInfo.format)) {
+		context.Log("Virtual textures with compressed formats are not supported!", pragma::util::LogSeverity::Error);
+		return nullptr;
+	}
+	if(createInfo.allowSparse && SparseVirtualTexture::IsSupported(context, createInfo)) {
+		auto vt = std::shared_ptr<SparseVirtualTexture> {new SparseVirtualTexture {context, createInfo, tileLoader}};
+		if(vt->Initialize())
+			return vt;
+		context.Log("Failed to initialize sparse virtual texture, falling back to software virtual texture...", pragma::util::LogSeverity::Warning);
+	}
+	auto vt = std::shared_ptr<SoftwareVirtualTexture> {new SoftwareVirtualTexture {context, createInfo, tileLoader}};
+	if(!vt->Initialize())
+		return nullptr;
+	return vt;
+}
+
+VirtualTexture::VirtualTexture(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader) : m_context {context}, m_createInfo {createInfo}, m_tileLoader {tileLoader} {}
+
+VirtualTexture::~VirtualTexture()
+{
+	if(m_stagingBuffer && m_stagingData)
+		m_stagingBuffer->Unmap();
+}
+
+bool VirtualTexture::InitializeBase(uint32_t tileWidth, uint32_t tileHeight, uint32_t tiledMipCount, DeviceSize extraStagingSizePerFrame)
+{
+	m_tileWidth = tileWidth;
+	m_tileHeight = tileHeight;
+	m_tiledMipCount = pragma::math::min(tiledMipCount, 16u);
+
+	// The coarsest tiled mipmap is always resident, so there is always something to fall back to
+	if(m_tiledMipCount > 0) {
+		auto coarsestMip = m_tiledMipCount - 1;
+		auto numPinned = GetTileCountX(coarsestMip) * GetTileCountY(coarsestMip);
+		if(numPinned >= m_createInfo.physicalTileCount) {
+			m_context.Log("Virtual texture requires more than " + std::to_string(numPinned) + " physical tiles!", pragma::util::LogSeverity::Error);
+			return false;
+		}
+		for(auto y = decltype(GetTileCountY(coarsestMip)) {0u}; y < GetTileCountY(coarsestMip); ++y) {
+			for(auto x = decltype(GetTileCountX(coarsestMip)) {0u}; x < GetTileCountX(coarsestMip); ++x)
+				m_pendingTiles.insert(Tile::Pack(x, y, coarsestMip));
+		}
+	}
+
+	m_slots.resize(m_createInfo.physicalTileCount);
+	for(auto i = decltype(m_slots.size()) {0u}; i < m_slots.size(); ++i) {
+		m_lru.push_back(static_cast<uint32_t>(i));
+		m_slots[i].lruIt = std::prev(m_lru.end());
+	}
+
+	util::BufferCreateInfo feedbackCreateInfo {};
+	feedbackCreateInfo.size = sizeof(uint32_t) * (1 + m_createInfo.feedbackCapacity);
+	feedbackCreateInfo.usageFlags = BufferUsageFlags::StorageBufferBit | BufferUsageFlags::TransferDstBit;
+	feedbackCreateInfo.memoryFeatures = MemoryFeatureFlags::GPUToCPU;
+	feedbackCreateInfo.debugName = m_createInfo.debugName + "_vt_feedback";
+	m_feedbackBuffers.reserve(m_createInfo.frameCount);
+	for(auto i = decltype(m_createInfo.frameCount) {0u}; i < m_createInfo.frameCount; ++i) {
+		auto buf = m_context.CreateBuffer(feedbackCreateInfo);
+		if(!buf)
+			return false;
+		uint32_t count = 0;
+		buf->Write(0, sizeof(count), &count);
+		m_feedbackBuffers.push_back(buf);
+	}
+
+	m_stagingSizePerFrame = m_createInfo.maxUploadsPerUpdate * GetTileByteSize() + extraStagingSizePerFrame;
+	util::BufferCreateInfo stagingCreateInfo {};
+	stagingCreateInfo.size = m_stagingSizePerFrame * m_createInfo.frameCount;
+	stagingCreateInfo.usageFlags = BufferUsageFlags::TransferSrcBit;
+	stagingCreateInfo.memoryFeatures = MemoryFeatureFlags::CPUToGPU;
+	stagingCreateInfo.debugName = m_createInfo.debugName + "_vt_staging";
+	m_stagingBuffer = m_context.CreateBuffer(stagingCreateInfo);
+	if(!m_stagingBuffer)
+		return false;
+	void *ptr = nullptr;
+	if(m_stagingBuffer->Map(0, stagingCreateInfo.size, IBuffer::MapFlags::None, &ptr) == false || ptr == nullptr)
+		return false;
+	m_stagingData = static_cast<uint8_t *>(ptr);
+	return true;
+}
+
+uint32_t VirtualTexture::GetTileCountX(uint32_t mip) const
+{
+	if(mip >= m_tiledMipCount)
+		return 0;
+	return (util::calculate_mipmap_size(m_createInfo.width, mip) + m_tileWidth - 1) / m_tileWidth;
+}
+uint32_t VirtualTexture::GetTileCountY(uint32_t mip) const
+{
+	if(mip >= m_tiledMipCount)
+		return 0;
+	return (util::calculate_mipmap_size(m_createInfo.height, mip) + m_tileHeight - 1) / m_tileHeight;
+}
+VirtualTexture::TileRegion VirtualTexture::GetTileRegion(const Tile &tile) const
+{
+	TileRegion region {};
+	region.tile = tile;
+	region.offsetX = tile.x * m_tileWidth;
+	region.offsetY = tile.y * m_tileHeight;
+	region.width = pragma::math::min(m_tileWidth, util::calculate_mipmap_size(m_createInfo.width, tile.mip) - region.offsetX);
+	region.height = pragma::math::min(m_tileHeight, util::calculate_mipmap_size(m_createInfo.height, tile.mip) - region.offsetY);
+	return region;
+}
+DeviceSize VirtualTexture::GetTileByteSize() const { return static_cast<DeviceSize>(m_tileWidth) * m_tileHeight * util::get_pixel_size(m_createInfo.format); }
+bool VirtualTexture::IsResident(const Tile &tile) const { return m_residentTiles.find(tile.Pack()) != m_residentTiles.end(); }
+
+void VirtualTexture::Touch(uint32_t slotIdx)
+{
+	auto &slot = m_slots[slotIdx];
+	slot.lastUsedFrame = m_frame;
+	if(slot.pinned)
+		return;
+	m_lru.splice(m_lru.begin(), m_lru, slot.lruIt);
+}
+
+std::optional<uint32_t> VirtualTexture::AcquireSlot()
+{
+	if(m_lru.empty())
+		return {};
+	auto slotIdx = m_lru.back();
+	auto &slot = m_slots[slotIdx];
+	// The least recently used tile may still be sampled by frames that are in flight
+	if(slot.tile != Tile::INVALID && slot.lastUsedFrame + m_createInfo.frameCount >= m_frame)
+		return {};
+	return slotIdx;
+}
+
+void VirtualTexture::RequestTiles(const uint32_t *tileIds, uint32_t count)
+{
+	std::scoped_lock lock {m_requestMutex};
+	m_cpuRequests.insert(m_cpuRequests.end(), tileIds, tileIds + count);
+}
+
+void VirtualTexture::ProcessFeedback(uint32_t frameIndex)
+{
+	// The frame that last used this frame index has completed, so the feedback it has written can be read back
+	auto &feedbackBuffer = GetFeedbackBuffer(frameIndex);
+	uint32_t count = 0;
+	feedbackBuffer.Read(0, sizeof(count), &count);
+	count = pragma::math::min(count, m_createInfo.feedbackCapacity);
+	std::vector<uint32_t> requests;
+	requests.resize(count);
+	if(count > 0)
+		feedbackBuffer.Read(sizeof(uint32_t), count * sizeof(uint32_t), requests.data());
+	uint32_t zero = 0;
+	feedbackBuffer.Write(0, sizeof(zero), &zero);
+
+	{
+		std::scoped_lock lock {m_requestMutex};
+		requests.insert(requests.end(), m_cpuRequests.begin(), m_cpuRequests.end());
+		m_cpuRequests.clear();
+	}
+
+	std::unordered_set<uint32_t> processed;
+	for(auto id : requests) {
+		if(id == Tile::INVALID || processed.insert(id).second == false)
+			continue;
+		auto tile = Tile::Unpack(id);
+		if(tile.mip >= m_tiledMipCount || tile.x >= GetTileCountX(tile.mip) || tile.y >= GetTileCountY(tile.mip))
+			continue;
+		++m_stats.requests;
+		// Request the ancestors as well, so the fallback gets progressively better while the tile is being streamed in
+		for(auto mip = tile.mip; mip < m_tiledMipCount; ++mip) {
+			auto mipId = Tile::Pack(tile.x >> (mip - tile.mip), tile.y >> (mip - tile.mip), mip);
+			auto it = m_residentTiles.find(mipId);
+			if(it != m_residentTiles.end())
+				Touch(it->second);
+			else
+				m_pendingTiles.insert(mipId);
+		}
+	}
+}
+
+void VirtualTexture::Update(ICommandBuffer &cmd, uint32_t frameIndex)
+{
+	++m_frame;
+	ProcessFeedback(frameIndex);
+
+	// Coarse tiles first, since they serve as fallback for the finer ones
+	std::vector<uint32_t> pending {m_pendingTiles.begin(), m_pendingTiles.end()};
+	std::sort(pending.begin(), pending.end(), [](uint32_t a, uint32_t b) { return Tile::Unpack(a).mip > Tile::Unpack(b).mip; });
+
+	auto stagingBaseOffset = (frameIndex % m_createInfo.frameCount) * m_stagingSizePerFrame;
+	auto tileByteSize = GetTileByteSize();
+	auto pixelSize = util::get_pixel_size(m_createInfo.format);
+	std::vector<Upload> uploads;
+	uploads.reserve(pragma::math::min(static_cast<uint32_t>(pending.size()), m_createInfo.maxUploadsPerUpdate));
+	for(auto id : pending) {
+		if(uploads.size() >= m_createInfo.maxUploadsPerUpdate)
+			break;
+		auto slotIdx = AcquireSlot();
+		if(!slotIdx)
+			break;
+		Upload upload {};
+		upload.region = GetTileRegion(Tile::Unpack(id));
+		upload.slot = *slotIdx;
+		upload.stagingOffset = stagingBaseOffset + uploads.size() * tileByteSize;
+		m_pendingTiles.erase(id);
+		if(!m_tileLoader(upload.region, m_stagingData + upload.stagingOffset, static_cast<DeviceSize>(upload.region.width) * upload.region.height * pixelSize))
+			continue;
+		auto &slot = m_slots[*slotIdx];
+		upload.evictedTile = slot.tile;
+		if(slot.tile != Tile::INVALID) {
+			m_residentTiles.erase(slot.tile);
+			++m_stats.evictions;
+		}
+		slot.tile = id;
+		Touch(*slotIdx);
+		if(upload.region.tile.mip == m_tiledMipCount - 1) {
+			slot.pinned = true;
+			m_lru.erase(slot.lruIt);
+		}
+		m_residentTiles[id] = *slotIdx;
+		uploads.push_back(upload);
+	}
+	m_stats.uploads += uploads.size();
+	m_stats.residentTiles = static_cast<uint32_t>(m_residentTiles.size());
+	m_stats.pendingTiles = static_cast<uint32_t>(m_pendingTiles.size());
+
+	if(!CommitUploads(uploads, frameIndex))
+		return;
+	RecordUploads(cmd, *m_stagingBuffer, uploads, stagingBaseOffset + m_createInfo.maxUploadsPerUpdate * tileByteSize);
+}
+
+////////////////
+
+bool SparseVirtualTexture::IsSupported(VlkContext &context, const CreateInfo &createInfo)
+{
+	auto &dev = context.GetDevice();
+	auto &features = *dev.get_physical_device_features().core_vk1_0_features_ptr;
+	if(!features.sparse_binding || !features.sparse_residency_image_2D || get_vma_allocator(context) == VK_NULL_HANDLE)
+		return false;
+	auto vkPhysDev = dev.get_physical_device()->get_physical_device();
+	uint32_t propCount = 0;
+	vkGetPhysicalDeviceSparseImageFormatProperties(vkPhysDev, static_cast<VkFormat>(createInfo.format), VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TILING_OPTIMAL, &propCount, nullptr);
+	if(propCount == 0)
+		return false;
+
+	// The binds have to be submitted to a queue that supports sparse binding
+	return dev.get_sparse_binding_queue(0) != nullptr;
+}
+
+SparseVirtualTexture::PageMemory::~PageMemory()
+{
+	if(!pages.empty())
+		vmaFreeMemoryPages(allocator, pages.size(), pages.data());
+	if(mipTail != VK_NULL_HANDLE)
+		vmaFreeMemory(allocator, mipTail);
+}
+
+SparseVirtualTexture::~SparseVirtualTexture()
+{
+	// The image may still be in use by frames in flight, and the semaphores may still be waited on
+	if(m_pageMemory)
+		m_context.KeepThreadSafeResourceAliveUntilPresentationComplete(m_pageMemory);
+	for(auto &semaphore : m_bindSemaphores)
+		m_context.KeepThreadSafeResourceAliveUntilPresentationComplete(semaphore);
+}
+
+bool SparseVirtualTexture::Initialize()
+{
+	auto &dev = m_context.GetDevice();
+	auto vkDevice = dev.get_device_vk();
+	m_queue = dev.get_sparse_binding_queue(0);
+	if(m_queue == nullptr)
+		return false;
+	m_bindSemaphores.reserve(m_createInfo.frameCount + 1);
+	for(auto i = decltype(m_createInfo.frameCount) {0u}; i < m_createInfo.frameCount + 1; ++i) {
+		auto semaphore = Anvil::Semaphore::create(Anvil::SemaphoreCreateInfo::create(&dev));
+		if(semaphore == nullptr)
+			return false;
+		m_bindSemaphores.push_back(std::shared_ptr<Anvil::Semaphore> {std::move(semaphore)});
+	}
+
+	util::ImageCreateInfo imgCreateInfo {};
+	imgCreateInfo.width = m_createInfo.width;
+	imgCreateInfo.height = m_createInfo.height;
+	imgCreateInfo.format = m_createInfo.format;
+	imgCreateInfo.usage = ImageUsageFlags::SampledBit | ImageUsageFlags::TransferDstBit;
+	imgCreateInfo.tiling = ImageTiling::Optimal;
+	imgCreateInfo.memoryFeatures = MemoryFeatureFlags::DeviceLocal;
+	imgCreateInfo.flags = util::ImageCreateInfo::Flags::Sparse | util::ImageCreateInfo::Flags::FullMipmapChain;
+	imgCreateInfo.postCreateLayout = ImageLayout::Undefined;
+	imgCreateInfo.debugName = m_createInfo.debugName + "_vt_sparse";
+	m_image = m_context.CreateImage(imgCreateInfo);
+	if(!m_image)
+		return false;
+	auto vkImage = static_cast<VlkImage &>(*m_image).GetAnvilImage().get_image();
+
+	uint32_t reqCount = 0;
+	vkGetImageSparseMemoryRequirements(vkDevice, vkImage, &reqCount, nullptr);
+	std::vector<VkSparseImageMemoryRequirements> sparseReqs {reqCount};
+	vkGetImageSparseMemoryRequirements(vkDevice, vkImage, &reqCount, sparseReqs.data());
+	const VkSparseImageMemoryRequirements *colorReqs = nullptr;
+	for(auto &req : sparseReqs) {
+		if(req.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT)
+			return false; // Metadata aspects are not supported
+		if(req.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT)
+			colorReqs = &req;
+	}
+	if(colorReqs == nullptr)
+		return false;
+	auto &granularity = colorReqs->formatProperties.imageGranularity;
+	m_mipTailFirstLod = pragma::math::min(colorReqs->imageMipTailFirstLod, m_image->GetMipmapCount());
+
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(vkDevice, vkImage, &memReqs);
+	auto allocator = get_vma_allocator(m_context);
+	m_pageMemory = std::make_shared<PageMemory>();
+	m_pageMemory->allocator = allocator;
+
+	VmaAllocationCreateInfo allocCreateInfo {};
+	allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	// One sparse block per slot of the tile cache
+	auto pageReqs = memReqs;
+	pageReqs.size = memReqs.alignment;
+	m_pageMemory->pages.resize(m_createInfo.physicalTileCount, VK_NULL_HANDLE);
+	m_pageInfos.resize(m_createInfo.physicalTileCount);
+	if(vmaAllocateMemoryPages(allocator, &pageReqs, &allocCreateInfo, m_pageMemory->pages.size(), m_pageMemory->pages.data(), m_pageInfos.data()) != VK_SUCCESS) {
+		m_pageMemory->pages.clear();
+		return false;
+	}
+
+	// The mip tail can't be bound per tile, so it's always resident
+	DeviceSize mipTailByteSize = 0;
+	if(m_mipTailFirstLod < m_image->GetMipmapCount()) {
+		auto tailReqs = memReqs;
+		tailReqs.size = colorReqs->imageMipTailSize;
+		VmaAllocationInfo tailInfo;
+		if(vmaAllocateMemory(allocator, &tailReqs, &allocCreateInfo, &m_pageMemory->mipTail, &tailInfo) != VK_SUCCESS)
+			return false;
+		VkSparseMemoryBind tailBind {};
+		tailBind.resourceOffset = colorReqs->imageMipTailOffset;
+		tailBind.size = colorReqs->imageMipTailSize;
+		tailBind.memory = tailInfo.deviceMemory;
+		tailBind.memoryOffset = tailInfo.offset;
+		VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo {};
+		opaqueBindInfo.image = vkImage;
+		opaqueBindInfo.bindCount = 1;
+		opaqueBindInfo.pBinds = &tailBind;
+		VkBindSparseInfo bindInfo {VK_STRUCTURE_TYPE_BIND_SPARSE_INFO};
+		bindInfo.imageOpaqueBindCount = 1;
+		bindInfo.pImageOpaqueBinds = &opaqueBindInfo;
+		if(!SubmitBind(bindInfo, m_createInfo.frameCount))
+			return false;
+		auto pixelSize = util::get_pixel_size(m_createInfo.format);
+		for(auto mip = m_mipTailFirstLod; mip < m_image->GetMipmapCount(); ++mip)
+			mipTailByteSize += static_cast<DeviceSize>(m_image->GetWidth(mip)) * m_image->GetHeight(mip) * pixelSize;
+	}
+	return InitializeBase(granularity.width, granularity.height, m_mipTailFirstLod, mipTailByteSize);
+}
+
+bool SparseVirtualTexture::SubmitBind(VkBindSparseInfo bindInfo, uint32_t semaphoreIndex)
+{
+	// The binding has to be complete before the uploads of this frame are executed, which is ensured by the semaphore instead of waiting on the CPU
+	auto &semaphore = m_bindSemaphores[semaphoreIndex];
+	auto vkSemaphore = semaphore->get_semaphore();
+	bindInfo.signalSemaphoreCount = 1;
+	bindInfo.pSignalSemaphores = &vkSemaphore;
+	{
+		// Anvil expects the queue to be externally synchronized through its mutex
+		std::unique_lock<std::mutex> lock;
+		if(auto *mutex = m_queue->get_mutex())
+			lock = std::unique_lock {*mutex};
+		if(vkQueueBindSparse(m_queue->get_queue(), 1, &bindInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			return false;
+	}
+	m_context.AddUniversalQueueWaitSemaphore(semaphore);
+	++m_stats.sparseBindSubmissions;
+	return true;
+}
+
+bool SparseVirtualTexture::CommitUploads(const std::vector<Upload> &uploads, uint32_t frameIndex)
+{
+	if(uploads.empty())
+		return true;
+	std::vector<VkSparseImageMemoryBind> binds;
+	binds.reserve(uploads.size() * 2);
+	auto addBind = [&binds](const TileRegion &region, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+		VkSparseImageMemoryBind bind {};
+		bind.subresource = {VK_IMAGE_ASPECT_COLOR_BIT, region.tile.mip, 0};
+		bind.offset = {static_cast<int32_t>(region.offsetX), static_cast<int32_t>(region.offsetY), 0};
+		bind.extent = {region.width, region.height, 1};
+		bind.memory = memory;
+		bind.memoryOffset = memoryOffset;
+		binds.push_back(bind);
+	};
+	// Unbind the evicted tiles first, since their memory is re-used by the new tiles
+	for(auto &upload : uploads) {
+		if(upload.evictedTile != Tile::INVALID)
+			addBind(GetTileRegion(Tile::Unpack(upload.evictedTile)), VK_NULL_HANDLE, 0);
+	}
+	for(auto &upload : uploads) {
+		auto &page = m_pageInfos[upload.slot];
+		addBind(upload.region, page.deviceMemory, page.offset);
+	}
+	VkSparseImageMemoryBindInfo imageBindInfo {};
+	imageBindInfo.image = static_cast<VlkImage &>(*m_image).GetAnvilImage().get_image();
+	imageBindInfo.bindCount = static_cast<uint32_t>(binds.size());
+	imageBindInfo.pBinds = binds.data();
+	VkBindSparseInfo bindInfo {VK_STRUCTURE_TYPE_BIND_SPARSE_INFO};
+	bindInfo.imageBindCount = 1;
+	bindInfo.pImageBinds = &imageBindInfo;
+	if(SubmitBind(bindInfo, frameIndex % m_createInfo.frameCount))
+		return true;
+	m_context.Log("Failed to bind virtual texture tiles!", pragma::util::LogSeverity::Error);
+	return false;
+}
+
+void SparseVirtualTexture::RecordUploads(ICommandBuffer &cmd, IBuffer &stagingBuffer, const std::vector<Upload> &uploads, DeviceSize extraStagingOffset)
+{
+	auto uploadMipTail = !m_mipTailUploaded && m_mipTailFirstLod < m_image->GetMipmapCount();
+	if(uploads.empty() && !uploadMipTail)
+		return;
+	record_begin_upload(cmd, *m_image, m_initialized);
+	for(auto &upload : uploads)
+		record_copy_region(cmd, stagingBuffer, upload.stagingOffset, *m_image, upload.region.tile.mip, upload.region.offsetX, upload.region.offsetY, upload.region.width, upload.region.height);
+	if(uploadMipTail) {
+		auto pixelSize = util::get_pixel_size(m_createInfo.format);
+		auto offset = extraStagingOffset;
+		for(auto mip = m_mipTailFirstLod; mip < m_image->GetMipmapCount(); ++mip) {
+			TileRegion region {};
+			region.tile = {0, 0, mip};
+			region.width = m_image->GetWidth(mip);
+			region.height = m_image->GetHeight(mip);
+			auto size = static_cast<DeviceSize>(region.width) * region.height * pixelSize;
+			if(m_tileLoader(region, m_stagingData + offset, size))
+				record_copy_region(cmd, stagingBuffer, offset, *m_image, mip, 0, 0, region.width, region.height);
+			offset += size;
+		}
+		m_mipTailUploaded = true;
+	}
+	record_end_upload(cmd, *m_image);
+	m_initialized = true;
+}
+
+////////////////
+
+bool SoftwareVirtualTexture::Initialize()
+{
+	auto tileSize = m_createInfo.tileSize;
+	if(tileSize == 0 || (m_createInfo.width % tileSize) != 0 || (m_createInfo.height % tileSize) != 0)
+		return false;
+	// The indirection texture has one mipmap per virtual mipmap, which only lines up for power-of-two tile counts
+	auto tilesX = m_createInfo.width / tileSize;
+	auto tilesY = m_createInfo.height / tileSize;
+	if((tilesX & (tilesX - 1)) != 0 || (tilesY & (tilesY - 1)) != 0) {
+		m_context.Log("Software virtual textures require a power-of-two number of tiles!", pragma::util::LogSeverity::Error);
+		return false;
+	}
+
+	m_slotsPerRow = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_createInfo.physicalTileCount))));
+	auto rows = (m_createInfo.physicalTileCount + m_slotsPerRow - 1) / m_slotsPerRow;
+	if(m_slotsPerRow > std::numeric_limits<uint8_t>::max() || rows > std::numeric_limits<uint8_t>::max())
+		return false;
+
+	util::ImageCreateInfo atlasCreateInfo {};
+	atlasCreateInfo.width = m_slotsPerRow * tileSize;
+	atlasCreateInfo.height = rows * tileSize;
+	atlasCreateInfo.format = m_createInfo.format;
+	atlasCreateInfo.usage = ImageUsageFlags::SampledBit | ImageUsageFlags::TransferDstBit;
+	atlasCreateInfo.tiling = ImageTiling::Optimal;
+	atlasCreateInfo.memoryFeatures = MemoryFeatureFlags::DeviceLocal;
+	atlasCreateInfo.postCreateLayout = ImageLayout::Undefined;
+	atlasCreateInfo.debugName = m_createInfo.debugName + "_vt_atlas";
+	m_image = m_context.CreateImage(atlasCreateInfo);
+	if(!m_image)
+		return false;
+
+	util::ImageCreateInfo indirectionCreateInfo {};
+	indirectionCreateInfo.width = tilesX;
+	indirectionCreateInfo.height = tilesY;
+	indirectionCreateInfo.format = Format::R8G8B8A8_UInt;
+	indirectionCreateInfo.usage = ImageUsageFlags::SampledBit | ImageUsageFlags::TransferDstBit;
+	indirectionCreateInfo.tiling = ImageTiling::Optimal;
+	indirectionCreateInfo.memoryFeatures = MemoryFeatureFlags::DeviceLocal;
+	indirectionCreateInfo.flags = util::ImageCreateInfo::Flags::FullMipmapChain;
+	indirectionCreateInfo.postCreateLayout = ImageLayout::Undefined;
+	indirectionCreateInfo.debugName = m_createInfo.debugName + "_vt_indirection";
+	m_indirectionImage = m_context.CreateImage(indirectionCreateInfo);
+	if(!m_indirectionImage)
+		return false;
+
+	auto mipCount = m_indirectionImage->GetMipmapCount();
+	m_indirection.resize(mipCount);
+	DeviceSize indirectionByteSize = 0;
+	for(auto mip = decltype(mipCount) {0u}; mip < mipCount; ++mip) {
+		auto numEntries = m_indirectionImage->GetWidth(mip) * m_indirectionImage->GetHeight(mip);
+		m_indirection[mip].resize(numEntries, {0, 0, 0, 0});
+		indirectionByteSize += numEntries * sizeof(m_indirection[mip].front());
+	}
+	return InitializeBase(tileSize, tileSize, mipCount, indirectionByteSize);
+}
+
+bool SoftwareVirtualTexture::CommitUploads(const std::vector<Upload> &uploads, uint32_t frameIndex)
+{
+	if(!uploads.empty())
+		m_indirectionDirty = true;
+	return true;
+}
+
+void SoftwareVirtualTexture::UpdateIndirection()
+{
+	// Non-resident tiles point to the closest resident ancestor, which is resolved from the coarsest mipmap downwards
+	auto mipCount = static_cast<uint32_t>(m_indirection.size());
+	for(auto mip = mipCount; mip-- > 0;) {
+		auto w = m_indirectionImage->GetWidth(mip);
+		auto h = m_indirectionImage->GetHeight(mip);
+		auto &entries = m_indirection[mip];
+		for(auto y = decltype(h) {0u}; y < h; ++y) {
+			for(auto x = decltype(w) {0u}; x < w; ++x) {
+				auto &entry = entries[y * w + x];
+				auto it = m_residentTiles.find(Tile::Pack(x, y, mip));
+				if(it != m_residentTiles.end()) {
+					entry = {static_cast<uint8_t>(it->second % m_slotsPerRow), static_cast<uint8_t>(it->second / m_slotsPerRow), static_cast<uint8_t>(mip), 1};
+					continue;
+				}
+				if(mip + 1 < mipCount) {
+					auto wParent = m_indirectionImage->GetWidth(mip + 1);
+					entry = m_indirection[mip + 1][(y / 2) * wParent + (x / 2)];
+					entry[3] = 0;
+				}
+				else
+					entry = {0, 0, 0, 0};
+			}
+		}
+	}
+}
+
+void SoftwareVirtualTexture::RecordUploads(ICommandBuffer &cmd, IBuffer &stagingBuffer, const std::vector<Upload> &uploads, DeviceSize extraStagingOffset)
+{
+	if(!uploads.empty()) {
+		record_begin_upload(cmd, *m_image, m_atlasInitialized);
+		for(auto &upload : uploads)
+			record_copy_region(cmd, stagingBuffer, upload.stagingOffset, *m_image, 0, (upload.slot % m_slotsPerRow) * m_tileWidth, (upload.slot / m_slotsPerRow) * m_tileHeight, upload.region.width, upload.region.height);
+		record_end_upload(cmd, *m_image);
+		m_atlasInitialized = true;
+	}
+	if(!m_indirectionDirty)
+		return;
+	m_indirectionDirty = false;
+	UpdateIndirection();
+
+	record_begin_upload(cmd, *m_indirectionImage, m_indirectionInitialized);
+	auto offset = extraStagingOffset;
+	for(auto mip = decltype(m_indirection.size()) {0u}; mip < m_indirection.size(); ++mip) {
+		auto &entries = m_indirection[mip];
+		auto size = entries.size() * sizeof(entries.front());
+		memcpy(m_stagingData + offset, entries.data(), size);
+		record_copy_region(cmd, stagingBuffer, offset, *m_indirectionImage, static_cast<uint32_t>(mip), 0, 0, m_indirectionImage->GetWidth(mip), m_indirectionImage->GetHeight(mip));
+		offset += size;
+	}
+	record_end_upload(cmd, *m_indirectionImage);
+	m_indirectionInitialized = true;
+}
@@ -166,14 +166,25 @@ Anvil::Semaphore &prosper::VlkWindow::Submit(VlkPrimaryCommandBuffer &cmd, Anvil
 {
 	/* Submit work chunk and present */
 	auto *signalSemaphore = m_curFrameSignalSemaphore;
-	std::array<Anvil::Semaphore *, 2> waitSemaphores = {m_curFrameWaitSemaphore, optWaitSemaphore};
 	auto swapchainImgIdx = GetLastAcquiredSwapchainImageIndex();
 	auto &context = static_cast<VlkContext &>(GetContext());
 	auto &dev = context.GetDevice();
 
-	const std::array<Anvil::PipelineStageFlags, 2> wait_stage_mask {Anvil::PipelineStageFlagBits::ALL_COMMANDS_BIT, Anvil::PipelineStageFlagBits::ALL_COMMANDS_BIT};
+	// Uploads that have been recorded during the frame
+	context.SubmitUploadCommands();
+	// Operations on other queues (e.g. sparse binding) that the frame depends on
+	auto extraWaitSemaphores = context.TakeUniversalQueueWaitSemaphores();
+	std::vector<Anvil::Semaphore *> waitSemaphores;
+	waitSemaphores.reserve(2 + extraWaitSemaphores.size());
+	waitSemaphores.push_back(m_curFrameWaitSemaphore);
+	if(optWaitSemaphore)
+		waitSemaphores.push_back(optWaitSemaphore);
+	for(auto &semaphore : extraWaitSemaphores)
+		waitSemaphores.push_back(semaphore.get());
+
+	const std::vector<Anvil::PipelineStageFlags> wait_stage_mask(waitSemaphores.size(), Anvil::PipelineStageFlagBits::ALL_COMMANDS_BIT);
 	auto res = dev.get_universal_queue(0)->submit(Anvil::SubmitInfo::create(&cmd.GetAnvilCommandBuffer(), 1, /* n_semaphores_to_signal */
-	  &signalSemaphore, optWaitSemaphore ? 2 : 1,                                                            /* n_semaphores_to_wait_on */
+	  &signalSemaphore, static_cast<uint32_t>(waitSemaphores.size()),                                        /* n_semaphores_to_wait_on */
 	  waitSemaphores.data(), wait_stage_mask.data(), false,                                                  /* should_block  */
 	  m_cmdFences.at(swapchainImgIdx).get()));                                                               /* opt_fence_ptr */
 	if(res == VkResult::VK_SUCCESS)
@@ -12,6 +12,8 @@ export import :debug.object;
 export namespace prosper {
 	class VkDynamicResizableBuffer;
 	class VkUniformResizableBuffer;
+	class MemoryDefragmenter;
+	class VlkContext;
 	class PR_EXPORT VlkBuffer : virtual public IBuffer, public VlkDebugObject {
 	  public:
 		static std::shared_ptr<VlkBuffer> Create(IPrContext &context, Anvil::BufferUniquePtr buf, const util::BufferCreateInfo &bufCreateInfo, DeviceSize startOffset, DeviceSize size, const std::function<void(IBuffer &)> &onDestroyedCallback = nullptr);
@@ -34,11 +36,32 @@ export namespace prosper {
 		virtual const void *GetInternalHandle() const override { return GetVkBuffer(); }
 		VkBuffer GetVkBuffer() const { return m_vkBuffer; };
 		virtual void Initialize() override;
+
+		// Host-visible buffers are mapped on first access and stay mapped for their lifetime. Returns nullptr if the buffer is not host-visible.
+		uint8_t *GetPersistentHostPointer() const;
+		// Writes to non-coherent memory are collected as dirty ranges, which are flushed with a single vkFlushMappedMemoryRanges
+		// call before the next queue submission (see VlkContext::FlushMappedMemoryRanges)
+		bool IsHostCoherent() const;
+
+		struct PR_EXPORT FlushBenchmarkResult {
+			uint32_t writes = 0;
+			// Number of ranges that have to be flushed if the dirty ranges are collected and coalesced
+			uint32_t batchedRanges = 0;
+			std::chrono::nanoseconds batchedDuration {0};
+			// Number of ranges that have to be flushed if every write is flushed individually
+			uint32_t unbatchedRanges = 0;
+			std::chrono::nanoseconds unbatchedDuration {0};
+		};
+		// Records the specified number of small, mostly sequential writes and compares the ranges that have to be flushed with and
+		// without coalescing them. Runs on the CPU only, no device memory is flushed.
+		static FlushBenchmarkResult RunFlushBenchmark(uint32_t writeCount = 100'000, DeviceSize writeSize = 64, DeviceSize nonCoherentAtomSize = 256);
 	  protected:
 		friend IDynamicResizableBuffer;
 		friend VkDynamicResizableBuffer;
 		friend IUniformResizableBuffer;
 		friend VkUniformResizableBuffer;
+		friend MemoryDefragmenter;
+		friend VlkContext;
 		VlkBuffer(IPrContext &context, const util::BufferCreateInfo &bufCreateInfo, DeviceSize startOffset, DeviceSize size, std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> buf);
 		virtual void RecreateInternalSubBuffer(IBuffer &newParentBuffer) override;
 		virtual bool DoWrite(Offset offset, Size size, const void *data) const override;
@@ -47,8 +70,44 @@ export namespace prosper {
 		virtual bool DoUnmap() const override;
 
 		std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> m_buffer = nullptr;
-		VkBuffer m_vkBuffer;
+		VkBuffer m_vkBuffer = VK_NULL_HANDLE;
 	  private:
 		void SetBuffer(std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> buf);
+		// Same as SetBuffer, but returns the previous buffer instead of destroying it
+		std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> ReplaceBuffer(std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> buf);
+		// Hands the internal buffer over to the caller; The buffer is no longer tracked and has no internal buffer afterwards
+		std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> ReleaseBuffer();
+
+		// The persistent mapping and the dirty ranges are owned by the root buffer; Sub-buffers forward to it
+		struct PersistentMapping {
+			uint8_t *data = nullptr;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize memoryOffset = 0;
+			VkDeviceSize memorySize = 0;
+			bool initialized = false;
+			bool coherent = true;
+			bool writeCombined = false;
+			// Pairs of start and end offsets relative to the buffer
+			std::vector<std::pair<DeviceSize, DeviceSize>> dirtyRanges;
+			// Ranges that are currently mapped through Map; They become dirty ranges once they're unmapped
+			std::vector<std::pair<DeviceSize, DeviceSize>> mappedRanges;
+		};
+		const VlkBuffer &GetRootBuffer() const;
+		const PersistentMapping *GetPersistentMapping() const;
+		void AddDirtyRange(DeviceSize offset, DeviceSize size) const;
+		void BeginMappedRange(DeviceSize offset, DeviceSize size) const;
+		void EndMappedRange() const;
+		void InvalidateRange(DeviceSize offset, DeviceSize size) const;
+		// Appends the coalesced dirty ranges and the currently mapped ranges to outRanges, and clears the dirty ranges.
+		// Returns true if ranges are still mapped, in which case they have to be flushed again with the next submission.
+		bool CollectDirtyRanges(std::vector<VkMappedMemoryRange> &outRanges, DeviceSize nonCoherentAtomSize) const;
+		void ReleasePersistentMapping();
+		mutable PersistentMapping m_persistentMapping {};
+		mutable std::mutex m_persistentMappingMutex;
+		// Range of this buffer that is currently mapped through Map, relative to the root buffer; Guarded by the mutex of the root buffer
+		mutable std::optional<std::pair<DeviceSize, DeviceSize>> m_mappedRange {};
+		// If the buffer has been moved by the defragmenter, the internal buffer is bound to memory that is owned by the VMA allocation
+		// of the original internal buffer, which therefore has to outlive it
+		std::unique_ptr<Anvil::Buffer, std::function<void(Anvil::Buffer *)>> m_memoryOwner = nullptr;
 	};
 };
@@ -17,6 +17,8 @@ export namespace prosper {
 		  const std::optional<IndexBufferInfo> &indexBufferInfo = {});
 
 		bool Record(VkCommandBuffer cmdBuf) const;
+		// Re-caches the Vulkan handles if any of the specified buffers are referenced by this render buffer
+		void OnBuffersRelocated(const std::unordered_set<const IBuffer *> &buffers);
 	  private:
 		VlkRenderBuffer(prosper::IPrContext &context, const prosper::GraphicsPipelineCreateInfo &pipelineCreateInfo, const std::vector<prosper::IBuffer *> &buffers, const std::vector<prosper::DeviceSize> &offsets, const std::optional<IndexBufferInfo> &indexBufferInfo = {});
 		void Initialize();
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:buffer.transient_buffer_allocator;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Linear allocator for data that only has to live for a single frame (e.g. per-draw constants).
+	// The backing buffer is persistently mapped and split into one region per frame in flight; Allocating is a single
+	// atomic pointer bump, and a region is reset once the frame that used it has been retired.
+	// Allocations are meant to be bound through dynamic uniform / storage buffer descriptors with GetDynamicOffset().
+	class PR_EXPORT TransientBufferAllocator {
+	  public:
+		struct PR_EXPORT Allocation {
+			IBuffer *buffer = nullptr;
+			DeviceSize offset = 0;
+			void *data = nullptr;
+			uint32_t GetDynamicOffset() const { return static_cast<uint32_t>(offset); }
+			bool IsValid() const { return data != nullptr; }
+		};
+		struct PR_EXPORT Stats {
+			DeviceSize sizePerFrame = 0;
+			uint32_t frameCount = 0;
+			DeviceSize peakUsage = 0;
+			uint64_t allocationCount = 0;
+			uint64_t overflowCount = 0;
+			bool deviceLocal = false;
+		};
+		static std::unique_ptr<TransientBufferAllocator> Create(IPrContext &context, DeviceSize sizePerFrame, uint32_t frameCount, BufferUsageFlags usageFlags = BufferUsageFlags::UniformBufferBit | BufferUsageFlags::StorageBufferBit);
+		~TransientBufferAllocator();
+		TransientBufferAllocator(const TransientBufferAllocator &) = delete;
+		TransientBufferAllocator &operator=(const TransientBufferAllocator &) = delete;
+
+		// Returns an invalid allocation if the region of the current frame is exhausted
+		Allocation Allocate(DeviceSize size);
+		Allocation Write(const void *data, DeviceSize size);
+		template<typename T>
+		    requires(std::is_trivially_copyable_v<T>)
+		Allocation Write(const T &data)
+		{
+			return Write(&data, sizeof(data));
+		}
+
+		// Has to be called once the resources of the frame with the specified index are no longer in use by the GPU
+		void BeginFrame(uint32_t frameIndex);
+		IBuffer &GetBuffer() const { return *m_buffer; }
+		DeviceSize GetAlignment() const { return m_alignment; }
+		DeviceSize GetSizePerFrame() const { return m_sizePerFrame; }
+		uint32_t GetFrameCount() const { return m_frameCount; }
+		Stats GetStats() const;
+	  private:
+		// The frame index is stored in the upper bits of the head, so that allocations always see the head and the region of the same frame
+		static constexpr uint32_t FRAME_INDEX_SHIFT = 48;
+		static constexpr DeviceSize HEAD_MASK = (static_cast<DeviceSize>(1) << FRAME_INDEX_SHIFT) - 1;
+		TransientBufferAllocator() = default;
+		std::shared_ptr<IBuffer> m_buffer;
+		uint8_t *m_mappedPtr = nullptr;
+		DeviceSize m_alignment = 1;
+		DeviceSize m_sizePerFrame = 0;
+		uint32_t m_frameCount = 0;
+		bool m_deviceLocal = false;
+
+		std::atomic<DeviceSize> m_head = 0;
+		std::atomic<DeviceSize> m_peakUsage = 0;
+		std::atomic<uint64_t> m_allocationCount = 0;
+		std::atomic<uint64_t> m_overflowCount = 0;
+	};
+};
+#pragma warning(pop)
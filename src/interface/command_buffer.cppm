@@ -10,8 +10,34 @@ module;
 export module pragma.prosper.vulkan:command_buffer;
 
 export import pragma.prosper;
+export import :graphics_pipeline_library;
 
 export namespace prosper {
+	namespace util {
+		struct PR_EXPORT RenderingAttachmentInfo {
+			IImageView *imageView = nullptr;
+			// Layout the attachment is in during rendering
+			ImageLayout imageLayout = ImageLayout::ColorAttachmentOptimal;
+			AttachmentLoadOp loadOp = AttachmentLoadOp::Load;
+			AttachmentStoreOp storeOp = AttachmentStoreOp::Store;
+			ClearValue clearValue {};
+			// If specified, the multisampled attachment is resolved into this view at the end of rendering (averaged for color, sample zero for depth/stencil)
+			IImageView *resolveImageView = nullptr;
+			ImageLayout resolveImageLayout = ImageLayout::ColorAttachmentOptimal;
+		};
+		struct PR_EXPORT RenderingInfo {
+			std::vector<RenderingAttachmentInfo> colorAttachments;
+			// If the view has a combined depth/stencil format and only one of the two is specified, it is used for both aspects
+			std::optional<RenderingAttachmentInfo> depthAttachment {};
+			std::optional<RenderingAttachmentInfo> stencilAttachment {};
+			// If 0, the extents of the base mipmap of the first attachment's view are used
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t layerCount = 1;
+			// The secondary command buffers have to be recorded with VlkSecondaryCommandBuffer::StartRecording(renderingInfo)
+			bool secondaryCommandBuffers = false;
+		};
+	};
 	class PR_EXPORT VlkCommandBuffer : virtual public ICommandBuffer {
 	  public:
 		virtual ~VlkCommandBuffer() override;
@@ -72,6 +98,24 @@ export namespace prosper {
 		virtual bool RecordPresentImage(IImage &img, IImage &swapchainImg, IFramebuffer &swapchainFramebuffer) override;
 
 		VkCommandBuffer GetVkCommandBuffer() const { return m_vkCommandBuffer; }
+		// True between VlkPrimaryCommandBuffer::RecordBeginRendering and RecordEndRendering, in which case the dynamic rendering variants of pipelines are bound
+		bool IsDynamicRenderingActive() const { return m_dynamicRenderingActive; }
+
+		// Extended dynamic states (see VlkContext::GetExtendedDynamicStates). Have to be recorded after the pipeline has been bound, and override the
+		// values the pipeline was created with until another pipeline is bound. Return false if the state is not dynamic for the bound pipeline.
+		bool RecordSetCullMode(CullModeFlags cullMode);
+		bool RecordSetFrontFace(FrontFace frontFace);
+		bool RecordSetPrimitiveTopology(PrimitiveTopology topology);
+		bool RecordSetDepthTestEnable(bool enabled);
+		bool RecordSetDepthWriteEnable(bool enabled);
+		bool RecordSetDepthCompareOp(CompareOp compareOp);
+		bool RecordSetStencilTestEnable(bool enabled);
+		bool RecordSetStencilOp(StencilFaceFlags faceMask, StencilOp failOp, StencilOp passOp, StencilOp depthFailOp, CompareOp compareOp);
+		bool RecordSetDepthBiasEnable(bool enabled);
+		bool RecordSetPrimitiveRestartEnable(bool enabled);
+		bool RecordSetRasterizerDiscardEnable(bool enabled);
+		bool RecordSetPolygonMode(PolygonMode polygonMode);
+		ExtendedDynamicStateFlags GetBoundExtendedDynamicStates() const { return m_extendedDynamicStates; }
 	  protected:
 		VlkCommandBuffer(IPrContext &context, const std::shared_ptr<Anvil::CommandBufferBase> &cmdBuffer, prosper::QueueFamilyType queueFamilyType);
 		virtual bool DoRecordBindShaderPipeline(prosper::Shader &shader, PipelineID shaderPipelineId, PipelineID pipelineId) override;
@@ -83,9 +127,16 @@ export namespace prosper {
 		virtual bool DoRecordResolveImage(IImage &imgSrc, IImage &imgDst, const util::ImageResolve &resolve) override;
 		bool RecordBindVertexBuffers(const std::vector<IBuffer *> &buffers, uint32_t startBinding = 0u, const std::vector<DeviceSize> &offsets = {});
 		bool RecordBindVertexBuffers(const std::vector<std::shared_ptr<IBuffer>> &buffers, uint32_t startBinding = 0u, const std::vector<DeviceSize> &offsets = {});
+		// Records the states of a newly bound pipeline that differ from the current command buffer state
+		void ApplyExtendedDynamicState(ExtendedDynamicStateFlags dynamicStates, const GraphicsPipelineLibraryManager::ExtendedDynamicStateValues &values);
+		bool IsExtendedDynamicStateBound(ExtendedDynamicStateFlags state) const { return pragma::math::is_flag_set(m_extendedDynamicStates, state); }
 
 		std::shared_ptr<Anvil::CommandBufferBase> m_cmdBuffer = nullptr;
 		VkCommandBuffer m_vkCommandBuffer = nullptr;
+		mutable bool m_dynamicRenderingActive = false;
+		// Dynamic states of the bound graphics pipeline and their current values. The state is undefined at the start of a recording.
+		mutable ExtendedDynamicStateFlags m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
+		GraphicsPipelineLibraryManager::ExtendedDynamicStateValues m_extendedDynamicStateValues {};
 	};
 
 	class PR_EXPORT VlkCommandPool : public prosper::ICommandBufferPool {
@@ -117,6 +168,13 @@ export namespace prosper {
 		virtual bool StartRecording(bool oneTimeSubmit = true, bool simultaneousUseAllowed = false) const override;
 		virtual bool RecordNextSubPass() override;
 		virtual bool ExecuteCommands(prosper::ISecondaryCommandBuffer &cmdBuf) override;
+
+		// Begins rendering into the specified attachment views through VK_KHR_dynamic_rendering, without a render pass or framebuffer.
+		// The attachments have to be in their specified layouts and have to be kept alive until the command buffer has been executed.
+		// Only pipelines that have a dynamic rendering variant can be bound (see VlkContext::SetDynamicRenderingPipelinesEnabled).
+		// Returns false if dynamic rendering is not supported.
+		bool RecordBeginRendering(const util::RenderingInfo &renderingInfo);
+		bool RecordEndRendering();
 	  protected:
 		void SetRecording(bool b) { IPrimaryCommandBuffer::m_recording = b; }
 		friend VlkContext;
@@ -142,9 +200,16 @@ export namespace prosper {
 		virtual bool StartRecording(bool oneTimeSubmit = true, bool simultaneousUseAllowed = false) const override;
 		virtual bool StartRecording(prosper::IRenderPass &rp, prosper::IFramebuffer &fb, bool oneTimeSubmit = true, bool simultaneousUseAllowed = false) const override;
 		virtual bool StopRecording() const override;
+		// Starts recording commands that are executed within dynamic rendering (see VlkPrimaryCommandBuffer::RecordBeginRendering) with the same attachments.
+		// Anvil can't chain the inheritance info, so the command buffer is started directly through Vulkan and only commands that are not recorded
+		// through Anvil are valid: Graphics pipeline, descriptor set, vertex and index buffer binds, push constants, draws, dynamic states and attachment
+		// clears. Queries, copies and barriers are recorded through Anvil.
+		bool StartRecording(const util::RenderingInfo &renderingInfo, bool oneTimeSubmit = true, bool simultaneousUseAllowed = false) const;
 		bool StartRecording(bool oneTimeSubmit, bool simultaneousUseAllowed, bool renderPassUsageOnly, const IFramebuffer &framebuffer, const IRenderPass &rp, prosper::SubPassID subPassId, Anvil::OcclusionQuerySupportScope occlusionQuerySupportScope,
 		  bool occlusionQueryUsedByPrimaryCommandBuffer, Anvil::QueryPipelineStatisticFlags statisticsFlags) const;
 	  protected:
 		VlkSecondaryCommandBuffer(IPrContext &context, std::unique_ptr<Anvil::SecondaryCommandBuffer, std::function<void(Anvil::SecondaryCommandBuffer *)>> cmdBuffer, prosper::QueueFamilyType queueFamilyType);
+		// True if the recording was started without Anvil, in which case it also has to be stopped without it
+		mutable bool m_recordingWithoutAnvil = false;
 	};
 };
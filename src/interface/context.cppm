@@ -8,12 +8,28 @@ module;
 export module pragma.prosper.vulkan:context;
 
 export import pragma.prosper;
+export import :buffer.transient_buffer_allocator;
+export import :deferred_destruction_queue;
+export import :descriptor_set_allocator;
+export import :graphics_pipeline_library;
+export import :image.gpu_format_converter;
+export import :image.mipmap_generator;
+export import :image.sampler_cache;
+export import :memory_budget;
+export import :memory_defragmenter;
+export import :memory_type_table;
+export import :object_cache;
+export import :pipeline_layout_cache;
+export import :shader_module_cache;
+export import :spirv.optimizer;
 
 #undef CreateEvent
 #undef CreateWindow
 #undef max
 
 export namespace prosper {
+	class VlkBuffer;
+	class VlkRenderBuffer;
 	class PR_EXPORT VlkShaderStageProgram : public prosper::ShaderStageProgram {
 	  public:
 		VlkShaderStageProgram(std::vector<unsigned int> &&spirvBlob);
@@ -40,6 +56,41 @@ export namespace prosper {
 		bool IsValid() const;
 	};
 
+	// VK_EXT_host_image_copy
+	struct PR_EXPORT VkHostImageCopyFunctions {
+		PFN_vkCopyMemoryToImageEXT vkCopyMemoryToImageEXT = nullptr;
+		PFN_vkTransitionImageLayoutEXT vkTransitionImageLayoutEXT = nullptr;
+		void Initialize(VkDevice dev);
+		bool IsValid() const;
+	};
+
+	// VK_KHR_dynamic_rendering (Core in Vulkan 1.3)
+	struct PR_EXPORT VkDynamicRenderingFunctions {
+		PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+		PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR = nullptr;
+		void Initialize(VkDevice dev);
+		bool IsValid() const;
+	};
+
+	// VK_EXT_extended_dynamic_state, VK_EXT_extended_dynamic_state2 and VK_EXT_extended_dynamic_state3 (Only the polygon mode)
+	struct PR_EXPORT VkExtendedDynamicStateFunctions {
+		PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+		PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT = nullptr;
+		PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+		PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+		PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+		PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+		PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT = nullptr;
+		PFN_vkCmdSetStencilOpEXT vkCmdSetStencilOpEXT = nullptr;
+		PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT = nullptr;
+		PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT = nullptr;
+		PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT = nullptr;
+		PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT = nullptr;
+		void Initialize(VkDevice dev);
+		// Returns the states for which all required functions are available
+		ExtendedDynamicStateFlags GetSupportedStates() const;
+	};
+
 	class PR_EXPORT VlkContext : public IPrContext {
 	  public:
 		static std::shared_ptr<VlkContext> Create(const std::string &appName, bool bEnableValidation);
@@ -77,6 +128,8 @@ export namespace prosper {
 		using IPrContext::CreateDescriptorSetGroup;
 		std::shared_ptr<IDescriptorSetGroup> CreateDescriptorSetGroup(const DescriptorSetCreateInfo &descSetCreateInfo, std::unique_ptr<Anvil::DescriptorSetCreateInfo> descSetInfo);
 		virtual std::shared_ptr<IDescriptorSetGroup> CreateDescriptorSetGroup(DescriptorSetCreateInfo &descSetInfo) override;
+		// The descriptor set is only valid until the current frame has been retired, and is then handed out again
+		std::shared_ptr<IDescriptorSetGroup> CreateTransientDescriptorSetGroup(const DescriptorSetCreateInfo &descSetInfo);
 		virtual std::shared_ptr<ISwapCommandBufferGroup> CreateSwapCommandBufferGroup(Window &window, bool allowMt = true, const std::string &debugName = {}) override;
 		virtual std::expected<std::shared_ptr<Window>, std::string> CreateWindow(const WindowSettings &windowCreationInfo) override;
 
@@ -85,6 +138,10 @@ export namespace prosper {
 		virtual util::Limits GetPhysicalDeviceLimits() const override;
 		virtual std::optional<util::PhysicalDeviceImageFormatProperties> GetPhysicalDeviceImageFormatProperties(const ImageFormatPropertiesQuery &query) override;
 		virtual prosper::FeatureSupport AreFormatFeaturesSupported(Format format, FormatFeatureFlags featureFlags, std::optional<ImageTiling> tiling) const override;
+		// Cached, see m_formatProperties
+		Anvil::FormatProperties GetFormatProperties(Format format) const;
+		// Optimal tiling only
+		bool IsStorageImageFormatSupported(Format format) const;
 		virtual void BakeShaderPipeline(prosper::PipelineID pipelineId, prosper::PipelineBindPoint pipelineType) override;
 
 		virtual std::shared_ptr<prosper::IPrimaryCommandBuffer> AllocatePrimaryLevelCommandBuffer(prosper::QueueFamilyType queueFamilyType, uint32_t &universalQueueFamilyIndex) override;
@@ -131,6 +188,11 @@ export namespace prosper {
 		virtual void AddDebugObjectInformation(std::string &msgValidation) override;
 
 		std::pair<const Anvil::MemoryType *, prosper::MemoryFeatureFlags> FindCompatibleMemoryType(MemoryFeatureFlags featureFlags) const;
+		const MemoryTypeTable &GetMemoryTypeTable() const { return m_memoryTypeTable; }
+		// Checks the VK_KHR_dedicated_allocation requirements of large images
+		bool ShouldUseDedicatedAllocation(const VkImageCreateInfo &createInfo) const;
+		// Allocates memory exclusively for the image and binds it
+		bool AllocateDedicatedImageMemory(Anvil::Image &img, MemoryFeatureFlags featureFlags);
 		virtual std::optional<std::string> DumpMemoryBudget() const override;
 		virtual std::optional<std::string> DumpMemoryStats() const override;
 		virtual std::optional<std::string> DumpLimits() const override;
@@ -145,6 +207,7 @@ export namespace prosper {
 
 		bool IsCustomValidationEnabled() const { return m_customValidationEnabled; }
 		Anvil::PipelineLayout *GetPipelineLayout(bool graphicsShader, PipelineID pipelineId);
+		VkPipelineLayout GetVkPipelineLayout(bool graphicsShader, PipelineID pipelineId);
 		virtual void *GetInternalDevice() const override;
 		virtual void *GetInternalPhysicalDevice() const override;
 		virtual void *GetInternalInstance() const override;
@@ -153,9 +216,91 @@ export namespace prosper {
 		virtual bool IsInstanceExtensionEnabled(const std::string &ext) const override;
 
 		const VkRaytracingFunctions &GetRaytracingFunctions() const { return m_rtFunctions; }
+		const VkHostImageCopyFunctions &GetHostImageCopyFunctions() const { return m_hostImageCopyFunctions; }
+		// Returns true if images with the specified create info are created with host transfer usage, which allows
+		// writing to them directly from the CPU without a staging buffer (see VlkImage::CopyFromMemory).
+		// Only the case if the host access does not come at the cost of a less optimal device memory layout.
+		// The result is cached per format, type and usage.
+		bool IsHostImageCopySupported(const util::ImageCreateInfo &createInfo) const;
+		bool IsHostImageCopyDstLayout(ImageLayout layout) const;
+		// Layouts images can be transitioned from on the host (see VlkImage::TransitionLayoutOnHost), in addition to Undefined and Preinitialized
+		bool IsHostImageCopySrcLayout(ImageLayout layout) const;
+		// Returns the preferred layout if it is a host copy destination layout, otherwise the most suitable one that is
+		ImageLayout GetHostImageCopyDstLayout(ImageLayout preferredLayout) const;
+		const VkDynamicRenderingFunctions &GetDynamicRenderingFunctions() const { return m_dynamicRenderingFunctions; }
+		bool IsDynamicRenderingSupported() const { return m_dynamicRenderingFunctions.IsValid(); }
+		// If enabled, graphics pipelines are additionally created for dynamic rendering (see VlkPrimaryCommandBuffer::RecordBeginRendering),
+		// with the attachment formats of the render pass they were declared with. Only applies to pipelines created afterwards, and requires
+		// graphics pipeline library support.
+		void SetDynamicRenderingPipelinesEnabled(bool enabled) { m_dynamicRenderingPipelinesEnabled = enabled; }
+		bool AreDynamicRenderingPipelinesEnabled() const { return m_dynamicRenderingPipelinesEnabled && IsDynamicRenderingSupported() && m_graphicsPipelineLibrary; }
+		const VkExtendedDynamicStateFunctions &GetExtendedDynamicStateFunctions() const { return m_extendedDynamicStateFunctions; }
+		ExtendedDynamicStateFlags GetSupportedExtendedDynamicStates() const { return m_supportedExtendedDynamicStates; }
+		// Enabled by default if supported. Dynamic states are only used for pipelines created through graphics pipeline libraries, and
+		// only apply to pipelines created afterwards (see VlkCommandBuffer::RecordSetCullMode, etc.).
+		void SetExtendedDynamicStatesEnabled(bool enabled);
+		ExtendedDynamicStateFlags GetExtendedDynamicStates() const;
 		Anvil::MemoryAllocator *GetMemoryAllocator() { return m_memAllocator.get(); }
 
 		Anvil::PipelineID GetAnvilPipelineId(PipelineID pipelineId) const { return m_prosperPipelineToAnvilPipeline[pipelineId]; }
+
+		void SetSpirvOptimizationSettings(const spirv::OptimizationSettings &settings) { m_spirvOptimizationSettings = settings; }
+		const spirv::OptimizationSettings &GetSpirvOptimizationSettings() const { return m_spirvOptimizationSettings; }
+		const PipelineLayoutCache &GetPipelineLayoutCache() const { return m_pipelineLayoutCache; }
+		const ShaderModuleCache &GetShaderModuleCache() const { return m_shaderModuleCache; }
+		SamplerCache &GetSamplerCache() { return m_samplerCache; }
+		const SamplerCache &GetSamplerCache() const { return m_samplerCache; }
+		// Render passes and framebuffers with identical descriptions are shared (see CreateRenderPass and CreateFramebuffer)
+		ObjectCache<IRenderPass>::Stats GetRenderPassCacheStats() const { return m_renderPassCache.GetStats(); }
+		ObjectCache<IFramebuffer>::Stats GetFramebufferCacheStats() const { return m_framebufferCache.GetStats(); }
+		// Number of image view requests that were served by an existing view (see VlkImage::FindCachedView) or required a new one
+		uint64_t GetImageViewCacheHits() const { return m_imageViewCacheHits; }
+		uint64_t GetImageViewCacheMisses() const { return m_imageViewCacheMisses; }
+		MemoryBudgetGovernor &GetMemoryBudgetGovernor() { return m_memoryBudgetGovernor; }
+		const MemoryBudgetGovernor &GetMemoryBudgetGovernor() const { return m_memoryBudgetGovernor; }
+		// Per-frame allocator for short-lived uniform / storage data; Created on first use
+		TransientBufferAllocator *GetTransientBufferAllocator();
+		// Sub-allocates descriptor sets from shared pools per layout, instead of creating a dedicated pool for every descriptor set group
+		DescriptorSetAllocator *GetDescriptorSetAllocator() { return m_descriptorSetAllocator.get(); }
+		// If disabled, every descriptor set group gets its own descriptor pool again. The creation and destruction times of both paths are
+		// recorded by the allocator (see DescriptorSetAllocator::GetStats), so the two can be compared.
+		void SetDescriptorSetPoolingEnabled(bool enabled) { m_descriptorSetPoolingEnabled = enabled; }
+		bool IsDescriptorSetPoolingEnabled() const { return m_descriptorSetPoolingEnabled; }
+		// Only available if the VMA allocator is used
+		MemoryDefragmenter *GetMemoryDefragmenter() { return m_memoryDefragmenter.get(); }
+		// Has to be called if the internal buffers of the specified buffers have been replaced, since render buffers cache their Vulkan handles
+		void ReloadRenderBuffers(const std::unordered_set<const IBuffer *> &buffers);
+		// Resources that are kept alive until the GPU has finished the frame are destroyed through this queue
+		DeferredDestructionQueue &GetDeferredDestructionQueue() { return *m_deferredDestructionQueue; }
+		// Same as KeepResourceAliveUntilPresentationComplete, but the resource may be destroyed on the destruction thread afterwards.
+		// Only for resources whose destruction doesn't require external synchronization (see DeferredDestructionQueue::DestructionThread::Any).
+		void KeepThreadSafeResourceAliveUntilPresentationComplete(const std::shared_ptr<void> &resource);
+		// If enabled, packed RGB images are uploaded as-is and expanded to RGBA by a compute shader instead of on the CPU
+		void SetGpuFormatConversionEnabled(bool enabled) { m_gpuFormatConversionEnabled = enabled; }
+		bool IsGpuFormatConversionEnabled() const { return m_gpuFormatConversionEnabled; }
+		// Created on first use; Returns nullptr if the conversion shaders could not be initialized
+		GpuFormatConverter *GetGpuFormatConverter();
+		// Single-dispatch mipmap generation; Created on first use
+		MipmapGenerator *GetMipmapGenerator();
+		// Changing the size re-creates the allocator, which invalidates all previous allocations
+		void SetTransientBufferSizePerFrame(DeviceSize size);
+		// Flushes the dirty ranges (and the ranges that are currently mapped) of all persistently mapped non-coherent buffers with a single
+		// vkFlushMappedMemoryRanges call.
+		// Called automatically before every queue submission.
+		void FlushMappedMemoryRanges();
+		void RegisterDirtyBuffer(VlkBuffer &buffer);
+		void UnregisterDirtyBuffer(VlkBuffer &buffer);
+		// Only available if VK_EXT_graphics_pipeline_library is supported
+		GraphicsPipelineLibraryManager *GetGraphicsPipelineLibraryManager() { return m_graphicsPipelineLibrary.get(); }
+		// The next submission to the universal queue waits on the semaphore (e.g. for sparse binding operations that were submitted to a different queue).
+		// The semaphore has to stay alive until that submission has completed.
+		void AddUniversalQueueWaitSemaphore(const std::shared_ptr<Anvil::Semaphore> &semaphore);
+		std::vector<std::shared_ptr<Anvil::Semaphore>> TakeUniversalQueueWaitSemaphores();
+		// Records commands into the shared upload command buffer, which is submitted ahead of the next command buffer that is
+		// submitted to the universal queue. The resources added to keepAlive are released once the upload has been executed.
+		// The callback must not submit any command buffers.
+		bool RecordUploadCommands(const std::function<bool(ICommandBuffer &, std::vector<std::shared_ptr<void>> &keepAlive)> &record);
+		void SubmitUploadCommands();
 	  protected:
 		VlkContext(const std::string &appName, bool bEnableValidation = false);
 		virtual void Release() override;
@@ -172,7 +317,16 @@ export namespace prosper {
 		virtual void DoFlushCommandBuffer(ICommandBuffer &cmd) override;
 		virtual std::shared_ptr<IUniformResizableBuffer> DoCreateUniformResizableBuffer(const util::BufferCreateInfo &createInfo, uint64_t bufferInstanceSize, const void *data, prosper::DeviceSize bufferBaseSize, uint32_t alignment) override;
 		void InitVulkan(const CreateInfo &createInfo);
+		struct PipelineResources {
+			std::shared_ptr<PipelineLayoutCache::PipelineLayout> layout;
+			std::vector<std::shared_ptr<ShaderModuleCache::Entry>> shaderModules;
+		};
+		void SetPipelineResources(PipelineID pipelineId, PipelineResources &&resources);
+		void ReleasePipelineResources(PipelineResources &resources);
 		void InitMainRenderPass();
+		void UpdateMemoryBudget();
+		// Releases the resources of the uploads that have been executed; If waitIdle is set, the device has to be idle
+		void ReleaseCompletedUploads(bool waitIdle = false);
 		virtual void ReloadSwapchain() override;
 		virtual std::expected<void, std::string> InitAPI(const CreateInfo &createInfo) override;
 
@@ -188,8 +342,57 @@ export namespace prosper {
 		bool m_customValidationEnabled = false;
 		std::vector<Anvil::PipelineID> m_prosperPipelineToAnvilPipeline;
 		VkRaytracingFunctions m_rtFunctions {};
+		VkHostImageCopyFunctions m_hostImageCopyFunctions {};
+		std::vector<VkImageLayout> m_hostImageCopyDstLayouts;
+		std::vector<VkImageLayout> m_hostImageCopySrcLayouts;
+		mutable std::map<std::tuple<Format, ImageType, ImageUsageFlags, bool>, bool> m_hostImageCopySupport; // Caching
+		mutable std::mutex m_hostImageCopySupportMutex;
+		VkDynamicRenderingFunctions m_dynamicRenderingFunctions {};
+		std::atomic<bool> m_dynamicRenderingPipelinesEnabled = false;
+		VkExtendedDynamicStateFunctions m_extendedDynamicStateFunctions {};
+		ExtendedDynamicStateFlags m_supportedExtendedDynamicStates = ExtendedDynamicStateFlags::None;
 		std::vector<bool> m_swapchainResourcesInUse;
+		std::vector<std::vector<std::shared_ptr<void>>> m_threadSafeKeepAliveResources;
+		struct UploadBatch {
+			std::shared_ptr<IPrimaryCommandBuffer> cmd;
+			std::shared_ptr<IFence> fence;
+			std::vector<std::shared_ptr<void>> resources;
+		};
+		UploadBatch m_uploadBatch {};
+		std::mutex m_uploadMutex;
+		std::vector<UploadBatch> m_pendingUploads;
+		std::mutex m_pendingUploadMutex;
 		std::mutex m_swapchainResourcesInUseMutex;
+		spirv::OptimizationSettings m_spirvOptimizationSettings {};
+		PipelineLayoutCache m_pipelineLayoutCache {};
+		ShaderModuleCache m_shaderModuleCache {};
+		SamplerCache m_samplerCache {};
+		ObjectCache<IRenderPass> m_renderPassCache {};
+		ObjectCache<IFramebuffer> m_framebufferCache {};
+		std::vector<PipelineResources> m_pipelineResources; // Indexed by PipelineID
+		std::unique_ptr<GraphicsPipelineLibraryManager> m_graphicsPipelineLibrary;
+		MemoryBudgetGovernor m_memoryBudgetGovernor {};
+		std::unique_ptr<TransientBufferAllocator> m_transientBufferAllocator;
+		std::unique_ptr<DescriptorSetAllocator> m_descriptorSetAllocator;
+		std::atomic<bool> m_descriptorSetPoolingEnabled = true;
+		std::unique_ptr<MemoryDefragmenter> m_memoryDefragmenter;
+		std::vector<std::weak_ptr<VlkRenderBuffer>> m_renderBuffers;
+		std::mutex m_renderBufferMutex;
+		std::vector<std::shared_ptr<Anvil::Semaphore>> m_universalQueueWaitSemaphores;
+		std::mutex m_universalQueueWaitSemaphoreMutex;
+		std::unique_ptr<DeferredDestructionQueue> m_deferredDestructionQueue;
+		std::unique_ptr<GpuFormatConverter> m_gpuFormatConverter;
+		std::mutex m_gpuFormatConverterMutex;
+		std::atomic<bool> m_gpuFormatConversionEnabled = false;
+		std::unique_ptr<MipmapGenerator> m_mipmapGenerator;
+		std::mutex m_mipmapGeneratorMutex;
+		std::atomic<uint64_t> m_imageViewCacheHits = 0;
+		std::atomic<uint64_t> m_imageViewCacheMisses = 0;
+		MemoryTypeTable m_memoryTypeTable {};
+		PFN_vkGetDeviceImageMemoryRequirementsKHR m_vkGetDeviceImageMemoryRequirements = nullptr;
+		DeviceSize m_transientBufferSizePerFrame = 4 * 1024 * 1024;
+		std::unordered_set<VlkBuffer *> m_dirtyBuffers;
+		std::mutex m_dirtyBufferMutex;
 
 		mutable std::unordered_map<Format, Anvil::FormatProperties> m_formatProperties; // Caching
 		mutable std::mutex m_formatPropertiesMutex;
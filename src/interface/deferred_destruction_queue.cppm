@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:deferred_destruction_queue;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Destroys objects that are no longer in use by the GPU on a low-priority background thread, so that the destructors
+	// (and the memory frees and vkDestroy* calls they issue) don't run on the rendering thread. Each frame, the thread is
+	// given a time budget, which spreads the destruction of large numbers of objects (e.g. on level unload) across frames.
+	// Objects that can't be destroyed concurrently to the rendering thread are destroyed by Update within the same budget instead.
+	class PR_EXPORT DeferredDestructionQueue {
+	  public:
+		struct PR_EXPORT Settings {
+			// If disabled, the objects are destroyed on the thread that calls Update
+			bool useDestructionThread = true;
+			float timeBudgetPerFrameMs = 2.f;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t retiredObjects = 0;
+			uint64_t destroyedObjects = 0;
+			size_t pendingObjects = 0;
+			float lastFrameDestructionTimeMs = 0.f;
+		};
+
+		enum class DestructionThread : uint8_t {
+			// The objects are destroyed on the thread that calls Update. Required for objects that are freed into pools
+			// which are externally synchronized with the rendering thread (e.g. descriptor sets and command buffers).
+			UpdateThread = 0,
+			// The objects may be destroyed on the destruction thread. Only for objects whose destruction doesn't
+			// require any external synchronization (e.g. VMA allocations, pipelines or semaphores).
+			Any,
+		};
+
+		DeferredDestructionQueue(const Settings &settings = {});
+		~DeferredDestructionQueue();
+		DeferredDestructionQueue(const DeferredDestructionQueue &) = delete;
+		DeferredDestructionQueue &operator=(const DeferredDestructionQueue &) = delete;
+
+		void SetSettings(const Settings &settings);
+		Settings GetSettings() const;
+
+		// The GPU must no longer use the objects. The objects are destroyed once the last reference has been released,
+		// so other references may still be held elsewhere.
+		void Retire(std::vector<std::shared_ptr<void>> &&objects, DestructionThread thread = DestructionThread::UpdateThread);
+		void Retire(std::shared_ptr<void> object, DestructionThread thread = DestructionThread::UpdateThread);
+		// Grants the destruction thread the time budget for the next frame and destroys the objects that are bound
+		// to the calling thread within the same budget. Has to be called once per frame.
+		void Update();
+		// Destroys all pending objects and waits for the destruction thread to finish the objects it is currently destroying
+		void Flush();
+		Stats GetStats() const;
+	  private:
+		using Clock = std::chrono::steady_clock;
+		// Destroys objects until there are none left or the deadline has passed
+		void DestroyObjects(std::deque<std::shared_ptr<void>> &objects, std::optional<Clock::time_point> deadline);
+		void StartDestructionThread();
+		void StopDestructionThread();
+		void RunDestructionThread();
+
+		Settings m_settings {};
+		std::deque<std::shared_ptr<void>> m_pendingObjects;
+		std::deque<std::shared_ptr<void>> m_pendingUpdateThreadObjects;
+		uint32_t m_objectsInDestruction = 0;
+		bool m_frameBudgetAvailable = false;
+		Stats m_stats {};
+		mutable std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::condition_variable m_idleCondition;
+
+		std::thread m_thread;
+		bool m_threadRunning = false;
+	};
+};
+#pragma warning(pop)
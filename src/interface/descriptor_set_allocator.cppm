@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <wrappers/descriptor_set_group.h>
+
+export module pragma.prosper.vulkan:descriptor_set_allocator;
+
+export import :object_cache;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Sub-allocates descriptor sets from shared blocks, instead of creating a dedicated descriptor pool for every descriptor set group.
+	// Sets are grouped by their layout, and every layout has its own chain of blocks, which grows through the size classes in BLOCK_SIZE_CLASSES.
+	// A block is a single Anvil descriptor set group (and therefore a single descriptor pool) whose sets are handed out individually,
+	// and returned to the block once the GPU no longer uses them.
+	// Transient sets are taken from separate blocks per frame in flight, which are reclaimed as a whole once the frame has been retired.
+	class PR_EXPORT DescriptorSetAllocator {
+	  public:
+		static constexpr std::array<uint32_t, 4> BLOCK_SIZE_CLASSES = {16, 64, 256, 1024};
+		struct Block {
+			Anvil::DescriptorSetGroupUniquePtr descriptorSetGroup;
+			uint32_t capacity = 0;
+			std::vector<uint32_t> freeIndices;
+			// Only used by transient blocks
+			uint32_t head = 0;
+			std::mutex mutex;
+		};
+		struct PR_EXPORT Allocation {
+			std::shared_ptr<Block> block;
+			uint32_t index = 0;
+			bool transient = false;
+			Anvil::DescriptorSet *GetDescriptorSet() const { return block ? block->descriptorSetGroup->get_descriptor_set(index) : nullptr; }
+			Anvil::DescriptorSetLayout *GetDescriptorSetLayout() const { return block ? block->descriptorSetGroup->get_descriptor_set_layout(index) : nullptr; }
+			bool IsValid() const { return block != nullptr; }
+		};
+		struct PR_EXPORT Stats {
+			size_t layoutCount = 0;
+			size_t blockCount = 0;
+			size_t transientBlockCount = 0;
+			size_t setCapacity = 0;
+			size_t liveSets = 0;
+			uint64_t allocations = 0;
+			uint64_t transientAllocations = 0;
+			// Accumulated time spent creating and destroying descriptor set groups, for the pooled path and for the dedicated pool path
+			// (see VlkContext::SetDescriptorSetPoolingEnabled)
+			std::chrono::nanoseconds pooledCreateTime {0};
+			std::chrono::nanoseconds pooledDestroyTime {0};
+			uint64_t pooledCreateCount = 0;
+			uint64_t pooledDestroyCount = 0;
+			std::chrono::nanoseconds dedicatedCreateTime {0};
+			std::chrono::nanoseconds dedicatedDestroyTime {0};
+			uint64_t dedicatedCreateCount = 0;
+			uint64_t dedicatedDestroyCount = 0;
+		};
+		using AnvilCreateInfoFactory = std::function<std::unique_ptr<Anvil::DescriptorSetCreateInfo>()>;
+
+		DescriptorSetAllocator(VlkContext &context, uint32_t frameCount);
+		~DescriptorSetAllocator();
+		DescriptorSetAllocator(const DescriptorSetAllocator &) = delete;
+		DescriptorSetAllocator &operator=(const DescriptorSetAllocator &) = delete;
+
+		// fCreateInfo has to return the Anvil equivalent of createInfo, and is only invoked if a new block has to be created.
+		// Returns an invalid allocation if the block could not be created.
+		Allocation Allocate(const DescriptorSetCreateInfo &createInfo, const AnvilCreateInfoFactory &fCreateInfo);
+		// The set is only valid until the current frame has been retired, and must not be freed
+		Allocation AllocateTransient(const DescriptorSetCreateInfo &createInfo, const AnvilCreateInfoFactory &fCreateInfo);
+		// The set is returned to its block when the current frame index begins again (see BeginFrame), at which point all work that was
+		// submitted up to and including the current frame is complete
+		void Free(Allocation &&allocation);
+
+		// Has to be called once the resources of the frame with the specified index are no longer in use by the GPU
+		void BeginFrame(uint32_t frameIndex);
+		// Has to be called when the number of frames in flight changes. Waits for the device to become idle and discards all transient allocations.
+		void SetFrameCount(uint32_t frameCount);
+		uint32_t GetFrameCount() const { return m_frameCount; }
+
+		void AddTiming(bool pooled, bool create, std::chrono::nanoseconds duration);
+		Stats GetStats() const;
+	  private:
+		struct Layout {
+			ObjectCacheKey key;
+			std::vector<std::shared_ptr<Block>> blocks;
+			// One chain per frame in flight
+			std::vector<std::vector<std::shared_ptr<Block>>> transientBlocks;
+			uint32_t nextSizeClass = 0;
+		};
+		Layout &GetLayout(const DescriptorSetCreateInfo &createInfo);
+		std::shared_ptr<Block> CreateBlock(uint32_t capacity, const AnvilCreateInfoFactory &fCreateInfo);
+		static void ReleaseFreedSets(std::vector<Allocation> &allocations);
+
+		VlkContext &m_context;
+		uint32_t m_frameCount = 1;
+		uint32_t m_frameIndex = 0;
+		std::unordered_multimap<size_t, std::unique_ptr<Layout>> m_layouts;
+		// Layouts that have transient blocks, so that only these have to be visited at the start of a frame
+		std::vector<Layout *> m_transientLayouts;
+		// Sets that were freed during the frame with the respective index
+		std::vector<std::vector<Allocation>> m_freedSets;
+		uint64_t m_allocations = 0;
+		uint64_t m_transientAllocations = 0;
+		mutable std::mutex m_mutex;
+
+		std::atomic<int64_t> m_timings[2][2] {};
+		std::atomic<uint64_t> m_timingCounts[2][2] {};
+	};
+};
+#pragma warning(pop)
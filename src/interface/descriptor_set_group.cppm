@@ -8,14 +8,20 @@ module;
 export module pragma.prosper.vulkan:descriptor_set_group;
 
 export import :debug.object;
+export import :descriptor_set_allocator;
 
 export namespace prosper {
 	class PR_EXPORT VlkDescriptorSetGroup : public IDescriptorSetGroup {
 	  public:
 		static std::shared_ptr<VlkDescriptorSetGroup> Create(IPrContext &context, const DescriptorSetCreateInfo &createInfo, std::unique_ptr<Anvil::DescriptorSetGroup, std::function<void(Anvil::DescriptorSetGroup *)>> dsg,
 		  const std::function<void(IDescriptorSetGroup &)> &onDestroyedCallback = nullptr);
+		// The descriptor set is sub-allocated from a shared block of the context's descriptor set allocator
+		static std::shared_ptr<VlkDescriptorSetGroup> Create(IPrContext &context, const DescriptorSetCreateInfo &createInfo, DescriptorSetAllocator::Allocation allocation, const std::function<void(IDescriptorSetGroup &)> &onDestroyedCallback = nullptr);
 		virtual ~VlkDescriptorSetGroup() override;
 
+		bool IsPooled() const { return m_allocation.IsValid(); }
+		bool IsTransient() const { return m_allocation.transient; }
+		// Only valid for groups with a dedicated descriptor pool (see IsPooled)
 		Anvil::DescriptorSetGroup &GetAnvilDescriptorSetGroup() const;
 		Anvil::DescriptorSetGroup &operator*();
 		const Anvil::DescriptorSetGroup &operator*() const;
@@ -23,7 +29,9 @@ export namespace prosper {
 		const Anvil::DescriptorSetGroup *operator->() const;
 	  protected:
 		VlkDescriptorSetGroup(IPrContext &context, const DescriptorSetCreateInfo &createInfo, std::unique_ptr<Anvil::DescriptorSetGroup, std::function<void(Anvil::DescriptorSetGroup *)>> dsg);
+		VlkDescriptorSetGroup(IPrContext &context, const DescriptorSetCreateInfo &createInfo, DescriptorSetAllocator::Allocation allocation);
 		std::unique_ptr<Anvil::DescriptorSetGroup, std::function<void(Anvil::DescriptorSetGroup *)>> m_descriptorSetGroup = nullptr;
+		DescriptorSetAllocator::Allocation m_allocation {};
 	};
 
 	class PR_EXPORT VlkDescriptorSet : public IDescriptorSet, public VlkDebugObject {
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/physical_device.h>
+#include "util_enum_flags.hpp"
+
+export module pragma.prosper.vulkan:graphics_pipeline_library;
+
+export import :pipeline_layout_cache;
+export import :shader_module_cache;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Pipeline states that are left dynamic through VK_EXT_extended_dynamic_state (1, 2 and 3), so that pipelines which only differ in
+	// these states share the same libraries.
+	enum class ExtendedDynamicStateFlags : uint32_t {
+		None = 0u,
+		// VK_EXT_extended_dynamic_state
+		CullModeBit = 1u,
+		FrontFaceBit = CullModeBit << 1u,
+		PrimitiveTopologyBit = FrontFaceBit << 1u,
+		DepthTestEnableBit = PrimitiveTopologyBit << 1u,
+		DepthWriteEnableBit = DepthTestEnableBit << 1u,
+		DepthCompareOpBit = DepthWriteEnableBit << 1u,
+		StencilTestEnableBit = DepthCompareOpBit << 1u,
+		StencilOpBit = StencilTestEnableBit << 1u,
+		// VK_EXT_extended_dynamic_state2
+		DepthBiasEnableBit = StencilOpBit << 1u,
+		PrimitiveRestartEnableBit = DepthBiasEnableBit << 1u,
+		RasterizerDiscardEnableBit = PrimitiveRestartEnableBit << 1u,
+		// VK_EXT_extended_dynamic_state3
+		PolygonModeBit = RasterizerDiscardEnableBit << 1u,
+
+		ExtendedDynamicState1 = CullModeBit | FrontFaceBit | PrimitiveTopologyBit | DepthTestEnableBit | DepthWriteEnableBit | DepthCompareOpBit | StencilTestEnableBit | StencilOpBit,
+		ExtendedDynamicState2 = DepthBiasEnableBit | PrimitiveRestartEnableBit | RasterizerDiscardEnableBit,
+	};
+	using namespace pragma::math::scoped_enum::bitwise;
+
+	// Builds graphics pipelines from individually cached VK_EXT_graphics_pipeline_library parts
+	// (vertex input, pre-rasterization shaders, fragment shader, fragment output). Pipelines are fast-linked
+	// on creation and replaced by a link-time optimized pipeline once it has been compiled in the background.
+	class PR_EXPORT GraphicsPipelineLibraryManager {
+	  public:
+		struct PR_EXPORT ShaderStage {
+			VkShaderStageFlagBits stage;
+			std::shared_ptr<ShaderModuleCache::Entry> module;
+			std::string entrypoint;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t libraryHits = 0;
+			uint64_t libraryMisses = 0;
+			// Libraries that were created from shader module identifiers without having to compile the SPIR-V code
+			uint64_t moduleIdentifierHits = 0;
+			uint64_t fastLinkedPipelines = 0;
+			uint64_t optimizedPipelines = 0;
+			// Pipelines that re-used the linked pipeline of another pipeline with the same libraries and layout
+			uint64_t linkedPipelineHits = 0;
+			size_t libraryCount = 0;
+			// Number of distinct pipeline states that were requested, and the number of distinct states that remain
+			// once the extended dynamic states are excluded
+			size_t uniquePipelineStates = 0;
+			size_t uniqueStaticPipelineStates = 0;
+			double GetCollapseRatio() const { return (uniqueStaticPipelineStates > 0) ? static_cast<double>(uniquePipelineStates) / static_cast<double>(uniqueStaticPipelineStates) : 1.0; }
+		};
+		// Values of the extended dynamic states as they were declared in the pipeline create info. They are applied whenever the
+		// pipeline is bound, so that pipelines behave the same regardless of whether the states are dynamic or not.
+		struct PR_EXPORT ExtendedDynamicStateValues {
+			VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+			VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			VkPrimitiveTopology primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			VkBool32 depthTestEnable = VK_FALSE;
+			VkBool32 depthWriteEnable = VK_FALSE;
+			VkCompareOp depthCompareOp = VK_COMPARE_OP_NEVER;
+			VkBool32 stencilTestEnable = VK_FALSE;
+			// Only the operations and the compare op are dynamic, masks and reference remain part of the pipeline
+			VkStencilOpState front {};
+			VkStencilOpState back {};
+			VkBool32 depthBiasEnable = VK_FALSE;
+			VkBool32 primitiveRestartEnable = VK_FALSE;
+			VkBool32 rasterizerDiscardEnable = VK_FALSE;
+			VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+		};
+
+		static bool IsSupported(const Anvil::PhysicalDevice &physDev);
+		// Libraries and linked pipelines are created through the specified pipeline cache, which may be VK_NULL_HANDLE
+		GraphicsPipelineLibraryManager(IPrContext &context, VkDevice device, VkPipelineCache pipelineCache);
+		~GraphicsPipelineLibraryManager();
+		GraphicsPipelineLibraryManager(const GraphicsPipelineLibraryManager &) = delete;
+		GraphicsPipelineLibraryManager &operator=(const GraphicsPipelineLibraryManager &) = delete;
+
+		// Returns false if the pipeline cannot be expressed through pipeline libraries, in which case the caller should use the monolithic path.
+		// If renderingInfo is specified, the pipeline is created for dynamic rendering (VK_KHR_dynamic_rendering) instead of the render pass, and stored
+		// separately from the render pass variant of the same pipeline id.
+		bool CreatePipeline(PipelineID pipelineId, const GraphicsPipelineCreateInfo &createInfo, VkRenderPass renderPass, uint32_t subPass, const std::vector<ShaderStage> &stages, const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout, VkPipelineLayout vkLayout,
+		  const VkPipelineRenderingCreateInfo *renderingInfo = nullptr);
+		VkPipeline GetPipeline(PipelineID pipelineId, bool dynamicRendering = false) const;
+		// Also returns which states of the pipeline are dynamic and the values they have to be set to
+		VkPipeline GetPipeline(PipelineID pipelineId, bool dynamicRendering, ExtendedDynamicStateFlags &outDynamicStates, ExtendedDynamicStateValues &outDynamicStateValues) const;
+		std::shared_ptr<PipelineLayoutCache::PipelineLayout> GetPipelineLayout(PipelineID pipelineId) const;
+		void ClearPipeline(PipelineID pipelineId);
+		void OnRenderPassDestroyed(VkRenderPass renderPass);
+
+		// States that are made dynamic for pipelines created afterwards. Has to be a subset of the states supported by the device.
+		void SetExtendedDynamicStates(ExtendedDynamicStateFlags states) { m_extendedDynamicStates = states; }
+		ExtendedDynamicStateFlags GetExtendedDynamicStates() const { return m_extendedDynamicStates; }
+
+		// Swaps in pipelines that have finished their optimized link. Has to be called from the rendering thread.
+		// Once the first batch of pipelines has been linked, the pipeline state collapse ratio is logged.
+		void Update();
+		Stats GetStats() const;
+	  private:
+		struct Library {
+			~Library();
+			VkDevice device = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			// Keep the objects that are referenced by the key alive
+			std::shared_ptr<PipelineLayoutCache::PipelineLayout> layout;
+			std::vector<std::shared_ptr<ShaderModuleCache::Entry>> modules;
+		};
+		// Pipelines with the same libraries and layout only differ in their extended dynamic state values, so they share one linked pipeline.
+		// The pipeline is destroyed once the last pipeline id referencing it has been cleared.
+		struct LinkedPipeline {
+			~LinkedPipeline();
+			GraphicsPipelineLibraryManager *manager = nullptr;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			std::array<std::shared_ptr<Library>, 4> libraries;
+			std::shared_ptr<PipelineLayoutCache::PipelineLayout> layout;
+		};
+		struct Pipeline {
+			std::shared_ptr<LinkedPipeline> linkedPipeline;
+			ExtendedDynamicStateFlags dynamicStates = ExtendedDynamicStateFlags::None;
+			ExtendedDynamicStateValues dynamicStateValues {};
+		};
+		struct LinkJob {
+			std::shared_ptr<LinkedPipeline> linkedPipeline;
+			VkPipeline result = VK_NULL_HANDLE;
+		};
+		std::shared_ptr<Library> GetOrCreateLibrary(const std::string &key, VkGraphicsPipelineCreateInfo &createInfo, VkGraphicsPipelineLibraryFlagsEXT flags, VkRenderPass renderPass, const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout,
+		  std::vector<std::shared_ptr<ShaderModuleCache::Entry>> &&modules);
+		std::shared_ptr<LinkedPipeline> GetOrLinkPipeline(const std::array<std::shared_ptr<Library>, 4> &libraries, const std::shared_ptr<PipelineLayoutCache::PipelineLayout> &layout, VkPipelineLayout vkLayout);
+		VkPipeline Link(const std::array<std::shared_ptr<Library>, 4> &libraries, VkPipelineLayout layout, bool optimize) const;
+		void DestroyPipelineDeferred(VkPipeline pipeline);
+		void RunLinkThread();
+
+		IPrContext &m_context;
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		std::unordered_map<std::string, std::weak_ptr<Library>> m_libraries;
+		std::unordered_map<PipelineID, Pipeline> m_pipelines;
+		std::unordered_map<PipelineID, Pipeline> m_dynamicRenderingPipelines;
+		// Keyed by the libraries and the layout
+		std::unordered_map<std::string, std::weak_ptr<LinkedPipeline>> m_linkedPipelines;
+		mutable std::shared_mutex m_pipelineMutex;
+		mutable std::mutex m_libraryMutex;
+		// Stats are updated while either of the above mutexes is held, so they are guarded by their own mutex
+		mutable std::mutex m_statsMutex;
+		Stats m_stats {};
+		std::atomic<ExtendedDynamicStateFlags> m_extendedDynamicStates = ExtendedDynamicStateFlags::None;
+		std::unordered_set<size_t> m_pipelineStates;
+		std::unordered_set<size_t> m_staticPipelineStates;
+		bool m_collapseRatioReported = false;
+
+		std::thread m_linkThread;
+		std::queue<LinkJob> m_pendingLinkJobs;
+		std::vector<LinkJob> m_completedLinkJobs;
+		std::mutex m_linkJobMutex;
+		std::condition_variable m_linkJobCondition;
+		bool m_linkThreadRunning = true;
+		bool m_linkThreadBusy = false;
+	};
+};
+export {
+	REGISTER_ENUM_FLAGS(prosper::ExtendedDynamicStateFlags)
+}
+#pragma warning(pop)
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:image.format_conversion;
+
+export import pragma.prosper;
+
+export namespace prosper {
+	namespace util {
+		// Instruction set used by the conversion kernels. The best supported level is selected at runtime.
+		enum class SimdLevel : uint8_t {
+			Scalar = 0,
+			SSE4,
+			AVX2,
+		};
+		enum class PixelConversion : uint8_t {
+			None = 0,
+			Rgb8ToRgba8,
+			Rgba8ToRgb8,
+			Rgb16fToRgba16f,
+			// Swaps the red and blue channels (RGB <-> BGR)
+			SwizzleRbRgb8,
+			SwizzleRbRgba8,
+		};
+
+		PR_EXPORT SimdLevel get_supported_simd_level();
+		PR_EXPORT SimdLevel get_simd_level();
+		// Forces a lower level (e.g. to compare the kernels against the scalar implementation). Clamped to the supported level.
+		PR_EXPORT void set_simd_level(SimdLevel level);
+
+		// Splits the rows into ranges that are processed by a shared worker pool, if the total size is large enough to be worth it.
+		// Blocks until all rows have been processed.
+		PR_EXPORT void parallel_for_rows(uint32_t rowCount, size_t rowSize, const std::function<void(uint32_t rowBegin, uint32_t rowEnd)> &fn);
+
+		struct PR_EXPORT ParallelForRowsBenchmarkResult {
+			uint32_t callerCount = 0;
+			uint32_t callsPerCaller = 0;
+			// Whether every row of every call (including a nested call) was processed exactly once
+			bool valid = false;
+			// Same number of calls, once issued from a single thread and once from callerCount threads at the same time
+			std::chrono::nanoseconds sequentialDuration {};
+			std::chrono::nanoseconds concurrentDuration {};
+		};
+		// Verifies parallel_for_rows with concurrent and nested callers and measures the throughput. The rows are swizzled in place.
+		PR_EXPORT ParallelForRowsBenchmarkResult run_parallel_for_rows_benchmark(uint32_t callerCount = 4, uint32_t callsPerCaller = 64, uint32_t rowCount = 1024, size_t rowSize = 4096);
+
+		PR_EXPORT uint32_t get_pixel_conversion_src_size(PixelConversion conversion);
+		PR_EXPORT uint32_t get_pixel_conversion_dst_size(PixelConversion conversion);
+		// Converts a single row of pixels. src and dst may only be the same for the swizzle conversions.
+		PR_EXPORT void convert_pixels(PixelConversion conversion, const void *src, void *dst, size_t pixelCount);
+		// Converts a tightly packed image row by row (in parallel), optionally flipping it vertically.
+		// src and dst may only be the same for the swizzle conversions without a flip.
+		PR_EXPORT void convert_image(PixelConversion conversion, const void *src, void *dst, uint32_t width, uint32_t height, bool flipVertically = false);
+		PR_EXPORT void flip_image_vertically(void *data, size_t rowSize, uint32_t rowCount);
+
+		PR_EXPORT void convert_float32_to_float16(const float *src, uint16_t *dst, size_t count);
+		PR_EXPORT void convert_float16_to_float32(const uint16_t *src, float *dst, size_t count);
+		// Only the first three channels are converted, the fourth channel (alpha) is left untouched
+		PR_EXPORT void convert_srgb_to_linear(uint8_t *data, size_t pixelCount, uint32_t numChannels);
+		PR_EXPORT void convert_linear_to_srgb(uint8_t *data, size_t pixelCount, uint32_t numChannels);
+	};
+};
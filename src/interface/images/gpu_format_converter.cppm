@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+export module pragma.prosper.vulkan:image.gpu_format_converter;
+
+export import :image.format_conversion;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Expands packed three-channel pixel data into a four-channel image with a compute shader. The source data is uploaded as-is,
+	// which saves a quarter of the upload bandwidth compared to expanding it on the CPU beforehand (see util::convert_image).
+	// Produces the same results as the CPU converter.
+	class PR_EXPORT GpuFormatConverter {
+	  public:
+		struct PR_EXPORT Stats {
+			uint64_t dispatchCount = 0;
+			uint64_t convertedPixels = 0;
+		};
+		struct PR_EXPORT ReferenceComparisonResult {
+			bool executed = false;
+			uint64_t pixelCount = 0;
+			// Number of pixels that differ from the result of util::convert_image
+			uint64_t mismatchedPixels = 0;
+			bool IsValid() const { return executed && mismatchedPixels == 0; }
+		};
+		// Returns nullptr if the shaders could not be compiled
+		static std::unique_ptr<GpuFormatConverter> Create(VlkContext &context);
+		~GpuFormatConverter();
+		GpuFormatConverter(const GpuFormatConverter &) = delete;
+		GpuFormatConverter &operator=(const GpuFormatConverter &) = delete;
+
+		// Only Rgb8ToRgba8 and Rgb16fToRgba16f are supported. The destination format has to support storage image usage,
+		// which excludes sRGB formats.
+		bool IsSupported(util::PixelConversion conversion, Format dstFormat) const;
+		// The destination image requires storage usage
+		static ImageUsageFlags GetRequiredImageUsage() { return ImageUsageFlags::StorageBit; }
+
+		// Records the conversion of the packed pixels at srcOffset in srcBuffer (which requires storage buffer usage) into the specified
+		// layer and mipmap of the image. The subresource has to be in ImageLayout::General and is left in that layout.
+		// If swizzleRb is set, the source is treated as BGR data.
+		// The returned object holds the descriptor set and image view of the dispatch and must be kept alive until the command buffer has been executed.
+		std::shared_ptr<void> RecordConvert(ICommandBuffer &cmd, util::PixelConversion conversion, IBuffer &srcBuffer, DeviceSize srcOffset, IImage &dstImage, uint32_t layer, uint32_t mipmap, uint32_t width, uint32_t height, bool swizzleRb = false);
+		// Converts all layers of the first mipmap of dstImage, with the packed pixels of each layer starting at a multiple of srcLayerStride.
+		// The layers are converted into a transient storage image and copied into dstImage, which only requires transfer destination usage.
+		// The previous contents of dstImage are discarded and the image is transitioned to dstLayout.
+		// The returned object holds the transient resources and must be kept alive until the command buffer has been executed.
+		std::shared_ptr<void> RecordConvertImage(ICommandBuffer &cmd, util::PixelConversion conversion, IBuffer &srcBuffer, DeviceSize srcLayerStride, IImage &dstImage, ImageLayout dstLayout);
+		Stats GetStats() const;
+
+		// Converts generated pixel data on the GPU with RecordConvertImage, reads it back and compares it against util::convert_image.
+		// Blocks until the GPU has finished.
+		static ReferenceComparisonResult RunCpuReferenceComparison(VlkContext &context, util::PixelConversion conversion, uint32_t width = 67, uint32_t height = 35, uint32_t layerCount = 2);
+	  private:
+		struct PipelineKey {
+			util::PixelConversion conversion;
+			bool swizzleRb;
+			bool operator==(const PipelineKey &other) const = default;
+		};
+		GpuFormatConverter(VlkContext &context);
+		bool Initialize();
+		VkPipeline GetPipeline(const PipelineKey &key);
+		VkDescriptorSet AllocateDescriptorSet(VkDescriptorPool &outPool);
+		void FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descSet);
+
+		VlkContext &m_context;
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+		// A new pool is added whenever the existing ones are exhausted
+		std::vector<VkDescriptorPool> m_descriptorPools;
+		// Compiled lazily on first use of a conversion
+		std::vector<std::pair<PipelineKey, VkPipeline>> m_pipelines;
+		Stats m_stats {};
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
@@ -29,10 +29,50 @@ export namespace prosper {
 		virtual std::optional<size_t> GetStorageSize() const override;
 		virtual const void *GetInternalHandle() const override;
 		virtual std::optional<util::SubresourceLayout> GetSubresourceLayout(uint32_t layerId = 0, uint32_t mipMapIdx = 0) override;
+
+		// Writes CPU memory directly into the image through VK_EXT_host_image_copy, without a staging buffer or a command buffer.
+		// If the host layout of the image is not a host copy destination layout (see VlkContext::IsHostImageCopyDstLayout), the image is
+		// transitioned on the host first. Only one aspect can be written at a time. rowLength is in texels, 0 means the data is tightly packed.
+		// Returns false if the image was not created with host transfer usage. The image must not be in use by the device.
+		bool CopyFromMemory(const void *data, ImageAspectFlags aspect, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rowLength = 0);
+		// Same as above, but writes all aspects of the image. For combined depth/stencil formats the texels are interleaved in the data.
+		bool CopyFromMemory(const void *data, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rowLength = 0);
+		// Transitions all subresources of the image with vkTransitionImageLayoutEXT. The new layout has to be a host copy destination layout.
+		bool TransitionLayoutOnHost(ImageLayout newLayout);
+		// Layout of the image as far as host copies are concerned; Initially the post-create layout of the image.
+		// If the image has since been transitioned by the device, the layout has to be updated before it is written from the host again.
+		ImageLayout GetHostLayout() const;
+		void SetHostLayout(ImageLayout layout);
+		bool IsHostImageCopyEnabled() const { return m_hostImageCopy; }
+
+		// Identifies an image view over this image by everything that affects the resulting VkImageView
+		struct PR_EXPORT ViewCacheKey {
+			ImageViewType type;
+			Format format;
+			ImageAspectFlags aspectMask;
+			uint32_t baseMipmap;
+			uint32_t mipmapCount;
+			uint32_t baseLayer;
+			uint32_t layerCount;
+			std::array<decltype(util::ImageViewCreateInfo::swizzleRed), 4> swizzle;
+			bool operator==(const ViewCacheKey &other) const = default;
+		};
+		// Views are only cached while they are referenced elsewhere, the cache itself does not keep them alive
+		std::shared_ptr<IImageView> FindCachedView(const ViewCacheKey &key) const;
+		// If a view with the same key has been added in the meantime, that view is returned instead
+		std::shared_ptr<IImageView> AddCachedView(const ViewCacheKey &key, const std::shared_ptr<IImageView> &view);
 	  protected:
 		VlkImage(IPrContext &context, std::unique_ptr<Anvil::Image, std::function<void(Anvil::Image *)>> img, const util::ImageCreateInfo &createInfo, bool isSwapchainImage);
 		virtual bool DoSetMemoryBuffer(IBuffer &buffer) override;
 		std::unique_ptr<Anvil::Image, std::function<void(Anvil::Image *)>> m_image = nullptr;
 		bool m_swapchainImage = false;
+		bool m_hostImageCopy = false;
+		std::vector<std::pair<ViewCacheKey, std::weak_ptr<IImageView>>> m_viewCache;
+		mutable std::mutex m_viewCacheMutex;
+	  private:
+		// Has to be called with m_hostLayoutMutex locked
+		bool DoTransitionLayoutOnHost(ImageLayout newLayout);
+		ImageLayout m_hostLayout = ImageLayout::Undefined;
+		mutable std::mutex m_hostLayoutMutex;
 	};
 };
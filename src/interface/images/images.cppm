@@ -4,6 +4,10 @@
 module;
 
 export module pragma.prosper.vulkan:image;
+export import :image.format_conversion;
+export import :image.gpu_format_converter;
 export import :image.image;
+export import :image.mipmap_generator;
 export import :image.sampler;
+export import :image.sampler_cache;
 export import :image.view;
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+export module pragma.prosper.vulkan:image.mipmap_generator;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Generates the mipmap chain of an image in a single compute dispatch (similar to AMD's FidelityFX Single Pass Downsampler).
+	// Every workgroup reduces a 64x64 tile of mipmap 0 to the next six mipmaps in shared memory, and the last workgroup to finish
+	// (determined through a global atomic counter) reduces mipmap 6 to the remaining ones. This avoids the barrier between every
+	// pair of mipmaps that a blit chain requires.
+	class PR_EXPORT MipmapGenerator {
+	  public:
+		enum class Filter : uint8_t {
+			Average = 0,
+			// For depth pyramids (Hi-Z)
+			Min,
+			Max,
+		};
+		static constexpr uint32_t MAX_MIPMAPS_PER_DISPATCH = 12;
+		static constexpr uint32_t MAX_SINGLE_PASS_EXTENT = 1 << MAX_MIPMAPS_PER_DISPATCH;
+
+		// Returns nullptr if the pipeline layout could not be created
+		static std::unique_ptr<MipmapGenerator> Create(VlkContext &context);
+		~MipmapGenerator();
+		MipmapGenerator(const MipmapGenerator &) = delete;
+		MipmapGenerator &operator=(const MipmapGenerator &) = delete;
+
+		// The image requires storage usage, a format that supports storage writes and an extent of at most MAX_SINGLE_PASS_EXTENT.
+		bool IsSinglePassSupported(const IImage &img) const;
+		// Generates all mipmaps of all layers from mipmap 0, which has to be in currentLayout. The previous contents of the other mipmaps are discarded.
+		// All mipmaps end up in finalLayout. If the single pass is not supported, the mipmaps are generated with a blit chain instead, which is only
+		// possible for the Average filter. Returns false if neither is possible.
+		// outResources receives the image views and descriptor set of the dispatch (nullptr for the blit chain), which must be kept alive
+		// until the command buffer has been executed.
+		bool RecordGenerateMipmaps(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout, std::shared_ptr<void> &outResources, Filter filter = Filter::Average);
+	  private:
+		struct PipelineKey {
+			Format format;
+			Filter filter;
+			bool operator==(const PipelineKey &other) const = default;
+		};
+		MipmapGenerator(VlkContext &context);
+		bool Initialize();
+		VkPipeline GetPipeline(const PipelineKey &key);
+		VkDescriptorSet AllocateDescriptorSet(VkDescriptorPool &outPool);
+		void FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descSet);
+		// The counter buffer holds one atomic counter per layer
+		bool ReserveCounters(uint32_t layerCount);
+		std::shared_ptr<void> RecordSinglePass(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout, Filter filter);
+		bool RecordBlitChain(ICommandBuffer &cmd, IImage &img, ImageLayout currentLayout, AccessFlags srcAccessMask, PipelineStageFlags srcStageMask, ImageLayout finalLayout);
+
+		VlkContext &m_context;
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> m_descriptorPools;
+		std::vector<std::pair<PipelineKey, VkPipeline>> m_pipelines;
+		std::shared_ptr<IBuffer> m_counterBuffer;
+		uint32_t m_counterCapacity = 0;
+		std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
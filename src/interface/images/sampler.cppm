@@ -8,6 +8,7 @@ module;
 export module pragma.prosper.vulkan:image.sampler;
 
 export import :debug.object;
+export import :image.sampler_cache;
 
 export namespace prosper {
 	class PR_EXPORT VlkSampler : public ISampler, public VlkDebugObject {
@@ -27,6 +28,9 @@ export namespace prosper {
 	  protected:
 		VlkSampler(IPrContext &context, const util::SamplerCreateInfo &samplerCreateInfo);
 		virtual bool DoUpdate() override;
-		std::unique_ptr<Anvil::Sampler, std::function<void(Anvil::Sampler *)>> m_sampler = nullptr;
+		// The Vulkan sampler is shared with all other samplers with the same state (see SamplerCache)
+		std::shared_ptr<SamplerCache::Entry> m_samplerEntry = nullptr;
+		// Only the sampler that created the Vulkan sampler registers it as debug object
+		bool m_debugObjectOwner = false;
 	};
 };
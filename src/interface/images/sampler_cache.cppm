@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/sampler.h>
+
+export module pragma.prosper.vulkan:image.sampler_cache;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Shares Vulkan samplers between all VlkSampler objects with identical sampler state. Materials tend to use only a handful
+	// of distinct filtering and addressing modes, but every material creates its own sampler object.
+	class PR_EXPORT SamplerCache {
+	  public:
+		// Sampler state after the device limits have been applied. State that is ignored by Vulkan (e.g. the compare op if comparison
+		// is disabled) is normalized, so that it doesn't result in separate samplers.
+		struct PR_EXPORT Key {
+			VkFilter magFilter = VK_FILTER_NEAREST;
+			VkFilter minFilter = VK_FILTER_NEAREST;
+			VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			std::array<VkSamplerAddressMode, 3> addressModes {};
+			float mipLodBias = 0.f;
+			float maxAnisotropy = 0.f;
+			bool compareEnable = false;
+			VkCompareOp compareOp = VK_COMPARE_OP_NEVER;
+			float minLod = 0.f;
+			float maxLod = 0.f;
+			VkBorderColor borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+			void Normalize();
+			size_t Hash() const;
+			bool operator==(const Key &other) const = default;
+		};
+		struct PR_EXPORT Entry {
+			size_t hash = 0;
+			Key key {};
+			Anvil::SamplerUniquePtr sampler = nullptr;
+			uint32_t refCount = 0;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			size_t samplerCount = 0;
+			size_t samplerReferenceCount = 0;
+		};
+
+		SamplerCache() = default;
+		SamplerCache(const SamplerCache &) = delete;
+		SamplerCache &operator=(const SamplerCache &) = delete;
+
+		// A warning is logged once the number of unique samplers approaches the device limit (maxSamplerAllocationCount)
+		void SetSamplerLimit(uint32_t maxSamplers);
+		// The key has to be normalized. outCreated is set to true if a new Vulkan sampler had to be created for the key.
+		std::shared_ptr<Entry> Acquire(VlkContext &context, const Key &key, bool *outCreated = nullptr);
+		void Release(const std::shared_ptr<Entry> &entry);
+		void Clear();
+		Stats GetStats() const;
+	  private:
+		std::unordered_multimap<size_t, std::shared_ptr<Entry>> m_entries;
+		uint32_t m_samplerLimit = 0;
+		bool m_limitWarningIssued = false;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
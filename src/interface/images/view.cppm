@@ -23,6 +23,9 @@ export namespace prosper {
 
 		virtual void Bake() override;
 
+		// Number of image views that currently exist
+		static uint32_t GetLiveViewCount();
+
 		virtual const void *GetInternalHandle() const override { return m_imageView ? m_imageView->get_image_view() : nullptr; }
 	  protected:
 		VlkImageView(IPrContext &context, IImage &img, const util::ImageViewCreateInfo &createInfo, ImageViewType type, ImageAspectFlags aspectFlags, std::unique_ptr<Anvil::ImageView, std::function<void(Anvil::ImageView *)>> imgView);
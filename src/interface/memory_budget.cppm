@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:memory_budget;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Watches the memory budget of each heap and reacts to memory pressure by invoking eviction callbacks and by
+	// moving new allocations out of device-local memory. The policy only operates on the budgets that are passed to
+	// Update, which allows it to be driven by simulated budgets.
+	class PR_EXPORT MemoryBudgetGovernor {
+	  public:
+		enum class Pressure : uint8_t {
+			Normal = 0,
+			Elevated, // Eviction watermark has been crossed
+			Critical, // Downgrade watermark has been crossed
+		};
+		struct PR_EXPORT HeapBudget {
+			uint64_t budget = 0;
+			uint64_t usage = 0;
+			bool deviceLocal = false;
+		};
+		struct PR_EXPORT Settings {
+			// Fractions of the heap budget
+			float evictionWatermark = 0.9f;
+			float downgradeWatermark = 0.95f;
+			// Eviction tries to bring the usage down to this level
+			float targetWatermark = 0.8f;
+			// Number of updates to wait after an eviction before evicting from the same heap again, since freed
+			// resources are usually only released once the GPU is done with them.
+			uint32_t evictionCooldown = 3;
+			bool downgradeDeviceLocalAllocations = true;
+		};
+		// Returns the (estimated) number of bytes that have been freed
+		using EvictionCallback = std::function<uint64_t(uint32_t heapIndex, uint64_t bytesToFree)>;
+		using CallbackHandle = uint32_t;
+
+		MemoryBudgetGovernor() = default;
+		MemoryBudgetGovernor(const MemoryBudgetGovernor &) = delete;
+		MemoryBudgetGovernor &operator=(const MemoryBudgetGovernor &) = delete;
+
+		void SetSettings(const Settings &settings);
+		const Settings &GetSettings() const { return m_settings; }
+
+		// Callbacks with a lower priority value are invoked first
+		CallbackHandle AddEvictionCallback(std::string name, int32_t priority, const EvictionCallback &callback);
+		void RemoveEvictionCallback(CallbackHandle handle);
+
+		void Update(const std::vector<HeapBudget> &budgets);
+		Pressure GetPressure(uint32_t heapIndex) const;
+		std::optional<HeapBudget> GetHeapBudget(uint32_t heapIndex) const;
+		bool ShouldDowngradeDeviceLocalAllocations() const { return m_downgradeDeviceLocalAllocations; }
+		// Returns the memory features that should be used for a new allocation under the current memory pressure
+		MemoryFeatureFlags ApplyAllocationPolicy(MemoryFeatureFlags featureFlags) const;
+		// Only buffers that can tolerate host-visible memory (see CanDemoteBuffer) are moved out of device-local memory
+		MemoryFeatureFlags ApplyAllocationPolicy(MemoryFeatureFlags featureFlags, BufferUsageFlags usageFlags) const;
+		// Buffers that are only used for transfers or as uniform buffers see little GPU bandwidth, all other buffers (e.g. storage,
+		// vertex or index buffers) would slow down rendering considerably if they were moved to host-visible memory
+		static bool CanDemoteBuffer(BufferUsageFlags usageFlags);
+		std::string ToString() const;
+	  private:
+		struct Callback {
+			CallbackHandle handle;
+			std::string name;
+			int32_t priority;
+			EvictionCallback callback;
+		};
+		struct HeapState {
+			HeapBudget budget {};
+			Pressure pressure = Pressure::Normal;
+			uint32_t cooldown = 0;
+		};
+		Settings m_settings {};
+		std::vector<Callback> m_callbacks;
+		std::vector<HeapState> m_heaps;
+		CallbackHandle m_nextCallbackHandle = 0;
+		std::atomic<bool> m_downgradeDeviceLocalAllocations = false;
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
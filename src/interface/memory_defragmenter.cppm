@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+export module pragma.prosper.vulkan:memory_defragmenter;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Incrementally reduces the fragmentation of the VMA heaps. VMA's defragmentation algorithm determines which allocations
+	// should be moved; Registered buffers among them are copied to the destination VMA has reserved for them, and the internal buffer
+	// is swapped for one that is bound to the new location. All copies of a pass are submitted with a single command buffer, and the
+	// pass is only completed (which releases the previous locations) once the copies and all frames that were in flight are done.
+	class PR_EXPORT MemoryDefragmenter {
+	  public:
+		// Called after a buffer has been relocated, so that descriptor sets and cached handles can be updated
+		using RelocationCallback = std::function<void(IBuffer &)>;
+		struct PR_EXPORT Settings {
+			bool enabled = false;
+			DeviceSize maxBytesPerPass = 16 * 1024 * 1024;
+			uint32_t maxMovesPerPass = 64;
+		};
+		struct PR_EXPORT FragmentationMetrics {
+			DeviceSize blockBytes = 0;
+			DeviceSize allocationBytes = 0;
+			DeviceSize largestUnusedRange = 0;
+			uint32_t blockCount = 0;
+			uint32_t allocationCount = 0;
+			uint32_t unusedRangeCount = 0;
+			DeviceSize GetUnusedBytes() const { return blockBytes - allocationBytes; }
+			// 0 if all free memory is contiguous, approaches 1 the more the free memory is split up
+			float GetFragmentation() const;
+			std::string ToString() const;
+		};
+		struct PR_EXPORT PassResult {
+			FragmentationMetrics before {};
+			FragmentationMetrics after {};
+			uint32_t movesRequested = 0;
+			uint32_t buffersRelocated = 0;
+			DeviceSize bytesMoved = 0;
+		};
+
+		MemoryDefragmenter(VlkContext &context);
+		~MemoryDefragmenter();
+		void SetSettings(const Settings &settings) { m_settings = settings; }
+		const Settings &GetSettings() const { return m_settings; }
+
+		// Only registered buffers are relocated. The buffer has to be a top-level buffer without sub-buffers and requires
+		// the TransferSrcBit and TransferDstBit usage flags.
+		void RegisterRelocatableBuffer(const std::shared_ptr<IBuffer> &buffer, const RelocationCallback &callback = nullptr);
+		void UnregisterRelocatableBuffer(IBuffer &buffer);
+
+		// Starts relocating up to maxBytesPerPass of registered buffers, or advances the pass that is currently in progress.
+		// Returns the result once a pass has been completed. Has to be called once per frame, before the frame's command buffer
+		// is submitted. Writes to a buffer by frames that are still in flight at the start of the pass would be lost, so it should
+		// only be used for buffers that are not written to by the GPU.
+		std::optional<PassResult> RunPass();
+		FragmentationMetrics CalcFragmentationMetrics() const;
+		const std::optional<PassResult> &GetLastPassResult() const { return m_lastPassResult; }
+	  private:
+		struct Entry {
+			std::weak_ptr<IBuffer> buffer;
+			RelocationCallback callback;
+		};
+		struct PendingPass;
+		bool BeginPass();
+		void EndPass();
+
+		VlkContext &m_context;
+		std::unique_ptr<PendingPass> m_pendingPass;
+		Settings m_settings {};
+		std::unordered_map<const IBuffer *, Entry> m_buffers;
+		std::optional<PassResult> m_lastPassResult {};
+		std::mutex m_bufferMutex;
+	};
+};
+#pragma warning(pop)
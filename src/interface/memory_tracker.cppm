@@ -16,6 +16,9 @@ export import pragma.prosper;
 #pragma warning(push)
 #pragma warning(disable : 4251)
 export namespace prosper {
+	// Keeps track of all buffers and images and the memory they occupy. Resources are distributed across
+	// several independently locked shards, and the allocated size per memory type is maintained incrementally,
+	// so adding / removing resources and querying the memory stats does not depend on the number of resources.
 	class PR_EXPORT MemoryTracker {
 	  public:
 		struct PR_EXPORT Resource {
@@ -29,26 +32,65 @@ export namespace prosper {
 
 				Any = std::numeric_limits<uint8_t>::max()
 			};
+			struct PR_EXPORT Allocation {
+				uint32_t memoryType;
+				uint64_t size;
+			};
 			void *resource;
 			TypeFlags typeFlags;
+			// Memory occupied by the resource at the time it was added (or last updated)
+			std::vector<Allocation> allocations;
 			Anvil::MemoryBlock *GetMemoryBlock(uint32_t i) const;
 			uint32_t GetMemoryBlockCount() const;
 		};
+		struct PR_EXPORT BenchmarkResult {
+			uint64_t operations = 0;
+			std::chrono::nanoseconds duration {0};
+			// True if all counters returned to zero once every resource was removed again
+			bool consistent = false;
+		};
 		static MemoryTracker &GetInstance();
+		// Adds and removes the specified number of synthetic resources (without any backing objects) on a separate
+		// tracker instance from multiple threads. Runs on the CPU only.
+		static BenchmarkResult RunStressBenchmark(uint32_t operations = 1'000'000, uint32_t threadCount = 4);
 
 		bool GetMemoryStats(prosper::IPrContext &context, uint32_t memType, uint64_t &allocatedSize, uint64_t &totalSize, Resource::TypeFlags typeFlags = Resource::TypeFlags::Any) const;
-		void GetResources(uint32_t memType, std::vector<const Resource *> &outResources, Resource::TypeFlags typeFlags = Resource::TypeFlags::Any) const;
-		const std::vector<Resource> &GetResources() const;
+		// Returned resources are copies. The resource pointers they contain are not guaranteed to be valid anymore once the call returns,
+		// use IterateResources if the resources have to be accessed.
+		void GetResources(uint32_t memType, std::vector<Resource> &outResources, Resource::TypeFlags typeFlags = Resource::TypeFlags::Any) const;
+		std::vector<Resource> GetResources() const;
+		// The callback is invoked while the shard of the resource is locked, so the resource cannot be destroyed during the call.
+		// Resources must not be added to or removed from the tracker from within the callback.
+		void IterateResources(const std::function<void(const Resource &)> &f, Resource::TypeFlags typeFlags = Resource::TypeFlags::Any) const;
+		size_t GetResourceCount() const;
 
 		void AddResource(IBuffer &buffer);
 		void AddResource(IImage &buffer);
 		void RemoveResource(IBuffer &buffer);
 		void RemoveResource(IImage &buffer);
+		// Has to be called if the memory of a tracked resource has changed
+		void UpdateResource(IBuffer &buffer);
+		void UpdateResource(IImage &image);
 	  private:
-		void RemoveResource(void *resource);
+		static constexpr uint32_t SHARD_COUNT = 32;
+		static constexpr uint32_t MAX_MEMORY_TYPES = 32; // VK_MAX_MEMORY_TYPES
+		enum class Category : uint8_t { Image = 0, DynamicBuffer, UniformBuffer, StandAloneBuffer, Count };
+		struct Shard {
+			std::unordered_map<const void *, Resource> resources;
+			mutable std::mutex mutex;
+		};
+		static Category GetCategory(Resource::TypeFlags typeFlags);
+		static void CollectAllocations(Resource &resource);
+		Shard &GetShard(const void *key);
+		const Shard &GetShard(const void *key) const;
+		void AddResource(const void *key, Resource &&resource);
+		void UpdateResource(const void *key);
+		void RemoveResource(const void *key);
+		void ApplyAllocations(const Resource &resource, bool add);
 		MemoryTracker() = default;
-		std::vector<Resource> m_resources = {};
-		mutable std::mutex m_resourceMutex;
+		std::array<Shard, SHARD_COUNT> m_shards;
+		std::array<std::array<std::atomic<uint64_t>, pragma::math::to_integral(Category::Count)>, MAX_MEMORY_TYPES> m_allocatedSizes {};
+		std::atomic<size_t> m_resourceCount = 0;
 	};
 	using namespace pragma::math::scoped_enum::bitwise;
 };
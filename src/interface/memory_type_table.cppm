@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+export module pragma.prosper.vulkan:memory_type_table;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Memory type selection for every combination of memory feature flags and resource kind, built once from the memory properties
+	// of the device. Only operates on the VkPhysicalDeviceMemoryProperties that are passed to Initialize, which allows the selection
+	// to be evaluated with synthetic memory properties.
+	class PR_EXPORT MemoryTypeTable {
+	  public:
+		enum class ResourceKind : uint8_t {
+			Buffer = 0,
+			Image,
+
+			Count
+		};
+		struct PR_EXPORT Selection {
+			// Best memory type for the requested features, or INVALID_MEMORY_TYPE if no compatible type exists
+			uint32_t memoryTypeIndex = INVALID_MEMORY_TYPE;
+			// The features that can actually be provided; Only differs from the requested features if no type supports all of them
+			MemoryFeatureFlags featureFlags = MemoryFeatureFlags::None;
+			bool IsValid() const { return memoryTypeIndex != INVALID_MEMORY_TYPE; }
+		};
+		static constexpr uint32_t INVALID_MEMORY_TYPE = std::numeric_limits<uint32_t>::max();
+		// Device-local host-visible heaps above this size indicate resizable BAR, as opposed to the legacy 256 MiB BAR window
+		static constexpr DeviceSize RESIZABLE_BAR_MIN_HEAP_SIZE = 256 * 1024 * 1024;
+		// Images at least this large are checked for dedicated allocation hints
+		static constexpr DeviceSize DEDICATED_ALLOCATION_MIN_SIZE = 32 * 1024 * 1024;
+
+		static MemoryFeatureFlags ToMemoryFeatureFlags(VkMemoryPropertyFlags propertyFlags);
+		static VkMemoryPropertyFlags ToMemoryPropertyFlags(MemoryFeatureFlags featureFlags);
+		// Decision for VK_KHR_dedicated_allocation requirements of a resource with the specified size
+		static bool ShouldUseDedicatedAllocation(const VkMemoryDedicatedRequirements &requirements, DeviceSize size);
+		// Checks the selection against synthetic memory properties of common device layouts. Returns false if any of the checks failed,
+		// in which case a description of every failed check is appended to outFailures.
+		static bool RunSelectionTests(std::vector<std::string> &outFailures);
+
+		void Initialize(const VkPhysicalDeviceMemoryProperties &memProps);
+		// Same as Select with the default resource kind and no memory type restrictions, but precomputed
+		const Selection &FindCompatibleMemoryType(MemoryFeatureFlags featureFlags) const;
+		// Memory types that support all of the requested features, best first
+		const std::vector<uint32_t> &GetRankedMemoryTypes(MemoryFeatureFlags featureFlags, ResourceKind kind) const;
+		// Returns the best ranked memory type that is also included in memoryTypeBits (see VkMemoryRequirements)
+		Selection Select(MemoryFeatureFlags featureFlags, ResourceKind kind, uint32_t memoryTypeBits = std::numeric_limits<uint32_t>::max()) const;
+
+		bool IsResizableBarAvailable() const { return m_resizableBarHeapIndex != INVALID_MEMORY_TYPE; }
+		// Size of the largest device-local host-visible heap, 0 if there is none
+		DeviceSize GetBarHeapSize() const { return m_barHeapSize; }
+		const VkPhysicalDeviceMemoryProperties &GetMemoryProperties() const { return m_memProps; }
+		std::string ToString() const;
+	  private:
+		// Index with all basic feature flags (DeviceLocal | HostCached | HostCoherent | LazilyAllocated | HostAccessable)
+		static constexpr uint32_t FEATURE_COMBINATION_COUNT = 32;
+		static uint32_t GetFeatureIndex(MemoryFeatureFlags featureFlags);
+		void RankMemoryTypes(MemoryFeatureFlags featureFlags, ResourceKind kind, std::vector<uint32_t> &outTypes) const;
+		VkPhysicalDeviceMemoryProperties m_memProps {};
+		std::array<std::array<std::vector<uint32_t>, static_cast<size_t>(ResourceKind::Count)>, FEATURE_COMBINATION_COUNT> m_rankedTypes;
+		std::array<Selection, FEATURE_COMBINATION_COUNT> m_compatibleTypes;
+		uint32_t m_resizableBarHeapIndex = INVALID_MEMORY_TYPE;
+		DeviceSize m_barHeapSize = 0;
+	};
+};
+#pragma warning(pop)
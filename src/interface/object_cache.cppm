@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:object_cache;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Flattened description of a Vulkan object. Objects with equal keys are interchangeable.
+	// Keys don't depend on a device, so they can be generated and compared without one.
+	struct PR_EXPORT ObjectCacheKey {
+		std::vector<uint64_t> words;
+		size_t hash = 0;
+		void Add(uint64_t word) { words.push_back(word); }
+		// Has to be called after all words have been added
+		void ComputeHash();
+		bool operator==(const ObjectCacheKey &other) const { return hash == other.hash && words == other.words; }
+	};
+	// Canonical description of the attachments, subpasses and subpass dependencies of a render pass
+	PR_EXPORT ObjectCacheKey make_render_pass_cache_key(const util::RenderPassCreateInfo &createInfo);
+	// Attachments are identified by their Vulkan image view handles
+	PR_EXPORT ObjectCacheKey make_framebuffer_cache_key(uint32_t width, uint32_t height, uint32_t layers, const std::vector<IImageView *> &attachments);
+
+	// Shares objects with equal keys for as long as they are referenced somewhere else.
+	// The cache only holds weak references, entries of released objects are evicted automatically.
+	template<class T>
+	class ObjectCache {
+	  public:
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			size_t objectCount = 0;
+		};
+		ObjectCache() = default;
+		ObjectCache(const ObjectCache &) = delete;
+		ObjectCache &operator=(const ObjectCache &) = delete;
+
+		std::shared_ptr<T> Find(const ObjectCacheKey &key)
+		{
+			std::scoped_lock lock {m_mutex};
+			auto range = m_entries.equal_range(key.hash);
+			for(auto it = range.first; it != range.second; ++it) {
+				if(it->second.first != key)
+					continue;
+				auto obj = it->second.second.lock();
+				if(!obj)
+					break;
+				++m_hits;
+				return obj;
+			}
+			++m_misses;
+			return nullptr;
+		}
+		// If an object with the same key has been added in the meantime, that object is returned instead
+		std::shared_ptr<T> Add(const ObjectCacheKey &key, const std::shared_ptr<T> &obj)
+		{
+			std::scoped_lock lock {m_mutex};
+			auto range = m_entries.equal_range(key.hash);
+			for(auto it = range.first; it != range.second; ++it) {
+				if(it->second.first != key)
+					continue;
+				if(auto existing = it->second.second.lock())
+					return existing;
+				it->second.second = obj;
+				return obj;
+			}
+			m_entries.insert({key.hash, {key, obj}});
+			// Only prune expired entries once the cache has doubled in size since the last time, to keep insertions cheap
+			if(m_entries.size() >= m_pruneThreshold) {
+				std::erase_if(m_entries, [](const auto &pair) { return pair.second.second.expired(); });
+				m_pruneThreshold = pragma::math::max(m_entries.size() * 2, static_cast<size_t>(64));
+			}
+			return obj;
+		}
+		void Clear()
+		{
+			std::scoped_lock lock {m_mutex};
+			m_entries.clear();
+		}
+		Stats GetStats() const
+		{
+			std::scoped_lock lock {m_mutex};
+			Stats stats {};
+			stats.hits = m_hits;
+			stats.misses = m_misses;
+			for(auto &[hash, entry] : m_entries) {
+				if(!entry.second.expired())
+					++stats.objectCount;
+			}
+			return stats;
+		}
+	  private:
+		std::unordered_multimap<size_t, std::pair<ObjectCacheKey, std::weak_ptr<T>>> m_entries;
+		size_t m_pruneThreshold = 64;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
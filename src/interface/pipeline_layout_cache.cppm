@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <misc/descriptor_set_create_info.h>
+
+export module pragma.prosper.vulkan:pipeline_layout_cache;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Hash-consed descriptor set layouts and pipeline layouts. Pipelines with identical layouts share the same
+	// Anvil create infos, which allows Anvil's pipeline layout manager to hand out the same VkPipelineLayout
+	// and keeps descriptor sets compatible between those pipelines.
+	class PR_EXPORT PipelineLayoutCache {
+	  public:
+		struct PR_EXPORT DescriptorSetLayout {
+			~DescriptorSetLayout();
+			size_t hash = 0;
+			// Canonical binding list (binding index, descriptor type, array size, stage flags, binding flags), sorted by binding index
+			std::vector<uint32_t> key;
+			std::unique_ptr<Anvil::DescriptorSetCreateInfo> createInfo;
+			uint32_t refCount = 0;
+
+			// Raw Vulkan objects are only created on demand for pipelines that are not baked through Anvil
+			VkDevice device = VK_NULL_HANDLE;
+			VkDescriptorSetLayout vkDescriptorSetLayout = VK_NULL_HANDLE;
+		};
+		struct PR_EXPORT PipelineLayout {
+			~PipelineLayout();
+			size_t hash = 0;
+			std::vector<std::shared_ptr<DescriptorSetLayout>> descriptorSetLayouts;
+			// Push constant ranges (offset, size, stage flags), sorted
+			std::vector<uint32_t> pushConstantKey;
+			std::vector<const Anvil::DescriptorSetCreateInfo *> descriptorSetCreateInfos;
+			uint32_t refCount = 0;
+
+			VkDevice device = VK_NULL_HANDLE;
+			VkPipelineLayout vkPipelineLayout = VK_NULL_HANDLE;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t pipelineLayoutHits = 0;
+			uint64_t pipelineLayoutMisses = 0;
+			uint64_t descriptorSetLayoutHits = 0;
+			uint64_t descriptorSetLayoutMisses = 0;
+			size_t pipelineLayoutCount = 0;
+			size_t descriptorSetLayoutCount = 0;
+		};
+
+		std::shared_ptr<PipelineLayout> Acquire(const BasePipelineCreateInfo &pipelineCreateInfo);
+		void Release(const std::shared_ptr<PipelineLayout> &layout);
+		// Creates the VkPipelineLayout for the specified layout if it doesn't exist yet
+		VkPipelineLayout GetVkPipelineLayout(VkDevice device, PipelineLayout &layout);
+		void Clear();
+		Stats GetStats() const;
+	  private:
+		std::shared_ptr<DescriptorSetLayout> AcquireDescriptorSetLayout(DescriptorSetCreateInfo &dsInfo);
+		void ReleaseDescriptorSetLayout(const std::shared_ptr<DescriptorSetLayout> &layout);
+
+		std::unordered_multimap<size_t, std::shared_ptr<PipelineLayout>> m_pipelineLayouts;
+		std::unordered_multimap<size_t, std::shared_ptr<DescriptorSetLayout>> m_descriptorSetLayouts;
+		Stats m_stats {};
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
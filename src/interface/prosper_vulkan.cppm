@@ -10,15 +10,26 @@ export import :debug;
 export import :image;
 export import :query;
 export import :raytracing;
+export import :spirv;
 
 export import :command_buffer;
 export import :context;
+export import :deferred_destruction_queue;
+export import :descriptor_set_allocator;
 export import :descriptor_set_group;
 export import :event;
 export import :fence;
 export import :framebuffer;
+export import :graphics_pipeline_library;
+export import :memory_budget;
+export import :memory_defragmenter;
 export import :memory_tracker;
+export import :memory_type_table;
+export import :object_cache;
 export import :pipeline_cache;
+export import :pipeline_layout_cache;
 export import :render_pass;
+export import :shader_module_cache;
 export import :util;
+export import :virtual_texture;
 export import :window;
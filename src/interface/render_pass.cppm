@@ -22,8 +22,16 @@ export namespace prosper {
 		virtual void Bake() override;
 
 		virtual const void *GetInternalHandle() const override { return m_renderPass ? m_renderPass->get_render_pass() : nullptr; }
+
+		// Returns a mask of the attachments that are stored, but whose contents are discarded anyway because the framebuffer image
+		// is a transient attachment
+		uint64_t GetDiscardableAttachmentMask(const IFramebuffer &fb) const;
+		// Returns a compatible render pass with STORE_OP_DONT_CARE for the specified attachments
+		VlkRenderPass &GetDontCareStoreVariant(uint64_t attachmentMask);
 	  protected:
 		VlkRenderPass(IPrContext &context, const util::RenderPassCreateInfo &createInfo, std::unique_ptr<Anvil::RenderPass, std::function<void(Anvil::RenderPass *)>> rp);
 		std::unique_ptr<Anvil::RenderPass, std::function<void(Anvil::RenderPass *)>> m_renderPass = nullptr;
+		std::unordered_map<uint64_t, std::shared_ptr<IRenderPass>> m_dontCareStoreVariants;
+		std::mutex m_variantMutex;
 	};
 };
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+#include <wrappers/shader_module.h>
+
+export module pragma.prosper.vulkan:shader_module_cache;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	// Shares shader modules with identical SPIR-V code (and entry points) between pipelines
+	class PR_EXPORT ShaderModuleCache {
+	  public:
+		struct PR_EXPORT Entry {
+			size_t hash = 0;
+			std::vector<unsigned int> spirv;
+			std::string entrypoints;
+			Anvil::ShaderModuleUniquePtr module = nullptr;
+			// Only available if VK_EXT_shader_module_identifier is enabled. Used to create pipeline libraries from the pipeline cache.
+			std::vector<uint8_t> identifier;
+			uint32_t refCount = 0;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			size_t moduleCount = 0;
+			size_t moduleReferenceCount = 0;
+			size_t spirvSize = 0;
+			// Size of the SPIR-V code that would have been uploaded to the driver without deduplication
+			size_t spirvSizeSaved = 0;
+		};
+
+		ShaderModuleCache() = default;
+		ShaderModuleCache(const ShaderModuleCache &) = delete;
+		ShaderModuleCache &operator=(const ShaderModuleCache &) = delete;
+
+		void SetShaderModuleIdentifiersEnabled(Anvil::BaseDevice &dev, bool enabled);
+		std::shared_ptr<Entry> Acquire(Anvil::BaseDevice &dev, const ShaderModule &module);
+		void Release(const std::shared_ptr<Entry> &entry);
+		void Clear();
+		Stats GetStats() const;
+	  private:
+		std::unordered_multimap<size_t, std::shared_ptr<Entry>> m_entries;
+		PFN_vkGetShaderModuleIdentifierEXT m_vkGetShaderModuleIdentifierEXT = nullptr;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		mutable std::mutex m_mutex;
+	};
+};
+#pragma warning(pop)
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "util_enum_flags.hpp"
+
+export module pragma.prosper.vulkan:spirv.optimizer;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	namespace spirv {
+		enum class OptimizationFlags : uint32_t {
+			None = 0u,
+			PerformancePassesBit = 1u,
+			StripDeadCodeBit = PerformancePassesBit << 1u,
+			StripUnusedBindingsBit = StripDeadCodeBit << 1u,
+			// Bakes the default values of all specialization constants into the module.
+			// Only safe for shaders that never override their specialization constants at pipeline creation!
+			FreezeSpecializationConstantsBit = StripUnusedBindingsBit << 1u,
+
+			Default = PerformancePassesBit | StripDeadCodeBit | StripUnusedBindingsBit
+		};
+
+		struct PR_EXPORT OptimizationSettings {
+			OptimizationFlags flags = OptimizationFlags::None;
+			// If enabled, the instruction count before and after optimization is logged for every shader
+			bool report = false;
+		};
+
+		struct PR_EXPORT OptimizationReport {
+			std::string shader;
+			uint32_t instructionCountBefore = 0;
+			uint32_t instructionCountAfter = 0;
+			size_t sizeBefore = 0;
+			size_t sizeAfter = 0;
+			bool success = false;
+			std::string ToString() const;
+		};
+
+		PR_EXPORT uint32_t count_instructions(const std::vector<unsigned int> &spirv);
+		PR_EXPORT bool optimize(const std::vector<unsigned int> &spirv, std::vector<unsigned int> &outSpirv, OptimizationFlags flags, std::string *optOutErrMsg = nullptr);
+
+		// Returns the cache location for the optimized variant of a cached SPIR-V file, i.e. "cache/<root>/spirv_opt/<flags>/...".
+		// Every combination of optimization flags has its own directory, so changing the flags never serves stale results.
+		PR_EXPORT std::string get_optimized_cache_path(const std::string &shaderRootPath, OptimizationFlags flags);
+
+		// Optimizes all SPIR-V files found in "cache/<root>/spirv" without requiring a device.
+		// If writeResults is false, the cache is left untouched and only the report is generated.
+		PR_EXPORT std::vector<OptimizationReport> optimize_cache(const std::string &shaderRootPath, OptimizationFlags flags, bool writeResults = true);
+	};
+	using namespace pragma::math::scoped_enum::bitwise;
+};
+export {
+	REGISTER_ENUM_FLAGS(prosper::spirv::OptimizationFlags)
+}
+#pragma warning(pop)
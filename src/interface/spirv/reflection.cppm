@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <misc/descriptor_set_create_info.h>
+
+export module pragma.prosper.vulkan:spirv.reflection;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	namespace spirv {
+		struct PR_EXPORT DescriptorBinding {
+			uint32_t set = 0;
+			uint32_t binding = 0;
+			DescriptorType type {};
+			// 0 for runtime-sized arrays
+			uint32_t arraySize = 1;
+			ShaderStageFlags stages {};
+			std::string name;
+		};
+
+		struct PR_EXPORT PushConstantRange {
+			uint32_t offset = 0;
+			uint32_t size = 0;
+			ShaderStageFlags stages {};
+		};
+
+		struct PR_EXPORT ReflectionData {
+			ShaderStageFlags stages {};
+			// Sorted by set and binding index
+			std::vector<DescriptorBinding> bindings;
+			std::vector<PushConstantRange> pushConstantRanges;
+
+			// Combines the reflection data of multiple stages of the same pipeline
+			void Merge(const ReflectionData &other);
+			const DescriptorBinding *FindBinding(uint32_t set, uint32_t binding) const;
+			uint32_t GetSetCount() const;
+		};
+
+		struct PR_EXPORT LayoutIssue {
+			enum class Severity : uint8_t {
+				// The declared layout is incompatible with the shader
+				Error = 0,
+				// The declared layout works, but declares bindings or stages the shader does not use
+				Redundant,
+			};
+			Severity severity = Severity::Error;
+			std::string message;
+		};
+
+		PR_EXPORT std::optional<ReflectionData> reflect(const std::vector<unsigned int> &spirv, std::string *optOutErrMsg = nullptr);
+
+		// Compares the reflected data with the hand-written layout of a pipeline
+		PR_EXPORT std::vector<LayoutIssue> validate_pipeline_layout(const ReflectionData &reflectionData, const BasePipelineCreateInfo &pipelineCreateInfo);
+
+		// Generates the descriptor set layouts required by the reflected shader stages
+		PR_EXPORT std::vector<std::unique_ptr<Anvil::DescriptorSetCreateInfo>> to_anvil_descriptor_set_create_infos(const ReflectionData &reflectionData);
+	};
+};
+#pragma warning(pop)
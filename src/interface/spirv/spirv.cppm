@@ -0,0 +1,8 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module pragma.prosper.vulkan:spirv;
+export import :spirv.optimizer;
+export import :spirv.reflection;
@@ -18,6 +18,10 @@ export namespace prosper {
 		PR_EXPORT std::vector<util::VendorDeviceInfo> get_available_vendor_devices(const IPrContext &context);
 		PR_EXPORT std::optional<util::PhysicalDeviceMemoryProperties> get_physical_device_memory_properties(const IPrContext &context);
 		PR_EXPORT bool get_memory_stats(IPrContext &context, MemoryPropertyFlags memPropFlags, DeviceSize &outAvailableSize, DeviceSize &outAllocatedSize, std::vector<uint32_t> *optOutMemIndices = nullptr);
+		// Copies to write-combined (uncached host-visible) memory with non-temporal stores, which bypass the CPU caches
+		PR_EXPORT void copy_write_combined(void *dst, const void *src, size_t size);
+		// True for stencil-only and combined depth/stencil formats
+		PR_EXPORT bool has_stencil_aspect(Format format);
 	};
 	std::unique_ptr<Anvil::DescriptorSetCreateInfo> ToAnvilDescriptorSetInfo(const DescriptorSetInfo &descSetInfo);
 	PR_EXPORT bool glsl_to_spv(IPrContext &context, prosper::ShaderStage stage, const std::string &shaderRootPath, const std::string &fileName, std::vector<unsigned int> &spirv, std::string *infoLog, std::string *debugInfoLog, bool bReload, const std::string &prefixCode = {},
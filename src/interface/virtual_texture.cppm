@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "vulkan_api.hpp"
+
+export module pragma.prosper.vulkan:virtual_texture;
+
+export import pragma.prosper;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+export namespace prosper {
+	class VlkContext;
+	// Streams the tiles of a very large texture on demand. Shaders write the ids of the tiles they would like to sample into the
+	// feedback buffer (see VirtualTexture::Tile::Pack), which are then loaded through the tile loader and kept in an LRU tile cache.
+	// If sparse residency is supported, the tiles are bound directly to a sparse image. Otherwise the tiles are placed in a physical
+	// tile atlas, with an indirection texture mapping each virtual tile to the atlas.
+	class PR_EXPORT VirtualTexture {
+	  public:
+		struct PR_EXPORT Tile {
+			// Packed layout: mip (4 bits) | y (14 bits) | x (14 bits)
+			static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+			static constexpr uint32_t Pack(uint32_t x, uint32_t y, uint32_t mip) { return (mip << 28) | ((y & 0x3FFF) << 14) | (x & 0x3FFF); }
+			static Tile Unpack(uint32_t id) { return {id & 0x3FFF, (id >> 14) & 0x3FFF, id >> 28}; }
+			uint32_t Pack() const { return Pack(x, y, mip); }
+			uint32_t x = 0;
+			uint32_t y = 0;
+			uint32_t mip = 0;
+		};
+		struct PR_EXPORT TileRegion {
+			Tile tile;
+			// Texel region covered by the tile within its mipmap
+			uint32_t offsetX = 0;
+			uint32_t offsetY = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+		};
+		// Has to write width * height tightly packed texels of the texture format to 'data'
+		using TileLoader = std::function<bool(const TileRegion &region, void *data, DeviceSize size)>;
+		struct PR_EXPORT CreateInfo {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			Format format = Format::R8G8B8A8_UNorm;
+			// Tile size of the software fallback; The sparse path uses the sparse block size of the format
+			uint32_t tileSize = 128;
+			// Number of tiles that can be resident at the same time
+			uint32_t physicalTileCount = 256;
+			uint32_t maxUploadsPerUpdate = 16;
+			uint32_t feedbackCapacity = 4096;
+			// Number of frames that can be in flight, usually the number of swapchain images
+			uint32_t frameCount = 3;
+			bool allowSparse = true;
+			std::string debugName;
+		};
+		struct PR_EXPORT Stats {
+			uint64_t requests = 0;
+			uint64_t uploads = 0;
+			uint64_t evictions = 0;
+			uint64_t sparseBindSubmissions = 0;
+			uint32_t residentTiles = 0;
+			uint32_t pendingTiles = 0;
+		};
+
+		// Returns nullptr if the texture could not be created. Falls back to the software path if sparse residency is not supported
+		// for the format, or if createInfo.allowSparse is false.
+		static std::shared_ptr<VirtualTexture> Create(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader);
+		virtual ~VirtualTexture();
+
+		// Processes the feedback that was written by the last frame that used the specified frame index, streams in the requested tiles
+		// and records the uploads to the command buffer. The command buffer must not be inside a render pass.
+		// Has to be called once per frame with the index of the swapchain image, before any shader writes to the feedback buffer.
+		// For sparse textures the command buffer has to be submitted through the context (or as the frame's command buffer), since the
+		// submission has to wait on the sparse binding operations.
+		void Update(ICommandBuffer &cmd, uint32_t frameIndex);
+		// Adds tile requests from the CPU (e.g. for prefetching)
+		void RequestTiles(const uint32_t *tileIds, uint32_t count);
+
+		// Storage buffer the shaders write the requested tile ids to. The first uint32 is an atomic counter, followed by feedbackCapacity ids.
+		IBuffer &GetFeedbackBuffer(uint32_t frameIndex) const { return *m_feedbackBuffers[frameIndex % m_feedbackBuffers.size()]; }
+		// The sparse image or the physical tile atlas
+		IImage &GetImage() const { return *m_image; }
+		// R8G8B8A8_UInt texture with one texel per tile and a mipmap per virtual mipmap; (atlas x, atlas y, mip of the resident tile, 1 if exact)
+		// Only available for the software path
+		IImage *GetIndirectionImage() const { return m_indirectionImage.get(); }
+		virtual bool IsSparse() const = 0;
+		uint32_t GetTileWidth() const { return m_tileWidth; }
+		uint32_t GetTileHeight() const { return m_tileHeight; }
+		uint32_t GetTileCountX(uint32_t mip) const;
+		uint32_t GetTileCountY(uint32_t mip) const;
+		// Number of mipmaps that are streamed in tiles
+		uint32_t GetTiledMipCount() const { return m_tiledMipCount; }
+		bool IsResident(const Tile &tile) const;
+		const Stats &GetStats() const { return m_stats; }
+	  protected:
+		struct Slot {
+			uint32_t tile = Tile::INVALID;
+			uint64_t lastUsedFrame = 0;
+			bool pinned = false;
+			std::list<uint32_t>::iterator lruIt;
+		};
+		struct Upload {
+			TileRegion region;
+			uint32_t slot = 0;
+			// Tile that previously occupied the slot
+			uint32_t evictedTile = Tile::INVALID;
+			DeviceSize stagingOffset = 0;
+		};
+		VirtualTexture(VlkContext &context, const CreateInfo &createInfo, const TileLoader &tileLoader);
+		bool InitializeBase(uint32_t tileWidth, uint32_t tileHeight, uint32_t tiledMipCount, DeviceSize extraStagingSizePerFrame);
+		TileRegion GetTileRegion(const Tile &tile) const;
+		DeviceSize GetTileByteSize() const;
+		void Touch(uint32_t slot);
+		std::optional<uint32_t> AcquireSlot();
+		void ProcessFeedback(uint32_t frameIndex);
+
+		// Called with all tiles that have been assigned to a slot in this update, before the uploads are recorded
+		virtual bool CommitUploads(const std::vector<Upload> &uploads, uint32_t frameIndex) = 0;
+		virtual void RecordUploads(ICommandBuffer &cmd, IBuffer &stagingBuffer, const std::vector<Upload> &uploads, DeviceSize extraStagingOffset) = 0;
+
+		VlkContext &m_context;
+		CreateInfo m_createInfo;
+		TileLoader m_tileLoader;
+		std::shared_ptr<IImage> m_image;
+		std::shared_ptr<IImage> m_indirectionImage;
+		std::vector<std::shared_ptr<IBuffer>> m_feedbackBuffers;
+		std::shared_ptr<IBuffer> m_stagingBuffer;
+		uint8_t *m_stagingData = nullptr;
+		DeviceSize m_stagingSizePerFrame = 0;
+		uint32_t m_tileWidth = 0;
+		uint32_t m_tileHeight = 0;
+		uint32_t m_tiledMipCount = 0;
+		uint64_t m_frame = 0;
+
+		std::vector<Slot> m_slots;
+		// Front is the most recently used slot
+		std::list<uint32_t> m_lru;
+		std::unordered_map<uint32_t, uint32_t> m_residentTiles;
+		std::unordered_set<uint32_t> m_pendingTiles;
+		std::mutex m_requestMutex;
+		std::vector<uint32_t> m_cpuRequests;
+		Stats m_stats {};
+	};
+};
+#pragma warning(pop)